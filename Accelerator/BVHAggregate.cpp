@@ -0,0 +1,1277 @@
+#include "BVHAggregate.h"
+#include "RaySorter.h"
+#include "../Parallel/ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <numeric>
+
+namespace Theia {
+	namespace {
+		constexpr Theia::Float Traversal_Cost = 0.5f;
+		// Most references BVHNode::m_primitive_count can count.
+		constexpr size_t Max_Leaf_References = std::numeric_limits<Theia::UInt16>::max();
+		// Levels above Max_Depth from which halving still brings any UInt32 reference count down to Max_Leaf_References.
+		constexpr Theia::UInt32 Halving_Depth = 18;
+
+		Theia::UInt32 BinIndex(Theia::Float value, Theia::Float min, Theia::Float inverse_width, Theia::UInt32 bin_count) {
+			Theia::Int32 index = Theia::Int32((value - min) * inverse_width);
+			return Theia::UInt32(std::clamp<Theia::Int32>(index, 0, Theia::Int32(bin_count) - 1));
+		}
+
+		Theia::AABB3f ClipAABB(const Theia::AABB3f& aabb, Theia::UInt32 axis, Theia::Float min, Theia::Float max) {
+			Theia::AABB3f clip_aabb = aabb;
+			clip_aabb.m_min[axis] = std::max(clip_aabb.m_min[axis], min);
+			clip_aabb.m_max[axis] = std::min(clip_aabb.m_max[axis], max);
+			return clip_aabb;
+		}
+
+		Theia::Float64 MillisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<Theia::Float64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		template <Theia::UInt32 Width> Theia::UInt32 BlockCount(Theia::UInt32 primitive_count) {
+			return (primitive_count + Width - 1) / Width;
+		}
+
+		template <Theia::UInt32 Width> std::optional<Theia::TriangleBlockIntersection> IntersectTriangleBlocks(std::span<const Theia::TriangleBlock<Width>> blocks, const Theia::Ray& ray, Theia::Float& t_max) {
+			std::optional<Theia::TriangleBlockIntersection> closest_intersection = {};
+			for (const Theia::TriangleBlock<Width>& block : blocks) {
+				std::optional<Theia::TriangleBlockIntersection> block_intersection = Theia::IntersectTriangleBlock(ray, t_max, block);
+				if (block_intersection) {
+					t_max = block_intersection->m_triangle_intersection.m_t;
+					closest_intersection = block_intersection;
+				}
+			}
+			return closest_intersection;
+		}
+
+		// Appends the blocks of one leaf and returns the index of the first.
+		template <Theia::UInt32 Width> Theia::UInt32 PackTriangles(std::span<const Theia::Triangle* const> triangles, std::vector<Theia::TriangleBlock<Width>>& blocks) {
+			Theia::UInt32 block_offset = Theia::UInt32(blocks.size());
+			for (size_t begin = 0; begin < triangles.size(); begin += Width) {
+				blocks.push_back(Theia::Triangle::CreateTriangleBlock<Width>(triangles.subspan(begin, std::min<size_t>(Width, triangles.size() - begin))));
+			}
+			return block_offset;
+		}
+
+		template <Theia::UInt32 Width> bool OccludedTriangleBlocks(std::span<const Theia::TriangleBlock<Width>> blocks, const Theia::Ray& ray, Theia::Float t_max) {
+			for (const Theia::TriangleBlock<Width>& block : blocks) {
+				if (Theia::IntersectTriangleBlock(ray, t_max, block)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Rays whose directions are within ~8 degrees of each other are traced as packets.
+		constexpr Theia::Float Coherent_Cosine = 0.99f;
+
+		typedef struct TraversalRay {
+			Theia::Point3f m_origin;
+			Theia::Vector3f m_inverse_direction;
+			Theia::Int32 m_direction_is_negative[3];
+			Theia::Float m_t_max;
+		} TraversalRay;
+
+		TraversalRay MakeTraversalRay(const Theia::Ray& ray) {
+			TraversalRay traversal_ray;
+			traversal_ray.m_origin = ray.GetOrigin();
+			traversal_ray.m_inverse_direction = 1.0f / ray.GetDirection();
+			for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+				traversal_ray.m_direction_is_negative[axis] = traversal_ray.m_inverse_direction[axis] < 0;
+			}
+			traversal_ray.m_t_max = Theia::Infinity;
+			return traversal_ray;
+		}
+
+		Theia::UInt32 Octant(const Theia::Vector3f& direction) {
+			return (std::signbit(direction.m_x) ? 1 : 0) | (std::signbit(direction.m_y) ? 2 : 0) | (std::signbit(direction.m_z) ? 4 : 0);
+		}
+
+		// Bounds of the interval product [a_min, a_max] * [b_min, b_max], treating 0 * inf as unbounded.
+		Theia::Float ProductLowerBound(Theia::Float a_min, Theia::Float a_max, Theia::Float b_min, Theia::Float b_max) {
+			Theia::Float products[4] = { a_min * b_min, a_min * b_max, a_max * b_min, a_max * b_max };
+			Theia::Float lower_bound = Theia::Infinity;
+			for (Theia::Float product : products) {
+				lower_bound = std::isnan(product) ? -Theia::Infinity : std::min(lower_bound, product);
+			}
+			return lower_bound;
+		}
+
+		Theia::Float ProductUpperBound(Theia::Float a_min, Theia::Float a_max, Theia::Float b_min, Theia::Float b_max) {
+			Theia::Float products[4] = { a_min * b_min, a_min * b_max, a_max * b_min, a_max * b_max };
+			Theia::Float upper_bound = -Theia::Infinity;
+			for (Theia::Float product : products) {
+				upper_bound = std::isnan(product) ? Theia::Infinity : std::max(upper_bound, product);
+			}
+			return upper_bound;
+		}
+
+		// Interval arithmetic slab test: false only if no ray with its origin and inverse direction inside the packet's bounds can hit bounds. All rays must share direction_is_negative.
+		bool PacketIntersectsBounds(const Theia::AABB3f& bounds, const Theia::AABB3f& origin_bounds, const Theia::Vector3f& inverse_direction_min, const Theia::Vector3f& inverse_direction_max, const Theia::Int32 direction_is_negative[3], Theia::Float t_max) {
+			Theia::Float t_near = 0.0f;
+			Theia::Float t_far = t_max;
+			for (Theia::UInt32 axis = 0; axis < 3 && t_near <= t_far; ++axis) {
+				Theia::Float near_plane = direction_is_negative[axis] ? bounds.m_max[axis] : bounds.m_min[axis];
+				Theia::Float far_plane = direction_is_negative[axis] ? bounds.m_min[axis] : bounds.m_max[axis];
+				t_near = std::max(t_near, ProductLowerBound(near_plane - origin_bounds.m_max[axis], near_plane - origin_bounds.m_min[axis], inverse_direction_min[axis], inverse_direction_max[axis]));
+				t_far = std::min(t_far, ProductUpperBound(far_plane - origin_bounds.m_max[axis], far_plane - origin_bounds.m_min[axis], inverse_direction_min[axis], inverse_direction_max[axis]) * (1 + 2 * Theia::Gamma(3)));
+			}
+			return t_near <= t_far;
+		}
+	}
+
+	BVHAggregate::BVHAggregate(std::vector<Theia::Primitive> primitives, const Theia::BVHBuildOptions& options) :
+		m_options(options),
+		m_statistics({}),
+		m_root_surface_area(0.0f)
+	{
+		m_statistics.m_primitive_count = Theia::UInt32(primitives.size());
+		if (primitives.empty()) {
+			return;
+		}
+
+		std::vector<PrimitiveReference> references(primitives.size());
+		Theia::AABB3f bounds;
+		for (Theia::UInt32 i = 0; i < primitives.size(); ++i) {
+			references[i] = CreateReference(primitives[i]->Bounds(), primitives[i]);
+			bounds = Theia::Union(bounds, references[i].m_bounds);
+		}
+		m_root_surface_area = bounds.SurfaceArea();
+
+		Theia::Int64 split_budget = 0;
+		if (m_options.m_split_method == Theia::BVHSplitMethod::SpatialSAH) {
+			split_budget = Theia::Int64(primitives.size() * m_options.m_spatial_split_budget);
+		}
+
+		BuildOutput output;
+		output.m_nodes.reserve(2 * primitives.size());
+		output.m_ordered_primitives.reserve(primitives.size() + split_budget);
+		Build(output, references, 0, split_budget);
+
+		m_nodes = std::move(output.m_nodes);
+		m_ordered_primitives = std::move(output.m_ordered_primitives);
+		m_nodes.shrink_to_fit();
+		m_ordered_primitives.shrink_to_fit();
+		m_statistics.m_max_depth = output.m_max_depth;
+		m_statistics.m_spatial_split_count = output.m_spatial_split_count;
+
+		FindSubtrees(0, 0);
+		for (Subtree& subtree : m_subtrees) {
+			subtree.m_built_cost = SubtreeCost(subtree.m_root);
+		}
+
+		PackTriangleLeaves();
+		ComputeStatistics();
+	}
+
+	BVHAggregate::BVHAggregate(std::vector<Theia::Primitive> ordered_primitives, std::span<const Theia::BVHNode> nodes, const Theia::BVHStatistics& build_statistics, const Theia::BVHBuildOptions& options) :
+		m_ordered_primitives(std::move(ordered_primitives)),
+		m_nodes(nodes.begin(), nodes.end()),
+		m_options(options),
+		m_statistics({}),
+		m_root_surface_area(0.0f)
+	{
+		m_statistics.m_primitive_count = build_statistics.m_primitive_count;
+		m_statistics.m_spatial_split_count = build_statistics.m_spatial_split_count;
+		m_statistics.m_max_depth = build_statistics.m_max_depth;
+		if (m_nodes.empty()) {
+			return;
+		}
+		m_root_surface_area = m_nodes[0].m_bounds.SurfaceArea();
+
+		FindSubtrees(0, 0);
+		for (Subtree& subtree : m_subtrees) {
+			subtree.m_built_cost = SubtreeCost(subtree.m_root);
+		}
+
+		PackTriangleLeaves();
+		ComputeStatistics();
+	}
+
+	Theia::AABB3f BVHAggregate::Bounds() const {
+		return m_nodes.empty() ? Theia::AABB3f() : m_nodes[0].m_bounds;
+	}
+
+	std::optional<Theia::ShapeIntersection> BVHAggregate::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		if (m_nodes.empty()) {
+			return {};
+		}
+
+		ClosestHit closest_hit;
+		Theia::Point3f origin = ray.GetOrigin();
+		Theia::Vector3f inverse_direction = 1.0f / ray.GetDirection();
+		Theia::Int32 direction_is_negative[3] = { inverse_direction.m_x < 0, inverse_direction.m_y < 0, inverse_direction.m_z < 0 };
+
+		Theia::UInt32 nodes_to_visit[Max_Depth];
+		Theia::UInt32 to_visit_offset = 0;
+		Theia::UInt32 current_node_index = 0;
+
+		while (true) {
+			const Theia::BVHNode& node = m_nodes[current_node_index];
+			if (node.m_bounds.IntersectP(origin, inverse_direction, direction_is_negative, t_max)) {
+				if (node.m_primitive_count > 0) {
+					IntersectLeaf(current_node_index, ray, t_max, closest_hit);
+
+					if (to_visit_offset == 0) {
+						break;
+					}
+					current_node_index = nodes_to_visit[--to_visit_offset];
+				}
+				else {
+					if (direction_is_negative[node.m_axis]) {
+						nodes_to_visit[to_visit_offset++] = current_node_index + 1;
+						current_node_index = node.m_second_child_offset;
+					}
+					else {
+						nodes_to_visit[to_visit_offset++] = node.m_second_child_offset;
+						current_node_index = current_node_index + 1;
+					}
+				}
+			}
+			else {
+				if (to_visit_offset == 0) {
+					break;
+				}
+				current_node_index = nodes_to_visit[--to_visit_offset];
+			}
+		}
+
+		return ResolveClosestHit(closest_hit, ray);
+	}
+
+	bool BVHAggregate::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		if (m_nodes.empty()) {
+			return false;
+		}
+
+		Theia::Point3f origin = ray.GetOrigin();
+		Theia::Vector3f inverse_direction = 1.0f / ray.GetDirection();
+		Theia::Int32 direction_is_negative[3] = { inverse_direction.m_x < 0, inverse_direction.m_y < 0, inverse_direction.m_z < 0 };
+
+		// Any hit ends the query, so children are visited in storage order.
+		Theia::UInt32 nodes_to_visit[Max_Depth];
+		Theia::UInt32 to_visit_offset = 0;
+		Theia::UInt32 current_node_index = 0;
+
+		while (true) {
+			const Theia::BVHNode& node = m_nodes[current_node_index];
+			if (node.m_bounds.IntersectP(origin, inverse_direction, direction_is_negative, t_max)) {
+				if (node.m_primitive_count > 0) {
+					if (OccludedLeaf(current_node_index, ray, t_max)) {
+						return true;
+					}
+
+					if (to_visit_offset == 0) {
+						break;
+					}
+					current_node_index = nodes_to_visit[--to_visit_offset];
+				}
+				else {
+					nodes_to_visit[to_visit_offset++] = node.m_second_child_offset;
+					current_node_index = current_node_index + 1;
+				}
+			}
+			else {
+				if (to_visit_offset == 0) {
+					break;
+				}
+				current_node_index = nodes_to_visit[--to_visit_offset];
+			}
+		}
+
+		return false;
+	}
+
+	void BVHAggregate::Intersect(std::span<const Theia::Ray> rays, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections, Theia::BVHTraversal traversal) const {
+		assert(rays.size() == shape_intersections.size(), "BVHAggregate::Intersect needs one result per ray.");
+		if (traversal == Theia::BVHTraversal::Single) {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				shape_intersections[i] = Intersect(rays[i]);
+			}
+			return;
+		}
+
+		if (traversal == Theia::BVHTraversal::Stream) {
+			std::vector<Theia::UInt32> ray_indices;
+			for (size_t begin = 0; begin < rays.size(); begin += Stream_Size) {
+				ray_indices.resize(std::min<size_t>(Stream_Size, rays.size() - begin));
+				std::iota(ray_indices.begin(), ray_indices.end(), Theia::UInt32(begin));
+				IntersectStream(rays, ray_indices, shape_intersections);
+			}
+			return;
+		}
+
+		// Packets are cut from consecutive rays; with Automatic, incoherent ones are traced one by one.
+		for (size_t begin = 0; begin < rays.size(); begin += Packet_Size) {
+			size_t count = std::min<size_t>(Packet_Size, rays.size() - begin);
+			std::span<const Theia::Ray> packet = rays.subspan(begin, count);
+			if (traversal == Theia::BVHTraversal::Packet || ChooseTraversal(packet) == Theia::BVHTraversal::Packet) {
+				IntersectPacket(packet, shape_intersections.subspan(begin, count));
+			}
+			else {
+				for (size_t i = begin; i < begin + count; ++i) {
+					shape_intersections[i] = Intersect(rays[i]);
+				}
+			}
+		}
+	}
+
+	void BVHAggregate::Occluded(std::span<const Theia::Ray> rays, std::span<const Theia::Float> t_max, std::span<bool> occluded) const {
+		assert(rays.size() == t_max.size() && rays.size() == occluded.size(), "BVHAggregate::Occluded needs one t_max and one result per ray.");
+		for (size_t begin = 0; begin < rays.size(); begin += Packet_Size) {
+			size_t count = std::min<size_t>(Packet_Size, rays.size() - begin);
+			std::span<const Theia::Ray> packet = rays.subspan(begin, count);
+			if (ChooseTraversal(packet) == Theia::BVHTraversal::Packet) {
+				OccludedPacket(packet, t_max.subspan(begin, count), occluded.subspan(begin, count));
+			}
+			else {
+				for (size_t i = begin; i < begin + count; ++i) {
+					occluded[i] = Occluded(rays[i], t_max[i]);
+				}
+			}
+		}
+	}
+
+	void BVHAggregate::Intersect(std::span<const Theia::Ray> rays, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections, Theia::RaySorter& ray_sorter, Theia::BVHTraversal traversal) const {
+		assert(rays.size() == shape_intersections.size(), "BVHAggregate::Intersect needs one result per ray.");
+		ray_sorter.Sort(rays);
+		std::span<const Theia::UInt32> order = ray_sorter.GetOrder();
+		std::vector<Theia::Ray> sorted_rays;
+		sorted_rays.reserve(rays.size());
+		for (Theia::UInt32 index : order) {
+			sorted_rays.push_back(rays[index]);
+		}
+
+		std::vector<std::optional<Theia::ShapeIntersection>> sorted_intersections(rays.size());
+		Intersect(sorted_rays, sorted_intersections, traversal);
+		for (size_t i = 0; i < order.size(); ++i) {
+			shape_intersections[order[i]] = std::move(sorted_intersections[i]);
+		}
+	}
+
+	void BVHAggregate::Occluded(std::span<const Theia::Ray> rays, std::span<const Theia::Float> t_max, std::span<bool> occluded, Theia::RaySorter& ray_sorter) const {
+		assert(rays.size() == t_max.size() && rays.size() == occluded.size(), "BVHAggregate::Occluded needs one t_max and one result per ray.");
+		ray_sorter.Sort(rays);
+		std::span<const Theia::UInt32> order = ray_sorter.GetOrder();
+		std::vector<Theia::Ray> sorted_rays;
+		std::vector<Theia::Float> sorted_t_max;
+		sorted_rays.reserve(rays.size());
+		sorted_t_max.reserve(rays.size());
+		for (Theia::UInt32 index : order) {
+			sorted_rays.push_back(rays[index]);
+			sorted_t_max.push_back(t_max[index]);
+		}
+
+		std::unique_ptr<bool[]> sorted_occluded(new bool[rays.size()]);
+		Occluded(sorted_rays, sorted_t_max, std::span<bool>(sorted_occluded.get(), rays.size()));
+		for (size_t i = 0; i < order.size(); ++i) {
+			occluded[order[i]] = sorted_occluded[i];
+		}
+	}
+
+	Theia::BVHTraversal BVHAggregate::ChooseTraversal(std::span<const Theia::Ray> rays) {
+		if (rays.size() <= 1) {
+			return Theia::BVHTraversal::Single;
+		}
+
+		Theia::Vector3f first_direction = Theia::Normalize(rays[0].GetDirection());
+		Theia::UInt32 octant = Octant(first_direction);
+		for (const Theia::Ray& ray : rays) {
+			Theia::Vector3f direction = Theia::Normalize(ray.GetDirection());
+			if (Octant(direction) != octant || Theia::Dot(direction, first_direction) < Coherent_Cosine) {
+				return Theia::BVHTraversal::Single;
+			}
+		}
+		return Theia::BVHTraversal::Packet;
+	}
+
+	// Interval arithmetic packet traversal: nodes are culled for the whole packet at once, leaves are tested per ray.
+	void BVHAggregate::IntersectPacket(std::span<const Theia::Ray> rays, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections) const {
+		assert(rays.size() <= Packet_Size, "BVHAggregate::IntersectPacket packet is too large.");
+		if (m_nodes.empty() || rays.empty()) {
+			return;
+		}
+
+		TraversalRay traversal_rays[Packet_Size];
+		ClosestHit closest_hits[Packet_Size];
+		Theia::AABB3f origin_bounds;
+		Theia::Vector3f inverse_direction_min(Theia::Infinity, Theia::Infinity, Theia::Infinity);
+		Theia::Vector3f inverse_direction_max(-Theia::Infinity, -Theia::Infinity, -Theia::Infinity);
+		Theia::UInt32 octant = Octant(rays[0].GetDirection());
+		for (size_t i = 0; i < rays.size(); ++i) {
+			// The interval test needs one sign per axis for the whole packet.
+			if (Octant(rays[i].GetDirection()) != octant) {
+				for (size_t j = 0; j < rays.size(); ++j) {
+					shape_intersections[j] = Intersect(rays[j]);
+				}
+				return;
+			}
+
+			traversal_rays[i] = MakeTraversalRay(rays[i]);
+			origin_bounds = Theia::Union(origin_bounds, traversal_rays[i].m_origin);
+			for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+				inverse_direction_min[axis] = std::min(inverse_direction_min[axis], traversal_rays[i].m_inverse_direction[axis]);
+				inverse_direction_max[axis] = std::max(inverse_direction_max[axis], traversal_rays[i].m_inverse_direction[axis]);
+			}
+		}
+		const Theia::Int32* direction_is_negative = traversal_rays[0].m_direction_is_negative;
+		Theia::Float packet_t_max = Theia::Infinity;
+
+		Theia::UInt32 nodes_to_visit[Max_Depth];
+		Theia::UInt32 to_visit_offset = 0;
+		Theia::UInt32 current_node_index = 0;
+
+		while (true) {
+			const Theia::BVHNode& node = m_nodes[current_node_index];
+			if (PacketIntersectsBounds(node.m_bounds, origin_bounds, inverse_direction_min, inverse_direction_max, direction_is_negative, packet_t_max)) {
+				if (node.m_primitive_count > 0) {
+					packet_t_max = 0.0f;
+					for (size_t i = 0; i < rays.size(); ++i) {
+						TraversalRay& traversal_ray = traversal_rays[i];
+						if (node.m_bounds.IntersectP(traversal_ray.m_origin, traversal_ray.m_inverse_direction, traversal_ray.m_direction_is_negative, traversal_ray.m_t_max)) {
+							IntersectLeaf(current_node_index, rays[i], traversal_ray.m_t_max, closest_hits[i]);
+						}
+						packet_t_max = std::max(packet_t_max, traversal_ray.m_t_max);
+					}
+
+					if (to_visit_offset == 0) {
+						break;
+					}
+					current_node_index = nodes_to_visit[--to_visit_offset];
+				}
+				else {
+					if (direction_is_negative[node.m_axis]) {
+						nodes_to_visit[to_visit_offset++] = current_node_index + 1;
+						current_node_index = node.m_second_child_offset;
+					}
+					else {
+						nodes_to_visit[to_visit_offset++] = node.m_second_child_offset;
+						current_node_index = current_node_index + 1;
+					}
+				}
+			}
+			else {
+				if (to_visit_offset == 0) {
+					break;
+				}
+				current_node_index = nodes_to_visit[--to_visit_offset];
+			}
+		}
+
+		for (size_t i = 0; i < rays.size(); ++i) {
+			shape_intersections[i] = ResolveClosestHit(closest_hits[i], rays[i]);
+		}
+	}
+
+	// Packet any-hit traversal: rays drop out of the packet as soon as they are occluded, and the traversal ends when none are left.
+	void BVHAggregate::OccludedPacket(std::span<const Theia::Ray> rays, std::span<const Theia::Float> t_max, std::span<bool> occluded) const {
+		assert(rays.size() <= Packet_Size, "BVHAggregate::OccludedPacket packet is too large.");
+		if (rays.empty()) {
+			return;
+		}
+
+		TraversalRay traversal_rays[Packet_Size];
+		Theia::AABB3f origin_bounds;
+		Theia::Vector3f inverse_direction_min(Theia::Infinity, Theia::Infinity, Theia::Infinity);
+		Theia::Vector3f inverse_direction_max(-Theia::Infinity, -Theia::Infinity, -Theia::Infinity);
+		Theia::Float packet_t_max = 0.0f;
+		Theia::UInt32 octant = Octant(rays[0].GetDirection());
+		for (size_t i = 0; i < rays.size(); ++i) {
+			if (Octant(rays[i].GetDirection()) != octant) {
+				for (size_t j = 0; j < rays.size(); ++j) {
+					occluded[j] = Occluded(rays[j], t_max[j]);
+				}
+				return;
+			}
+
+			traversal_rays[i] = MakeTraversalRay(rays[i]);
+			traversal_rays[i].m_t_max = t_max[i];
+			occluded[i] = false;
+			origin_bounds = Theia::Union(origin_bounds, traversal_rays[i].m_origin);
+			for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+				inverse_direction_min[axis] = std::min(inverse_direction_min[axis], traversal_rays[i].m_inverse_direction[axis]);
+				inverse_direction_max[axis] = std::max(inverse_direction_max[axis], traversal_rays[i].m_inverse_direction[axis]);
+			}
+			packet_t_max = std::max(packet_t_max, t_max[i]);
+		}
+		if (m_nodes.empty()) {
+			return;
+		}
+		const Theia::Int32* direction_is_negative = traversal_rays[0].m_direction_is_negative;
+		size_t active_count = rays.size();
+
+		Theia::UInt32 nodes_to_visit[Max_Depth];
+		Theia::UInt32 to_visit_offset = 0;
+		Theia::UInt32 current_node_index = 0;
+
+		while (true) {
+			const Theia::BVHNode& node = m_nodes[current_node_index];
+			if (PacketIntersectsBounds(node.m_bounds, origin_bounds, inverse_direction_min, inverse_direction_max, direction_is_negative, packet_t_max)) {
+				if (node.m_primitive_count > 0) {
+					for (size_t i = 0; i < rays.size(); ++i) {
+						const TraversalRay& traversal_ray = traversal_rays[i];
+						if (occluded[i] || !node.m_bounds.IntersectP(traversal_ray.m_origin, traversal_ray.m_inverse_direction, traversal_ray.m_direction_is_negative, traversal_ray.m_t_max)) {
+							continue;
+						}
+						if (OccludedLeaf(current_node_index, rays[i], traversal_ray.m_t_max)) {
+							occluded[i] = true;
+							--active_count;
+						}
+					}
+
+					if (active_count == 0 || to_visit_offset == 0) {
+						break;
+					}
+					current_node_index = nodes_to_visit[--to_visit_offset];
+				}
+				else {
+					nodes_to_visit[to_visit_offset++] = node.m_second_child_offset;
+					current_node_index = current_node_index + 1;
+				}
+			}
+			else {
+				if (to_visit_offset == 0) {
+					break;
+				}
+				current_node_index = nodes_to_visit[--to_visit_offset];
+			}
+		}
+	}
+
+	// Ray stream filtering: every node is visited once for all the rays that reach it, and its children only see the rays that hit its bounds.
+	void BVHAggregate::IntersectStream(std::span<const Theia::Ray> rays, std::span<const Theia::UInt32> ray_indices, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections) const {
+		if (m_nodes.empty() || ray_indices.empty()) {
+			return;
+		}
+
+		std::vector<TraversalRay> traversal_rays(ray_indices.size());
+		std::vector<ClosestHit> closest_hits(ray_indices.size());
+		for (size_t i = 0; i < ray_indices.size(); ++i) {
+			traversal_rays[i] = MakeTraversalRay(rays[ray_indices[i]]);
+		}
+
+		// Active lists of pending nodes live in a stack of slices of the same buffer, so popping a node frees every list above its own.
+		typedef struct StreamEntry {
+			Theia::UInt32 m_node_index;
+			size_t m_begin, m_count;
+		} StreamEntry;
+		std::vector<Theia::UInt32> active(ray_indices.size());
+		std::iota(active.begin(), active.end(), 0u);
+		StreamEntry entries_to_visit[2 * Max_Depth];
+		Theia::UInt32 to_visit_offset = 0;
+		entries_to_visit[to_visit_offset++] = { 0, 0, active.size() };
+
+		while (to_visit_offset > 0) {
+			StreamEntry entry = entries_to_visit[--to_visit_offset];
+			const Theia::BVHNode& node = m_nodes[entry.m_node_index];
+			size_t top = entry.m_begin + entry.m_count;
+			if (active.size() < top + entry.m_count) {
+				active.resize(top + entry.m_count);
+			}
+
+			size_t hit_count = 0;
+			size_t negative_count = 0;
+			for (size_t i = entry.m_begin; i < top; ++i) {
+				const TraversalRay& traversal_ray = traversal_rays[active[i]];
+				if (node.m_bounds.IntersectP(traversal_ray.m_origin, traversal_ray.m_inverse_direction, traversal_ray.m_direction_is_negative, traversal_ray.m_t_max)) {
+					active[top + hit_count++] = active[i];
+					negative_count += traversal_ray.m_direction_is_negative[node.m_axis];
+				}
+			}
+			if (hit_count == 0) {
+				continue;
+			}
+
+			if (node.m_primitive_count > 0) {
+				for (size_t i = top; i < top + hit_count; ++i) {
+					IntersectLeaf(entry.m_node_index, rays[ray_indices[active[i]]], traversal_rays[active[i]].m_t_max, closest_hits[active[i]]);
+				}
+			}
+			else {
+				// The near child is pushed last, in the order of the majority of the active rays.
+				Theia::UInt32 first_child_index = entry.m_node_index + 1;
+				Theia::UInt32 second_child_index = node.m_second_child_offset;
+				if (2 * negative_count > hit_count) {
+					std::swap(first_child_index, second_child_index);
+				}
+				entries_to_visit[to_visit_offset++] = { second_child_index, top, hit_count };
+				entries_to_visit[to_visit_offset++] = { first_child_index, top, hit_count };
+			}
+		}
+
+		for (size_t i = 0; i < ray_indices.size(); ++i) {
+			shape_intersections[ray_indices[i]] = ResolveClosestHit(closest_hits[i], rays[ray_indices[i]]);
+		}
+	}
+
+	void BVHAggregate::IntersectLeaf(Theia::UInt32 node_index, const Theia::Ray& ray, Theia::Float& t_max, ClosestHit& closest_hit) const {
+		const Theia::BVHNode& node = m_nodes[node_index];
+		Theia::UInt32 block_offset = m_leaf_block_offsets.empty() ? Unpacked_Leaf : m_leaf_block_offsets[node_index];
+		if (block_offset == Unpacked_Leaf) {
+			for (Theia::UInt32 i = 0; i < node.m_primitive_count; ++i) {
+				std::optional<Theia::ShapeIntersection> primitive_intersection = m_ordered_primitives[node.m_primitives_offset + i]->Intersect(ray, t_max);
+				if (primitive_intersection) {
+					t_max = primitive_intersection->m_t_hit;
+					// Instances and nested aggregates have already set the primitive inside them.
+					if (!primitive_intersection->m_primitive) {
+						primitive_intersection->m_primitive = m_ordered_primitives[node.m_primitives_offset + i];
+					}
+					closest_hit.m_shape_intersection = std::move(primitive_intersection);
+					closest_hit.m_triangle_block_intersection = {};
+				}
+			}
+			return;
+		}
+
+		std::optional<Theia::TriangleBlockIntersection> triangle_block_intersection = {};
+		if (m_options.m_leaf_format == Theia::BVHLeafFormat::Packed4) {
+			triangle_block_intersection = IntersectTriangleBlocks(std::span(m_triangle_blocks_4).subspan(block_offset, BlockCount<4>(node.m_primitive_count)), ray, t_max);
+		}
+		else {
+			triangle_block_intersection = IntersectTriangleBlocks(std::span(m_triangle_blocks_8).subspan(block_offset, BlockCount<8>(node.m_primitive_count)), ray, t_max);
+		}
+		if (triangle_block_intersection) {
+			closest_hit.m_triangle_block_intersection = triangle_block_intersection;
+			closest_hit.m_shape_intersection = {};
+		}
+	}
+
+	bool BVHAggregate::OccludedLeaf(Theia::UInt32 node_index, const Theia::Ray& ray, Theia::Float t_max) const {
+		const Theia::BVHNode& node = m_nodes[node_index];
+		Theia::UInt32 block_offset = m_leaf_block_offsets.empty() ? Unpacked_Leaf : m_leaf_block_offsets[node_index];
+		if (block_offset == Unpacked_Leaf) {
+			for (Theia::UInt32 i = 0; i < node.m_primitive_count; ++i) {
+				if (m_ordered_primitives[node.m_primitives_offset + i]->Occluded(ray, t_max)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		if (m_options.m_leaf_format == Theia::BVHLeafFormat::Packed4) {
+			return OccludedTriangleBlocks(std::span(m_triangle_blocks_4).subspan(block_offset, BlockCount<4>(node.m_primitive_count)), ray, t_max);
+		}
+		return OccludedTriangleBlocks(std::span(m_triangle_blocks_8).subspan(block_offset, BlockCount<8>(node.m_primitive_count)), ray, t_max);
+	}
+
+	std::optional<Theia::ShapeIntersection> BVHAggregate::ResolveClosestHit(ClosestHit& closest_hit, const Theia::Ray& ray) const {
+		if (closest_hit.m_triangle_block_intersection) {
+			const Theia::Triangle* triangle = closest_hit.m_triangle_block_intersection->m_triangle;
+			Theia::ShapeIntersection shape_intersection = triangle->InteractionFromIntersection(closest_hit.m_triangle_block_intersection->m_triangle_intersection, ray);
+			shape_intersection.m_primitive = triangle;
+			return shape_intersection;
+		}
+		return std::move(closest_hit.m_shape_intersection);
+	}
+
+	Theia::BVHUpdateStatistics BVHAggregate::Update() {
+		Theia::BVHUpdateStatistics update_statistics;
+		if (m_nodes.empty()) {
+			return update_statistics;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Theia::ParallelFor(0, Theia::Int64(m_subtrees.size()), [&](Theia::Int64 i) {
+			RefitNode(m_subtrees[i].m_root, m_subtrees[i].m_depth, std::numeric_limits<Theia::UInt32>::max());
+		});
+		RefitNode(0, 0, Update_Subtree_Depth);
+		update_statistics.m_refit_milliseconds = MillisecondsSince(start);
+
+		std::chrono::steady_clock::time_point rebuild_start = std::chrono::steady_clock::now();
+		std::vector<BuildOutput> rebuilt_subtrees(m_subtrees.size());
+		std::vector<Theia::UInt8> is_rebuilt(m_subtrees.size(), 0);
+		Theia::ParallelFor(0, Theia::Int64(m_subtrees.size()), [&](Theia::Int64 i) {
+			if (SubtreeCost(m_subtrees[i].m_root) > m_options.m_rebuild_threshold * m_subtrees[i].m_built_cost) {
+				rebuilt_subtrees[i] = RebuildSubtree(m_subtrees[i]);
+				is_rebuilt[i] = 1;
+			}
+		});
+
+		// Splicing from the back keeps the node and primitive offsets of the subtrees still to be spliced valid.
+		for (Theia::UInt32 i = Theia::UInt32(m_subtrees.size()); i-- > 0;) {
+			if (!is_rebuilt[i]) {
+				continue;
+			}
+
+			Theia::UInt32 node_count = SubtreeEnd(m_subtrees[i].m_root) - m_subtrees[i].m_root;
+			Theia::Int64 node_delta = Theia::Int64(rebuilt_subtrees[i].m_nodes.size()) - node_count;
+			update_statistics.m_rebuilt_primitive_count += Theia::UInt32(rebuilt_subtrees[i].m_ordered_primitives.size());
+			++update_statistics.m_rebuilt_subtree_count;
+
+			SpliceSubtree(m_subtrees[i], rebuilt_subtrees[i]);
+			m_subtrees[i].m_built_cost = SubtreeCost(m_subtrees[i].m_root);
+			for (Theia::UInt32 j = i + 1; j < m_subtrees.size(); ++j) {
+				m_subtrees[j].m_root = Theia::UInt32(m_subtrees[j].m_root + node_delta);
+			}
+		}
+		update_statistics.m_rebuild_milliseconds = MillisecondsSince(rebuild_start);
+
+		m_root_surface_area = m_nodes[0].m_bounds.SurfaceArea();
+		PackTriangleLeaves();
+		ComputeStatistics();
+		update_statistics.m_sah_cost = m_statistics.m_sah_cost;
+		update_statistics.m_total_milliseconds = MillisecondsSince(start);
+
+		return update_statistics;
+	}
+
+	const Theia::BVHStatistics& BVHAggregate::GetStatistics() const {
+		return m_statistics;
+	}
+
+	const Theia::BVHBuildOptions& BVHAggregate::GetOptions() const {
+		return m_options;
+	}
+
+	std::span<const Theia::BVHNode> BVHAggregate::GetNodes() const {
+		return m_nodes;
+	}
+
+	std::span<const Theia::Primitive> BVHAggregate::GetOrderedPrimitives() const {
+		return m_ordered_primitives;
+	}
+
+	Theia::UInt32 BVHAggregate::Build(BuildOutput& output, std::vector<PrimitiveReference>& references, Theia::UInt32 depth, Theia::Int64 split_budget) const {
+		Theia::UInt32 node_index = Theia::UInt32(output.m_nodes.size());
+		output.m_nodes.push_back(Theia::BVHNode());
+		output.m_max_depth = std::max(output.m_max_depth, depth);
+
+		bool by_meshlet = SpansMeshlets(references);
+		Theia::AABB3f bounds, centroid_bounds;
+		for (const PrimitiveReference& reference : references) {
+			bounds = Theia::Union(bounds, reference.m_bounds);
+			centroid_bounds = Theia::Union(centroid_bounds, SplitCentroid(reference, by_meshlet));
+		}
+		output.m_nodes[node_index].m_bounds = bounds;
+
+		bool fits_in_leaf = references.size() <= Max_Leaf_References;
+		if (references.size() == 1 || (depth + 1 >= Max_Depth && fits_in_leaf)) {
+			CreateLeaf(output, node_index, references);
+			return node_index;
+		}
+
+		// Nodes too large for a leaf are halved once they are too close to Max_Depth for any other split to be safe.
+		bool must_halve = !fits_in_leaf && depth + Halving_Depth >= Max_Depth;
+		Split split = must_halve ? Split() : FindObjectSplit(references, bounds, centroid_bounds, by_meshlet);
+		bool is_spatial_split = false;
+
+		if (split_budget > 0 && !must_halve) {
+			Theia::AABB3f overlap = Theia::Intersection(split.m_left_bounds, split.m_right_bounds);
+			if (split.m_cost == Theia::Infinity || (!overlap.IsEmpty() && overlap.SurfaceArea() > m_options.m_spatial_split_alpha * m_root_surface_area)) {
+				Split spatial_split = FindSpatialSplit(references, bounds);
+				if (spatial_split.m_cost < split.m_cost) {
+					split = spatial_split;
+					is_spatial_split = true;
+				}
+			}
+		}
+
+		Theia::Float leaf_cost = IntersectionCost(Theia::UInt32(references.size()));
+		if (references.size() <= MaxPrimitivesInLeaf() && split.m_cost >= leaf_cost) {
+			CreateLeaf(output, node_index, references);
+			return node_index;
+		}
+
+		std::vector<PrimitiveReference> left, right;
+		Theia::Int64 extra_references = 0;
+
+		if (is_spatial_split) {
+			extra_references = PerformSpatialSplit(references, bounds, split, split_budget, left, right);
+			if (left.empty() || right.empty()) {
+				left.clear();
+				right.clear();
+				extra_references = 0;
+				is_spatial_split = false;
+				split = FindObjectSplit(references, bounds, centroid_bounds, by_meshlet);
+			}
+			else {
+				++output.m_spatial_split_count;
+			}
+		}
+
+		if (!is_spatial_split) {
+			std::vector<PrimitiveReference>::iterator middle;
+			if (split.m_cost == Theia::Infinity) {
+				if (fits_in_leaf) {
+					CreateLeaf(output, node_index, references);
+					return node_index;
+				}
+				// Halves at the median centroid along the widest axis, which for coincident centroids is any half.
+				Theia::Vector3f extent = centroid_bounds.m_max - centroid_bounds.m_min;
+				split.m_axis = extent.m_x > extent.m_y && extent.m_x > extent.m_z ? 0 : (extent.m_y > extent.m_z ? 1 : 2);
+				middle = references.begin() + references.size() / 2;
+				std::nth_element(references.begin(), middle, references.end(), [&](const PrimitiveReference& a, const PrimitiveReference& b) {
+					return SplitCentroid(a, by_meshlet)[split.m_axis] < SplitCentroid(b, by_meshlet)[split.m_axis];
+				});
+			}
+			else {
+				Theia::UInt32 axis = split.m_axis;
+				Theia::Float inverse_extent = Object_Split_Bucket_Count / (centroid_bounds.m_max[axis] - centroid_bounds.m_min[axis]);
+				middle = std::partition(references.begin(), references.end(), [&](const PrimitiveReference& reference) {
+					return BinIndex(SplitCentroid(reference, by_meshlet)[axis], centroid_bounds.m_min[axis], inverse_extent, Object_Split_Bucket_Count) <= split.m_bucket;
+				});
+			}
+
+			left.assign(references.begin(), middle);
+			right.assign(middle, references.end());
+		}
+
+		output.m_nodes[node_index].m_axis = Theia::UInt8(split.m_axis);
+		output.m_nodes[node_index].m_primitive_count = 0;
+		std::vector<PrimitiveReference>().swap(references);
+
+		Theia::Int64 remaining_budget = std::max<Theia::Int64>(split_budget - extra_references, 0);
+		Theia::Int64 left_budget = remaining_budget * Theia::Int64(left.size()) / Theia::Int64(left.size() + right.size());
+
+		Build(output, left, depth + 1, left_budget);
+		Theia::UInt32 second_child_offset = Build(output, right, depth + 1, remaining_budget - left_budget);
+		output.m_nodes[node_index].m_second_child_offset = second_child_offset;
+
+		return node_index;
+	}
+
+	BVHAggregate::Split BVHAggregate::FindObjectSplit(const std::vector<PrimitiveReference>& references, const Theia::AABB3f& bounds, const Theia::AABB3f& centroid_bounds, bool by_meshlet) const {
+		Split best_split;
+		Theia::Float surface_area = bounds.SurfaceArea();
+		if (surface_area == 0.0f) {
+			return best_split;
+		}
+
+		for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+			Theia::Float extent = centroid_bounds.m_max[axis] - centroid_bounds.m_min[axis];
+			if (extent <= 0.0f) {
+				continue;
+			}
+
+			std::array<Theia::UInt32, Object_Split_Bucket_Count> counts = {};
+			std::array<Theia::AABB3f, Object_Split_Bucket_Count> bucket_bounds;
+			Theia::Float inverse_extent = Object_Split_Bucket_Count / extent;
+
+			for (const PrimitiveReference& reference : references) {
+				Theia::UInt32 bucket = BinIndex(SplitCentroid(reference, by_meshlet)[axis], centroid_bounds.m_min[axis], inverse_extent, Object_Split_Bucket_Count);
+				++counts[bucket];
+				bucket_bounds[bucket] = Theia::Union(bucket_bounds[bucket], reference.m_bounds);
+			}
+
+			std::array<Theia::AABB3f, Object_Split_Bucket_Count> right_bounds;
+			std::array<Theia::UInt32, Object_Split_Bucket_Count> right_counts = {};
+			Theia::AABB3f accumulated_bounds;
+			Theia::UInt32 accumulated_count = 0;
+			for (Theia::UInt32 i = Object_Split_Bucket_Count - 1; i > 0; --i) {
+				accumulated_bounds = Theia::Union(accumulated_bounds, bucket_bounds[i]);
+				accumulated_count += counts[i];
+				right_bounds[i] = accumulated_bounds;
+				right_counts[i] = accumulated_count;
+			}
+
+			accumulated_bounds = Theia::AABB3f();
+			accumulated_count = 0;
+			for (Theia::UInt32 i = 0; i < Object_Split_Bucket_Count - 1; ++i) {
+				accumulated_bounds = Theia::Union(accumulated_bounds, bucket_bounds[i]);
+				accumulated_count += counts[i];
+				if (accumulated_count == 0 || right_counts[i + 1] == 0) {
+					continue;
+				}
+
+				Theia::Float cost = Traversal_Cost + (IntersectionCost(accumulated_count) * accumulated_bounds.SurfaceArea() + IntersectionCost(right_counts[i + 1]) * right_bounds[i + 1].SurfaceArea()) / surface_area;
+				if (cost < best_split.m_cost) {
+					best_split.m_cost = cost;
+					best_split.m_axis = axis;
+					best_split.m_bucket = i;
+					best_split.m_left_bounds = accumulated_bounds;
+					best_split.m_right_bounds = right_bounds[i + 1];
+				}
+			}
+		}
+
+		return best_split;
+	}
+
+	BVHAggregate::Split BVHAggregate::FindSpatialSplit(const std::vector<PrimitiveReference>& references, const Theia::AABB3f& bounds) const {
+		Split best_split;
+		Theia::Float surface_area = bounds.SurfaceArea();
+		if (surface_area == 0.0f) {
+			return best_split;
+		}
+
+		for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+			Theia::Float min = bounds.m_min[axis];
+			Theia::Float extent = bounds.m_max[axis] - min;
+			if (extent <= 0.0f) {
+				continue;
+			}
+
+			std::array<Theia::UInt32, Spatial_Split_Bin_Count> entry_counts = {}, exit_counts = {};
+			std::array<Theia::AABB3f, Spatial_Split_Bin_Count> bin_bounds;
+			Theia::Float bin_width = extent / Spatial_Split_Bin_Count;
+			Theia::Float inverse_bin_width = Spatial_Split_Bin_Count / extent;
+
+			for (const PrimitiveReference& reference : references) {
+				Theia::UInt32 first_bin = BinIndex(reference.m_bounds.m_min[axis], min, inverse_bin_width, Spatial_Split_Bin_Count);
+				Theia::UInt32 last_bin = std::max(first_bin, BinIndex(reference.m_bounds.m_max[axis], min, inverse_bin_width, Spatial_Split_Bin_Count));
+
+				if (first_bin == last_bin) {
+					bin_bounds[first_bin] = Theia::Union(bin_bounds[first_bin], reference.m_bounds);
+				}
+				else {
+					const Theia::Primitive primitive = reference.m_primitive;
+					for (Theia::UInt32 bin = first_bin; bin <= last_bin; ++bin) {
+						Theia::Float bin_min = (bin == 0) ? -Theia::Infinity : min + bin * bin_width;
+						Theia::Float bin_max = (bin == Spatial_Split_Bin_Count - 1) ? Theia::Infinity : min + (bin + 1) * bin_width;
+						Theia::AABB3f clipped_bounds = primitive->ClippedBounds(ClipAABB(reference.m_bounds, axis, bin_min, bin_max));
+						if (!clipped_bounds.IsEmpty()) {
+							bin_bounds[bin] = Theia::Union(bin_bounds[bin], clipped_bounds);
+						}
+					}
+				}
+
+				++entry_counts[first_bin];
+				++exit_counts[last_bin];
+			}
+
+			std::array<Theia::AABB3f, Spatial_Split_Bin_Count> right_bounds;
+			std::array<Theia::UInt32, Spatial_Split_Bin_Count> right_counts = {};
+			Theia::AABB3f accumulated_bounds;
+			Theia::UInt32 accumulated_count = 0;
+			for (Theia::UInt32 i = Spatial_Split_Bin_Count - 1; i > 0; --i) {
+				accumulated_bounds = Theia::Union(accumulated_bounds, bin_bounds[i]);
+				accumulated_count += exit_counts[i];
+				right_bounds[i] = accumulated_bounds;
+				right_counts[i] = accumulated_count;
+			}
+
+			accumulated_bounds = Theia::AABB3f();
+			accumulated_count = 0;
+			for (Theia::UInt32 i = 1; i < Spatial_Split_Bin_Count; ++i) {
+				accumulated_bounds = Theia::Union(accumulated_bounds, bin_bounds[i - 1]);
+				accumulated_count += entry_counts[i - 1];
+				if (accumulated_count == 0 || right_counts[i] == 0) {
+					continue;
+				}
+
+				Theia::Float cost = Traversal_Cost + (IntersectionCost(accumulated_count) * accumulated_bounds.SurfaceArea() + IntersectionCost(right_counts[i]) * right_bounds[i].SurfaceArea()) / surface_area;
+				if (cost < best_split.m_cost) {
+					best_split.m_cost = cost;
+					best_split.m_axis = axis;
+					best_split.m_bucket = i;
+					best_split.m_left_bounds = accumulated_bounds;
+					best_split.m_right_bounds = right_bounds[i];
+				}
+			}
+		}
+
+		return best_split;
+	}
+
+	Theia::Int64 BVHAggregate::PerformSpatialSplit(const std::vector<PrimitiveReference>& references, const Theia::AABB3f& bounds, const Split& split, Theia::Int64 split_budget, std::vector<PrimitiveReference>& left, std::vector<PrimitiveReference>& right) const {
+		Theia::UInt32 axis = split.m_axis;
+		Theia::Float min = bounds.m_min[axis];
+		Theia::Float extent = bounds.m_max[axis] - min;
+		Theia::Float inverse_bin_width = Spatial_Split_Bin_Count / extent;
+		Theia::Float plane = min + split.m_bucket * (extent / Spatial_Split_Bin_Count);
+
+		Theia::AABB3f left_bounds = split.m_left_bounds, right_bounds = split.m_right_bounds;
+		Theia::UInt32 left_count = 0, right_count = 0;
+		for (const PrimitiveReference& reference : references) {
+			left_count += BinIndex(reference.m_bounds.m_min[axis], min, inverse_bin_width, Spatial_Split_Bin_Count) < split.m_bucket;
+			right_count += BinIndex(reference.m_bounds.m_max[axis], min, inverse_bin_width, Spatial_Split_Bin_Count) >= split.m_bucket;
+		}
+
+		Theia::Int64 extra_references = 0;
+		for (const PrimitiveReference& reference : references) {
+			Theia::UInt32 first_bin = BinIndex(reference.m_bounds.m_min[axis], min, inverse_bin_width, Spatial_Split_Bin_Count);
+			Theia::UInt32 last_bin = std::max(first_bin, BinIndex(reference.m_bounds.m_max[axis], min, inverse_bin_width, Spatial_Split_Bin_Count));
+
+			if (last_bin < split.m_bucket) {
+				left.push_back(reference);
+				continue;
+			}
+			if (first_bin >= split.m_bucket) {
+				right.push_back(reference);
+				continue;
+			}
+
+			// Reference unsplitting: keep a straddling reference whole on one side when that is cheaper than duplicating it or the budget is spent.
+			Theia::Float split_cost = left_bounds.SurfaceArea() * left_count + right_bounds.SurfaceArea() * right_count;
+			Theia::Float left_cost = Theia::Union(left_bounds, reference.m_bounds).SurfaceArea() * left_count + right_bounds.SurfaceArea() * (right_count - 1);
+			Theia::Float right_cost = left_bounds.SurfaceArea() * (left_count - 1) + Theia::Union(right_bounds, reference.m_bounds).SurfaceArea() * right_count;
+
+			Theia::AABB3f left_part, right_part;
+			if (extra_references < split_budget && split_cost <= std::min(left_cost, right_cost)) {
+				const Theia::Primitive primitive = reference.m_primitive;
+				left_part = primitive->ClippedBounds(ClipAABB(reference.m_bounds, axis, -Theia::Infinity, plane));
+				right_part = primitive->ClippedBounds(ClipAABB(reference.m_bounds, axis, plane, Theia::Infinity));
+			}
+
+			if (!left_part.IsEmpty() && !right_part.IsEmpty()) {
+				left.push_back(PrimitiveReference{ left_part, reference.m_primitive, reference.m_meshlet });
+				right.push_back(PrimitiveReference{ right_part, reference.m_primitive, reference.m_meshlet });
+				++extra_references;
+			}
+			else if (left_cost <= right_cost) {
+				left.push_back(reference);
+				left_bounds = Theia::Union(left_bounds, reference.m_bounds);
+				--right_count;
+			}
+			else {
+				right.push_back(reference);
+				right_bounds = Theia::Union(right_bounds, reference.m_bounds);
+				--left_count;
+			}
+		}
+
+		return extra_references;
+	}
+
+	// Packed leaves test a whole block of triangles for about the price of one, so the SAH counts blocks rather than triangles.
+	Theia::Float BVHAggregate::IntersectionCost(Theia::UInt32 primitive_count) const {
+		if (m_options.m_leaf_format == Theia::BVHLeafFormat::Packed4) {
+			return Theia::Float(BlockCount<4>(primitive_count));
+		}
+		else if (m_options.m_leaf_format == Theia::BVHLeafFormat::Packed8) {
+			return Theia::Float(BlockCount<8>(primitive_count));
+		}
+		return Theia::Float(primitive_count);
+	}
+
+	Theia::UInt32 BVHAggregate::MaxPrimitivesInLeaf() const {
+		if (m_options.m_leaf_format == Theia::BVHLeafFormat::Packed4) {
+			return std::max(m_options.m_max_primitives_in_node, 4u);
+		}
+		else if (m_options.m_leaf_format == Theia::BVHLeafFormat::Packed8) {
+			return std::max(m_options.m_max_primitives_in_node, 8u);
+		}
+		return m_options.m_max_primitives_in_node;
+	}
+
+	void BVHAggregate::CreateLeaf(BuildOutput& output, Theia::UInt32 node_index, const std::vector<PrimitiveReference>& references) const {
+		output.m_nodes[node_index].m_primitives_offset = Theia::UInt32(output.m_ordered_primitives.size());
+		assert(references.size() <= Max_Leaf_References, "BVHAggregate::CreateLeaf has more references than a leaf can count.");
+		output.m_nodes[node_index].m_primitive_count = Theia::UInt16(references.size());
+		output.m_nodes[node_index].m_axis = 0;
+
+		for (const PrimitiveReference& reference : references) {
+			output.m_ordered_primitives.push_back(reference.m_primitive);
+		}
+	}
+
+	bool BVHAggregate::SpansMeshlets(const std::vector<PrimitiveReference>& references) const {
+		for (const PrimitiveReference& reference : references) {
+			if (reference.m_meshlet != references[0].m_meshlet) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Theia::Point3f BVHAggregate::SplitCentroid(const PrimitiveReference& reference, bool by_meshlet) {
+		if (by_meshlet && reference.m_meshlet) {
+			return reference.m_meshlet->m_bounds.Centroid();
+		}
+		return reference.m_bounds.Centroid();
+	}
+
+	BVHAggregate::PrimitiveReference BVHAggregate::CreateReference(const Theia::AABB3f& bounds, Theia::Primitive primitive) const {
+		const Theia::Meshlet* meshlet = nullptr;
+		if (m_options.m_group_meshlets) {
+			const Theia::Triangle* triangle = dynamic_cast<const Theia::Triangle*>(primitive);
+			if (triangle) {
+				meshlet = triangle->GetMeshlet();
+			}
+		}
+		return PrimitiveReference{ bounds, primitive, meshlet };
+	}
+
+	void BVHAggregate::ComputeStatistics() {
+		m_statistics.m_reference_count = Theia::UInt32(m_ordered_primitives.size());
+		m_statistics.m_node_count = Theia::UInt32(m_nodes.size());
+		m_statistics.m_leaf_count = 0;
+		m_statistics.m_memory_bytes = m_nodes.size() * sizeof(Theia::BVHNode) + m_ordered_primitives.size() * sizeof(Theia::Primitive);
+		m_statistics.m_memory_bytes += m_leaf_block_offsets.size() * sizeof(Theia::UInt32) + m_triangle_blocks_4.size() * sizeof(Theia::TriangleBlock<4>) + m_triangle_blocks_8.size() * sizeof(Theia::TriangleBlock<8>);
+		m_statistics.m_sah_cost = 0.0f;
+
+		if (m_root_surface_area == 0.0f) {
+			return;
+		}
+
+		for (const Theia::BVHNode& node : m_nodes) {
+			Theia::Float relative_area = node.m_bounds.SurfaceArea() / m_root_surface_area;
+			if (node.m_primitive_count > 0) {
+				++m_statistics.m_leaf_count;
+				m_statistics.m_sah_cost += relative_area * IntersectionCost(node.m_primitive_count);
+			}
+			else {
+				m_statistics.m_sah_cost += relative_area * Traversal_Cost;
+			}
+		}
+	}
+
+	void BVHAggregate::PackTriangleLeaves() {
+		m_leaf_block_offsets.clear();
+		m_triangle_blocks_4.clear();
+		m_triangle_blocks_8.clear();
+		if (m_options.m_leaf_format == Theia::BVHLeafFormat::Indexed) {
+			return;
+		}
+
+		m_leaf_block_offsets.assign(m_nodes.size(), Unpacked_Leaf);
+		std::vector<const Theia::Triangle*> triangles;
+		for (Theia::UInt32 node_index = 0; node_index < m_nodes.size(); ++node_index) {
+			const Theia::BVHNode& node = m_nodes[node_index];
+			if (node.m_primitive_count == 0) {
+				continue;
+			}
+
+			// Leaves holding anything other than triangles keep going through the primitives.
+			triangles.clear();
+			for (Theia::UInt32 i = 0; i < node.m_primitive_count; ++i) {
+				const Theia::Triangle* triangle = dynamic_cast<const Theia::Triangle*>(m_ordered_primitives[node.m_primitives_offset + i]);
+				if (!triangle) {
+					break;
+				}
+				triangles.push_back(triangle);
+			}
+			if (triangles.size() != node.m_primitive_count) {
+				continue;
+			}
+
+			if (m_options.m_leaf_format == Theia::BVHLeafFormat::Packed4) {
+				m_leaf_block_offsets[node_index] = PackTriangles<4>(triangles, m_triangle_blocks_4);
+			}
+			else {
+				m_leaf_block_offsets[node_index] = PackTriangles<8>(triangles, m_triangle_blocks_8);
+			}
+		}
+		m_triangle_blocks_4.shrink_to_fit();
+		m_triangle_blocks_8.shrink_to_fit();
+	}
+
+	void BVHAggregate::FindSubtrees(Theia::UInt32 node_index, Theia::UInt32 depth) {
+		const Theia::BVHNode& node = m_nodes[node_index];
+		if (depth == Update_Subtree_Depth) {
+			m_subtrees.push_back(Subtree{ node_index, depth, 0.0f });
+		}
+		else if (node.m_primitive_count == 0) {
+			FindSubtrees(node_index + 1, depth + 1);
+			FindSubtrees(node.m_second_child_offset, depth + 1);
+		}
+	}
+
+	Theia::AABB3f BVHAggregate::RefitNode(Theia::UInt32 node_index, Theia::UInt32 depth, Theia::UInt32 stop_depth) {
+		Theia::BVHNode& node = m_nodes[node_index];
+		if (depth == stop_depth) {
+			return node.m_bounds;
+		}
+
+		Theia::AABB3f bounds;
+		if (node.m_primitive_count > 0) {
+			for (Theia::UInt32 i = 0; i < node.m_primitive_count; ++i) {
+				bounds = Theia::Union(bounds, m_ordered_primitives[node.m_primitives_offset + i]->Bounds());
+			}
+		}
+		else {
+			bounds = Theia::Union(RefitNode(node_index + 1, depth + 1, stop_depth), RefitNode(node.m_second_child_offset, depth + 1, stop_depth));
+		}
+
+		node.m_bounds = bounds;
+		return bounds;
+	}
+
+	Theia::UInt32 BVHAggregate::SubtreeEnd(Theia::UInt32 node_index) const {
+		while (m_nodes[node_index].m_primitive_count == 0) {
+			node_index = m_nodes[node_index].m_second_child_offset;
+		}
+
+		return node_index + 1;
+	}
+
+	Theia::Float BVHAggregate::SubtreeCost(Theia::UInt32 node_index) const {
+		Theia::Float surface_area = m_nodes[node_index].m_bounds.SurfaceArea();
+		if (surface_area == 0.0f) {
+			return 0.0f;
+		}
+
+		Theia::Float cost = 0.0f;
+		Theia::UInt32 end = SubtreeEnd(node_index);
+		for (Theia::UInt32 i = node_index; i < end; ++i) {
+			const Theia::BVHNode& node = m_nodes[i];
+			cost += node.m_bounds.SurfaceArea() / surface_area * ((node.m_primitive_count > 0) ? IntersectionCost(node.m_primitive_count) : Traversal_Cost);
+		}
+
+		return cost;
+	}
+
+	BVHAggregate::BuildOutput BVHAggregate::RebuildSubtree(const Subtree& subtree) const {
+		std::vector<Theia::Primitive> primitives;
+		Theia::UInt32 end = SubtreeEnd(subtree.m_root);
+		for (Theia::UInt32 i = subtree.m_root; i < end; ++i) {
+			const Theia::BVHNode& node = m_nodes[i];
+			for (Theia::UInt32 j = 0; j < node.m_primitive_count; ++j) {
+				primitives.push_back(m_ordered_primitives[node.m_primitives_offset + j]);
+			}
+		}
+
+		// Spatial splits may have referenced a primitive from several leaves.
+		std::sort(primitives.begin(), primitives.end());
+		primitives.erase(std::unique(primitives.begin(), primitives.end()), primitives.end());
+
+		std::vector<PrimitiveReference> references;
+		references.reserve(primitives.size());
+		for (const Theia::Primitive primitive : primitives) {
+			references.push_back(CreateReference(primitive->Bounds(), primitive));
+		}
+
+		// Partial rebuilds use object splits only to keep the frame update fast.
+		BuildOutput output;
+		Build(output, references, subtree.m_depth, 0);
+		return output;
+	}
+
+	void BVHAggregate::SpliceSubtree(const Subtree& subtree, BuildOutput& rebuilt) {
+		Theia::UInt32 root = subtree.m_root;
+		Theia::UInt32 end = SubtreeEnd(root);
+		Theia::UInt32 primitives_begin = std::numeric_limits<Theia::UInt32>::max(), primitives_end = 0;
+		for (Theia::UInt32 i = root; i < end; ++i) {
+			if (m_nodes[i].m_primitive_count > 0) {
+				primitives_begin = std::min(primitives_begin, m_nodes[i].m_primitives_offset);
+				primitives_end = std::max(primitives_end, m_nodes[i].m_primitives_offset + m_nodes[i].m_primitive_count);
+			}
+		}
+
+		Theia::Int64 node_delta = Theia::Int64(rebuilt.m_nodes.size()) - (end - root);
+		Theia::Int64 primitive_delta = Theia::Int64(rebuilt.m_ordered_primitives.size()) - (primitives_end - primitives_begin);
+
+		for (Theia::BVHNode& node : rebuilt.m_nodes) {
+			if (node.m_primitive_count > 0) {
+				node.m_primitives_offset += primitives_begin;
+			}
+			else {
+				node.m_second_child_offset += root;
+			}
+		}
+
+		for (Theia::UInt32 i = 0; i < m_nodes.size(); ++i) {
+			if (i == root) {
+				i = end - 1;
+				continue;
+			}
+
+			Theia::BVHNode& node = m_nodes[i];
+			if (node.m_primitive_count > 0 && node.m_primitives_offset >= primitives_end) {
+				node.m_primitives_offset = Theia::UInt32(node.m_primitives_offset + primitive_delta);
+			}
+			else if (node.m_primitive_count == 0 && node.m_second_child_offset >= end) {
+				node.m_second_child_offset = Theia::UInt32(node.m_second_child_offset + node_delta);
+			}
+		}
+
+		m_nodes.erase(m_nodes.begin() + root, m_nodes.begin() + end);
+		m_nodes.insert(m_nodes.begin() + root, rebuilt.m_nodes.begin(), rebuilt.m_nodes.end());
+		m_ordered_primitives.erase(m_ordered_primitives.begin() + primitives_begin, m_ordered_primitives.begin() + primitives_end);
+		m_ordered_primitives.insert(m_ordered_primitives.begin() + primitives_begin, rebuilt.m_ordered_primitives.begin(), rebuilt.m_ordered_primitives.end());
+		m_statistics.m_max_depth = std::max(m_statistics.m_max_depth, rebuilt.m_max_depth);
+	}
+}
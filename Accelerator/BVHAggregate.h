@@ -0,0 +1,190 @@
+#ifndef _THEIA_ACCELERATOR_BVH_AGGREGATE_H_
+#define _THEIA_ACCELERATOR_BVH_AGGREGATE_H_
+#include "../Engine/IPrimitive.h"
+#include "../Shape/Triangle.h"
+#include <span>
+#include <vector>
+
+namespace Theia {
+	class RaySorter;
+
+	enum class BVHSplitMethod {
+		SAH,
+		SpatialSAH
+	};
+
+	enum class BVHTraversal {
+		Automatic,
+		Single,
+		Packet,
+		Stream
+	};
+
+	// Indexed leaves reach triangles through the mesh index buffer. Packed leaves copy the vertices of their triangles into SoA blocks of 4 or 8, trading memory for SIMD intersection.
+	enum class BVHLeafFormat {
+		Indexed,
+		Packed4,
+		Packed8
+	};
+
+	typedef struct BVHBuildOptions {
+		Theia::BVHSplitMethod m_split_method = Theia::BVHSplitMethod::SAH;
+		Theia::UInt32 m_max_primitives_in_node = 4;
+		// Spatial splits are only tried where the children of the best object split overlap by more than this fraction of the root surface area.
+		Theia::Float m_spatial_split_alpha = 1e-5f;
+		// Extra primitive references allowed by spatial splits, as a fraction of the primitive count.
+		Theia::Float m_spatial_split_budget = 0.3f;
+		// Update() rebuilds a subtree once refitting has grown its SAH cost past this multiple of its cost when it was built.
+		Theia::Float m_rebuild_threshold = 1.5f;
+		// Only applies to leaves whose primitives are all triangles, so it can be chosen per mesh by giving each mesh its own BVHAggregate. Packed formats raise m_max_primitives_in_node to the block width.
+		Theia::BVHLeafFormat m_leaf_format = Theia::BVHLeafFormat::Indexed;
+		// Nodes holding triangles of several meshlets are split by meshlet centroid, so that every meshlet ends up in a subtree of its own whose leaves are adjacent in memory.
+		bool m_group_meshlets = true;
+	} BVHBuildOptions;
+
+	typedef struct BVHStatistics {
+		Theia::UInt32 m_primitive_count = 0;
+		Theia::UInt32 m_reference_count = 0;
+		Theia::UInt32 m_spatial_split_count = 0;
+		Theia::UInt32 m_node_count = 0;
+		Theia::UInt32 m_leaf_count = 0;
+		Theia::UInt32 m_max_depth = 0;
+		Theia::UInt64 m_memory_bytes = 0;
+		Theia::Float m_sah_cost = 0.0f;
+	} BVHStatistics;
+
+	typedef struct BVHUpdateStatistics {
+		Theia::Float64 m_refit_milliseconds = 0.0;
+		Theia::Float64 m_rebuild_milliseconds = 0.0;
+		Theia::Float64 m_total_milliseconds = 0.0;
+		Theia::UInt32 m_rebuilt_subtree_count = 0;
+		Theia::UInt32 m_rebuilt_primitive_count = 0;
+		Theia::Float m_sah_cost = 0.0f;
+	} BVHUpdateStatistics;
+
+	typedef struct BVHNode {
+		Theia::AABB3f m_bounds;
+		union {
+			Theia::UInt32 m_primitives_offset;
+			Theia::UInt32 m_second_child_offset;
+		};
+		Theia::UInt16 m_primitive_count;
+		Theia::UInt8 m_axis;
+		Theia::UInt8 m_padding;
+	} BVHNode;
+
+	static_assert(sizeof(BVHNode) == 32, "BVHNode is not 32 bytes");
+
+	class BVHAggregate : public IPrimitive {
+	public:
+		BVHAggregate(std::vector<Theia::Primitive> primitives, const Theia::BVHBuildOptions& options = Theia::BVHBuildOptions());
+		// Restores a BVH from the nodes and primitive order of an earlier build, e.g. one saved in a SceneCache, without rebuilding it. build_statistics provides the counts that the nodes do not record.
+		BVHAggregate(std::vector<Theia::Primitive> ordered_primitives, std::span<const Theia::BVHNode> nodes, const Theia::BVHStatistics& build_statistics, const Theia::BVHBuildOptions& options);
+
+		Theia::AABB3f Bounds() const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+
+		// Closest hits for a batch of rays. Coherent rays, such as the primary rays of a screen tile, should be adjacent so that Automatic can trace them as packets.
+		void Intersect(std::span<const Theia::Ray> rays, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections, Theia::BVHTraversal traversal = Theia::BVHTraversal::Automatic) const;
+		// Visibility for a batch of rays, e.g. the shadow rays of a tile. Coherent groups of consecutive rays are traced as packets.
+		void Occluded(std::span<const Theia::Ray> rays, std::span<const Theia::Float> t_max, std::span<bool> occluded) const;
+		// As above for incoherent batches, such as bounce rays: the rays are sorted with ray_sorter and traced in sorted order, and the results are written in the order of rays.
+		void Intersect(std::span<const Theia::Ray> rays, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections, Theia::RaySorter& ray_sorter, Theia::BVHTraversal traversal = Theia::BVHTraversal::Automatic) const;
+		void Occluded(std::span<const Theia::Ray> rays, std::span<const Theia::Float> t_max, std::span<bool> occluded, Theia::RaySorter& ray_sorter) const;
+
+		// Refits all node bounds to the current primitive bounds, e.g. after the vertex buffers of a deforming mesh changed, and rebuilds the subtrees that degraded too much.
+		Theia::BVHUpdateStatistics Update();
+
+		const Theia::BVHStatistics& GetStatistics() const;
+		const Theia::BVHBuildOptions& GetOptions() const;
+		std::span<const Theia::BVHNode> GetNodes() const;
+		// Primitives in leaf order; the leaves index into this.
+		std::span<const Theia::Primitive> GetOrderedPrimitives() const;
+
+		// Packet for rays that share an octant and a narrow cone of directions, Single otherwise. Stream filtering is only used on request, as it does not beat single rays without SIMD box tests.
+		static Theia::BVHTraversal ChooseTraversal(std::span<const Theia::Ray> rays);
+
+		static constexpr Theia::UInt32 Max_Depth = 64;
+		static constexpr Theia::UInt32 Packet_Size = 64;
+		static constexpr Theia::UInt32 Stream_Size = 4096;
+	protected:
+	private:
+		typedef struct PrimitiveReference {
+			Theia::AABB3f m_bounds;
+			Theia::Primitive m_primitive;
+			const Theia::Meshlet* m_meshlet;
+		} PrimitiveReference;
+
+		typedef struct BuildOutput {
+			std::vector<Theia::BVHNode> m_nodes;
+			std::vector<Theia::Primitive> m_ordered_primitives;
+			Theia::UInt32 m_max_depth = 0;
+			Theia::UInt32 m_spatial_split_count = 0;
+		} BuildOutput;
+
+		typedef struct Subtree {
+			Theia::UInt32 m_root;
+			Theia::UInt32 m_depth;
+			Theia::Float m_built_cost;
+		} Subtree;
+
+		// Closest hit so far; hits in packed leaves only build their interaction once traversal is done.
+		typedef struct ClosestHit {
+			std::optional<Theia::ShapeIntersection> m_shape_intersection;
+			std::optional<Theia::TriangleBlockIntersection> m_triangle_block_intersection;
+		} ClosestHit;
+
+		typedef struct Split {
+			Theia::Float m_cost = Theia::Infinity;
+			Theia::UInt32 m_axis = 0;
+			Theia::UInt32 m_bucket = 0;
+			Theia::AABB3f m_left_bounds, m_right_bounds;
+		} Split;
+
+		void IntersectLeaf(Theia::UInt32 node_index, const Theia::Ray& ray, Theia::Float& t_max, ClosestHit& closest_hit) const;
+		bool OccludedLeaf(Theia::UInt32 node_index, const Theia::Ray& ray, Theia::Float t_max) const;
+		std::optional<Theia::ShapeIntersection> ResolveClosestHit(ClosestHit& closest_hit, const Theia::Ray& ray) const;
+		void IntersectPacket(std::span<const Theia::Ray> rays, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections) const;
+		void OccludedPacket(std::span<const Theia::Ray> rays, std::span<const Theia::Float> t_max, std::span<bool> occluded) const;
+		void IntersectStream(std::span<const Theia::Ray> rays, std::span<const Theia::UInt32> ray_indices, std::span<std::optional<Theia::ShapeIntersection>> shape_intersections) const;
+
+		Theia::UInt32 Build(BuildOutput& output, std::vector<PrimitiveReference>& references, Theia::UInt32 depth, Theia::Int64 split_budget) const;
+		Split FindObjectSplit(const std::vector<PrimitiveReference>& references, const Theia::AABB3f& bounds, const Theia::AABB3f& centroid_bounds, bool by_meshlet) const;
+		Split FindSpatialSplit(const std::vector<PrimitiveReference>& references, const Theia::AABB3f& bounds) const;
+		Theia::Int64 PerformSpatialSplit(const std::vector<PrimitiveReference>& references, const Theia::AABB3f& bounds, const Split& split, Theia::Int64 split_budget, std::vector<PrimitiveReference>& left, std::vector<PrimitiveReference>& right) const;
+		Theia::Float IntersectionCost(Theia::UInt32 primitive_count) const;
+		Theia::UInt32 MaxPrimitivesInLeaf() const;
+		void CreateLeaf(BuildOutput& output, Theia::UInt32 node_index, const std::vector<PrimitiveReference>& references) const;
+		bool SpansMeshlets(const std::vector<PrimitiveReference>& references) const;
+		static Theia::Point3f SplitCentroid(const PrimitiveReference& reference, bool by_meshlet);
+		PrimitiveReference CreateReference(const Theia::AABB3f& bounds, Theia::Primitive primitive) const;
+		void ComputeStatistics();
+		void PackTriangleLeaves();
+
+		void FindSubtrees(Theia::UInt32 node_index, Theia::UInt32 depth);
+		Theia::AABB3f RefitNode(Theia::UInt32 node_index, Theia::UInt32 depth, Theia::UInt32 stop_depth);
+		Theia::UInt32 SubtreeEnd(Theia::UInt32 node_index) const;
+		Theia::Float SubtreeCost(Theia::UInt32 node_index) const;
+		BuildOutput RebuildSubtree(const Subtree& subtree) const;
+		void SpliceSubtree(const Subtree& subtree, BuildOutput& rebuilt);
+
+		static constexpr Theia::UInt32 Object_Split_Bucket_Count = 12;
+		static constexpr Theia::UInt32 Spatial_Split_Bin_Count = 16;
+		// Depth of the independent subtrees that Update() refits and rebuilds in parallel.
+		static constexpr Theia::UInt32 Update_Subtree_Depth = 6;
+		static constexpr Theia::UInt32 Unpacked_Leaf = 0xFFFFFFFF;
+
+		std::vector<Theia::Primitive> m_ordered_primitives;
+		std::vector<Theia::BVHNode> m_nodes;
+		// First block of each packed leaf, Unpacked_Leaf for the other nodes; empty with indexed leaves.
+		std::vector<Theia::UInt32> m_leaf_block_offsets;
+		std::vector<Theia::TriangleBlock<4>> m_triangle_blocks_4;
+		std::vector<Theia::TriangleBlock<8>> m_triangle_blocks_8;
+		Theia::BVHBuildOptions m_options;
+		Theia::BVHStatistics m_statistics;
+		std::vector<Subtree> m_subtrees;
+		Theia::Float m_root_surface_area;
+	};
+}
+#endif
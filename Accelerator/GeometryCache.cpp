@@ -0,0 +1,204 @@
+#include "GeometryCache.h"
+
+namespace Theia {
+	namespace {
+		Theia::TriangleMesh TessellateMesh(const Theia::IParametricPatch* patch, const Theia::DisplacementFunction& displacement, Theia::UInt32 rate) {
+			std::vector<Theia::Point3f> positions;
+			std::vector<Theia::Point2f> uvs;
+			positions.reserve(size_t(rate + 1) * (rate + 1));
+			uvs.reserve(size_t(rate + 1) * (rate + 1));
+			for (Theia::UInt32 j = 0; j <= rate; j++) {
+				for (Theia::UInt32 i = 0; i <= rate; i++) {
+					Theia::Point2f uv(Theia::Float(i) / rate, Theia::Float(j) / rate);
+					Theia::PatchPoint patch_point = patch->Evaluate(uv);
+					if (displacement) {
+						patch_point.m_position += displacement(patch_point.m_position, uv) * patch_point.m_normal;
+					}
+					positions.push_back(patch_point.m_position);
+					uvs.push_back(uv);
+				}
+			}
+
+			std::vector<Theia::UInt32> indices;
+			indices.reserve(size_t(rate) * rate * 6);
+			for (Theia::UInt32 j = 0; j < rate; j++) {
+				for (Theia::UInt32 i = 0; i < rate; i++) {
+					Theia::UInt32 v00 = j * (rate + 1) + i;
+					Theia::UInt32 v10 = v00 + 1;
+					Theia::UInt32 v01 = v00 + rate + 1;
+					Theia::UInt32 v11 = v01 + 1;
+					indices.insert(indices.end(), { v00, v10, v11, v00, v11, v01 });
+				}
+			}
+			return Theia::TriangleMesh(Theia::Transform(), std::move(positions), std::move(indices), {}, std::move(uvs));
+		}
+
+		std::vector<Theia::Primitive> ToPrimitives(std::vector<Theia::Triangle>& triangles) {
+			std::vector<Theia::Primitive> primitives;
+			primitives.reserve(triangles.size());
+			for (Theia::Triangle& triangle : triangles) {
+				primitives.push_back(&triangle);
+			}
+			return primitives;
+		}
+
+		Theia::Float IsolineLength(const Theia::IParametricPatch* patch, bool along_u) {
+			static constexpr Theia::UInt32 Segment_Count = 8;
+			Theia::Float length = 0.0f;
+			Theia::Point3f previous = patch->Evaluate(along_u ? Theia::Point2f(0.0f, 0.5f) : Theia::Point2f(0.5f, 0.0f)).m_position;
+			for (Theia::UInt32 i = 1; i <= Segment_Count; i++) {
+				Theia::Float t = Theia::Float(i) / Segment_Count;
+				Theia::Point3f current = patch->Evaluate(along_u ? Theia::Point2f(t, 0.5f) : Theia::Point2f(0.5f, t)).m_position;
+				length += Theia::Length(current - previous);
+				previous = current;
+			}
+			return length;
+		}
+	}
+
+	TessellatedGrid::TessellatedGrid(const Theia::IParametricPatch* patch, const Theia::DisplacementFunction& displacement, Theia::UInt32 rate) :
+		m_rate(rate),
+		m_mesh(TessellateMesh(patch, displacement, rate)),
+		m_triangles(Theia::Triangle::CreateTriangles(&m_mesh)),
+		m_bvh(ToPrimitives(m_triangles))
+	{
+
+	}
+
+	std::optional<Theia::ShapeIntersection> TessellatedGrid::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		return m_bvh.Intersect(ray, t_max);
+	}
+
+	bool TessellatedGrid::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		return m_bvh.Occluded(ray, t_max);
+	}
+
+	Theia::UInt32 TessellatedGrid::GetRate() const {
+		return m_rate;
+	}
+
+	Theia::UInt64 TessellatedGrid::GetMemoryBytes() const {
+		return sizeof(TessellatedGrid) - sizeof(Theia::TriangleMesh) +
+			m_mesh.MemoryBytes() +
+			m_triangles.capacity() * sizeof(Theia::Triangle) +
+			m_bvh.GetStatistics().m_memory_bytes;
+	}
+
+	GeometryCache::GeometryCache(const Theia::RayDifferential& dicing_ray, const Theia::GeometryCacheOptions& options) :
+		m_dicing_ray(dicing_ray),
+		m_options(options)
+	{
+
+	}
+
+	std::shared_ptr<const Theia::TessellatedGrid> GeometryCache::Acquire(const Theia::TessellatedPatch* patch) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto entry = m_entries.find(patch);
+			if (entry != m_entries.end()) {
+				m_lru.splice(m_lru.begin(), m_lru, entry->second.m_lru_position);
+				m_statistics.m_hit_count++;
+				return entry->second.m_grid;
+			}
+		}
+
+		// Tessellate outside the lock, so that other threads keep hitting resident grids meanwhile. If two threads miss on the same patch, the first grid inserted wins.
+		std::shared_ptr<const Theia::TessellatedGrid> grid = patch->Tessellate(patch->TessellationRate());
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto entry = m_entries.find(patch);
+		if (entry != m_entries.end()) {
+			m_lru.splice(m_lru.begin(), m_lru, entry->second.m_lru_position);
+			return entry->second.m_grid;
+		}
+
+		m_lru.push_front(patch);
+		m_entries.emplace(patch, Entry{ grid, m_lru.begin() });
+		m_statistics.m_tessellation_count++;
+		m_statistics.m_resident_bytes += grid->GetMemoryBytes();
+		m_statistics.m_resident_count++;
+		Evict();
+		m_statistics.m_peak_resident_bytes = std::max(m_statistics.m_peak_resident_bytes, m_statistics.m_resident_bytes);
+		return grid;
+	}
+
+	// Never evicts the grid just inserted, so a single grid larger than the budget still renders.
+	void GeometryCache::Evict() {
+		while (m_statistics.m_resident_bytes > m_options.m_budget_bytes && m_lru.size() > 1) {
+			auto entry = m_entries.find(m_lru.back());
+			m_statistics.m_resident_bytes -= entry->second.m_grid->GetMemoryBytes();
+			m_statistics.m_resident_count--;
+			m_statistics.m_eviction_count++;
+			m_entries.erase(entry);
+			m_lru.pop_back();
+		}
+	}
+
+	Theia::UInt32 GeometryCache::TessellationRate(const Theia::AABB3f& bounds, Theia::Float size) const {
+		Theia::Float distance = Theia::Distance(m_dicing_ray.GetRay().GetOrigin(), bounds);
+		Theia::Float footprint = m_dicing_ray.FootprintWidth(distance) * m_options.m_shading_rate;
+		if (footprint <= 0.0f) {
+			return m_options.m_max_rate;
+		}
+
+		Theia::Float rate = std::ceil(size / footprint);
+		if (rate >= Theia::Float(m_options.m_max_rate)) {
+			return m_options.m_max_rate;
+		}
+		return std::min(Theia::UInt32(Theia::RoundUpPowerOf2(std::max(Theia::Int32(rate), 1))), m_options.m_max_rate);
+	}
+
+	Theia::GeometryCacheStatistics GeometryCache::GetStatistics() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_statistics;
+	}
+
+	TessellatedPatch::TessellatedPatch(const Theia::IParametricPatch* patch, Theia::GeometryCache* cache, Theia::DisplacementFunction displacement, Theia::Float max_displacement) :
+		m_patch(patch),
+		m_cache(cache),
+		m_displacement(std::move(displacement)),
+		m_size(std::max(IsolineLength(patch, true), IsolineLength(patch, false)))
+	{
+		Theia::AABB3f bounds = patch->Bounds();
+		Theia::Vector3f padding(max_displacement, max_displacement, max_displacement);
+		m_bounds = Theia::AABB3f(bounds.m_min - padding, bounds.m_max + padding);
+	}
+
+	Theia::AABB3f TessellatedPatch::Bounds() const {
+		return m_bounds;
+	}
+
+	// A BVH leaf can hold several patches, so the proxy bounds are tested again before anything is tessellated.
+	std::optional<Theia::ShapeIntersection> TessellatedPatch::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		if (!ReachesBounds(ray, t_max)) {
+			return {};
+		}
+		std::optional<Theia::ShapeIntersection> shape_intersection = m_cache->Acquire(this)->Intersect(ray, t_max);
+		// The triangle hit lives only as long as its grid, which the cache can evict, so the patch reports itself.
+		if (shape_intersection) {
+			shape_intersection->m_primitive = this;
+		}
+		return shape_intersection;
+	}
+
+	bool TessellatedPatch::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		if (!ReachesBounds(ray, t_max)) {
+			return false;
+		}
+		return m_cache->Acquire(this)->Occluded(ray, t_max);
+	}
+
+	std::shared_ptr<const Theia::TessellatedGrid> TessellatedPatch::Tessellate(Theia::UInt32 rate) const {
+		return std::make_shared<const Theia::TessellatedGrid>(m_patch, m_displacement, rate);
+	}
+
+	Theia::UInt32 TessellatedPatch::TessellationRate() const {
+		return m_cache->TessellationRate(m_bounds, m_size);
+	}
+
+	bool TessellatedPatch::ReachesBounds(const Theia::Ray& ray, Theia::Float t_max) const {
+		Theia::Vector3f inverse_direction = 1.0f / ray.GetDirection();
+		Theia::Int32 direction_is_negative[3] = { inverse_direction.m_x < 0, inverse_direction.m_y < 0, inverse_direction.m_z < 0 };
+		return m_bounds.IntersectP(ray.GetOrigin(), inverse_direction, direction_is_negative, t_max);
+	}
+}
\ No newline at end of file
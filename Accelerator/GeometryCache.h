@@ -0,0 +1,105 @@
+#ifndef _THEIA_ACCELERATOR_GEOMETRY_CACHE_H_
+#define _THEIA_ACCELERATOR_GEOMETRY_CACHE_H_
+#include "BVHAggregate.h"
+#include "../Math/RayDifferential.h"
+#include "../Shape/IParametricPatch.h"
+#include "../Shape/TriangleMesh.h"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace Theia {
+	class TessellatedPatch;
+
+	typedef struct GeometryCacheOptions {
+		// Bytes of tessellated geometry kept resident. Grids still being traced when they are evicted live on until their rays are done, so the peak is this plus one grid per thread.
+		Theia::UInt64 m_budget_bytes = Theia::UInt64(256) << 20;
+		// Target triangle edge length in pixel footprints of the dicing ray.
+		Theia::Float m_shading_rate = 1.0f;
+		// Quads per side of the finest grid.
+		Theia::UInt32 m_max_rate = 64;
+	} GeometryCacheOptions;
+
+	typedef struct GeometryCacheStatistics {
+		Theia::UInt64 m_hit_count = 0;
+		Theia::UInt64 m_tessellation_count = 0;
+		Theia::UInt64 m_eviction_count = 0;
+		Theia::UInt64 m_resident_bytes = 0;
+		Theia::UInt64 m_peak_resident_bytes = 0;
+		Theia::UInt32 m_resident_count = 0;
+	} GeometryCacheStatistics;
+
+	// Triangles of one patch tessellated into a rate x rate grid of quads, with their own BVH. The mesh uvs are the patch parameters.
+	class TessellatedGrid {
+	public:
+		TessellatedGrid(const Theia::IParametricPatch* patch, const Theia::DisplacementFunction& displacement, Theia::UInt32 rate);
+		TessellatedGrid(const TessellatedGrid&) = delete;
+		TessellatedGrid& operator=(const TessellatedGrid&) = delete;
+
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max) const;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max) const;
+
+		Theia::UInt32 GetRate() const;
+		Theia::UInt64 GetMemoryBytes() const;
+	protected:
+	private:
+		Theia::UInt32 m_rate;
+		Theia::TriangleMesh m_mesh;
+		std::vector<Theia::Triangle> m_triangles;
+		Theia::BVHAggregate m_bvh;
+	};
+
+	// Tessellations of the TessellatedPatch primitives that rays have reached, evicted least recently used first once they take more than the budget. The dicing ray is usually the camera ray through the center of the film: its footprint at the distance of a patch sets the tessellation rate, so that every ray sees the same grid whatever its origin and the rate does not depend on the order of the rays.
+	class GeometryCache {
+	public:
+		GeometryCache(const Theia::RayDifferential& dicing_ray, const Theia::GeometryCacheOptions& options = Theia::GeometryCacheOptions());
+
+		// The grid of the patch, tessellated now if it is not resident. Safe to call from several threads.
+		std::shared_ptr<const Theia::TessellatedGrid> Acquire(const Theia::TessellatedPatch* patch);
+
+		// Quads per side for a patch of the given bounds whose isoparametric lines are about size long, a power of 2 so that neighbouring rates nest.
+		Theia::UInt32 TessellationRate(const Theia::AABB3f& bounds, Theia::Float size) const;
+
+		Theia::GeometryCacheStatistics GetStatistics() const;
+	protected:
+	private:
+		typedef struct Entry {
+			std::shared_ptr<const Theia::TessellatedGrid> m_grid;
+			std::list<const Theia::TessellatedPatch*>::iterator m_lru_position;
+		} Entry;
+
+		void Evict();
+
+		Theia::RayDifferential m_dicing_ray;
+		Theia::GeometryCacheOptions m_options;
+		mutable std::mutex m_mutex;
+		std::unordered_map<const Theia::TessellatedPatch*, Entry> m_entries;
+		// Most recently used at the front.
+		std::list<const Theia::TessellatedPatch*> m_lru;
+		Theia::GeometryCacheStatistics m_statistics;
+	};
+
+	// Stands in for a parametric patch in the BVH with its proxy bounds, which include the largest displacement. The patch is only tessellated once a ray reaches these bounds.
+	class TessellatedPatch : public IPrimitive {
+	public:
+		TessellatedPatch(const Theia::IParametricPatch* patch, Theia::GeometryCache* cache, Theia::DisplacementFunction displacement = {}, Theia::Float max_displacement = 0.0f);
+
+		Theia::AABB3f Bounds() const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+
+		std::shared_ptr<const Theia::TessellatedGrid> Tessellate(Theia::UInt32 rate) const;
+		Theia::UInt32 TessellationRate() const;
+	protected:
+	private:
+		bool ReachesBounds(const Theia::Ray& ray, Theia::Float t_max) const;
+
+		const Theia::IParametricPatch* m_patch;
+		Theia::GeometryCache* m_cache;
+		Theia::DisplacementFunction m_displacement;
+		Theia::AABB3f m_bounds;
+		Theia::Float m_size;
+	};
+}
+#endif
\ No newline at end of file
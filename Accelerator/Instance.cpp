@@ -0,0 +1,50 @@
+#include "Instance.h"
+
+namespace Theia {
+	namespace {
+		Theia::Vector3f ToVector(const Theia::Normal3f& normal) {
+			return Theia::Vector3f(normal.m_x, normal.m_y, normal.m_z);
+		}
+
+		Theia::IInteraction TransformInteraction(const Theia::Transform& transform, const Theia::IInteraction& interaction) {
+			Theia::Vector3f w_o = transform(interaction.m_w_o);
+			if (Theia::LengthSquared(w_o) > 0.0f) {
+				w_o = Theia::Normalize(w_o);
+			}
+			Theia::Vector3f normal = Theia::Normalize(ToVector(transform(interaction.m_normal)));
+
+			Theia::IInteraction transformed_interaction = interaction;
+			transformed_interaction.m_point_interval = transform(interaction.m_point_interval);
+			transformed_interaction.m_w_o = w_o;
+			transformed_interaction.m_normal = Theia::Normal3f(normal.m_x, normal.m_y, normal.m_z);
+			return transformed_interaction;
+		}
+	}
+
+	Instance::Instance(const Theia::IPrimitive* primitive, const Theia::Transform& render_from_object) :
+		m_primitive(primitive),
+		m_render_from_object(render_from_object)
+	{
+
+	}
+
+	Theia::AABB3f Instance::Bounds() const {
+		return m_render_from_object(m_primitive->Bounds());
+	}
+
+	std::optional<Theia::ShapeIntersection> Instance::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		Theia::Ray object_ray = m_render_from_object.ApplyInverse(ray, t_max);
+		std::optional<Theia::ShapeIntersection> shape_intersection = m_primitive->Intersect(object_ray, t_max);
+		if (!shape_intersection) {
+			return {};
+		}
+
+		shape_intersection->m_interaction = TransformInteraction(m_render_from_object, shape_intersection->m_interaction);
+		return shape_intersection;
+	}
+
+	bool Instance::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		Theia::Ray object_ray = m_render_from_object.ApplyInverse(ray, t_max);
+		return m_primitive->Occluded(object_ray, t_max);
+	}
+}
@@ -0,0 +1,20 @@
+#ifndef _THEIA_ACCELERATOR_INSTANCE_H_
+#define _THEIA_ACCELERATOR_INSTANCE_H_
+#include "../Engine/IPrimitive.h"
+
+namespace Theia {
+	// Places a shared bottom-level primitive (usually a BVHAggregate) in the scene. Rays are moved into object space on entry, so instances cost no geometry memory of their own.
+	class Instance : public IPrimitive {
+	public:
+		Instance(const Theia::IPrimitive* primitive, const Theia::Transform& render_from_object);
+
+		Theia::AABB3f Bounds() const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+	protected:
+	private:
+		const Theia::IPrimitive* m_primitive;
+		Theia::Transform m_render_from_object;
+	};
+}
+#endif
@@ -0,0 +1,145 @@
+#include "RaySorter.h"
+#include "BVHAggregate.h"
+#include "../Parallel/Algorithms.h"
+#include <algorithm>
+#include <chrono>
+
+namespace Theia {
+	namespace {
+		// Rays a thread keys at a time.
+		constexpr Theia::UInt32 Chunk_Size = 16384;
+		// Bits of every coordinate of the quantized direction and the origin.
+		constexpr Theia::UInt32 Direction_Bits = 3;
+		constexpr Theia::UInt32 Origin_Bits = 10;
+		// 39 bits, sorted in five passes.
+		constexpr Theia::UInt32 Key_Bits = 3 + 3 * Origin_Bits + 2 * Direction_Bits;
+
+		Theia::Float64 MillisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<Theia::Float64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// Spreads the low 21 bits of value so that two zero bits follow each of them.
+		Theia::UInt64 SpreadBits3(Theia::UInt64 value) {
+			value &= 0x1FFFFF;
+			value = (value | (value << 32)) & 0x001F00000000FFFFull;
+			value = (value | (value << 16)) & 0x001F0000FF0000FFull;
+			value = (value | (value << 8)) & 0x100F00F00F00F00Full;
+			value = (value | (value << 4)) & 0x10C30C30C30C30C3ull;
+			value = (value | (value << 2)) & 0x1249249249249249ull;
+			return value;
+		}
+
+		// Spreads the low 16 bits of value so that a zero bit follows each of them.
+		Theia::UInt32 SpreadBits2(Theia::UInt32 value) {
+			value &= 0xFFFF;
+			value = (value | (value << 8)) & 0x00FF00FFu;
+			value = (value | (value << 4)) & 0x0F0F0F0Fu;
+			value = (value | (value << 2)) & 0x33333333u;
+			value = (value | (value << 1)) & 0x55555555u;
+			return value;
+		}
+
+		Theia::UInt32 Quantize(Theia::Float value, Theia::UInt32 bits) {
+			Theia::Float scaled = value * Theia::Float(1u << bits);
+			return std::min(Theia::UInt32(std::max(scaled, 0.0f)), (1u << bits) - 1);
+		}
+
+		// Octant in the top bits, then the Morton code of the origin, then the Morton code of the direction projected onto the octahedron within the octant. Origins come before the finer direction, as rays that share a direction but start all over the scene visit all of the BVH between them. origin_scale maps the origin bounds of the batch to the unit cube.
+		Theia::UInt64 RayKey(const Theia::Ray& ray, const Theia::Point3f& origin_min, const Theia::Vector3f& origin_scale) {
+			Theia::Vector3f direction = ray.GetDirection();
+			Theia::UInt64 octant = (std::signbit(direction.m_x) ? 1 : 0) | (std::signbit(direction.m_y) ? 2 : 0) | (std::signbit(direction.m_z) ? 4 : 0);
+			Theia::Float length = std::abs(direction.m_x) + std::abs(direction.m_y) + std::abs(direction.m_z);
+			Theia::UInt64 direction_code = 0;
+			if (length > 0.0f) {
+				Theia::Float inverse_length = 1.0f / length;
+				direction_code = Theia::UInt64(SpreadBits2(Quantize(std::abs(direction.m_x) * inverse_length, Direction_Bits)) | (SpreadBits2(Quantize(std::abs(direction.m_y) * inverse_length, Direction_Bits)) << 1));
+			}
+
+			Theia::Point3f origin = ray.GetOrigin();
+			Theia::UInt64 origin_code = SpreadBits3(Quantize((origin.m_x - origin_min.m_x) * origin_scale.m_x, Origin_Bits)) | (SpreadBits3(Quantize((origin.m_y - origin_min.m_y) * origin_scale.m_y, Origin_Bits)) << 1) | (SpreadBits3(Quantize((origin.m_z - origin_min.m_z) * origin_scale.m_z, Origin_Bits)) << 2);
+			return (octant << (3 * Origin_Bits + 2 * Direction_Bits)) | (origin_code << (2 * Direction_Bits)) | direction_code;
+		}
+	}
+
+	RaySorter::RaySorter(Theia::ThreadPool& pool) :
+		m_pool(pool)
+	{
+
+	}
+
+	void RaySorter::Sort(std::span<const Theia::Ray> rays) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Theia::UInt32 ray_count = Theia::UInt32(rays.size());
+		Theia::UInt32 chunk_count = (ray_count + Chunk_Size - 1) / Chunk_Size;
+		auto for_each_chunk = [&](const auto& function) {
+			Theia::ParallelFor(0, chunk_count, [&](Theia::Int64 chunk) {
+				Theia::UInt32 begin = Theia::UInt32(chunk) * Chunk_Size;
+				function(Theia::UInt32(chunk), begin, std::min(begin + Chunk_Size, ray_count));
+			}, 1, m_pool);
+		};
+
+		std::vector<Theia::AABB3f> chunk_bounds(chunk_count);
+		for_each_chunk([&](Theia::UInt32 chunk, Theia::UInt32 begin, Theia::UInt32 end) {
+			Theia::AABB3f bounds;
+			for (Theia::UInt32 i = begin; i < end; i++) {
+				bounds = Theia::Union(bounds, rays[i].GetOrigin());
+			}
+			chunk_bounds[chunk] = bounds;
+		});
+		Theia::AABB3f origin_bounds;
+		for (const Theia::AABB3f& bounds : chunk_bounds) {
+			origin_bounds = Theia::Union(origin_bounds, bounds);
+		}
+
+		Theia::Vector3f extent = origin_bounds.IsEmpty() ? Theia::Vector3f(0.0f, 0.0f, 0.0f) : origin_bounds.Diagonal();
+		Theia::Vector3f origin_scale(extent.m_x > 0.0f ? 1.0f / extent.m_x : 0.0f, extent.m_y > 0.0f ? 1.0f / extent.m_y : 0.0f, extent.m_z > 0.0f ? 1.0f / extent.m_z : 0.0f);
+		m_keys.resize(ray_count);
+		m_order.resize(ray_count);
+		for_each_chunk([&](Theia::UInt32, Theia::UInt32 begin, Theia::UInt32 end) {
+			for (Theia::UInt32 i = begin; i < end; i++) {
+				m_keys[i] = RayKey(rays[i], origin_bounds.m_min, origin_scale);
+				m_order[i] = i;
+			}
+		});
+
+		m_statistics = Theia::RaySortStatistics();
+		m_statistics.m_pass_count = Theia::RadixSort(m_keys, m_order, m_sorted_keys, m_sorted_order, Key_Bits, m_pool);
+		m_statistics.m_ray_count = ray_count;
+		m_statistics.m_sort_milliseconds = MillisecondsSince(start);
+	}
+
+	std::span<const Theia::UInt32> RaySorter::GetOrder() const {
+		return m_order;
+	}
+
+	const Theia::RaySortStatistics& RaySorter::GetStatistics() const {
+		return m_statistics;
+	}
+
+	Theia::RayCoherence RaySorter::MeasureCoherence(std::span<const Theia::Ray> rays) {
+		Theia::RayCoherence coherence;
+		if (rays.empty()) {
+			return coherence;
+		}
+
+		Theia::Float64 origin_distance_sum = 0.0;
+		Theia::Float64 direction_cosine_sum = 0.0;
+		for (size_t i = 1; i < rays.size(); ++i) {
+			origin_distance_sum += Theia::Length(rays[i].GetOrigin() - rays[i - 1].GetOrigin());
+			direction_cosine_sum += Theia::Dot(Theia::Normalize(rays[i].GetDirection()), Theia::Normalize(rays[i - 1].GetDirection()));
+		}
+		size_t pair_count = std::max<size_t>(rays.size() - 1, 1);
+		coherence.m_mean_origin_distance = Theia::Float(origin_distance_sum / Theia::Float64(pair_count));
+		coherence.m_mean_direction_cosine = Theia::Float(direction_cosine_sum / Theia::Float64(pair_count));
+
+		size_t packet_count = 0;
+		size_t coherent_count = 0;
+		for (size_t begin = 0; begin < rays.size(); begin += Theia::BVHAggregate::Packet_Size) {
+			std::span<const Theia::Ray> packet = rays.subspan(begin, std::min<size_t>(Theia::BVHAggregate::Packet_Size, rays.size() - begin));
+			coherent_count += Theia::BVHAggregate::ChooseTraversal(packet) == Theia::BVHTraversal::Packet ? 1 : 0;
+			packet_count++;
+		}
+		coherence.m_packet_fraction = Theia::Float(coherent_count) / Theia::Float(packet_count);
+		return coherence;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef _THEIA_ACCELERATOR_RAY_SORTER_H_
+#define _THEIA_ACCELERATOR_RAY_SORTER_H_
+#include "../Math/Math.h"
+#include "../Parallel/ThreadPool.h"
+#include <span>
+#include <vector>
+
+namespace Theia {
+	typedef struct RaySortStatistics {
+		Theia::UInt32 m_ray_count = 0;
+		// Radix passes that moved keys; passes over a digit that every key shares are skipped.
+		Theia::UInt32 m_pass_count = 0;
+		Theia::Float64 m_sort_milliseconds = 0.0;
+	} RaySortStatistics;
+
+	// Measures of how similar consecutive rays of a batch are.
+	typedef struct RayCoherence {
+		Theia::Float m_mean_origin_distance = 0.0f;
+		Theia::Float m_mean_direction_cosine = 0.0f;
+		// Fraction of the consecutive groups of BVHAggregate::Packet_Size rays that BVHAggregate::ChooseTraversal would trace as packets.
+		Theia::Float m_packet_fraction = 0.0f;
+	} RayCoherence;
+
+	// Orders batches of incoherent rays, such as the bounce rays of a path tracer, so that rays crossing the same parts of a BVH are adjacent and a batch traced in that order keeps reusing the nodes it has just loaded. As in Disney's Hyperion, every ray gets a key from its direction octant, the Morton code of its origin in the bounds of the batch and its direction quantized within the octant, and the keys are sorted with RadixSort.
+	class RaySorter {
+	public:
+		explicit RaySorter(Theia::ThreadPool& pool = Theia::ThreadPool::Default());
+
+		void Sort(std::span<const Theia::Ray> rays);
+
+		// Indices into the rays of the last Sort, in sorted order.
+		std::span<const Theia::UInt32> GetOrder() const;
+		const Theia::RaySortStatistics& GetStatistics() const;
+
+		static Theia::RayCoherence MeasureCoherence(std::span<const Theia::Ray> rays);
+	protected:
+	private:
+		Theia::ThreadPool& m_pool;
+		std::vector<Theia::UInt64> m_keys;
+		std::vector<Theia::UInt64> m_sorted_keys;
+		std::vector<Theia::UInt32> m_order;
+		std::vector<Theia::UInt32> m_sorted_order;
+		Theia::RaySortStatistics m_statistics;
+	};
+}
+#endif
\ No newline at end of file
@@ -3,4 +3,5 @@
 
 #include "IInteraction.h"
 #include "ICamera.h"
+#include "IPrimitive.h"
 #endif
\ No newline at end of file
@@ -37,7 +37,37 @@ namespace Theia {
 		{
 
 		}
-		
+
+		// Point just outside the error bounds of m_point_interval on the side of the surface that direction leaves through, so a ray spawned from it cannot hit the surface it starts on.
+		Theia::Point3f OffsetRayOrigin(const Theia::Vector3f& direction) const {
+			Theia::Vector3f normal = Theia::Vector3f(m_normal.m_x, m_normal.m_y, m_normal.m_z);
+			Theia::Vector3f error = Theia::Vector3f(m_point_interval.m_x.GetRange(), m_point_interval.m_y.GetRange(), m_point_interval.m_z.GetRange()) / 2.0f;
+			Theia::Vector3f offset = Theia::Dot(Theia::Abs(normal), error) * normal;
+			if (Theia::Dot(direction, normal) < 0.0f) {
+				offset = -offset;
+			}
+
+			Theia::Point3f origin = Theia::Point3f(m_point_interval) + offset;
+			for (Theia::UInt32 i = 0; i < 3; ++i) {
+				if (offset[i] > 0.0f) {
+					origin[i] = Theia::NextFloatUp(origin[i]);
+				}
+				else if (offset[i] < 0.0f) {
+					origin[i] = Theia::NextFloatDown(origin[i]);
+				}
+			}
+
+			return origin;
+		}
+
+		Theia::Medium GetMedium(const Theia::Vector3f& direction) const {
+			return Theia::Dot(direction, Theia::Vector3f(m_normal.m_x, m_normal.m_y, m_normal.m_z)) > 0.0f ? m_medium_pair.m_outside : m_medium_pair.m_inside;
+		}
+
+		Theia::Ray SpawnRay(const Theia::Vector3f& direction) const {
+			return Theia::Ray(OffsetRayOrigin(direction), direction, m_time, GetMedium(direction));
+		}
+
 		Point3Interval m_point_interval;
 		Theia::Float m_time;
 		Theia::Vector3f m_w_o;
@@ -0,0 +1,35 @@
+#ifndef _THEIA_ENGINE_I_PRIMITIVE_H_
+#define _THEIA_ENGINE_I_PRIMITIVE_H_
+#include "../Math/Math.h"
+#include "IInteraction.h"
+#include <optional>
+
+namespace Theia {
+	class IPrimitive;
+
+	typedef struct ShapeIntersection {
+		Theia::IInteraction m_interaction;
+		Theia::Float m_t_hit;
+		// Innermost primitive that was hit and outlives the query, set by aggregates so callers can look up what the surface is made of. Null from shapes queried directly.
+		const Theia::IPrimitive* m_primitive = nullptr;
+	} ShapeIntersection;
+
+	class IPrimitive {
+	public:
+		virtual ~IPrimitive() = default;
+		virtual Theia::AABB3f Bounds() const = 0;
+		virtual std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const = 0;
+		// Any-hit query for shadow and visibility rays: true as soon as some hit closer than t_max is found, without building an interaction.
+		virtual bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const = 0;
+
+		// Bounds of the part of the primitive that lies inside clip_aabb, used by spatial splits.
+		virtual Theia::AABB3f ClippedBounds(const Theia::AABB3f& clip_aabb) const {
+			return Theia::Intersection(Bounds(), clip_aabb);
+		}
+	protected:
+	private:
+	};
+
+	typedef IPrimitive* Primitive;
+}
+#endif
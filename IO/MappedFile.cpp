@@ -0,0 +1,125 @@
+#include "MappedFile.h"
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Theia {
+	MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+		HANDLE file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE) {
+			return;
+		}
+		m_file_handle = file_handle;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_handle, &size)) {
+			Close();
+			return;
+		}
+		m_size = Theia::UInt64(size.QuadPart);
+		m_is_open = true;
+		// Empty files cannot be mapped, but are still valid files.
+		if (m_size == 0) {
+			return;
+		}
+
+		m_mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_mapping_handle) {
+			Close();
+			return;
+		}
+		m_data = static_cast<const Theia::UInt8*>(MapViewOfFile(m_mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (!m_data) {
+			Close();
+		}
+#else
+		int file_descriptor = open(path.c_str(), O_RDONLY);
+		if (file_descriptor < 0) {
+			return;
+		}
+
+		struct stat file_status;
+		if (fstat(file_descriptor, &file_status) != 0) {
+			close(file_descriptor);
+			return;
+		}
+		m_size = Theia::UInt64(file_status.st_size);
+		m_is_open = true;
+		// Empty files cannot be mapped, but are still valid files.
+		if (m_size > 0) {
+			void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+			if (data == MAP_FAILED) {
+				m_size = 0;
+				m_is_open = false;
+			}
+			else {
+				m_data = static_cast<const Theia::UInt8*>(data);
+			}
+		}
+		// The mapping keeps its own reference to the file.
+		close(file_descriptor);
+#endif
+	}
+
+	MappedFile::MappedFile(MappedFile&& mapped_file) noexcept {
+		*this = std::move(mapped_file);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& mapped_file) noexcept {
+		if (this != &mapped_file) {
+			Close();
+			m_data = std::exchange(mapped_file.m_data, nullptr);
+			m_size = std::exchange(mapped_file.m_size, 0);
+			m_is_open = std::exchange(mapped_file.m_is_open, false);
+#ifdef _WIN32
+			m_file_handle = std::exchange(mapped_file.m_file_handle, nullptr);
+			m_mapping_handle = std::exchange(mapped_file.m_mapping_handle, nullptr);
+#endif
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+	bool MappedFile::IsOpen() const {
+		return m_is_open;
+	}
+
+	std::span<const Theia::UInt8> MappedFile::GetBytes() const {
+		return std::span<const Theia::UInt8>(m_data, m_data ? size_t(m_size) : 0);
+	}
+
+	void MappedFile::Close() {
+#ifdef _WIN32
+		if (m_data) {
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping_handle) {
+			CloseHandle(m_mapping_handle);
+		}
+		if (m_file_handle) {
+			CloseHandle(m_file_handle);
+		}
+		m_file_handle = nullptr;
+		m_mapping_handle = nullptr;
+#else
+		if (m_data) {
+			munmap(const_cast<Theia::UInt8*>(m_data), m_size);
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+		m_is_open = false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef _THEIA_IO_MAPPED_FILE_H_
+#define _THEIA_IO_MAPPED_FILE_H_
+#include "../Types.h"
+#include <span>
+#include <string>
+
+namespace Theia {
+	// Read-only view of a whole file through the virtual memory system, so that pages are only read from disk when they are first touched.
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		// IsOpen() is false when the file cannot be opened or mapped.
+		explicit MappedFile(const std::string& path);
+		MappedFile(MappedFile&& mapped_file) noexcept;
+		MappedFile& operator=(MappedFile&& mapped_file) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		bool IsOpen() const;
+		std::span<const Theia::UInt8> GetBytes() const;
+	protected:
+	private:
+		void Close();
+
+		const Theia::UInt8* m_data = nullptr;
+		Theia::UInt64 m_size = 0;
+		bool m_is_open = false;
+#ifdef _WIN32
+		void* m_file_handle = nullptr;
+		void* m_mapping_handle = nullptr;
+#endif
+	};
+}
+#endif
\ No newline at end of file
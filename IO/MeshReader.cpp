@@ -0,0 +1,20 @@
+#include "MeshReader.h"
+#include <algorithm>
+#include <cctype>
+
+namespace Theia {
+	Theia::MeshReadResult ReadMesh(const std::string& path, const Theia::Transform& render_from_object, const Theia::MeshReadOptions& options) {
+		std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(std::tolower(Theia::UInt8(c))); });
+		if (extension == ".ply") {
+			return Theia::ReadPLY(path, render_from_object, options);
+		}
+		else if (extension == ".obj") {
+			return Theia::ReadOBJ(path, render_from_object, options);
+		}
+
+		Theia::MeshReadResult result;
+		result.m_error = "ReadMesh does not know the format of " + path + ".";
+		return result;
+	}
+}
\ No newline at end of file
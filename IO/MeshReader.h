@@ -0,0 +1,28 @@
+#ifndef _THEIA_IO_MESH_READER_H_
+#define _THEIA_IO_MESH_READER_H_
+#include "../Math/Math.h"
+#include "../Shape/TriangleMesh.h"
+#include <memory>
+#include <string>
+
+namespace Theia {
+	typedef struct MeshReadOptions {
+		// Number of pieces the file is parsed in, each a task of the default thread pool; 0 uses one per thread of the pool.
+		Theia::UInt32 m_thread_count = 0;
+	} MeshReadOptions;
+
+	typedef struct MeshReadResult {
+		// Null when the file could not be read, with the reason in m_error.
+		std::unique_ptr<Theia::TriangleMesh> m_mesh;
+		std::string m_error;
+		Theia::UInt64 m_file_bytes = 0;
+	} MeshReadResult;
+
+	// ASCII and binary PLY with float or integer vertex properties. Reads x, y, z, optional nx, ny, nz and u, v (or s, t), and the vertex_indices lists of faces, which are split into fans. Other properties and elements are skipped.
+	Theia::MeshReadResult ReadPLY(const std::string& path, const Theia::Transform& render_from_object = Theia::Transform(), const Theia::MeshReadOptions& options = Theia::MeshReadOptions());
+	// Wavefront OBJ positions, texture coordinates, normals and faces, including negative indices. Polygons are split into fans, and all groups go into one mesh; materials are ignored. Corners that pair a position with several uvs or normals get a vertex of their own.
+	Theia::MeshReadResult ReadOBJ(const std::string& path, const Theia::Transform& render_from_object = Theia::Transform(), const Theia::MeshReadOptions& options = Theia::MeshReadOptions());
+	// Picks the reader from the file extension.
+	Theia::MeshReadResult ReadMesh(const std::string& path, const Theia::Transform& render_from_object = Theia::Transform(), const Theia::MeshReadOptions& options = Theia::MeshReadOptions());
+}
+#endif
\ No newline at end of file
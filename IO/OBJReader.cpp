@@ -0,0 +1,310 @@
+#include "MeshReader.h"
+#include "MappedFile.h"
+#include "Parsing.h"
+#include "../Math/Hash.h"
+#include <unordered_map>
+
+namespace Theia {
+	namespace {
+		constexpr Theia::UInt32 No_Index = 0xFFFFFFFF;
+
+		enum class OBJLine {
+			Position,
+			UV,
+			Normal,
+			Face,
+			Other
+		};
+
+		typedef struct OBJCounts {
+			Theia::UInt64 m_position_count = 0;
+			Theia::UInt64 m_uv_count = 0;
+			Theia::UInt64 m_normal_count = 0;
+			Theia::UInt64 m_triangle_count = 0;
+			bool m_has_corner_uvs = false;
+			bool m_has_corner_normals = false;
+		} OBJCounts;
+
+		typedef struct OBJCorner {
+			Theia::UInt32 m_position;
+			Theia::UInt32 m_uv;
+			Theia::UInt32 m_normal;
+
+			bool operator==(const OBJCorner& corner) const {
+				return m_position == corner.m_position && m_uv == corner.m_uv && m_normal == corner.m_normal;
+			}
+		} OBJCorner;
+
+		typedef struct OBJCornerHash {
+			size_t operator()(const OBJCorner& corner) const {
+				return size_t(Theia::HashBuffer(&corner, sizeof(OBJCorner)));
+			}
+		} OBJCornerHash;
+
+		// Moves cursor past the keyword of the line.
+		OBJLine ClassifyLine(const char*& cursor, const char* end) {
+			cursor = Theia::SkipSpaces(cursor, end);
+			if (end - cursor < 2) {
+				return OBJLine::Other;
+			}
+
+			if (cursor[0] == 'v') {
+				if (Theia::IsSpace(cursor[1])) {
+					cursor += 2;
+					return OBJLine::Position;
+				}
+				else if (end - cursor >= 3 && Theia::IsSpace(cursor[2]) && (cursor[1] == 't' || cursor[1] == 'n')) {
+					cursor += 3;
+					return cursor[-2] == 't' ? OBJLine::UV : OBJLine::Normal;
+				}
+			}
+			else if (cursor[0] == 'f' && Theia::IsSpace(cursor[1])) {
+				cursor += 2;
+				return OBJLine::Face;
+			}
+			return OBJLine::Other;
+		}
+
+		void CountChunk(const char* cursor, const char* end, OBJCounts& counts) {
+			while (cursor < end) {
+				OBJLine line = ClassifyLine(cursor, end);
+				if (line == OBJLine::Position) {
+					++counts.m_position_count;
+				}
+				else if (line == OBJLine::UV) {
+					++counts.m_uv_count;
+				}
+				else if (line == OBJLine::Normal) {
+					++counts.m_normal_count;
+				}
+				else if (line == OBJLine::Face) {
+					Theia::UInt64 corner_count = 0;
+					while (true) {
+						cursor = Theia::SkipSpaces(cursor, end);
+						if (cursor == end || *cursor == '\n') {
+							break;
+						}
+						const char* token_end = Theia::SkipToken(cursor, end);
+						const char* slash = std::find(cursor, token_end, '/');
+						if (slash != token_end) {
+							counts.m_has_corner_uvs |= slash + 1 < token_end && slash[1] != '/';
+							counts.m_has_corner_normals |= std::find(slash + 1, token_end, '/') != token_end;
+						}
+						cursor = token_end;
+						++corner_count;
+					}
+					counts.m_triangle_count += corner_count >= 3 ? corner_count - 2 : 0;
+				}
+				cursor = Theia::NextLine(cursor, end);
+			}
+		}
+
+		// OBJ indices start at 1, and negative ones count back from the last element read so far.
+		bool ResolveIndex(Theia::Int64 index, Theia::UInt64 count_so_far, Theia::UInt64 total_count, Theia::UInt32& resolved) {
+			Theia::Int64 zero_based = index > 0 ? index - 1 : Theia::Int64(count_so_far) + index;
+			if (index == 0 || zero_based < 0 || zero_based >= Theia::Int64(total_count)) {
+				return false;
+			}
+			resolved = Theia::UInt32(zero_based);
+			return true;
+		}
+
+		bool ParseFloats(const char*& cursor, const char* end, Theia::Float* values, Theia::UInt32 count) {
+			for (Theia::UInt32 i = 0; i < count; ++i) {
+				cursor = Theia::SkipSpaces(cursor, end);
+				if (!Theia::ParseFloat(cursor, end, values[i])) {
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	Theia::MeshReadResult ReadOBJ(const std::string& path, const Theia::Transform& render_from_object, const Theia::MeshReadOptions& options) {
+		Theia::MeshReadResult result;
+		Theia::MappedFile file(path);
+		if (!file.IsOpen()) {
+			result.m_error = "ReadOBJ cannot open " + path + ".";
+			return result;
+		}
+		std::span<const Theia::UInt8> bytes = file.GetBytes();
+		result.m_file_bytes = bytes.size();
+		const char* begin = reinterpret_cast<const char*>(bytes.data());
+		const char* end = begin + bytes.size();
+
+		// First pass counts the elements of each chunk, so that the second can write them straight to their place in the final buffers.
+		Theia::UInt32 chunk_count = Theia::UInt32(std::clamp<Theia::UInt64>(bytes.size() / (1 << 20), 1, Theia::ReadThreadCount(options.m_thread_count)));
+		std::vector<const char*> boundaries = Theia::SplitLines(begin, end, chunk_count);
+		std::vector<OBJCounts> chunk_counts(chunk_count);
+		Theia::RunChunks(chunk_count, [&](Theia::UInt32 chunk) {
+			CountChunk(boundaries[chunk], boundaries[chunk + 1], chunk_counts[chunk]);
+		});
+
+		std::vector<OBJCounts> chunk_offsets(chunk_count);
+		OBJCounts totals;
+		for (Theia::UInt32 chunk = 0; chunk < chunk_count; ++chunk) {
+			chunk_offsets[chunk] = totals;
+			totals.m_position_count += chunk_counts[chunk].m_position_count;
+			totals.m_uv_count += chunk_counts[chunk].m_uv_count;
+			totals.m_normal_count += chunk_counts[chunk].m_normal_count;
+			totals.m_triangle_count += chunk_counts[chunk].m_triangle_count;
+			totals.m_has_corner_uvs |= chunk_counts[chunk].m_has_corner_uvs;
+			totals.m_has_corner_normals |= chunk_counts[chunk].m_has_corner_normals;
+		}
+		if (totals.m_position_count >= No_Index || 3 * totals.m_triangle_count >= No_Index) {
+			result.m_error = "ReadOBJ " + path + " has too many vertices or triangles for 32-bit indices.";
+			return result;
+		}
+
+		std::vector<Theia::Point3f> positions(totals.m_position_count);
+		std::vector<Theia::Point2f> uvs(totals.m_has_corner_uvs ? totals.m_uv_count : 0);
+		std::vector<Theia::Normal3f> normals(totals.m_has_corner_normals ? totals.m_normal_count : 0);
+		std::vector<Theia::UInt32> indices(3 * totals.m_triangle_count);
+		std::vector<Theia::UInt32> corner_uvs(totals.m_has_corner_uvs ? indices.size() : 0, No_Index);
+		std::vector<Theia::UInt32> corner_normals(totals.m_has_corner_normals ? indices.size() : 0, No_Index);
+
+		std::vector<std::string> chunk_errors(chunk_count);
+		Theia::RunChunks(chunk_count, [&](Theia::UInt32 chunk) {
+			OBJCounts next = chunk_offsets[chunk];
+			std::string& error = chunk_errors[chunk];
+			const char* cursor = boundaries[chunk];
+			const char* chunk_end = boundaries[chunk + 1];
+			while (cursor < chunk_end && error.empty()) {
+				OBJLine line = ClassifyLine(cursor, chunk_end);
+				if (line == OBJLine::Position) {
+					Theia::Float values[3];
+					if (!ParseFloats(cursor, chunk_end, values, 3)) {
+						error = "ReadOBJ " + path + " has a malformed vertex position.";
+					}
+					positions[next.m_position_count++] = Theia::Point3f(values[0], values[1], values[2]);
+				}
+				else if (line == OBJLine::UV) {
+					// v is optional.
+					Theia::Float values[2] = { 0.0f, 0.0f };
+					const char* second = Theia::SkipSpaces(Theia::SkipToken(Theia::SkipSpaces(cursor, chunk_end), chunk_end), chunk_end);
+					bool has_v = second < chunk_end && *second != '\n';
+					if (!ParseFloats(cursor, chunk_end, values, has_v ? 2 : 1)) {
+						error = "ReadOBJ " + path + " has a malformed texture coordinate.";
+					}
+					else if (!uvs.empty()) {
+						uvs[next.m_uv_count] = Theia::Point2f(values[0], values[1]);
+					}
+					++next.m_uv_count;
+				}
+				else if (line == OBJLine::Normal) {
+					Theia::Float values[3];
+					if (!ParseFloats(cursor, chunk_end, values, 3)) {
+						error = "ReadOBJ " + path + " has a malformed normal.";
+					}
+					else if (!normals.empty()) {
+						normals[next.m_normal_count] = Theia::Normal3f(values[0], values[1], values[2]);
+					}
+					++next.m_normal_count;
+				}
+				else if (line == OBJLine::Face) {
+					// Corners are written as fans around the first one.
+					OBJCorner first, previous;
+					Theia::UInt32 corner_count = 0;
+					while (error.empty()) {
+						cursor = Theia::SkipSpaces(cursor, chunk_end);
+						if (cursor == chunk_end || *cursor == '\n') {
+							break;
+						}
+
+						OBJCorner corner = { No_Index, No_Index, No_Index };
+						Theia::Int64 index = 0;
+						bool is_valid = Theia::ParseInt(cursor, chunk_end, index) && ResolveIndex(index, next.m_position_count, totals.m_position_count, corner.m_position);
+						if (is_valid && cursor < chunk_end && *cursor == '/') {
+							++cursor;
+							if (cursor < chunk_end && *cursor != '/') {
+								is_valid = Theia::ParseInt(cursor, chunk_end, index) && ResolveIndex(index, next.m_uv_count, totals.m_uv_count, corner.m_uv);
+							}
+							if (is_valid && cursor < chunk_end && *cursor == '/') {
+								++cursor;
+								is_valid = Theia::ParseInt(cursor, chunk_end, index) && ResolveIndex(index, next.m_normal_count, totals.m_normal_count, corner.m_normal);
+							}
+						}
+						if (!is_valid) {
+							error = "ReadOBJ " + path + " has a malformed or out of range face index.";
+							break;
+						}
+
+						if (corner_count == 0) {
+							first = corner;
+						}
+						else if (corner_count >= 2) {
+							size_t offset = 3 * next.m_triangle_count++;
+							const OBJCorner triangle[3] = { first, previous, corner };
+							for (Theia::UInt32 k = 0; k < 3; ++k) {
+								indices[offset + k] = triangle[k].m_position;
+								if (!corner_uvs.empty()) {
+									corner_uvs[offset + k] = triangle[k].m_uv;
+								}
+								if (!corner_normals.empty()) {
+									corner_normals[offset + k] = triangle[k].m_normal;
+								}
+							}
+						}
+						previous = corner;
+						++corner_count;
+					}
+				}
+				cursor = Theia::NextLine(cursor, chunk_end);
+			}
+		});
+
+		for (const std::string& error : chunk_errors) {
+			if (!error.empty()) {
+				result.m_error = error;
+				return result;
+			}
+		}
+
+		// Exporters that number uvs and normals like positions need no remapping. Otherwise every position takes the attributes of its first corner, and corners that disagree with it get a copy of the position.
+		bool uvs_match = uvs.size() == positions.size() && std::equal(corner_uvs.begin(), corner_uvs.end(), indices.begin());
+		bool normals_match = normals.size() == positions.size() && std::equal(corner_normals.begin(), corner_normals.end(), indices.begin());
+		if ((!corner_uvs.empty() && !uvs_match) || (!corner_normals.empty() && !normals_match)) {
+			std::vector<Theia::Point2f> vertex_uvs(corner_uvs.empty() ? 0 : positions.size());
+			std::vector<Theia::Normal3f> vertex_normals(corner_normals.empty() ? 0 : positions.size());
+			std::vector<OBJCorner> claimed(positions.size(), OBJCorner{ No_Index, No_Index, No_Index });
+			std::unordered_map<OBJCorner, Theia::UInt32, OBJCornerHash> split_vertices;
+			for (size_t i = 0; i < indices.size(); ++i) {
+				OBJCorner corner = { indices[i], corner_uvs.empty() ? No_Index : corner_uvs[i], corner_normals.empty() ? No_Index : corner_normals[i] };
+				Theia::UInt32 vertex = corner.m_position;
+				if (claimed[vertex].m_position == No_Index) {
+					claimed[vertex] = corner;
+				}
+				else if (!(claimed[vertex] == corner)) {
+					auto [split, is_new] = split_vertices.try_emplace(corner, Theia::UInt32(positions.size()));
+					vertex = split->second;
+					if (is_new) {
+						Theia::Point3f position = positions[corner.m_position];
+						positions.push_back(position);
+						if (!vertex_uvs.empty()) {
+							vertex_uvs.push_back(Theia::Point2f());
+						}
+						if (!vertex_normals.empty()) {
+							vertex_normals.push_back(Theia::Normal3f());
+						}
+					}
+				}
+				else {
+					continue;
+				}
+
+				if (!vertex_uvs.empty() && corner.m_uv != No_Index) {
+					vertex_uvs[vertex] = uvs[corner.m_uv];
+				}
+				if (!vertex_normals.empty() && corner.m_normal != No_Index) {
+					vertex_normals[vertex] = normals[corner.m_normal];
+				}
+				indices[i] = vertex;
+			}
+			uvs = std::move(vertex_uvs);
+			normals = std::move(vertex_normals);
+		}
+
+		result.m_mesh = std::make_unique<Theia::TriangleMesh>(render_from_object, std::move(positions), std::move(indices), std::move(normals), std::move(uvs));
+		return result;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,599 @@
+#include "MeshReader.h"
+#include "MappedFile.h"
+#include "Parsing.h"
+#include <array>
+
+namespace Theia {
+	namespace {
+		enum class PLYFormat {
+			ASCII,
+			BinaryLittleEndian,
+			BinaryBigEndian
+		};
+
+		enum class PLYType {
+			Int8,
+			UInt8,
+			Int16,
+			UInt16,
+			Int32,
+			UInt32,
+			Float32,
+			Float64,
+			Invalid
+		};
+
+		typedef struct PLYProperty {
+			std::string m_name;
+			PLYType m_type;
+			// Only for lists, whose m_type is the type of their items.
+			PLYType m_count_type = PLYType::Invalid;
+		} PLYProperty;
+
+		typedef struct PLYElement {
+			std::string m_name;
+			Theia::UInt64 m_count;
+			std::vector<PLYProperty> m_properties;
+		} PLYElement;
+
+		// Property indices of the attributes the mesh keeps, -1 when absent.
+		typedef struct PLYVertexLayout {
+			Theia::Int32 m_position[3] = { -1, -1, -1 };
+			Theia::Int32 m_normal[3] = { -1, -1, -1 };
+			Theia::Int32 m_uv[2] = { -1, -1 };
+		} PLYVertexLayout;
+
+		PLYType ParseType(const std::string& name) {
+			if (name == "char" || name == "int8") {
+				return PLYType::Int8;
+			}
+			else if (name == "uchar" || name == "uint8") {
+				return PLYType::UInt8;
+			}
+			else if (name == "short" || name == "int16") {
+				return PLYType::Int16;
+			}
+			else if (name == "ushort" || name == "uint16") {
+				return PLYType::UInt16;
+			}
+			else if (name == "int" || name == "int32") {
+				return PLYType::Int32;
+			}
+			else if (name == "uint" || name == "uint32") {
+				return PLYType::UInt32;
+			}
+			else if (name == "float" || name == "float32") {
+				return PLYType::Float32;
+			}
+			else if (name == "double" || name == "float64") {
+				return PLYType::Float64;
+			}
+			return PLYType::Invalid;
+		}
+
+		Theia::UInt32 TypeSize(PLYType type) {
+			static constexpr Theia::UInt32 Sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+			return Sizes[Theia::UInt32(type)];
+		}
+
+		bool IsList(const PLYProperty& property) {
+			return property.m_count_type != PLYType::Invalid;
+		}
+
+		// Bytes per record, or 0 when the element has lists and records vary in size.
+		Theia::UInt32 RecordSize(const PLYElement& element) {
+			Theia::UInt32 size = 0;
+			for (const PLYProperty& property : element.m_properties) {
+				if (IsList(property)) {
+					return 0;
+				}
+				size += TypeSize(property.m_type);
+			}
+			return size;
+		}
+
+		template <typename T> T LoadScalar(const Theia::UInt8* data, bool swap_bytes) {
+			std::array<Theia::UInt8, sizeof(T)> bytes;
+			std::memcpy(bytes.data(), data, sizeof(T));
+			if (swap_bytes) {
+				std::reverse(bytes.begin(), bytes.end());
+			}
+			T value;
+			std::memcpy(&value, bytes.data(), sizeof(T));
+			return value;
+		}
+
+		Theia::Float64 LoadValue(const Theia::UInt8* data, PLYType type, bool swap_bytes) {
+			switch (type) {
+			case PLYType::Int8:
+				return Theia::Float64(Theia::Int8(data[0]));
+			case PLYType::UInt8:
+				return Theia::Float64(data[0]);
+			case PLYType::Int16:
+				return Theia::Float64(LoadScalar<Theia::Int16>(data, swap_bytes));
+			case PLYType::UInt16:
+				return Theia::Float64(LoadScalar<Theia::UInt16>(data, swap_bytes));
+			case PLYType::Int32:
+				return Theia::Float64(LoadScalar<Theia::Int32>(data, swap_bytes));
+			case PLYType::UInt32:
+				return Theia::Float64(LoadScalar<Theia::UInt32>(data, swap_bytes));
+			case PLYType::Float32:
+				return Theia::Float64(LoadScalar<Theia::Float32>(data, swap_bytes));
+			default:
+				return LoadScalar<Theia::Float64>(data, swap_bytes);
+			}
+		}
+
+		// Index of a vertex as written, which may be negative or fractional in a malformed file; those fail the range check later.
+		Theia::UInt32 LoadIndex(const Theia::UInt8* data, PLYType type, bool swap_bytes) {
+			if (type == PLYType::Int32 || type == PLYType::UInt32) {
+				return LoadScalar<Theia::UInt32>(data, swap_bytes);
+			}
+			Theia::Float64 value = LoadValue(data, type, swap_bytes);
+			return value >= 0.0 && value < 4294967295.0 ? Theia::UInt32(value) : 0xFFFFFFFF;
+		}
+
+		std::string ReadWord(const char*& cursor, const char* end) {
+			cursor = Theia::SkipSpaces(cursor, end);
+			const char* word_end = Theia::SkipToken(cursor, end);
+			std::string word(cursor, word_end);
+			cursor = word_end;
+			return word;
+		}
+
+		// Returns the start of the body, or null with error set.
+		const char* ParseHeader(const char* begin, const char* end, PLYFormat& format, std::vector<PLYElement>& elements, std::string& error) {
+			const char* cursor = begin;
+			if (ReadWord(cursor, end) != "ply") {
+				error = "is not a PLY file";
+				return nullptr;
+			}
+
+			bool has_format = false;
+			for (cursor = Theia::NextLine(cursor, end); cursor < end; cursor = Theia::NextLine(cursor, end)) {
+				std::string keyword = ReadWord(cursor, end);
+				if (keyword == "format") {
+					std::string name = ReadWord(cursor, end);
+					has_format = true;
+					if (name == "ascii") {
+						format = PLYFormat::ASCII;
+					}
+					else if (name == "binary_little_endian") {
+						format = PLYFormat::BinaryLittleEndian;
+					}
+					else if (name == "binary_big_endian") {
+						format = PLYFormat::BinaryBigEndian;
+					}
+					else {
+						error = "has unknown format " + name;
+						return nullptr;
+					}
+				}
+				else if (keyword == "element") {
+					std::string name = ReadWord(cursor, end);
+					Theia::Int64 count = 0;
+					cursor = Theia::SkipSpaces(cursor, end);
+					if (!Theia::ParseInt(cursor, end, count) || count < 0) {
+						error = "has a malformed element " + name;
+						return nullptr;
+					}
+					elements.push_back(PLYElement{ name, Theia::UInt64(count), {} });
+				}
+				else if (keyword == "property") {
+					if (elements.empty()) {
+						error = "has a property outside of any element";
+						return nullptr;
+					}
+					PLYProperty property;
+					std::string type = ReadWord(cursor, end);
+					if (type == "list") {
+						property.m_count_type = ParseType(ReadWord(cursor, end));
+						type = ReadWord(cursor, end);
+					}
+					property.m_type = ParseType(type);
+					property.m_name = ReadWord(cursor, end);
+					if (property.m_type == PLYType::Invalid || (type == "list" && property.m_count_type == PLYType::Invalid)) {
+						error = "has property " + property.m_name + " of unknown type";
+						return nullptr;
+					}
+					elements.back().m_properties.push_back(property);
+				}
+				else if (keyword == "end_header") {
+					if (!has_format) {
+						error = "has no format";
+						return nullptr;
+					}
+					return Theia::NextLine(cursor, end);
+				}
+				else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty()) {
+					error = "has unknown header line " + keyword;
+					return nullptr;
+				}
+			}
+			error = "has no end_header";
+			return nullptr;
+		}
+
+		PLYVertexLayout FindVertexLayout(const PLYElement& element) {
+			PLYVertexLayout layout;
+			for (Theia::Int32 i = 0; i < Theia::Int32(element.m_properties.size()); ++i) {
+				const std::string& name = element.m_properties[i].m_name;
+				if (IsList(element.m_properties[i])) {
+					continue;
+				}
+				else if (name == "x" || name == "y" || name == "z") {
+					layout.m_position[name[0] - 'x'] = i;
+				}
+				else if (name == "nx" || name == "ny" || name == "nz") {
+					layout.m_normal[name[1] - 'x'] = i;
+				}
+				else if (name == "u" || name == "s" || name == "texture_u" || name == "texture_s") {
+					layout.m_uv[0] = i;
+				}
+				else if (name == "v" || name == "t" || name == "texture_v" || name == "texture_t") {
+					layout.m_uv[1] = i;
+				}
+			}
+			return layout;
+		}
+
+		bool HasAll(const Theia::Int32* properties, Theia::UInt32 count) {
+			return std::all_of(properties, properties + count, [](Theia::Int32 property) { return property >= 0; });
+		}
+
+		Theia::Int32 FindFaceList(const PLYElement& element) {
+			for (Theia::Int32 i = 0; i < Theia::Int32(element.m_properties.size()); ++i) {
+				const PLYProperty& property = element.m_properties[i];
+				if (IsList(property) && (property.m_name == "vertex_indices" || property.m_name == "vertex_index")) {
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		// Vertex data of one record, values indexed like the element properties.
+		void StoreVertex(const Theia::Float64* values, const PLYVertexLayout& layout, Theia::UInt64 vertex, std::vector<Theia::Point3f>& positions, std::vector<Theia::Normal3f>& normals, std::vector<Theia::Point2f>& uvs) {
+			positions[vertex] = Theia::Point3f(Theia::Float(values[layout.m_position[0]]), Theia::Float(values[layout.m_position[1]]), Theia::Float(values[layout.m_position[2]]));
+			if (!normals.empty()) {
+				normals[vertex] = Theia::Normal3f(Theia::Float(values[layout.m_normal[0]]), Theia::Float(values[layout.m_normal[1]]), Theia::Float(values[layout.m_normal[2]]));
+			}
+			if (!uvs.empty()) {
+				uvs[vertex] = Theia::Point2f(Theia::Float(values[layout.m_uv[0]]), Theia::Float(values[layout.m_uv[1]]));
+			}
+		}
+
+		void StoreFan(const Theia::UInt32* corners, Theia::UInt64 corner_count, Theia::UInt32* triangles) {
+			for (Theia::UInt64 i = 2; i < corner_count; ++i) {
+				triangles[0] = corners[0];
+				triangles[1] = corners[i - 1];
+				triangles[2] = corners[i];
+				triangles += 3;
+			}
+		}
+	}
+
+	Theia::MeshReadResult ReadPLY(const std::string& path, const Theia::Transform& render_from_object, const Theia::MeshReadOptions& options) {
+		Theia::MeshReadResult result;
+		Theia::MappedFile file(path);
+		if (!file.IsOpen()) {
+			result.m_error = "ReadPLY cannot open " + path + ".";
+			return result;
+		}
+		std::span<const Theia::UInt8> bytes = file.GetBytes();
+		result.m_file_bytes = bytes.size();
+		const char* begin = reinterpret_cast<const char*>(bytes.data());
+		const char* end = begin + bytes.size();
+
+		PLYFormat format = PLYFormat::ASCII;
+		std::vector<PLYElement> elements;
+		std::string error;
+		const char* body = ParseHeader(begin, end, format, elements, error);
+		auto fail = [&](const std::string& reason) {
+			result.m_error = "ReadPLY " + path + " " + reason + ".";
+			return std::move(result);
+		};
+		if (!body) {
+			return fail(error);
+		}
+
+		const PLYElement* vertex_element = nullptr;
+		const PLYElement* face_element = nullptr;
+		for (const PLYElement& element : elements) {
+			if (element.m_name == "vertex") {
+				vertex_element = &element;
+			}
+			else if (element.m_name == "face") {
+				face_element = &element;
+			}
+		}
+		if (!vertex_element) {
+			return fail("has no vertex element");
+		}
+		PLYVertexLayout layout = FindVertexLayout(*vertex_element);
+		if (!HasAll(layout.m_position, 3)) {
+			return fail("has no vertex positions");
+		}
+		Theia::Int32 face_list = face_element ? FindFaceList(*face_element) : -1;
+		if (face_element && face_list < 0) {
+			return fail("has faces without vertex_indices");
+		}
+		if (vertex_element->m_count >= 0xFFFFFFFF) {
+			return fail("has too many vertices for 32-bit indices");
+		}
+
+		std::vector<Theia::Point3f> positions(vertex_element->m_count);
+		std::vector<Theia::Normal3f> normals(HasAll(layout.m_normal, 3) ? vertex_element->m_count : 0);
+		std::vector<Theia::Point2f> uvs(HasAll(layout.m_uv, 2) ? vertex_element->m_count : 0);
+		std::vector<Theia::UInt32> indices;
+		Theia::UInt32 thread_count = Theia::ReadThreadCount(options.m_thread_count);
+		auto chunk_count_for = [&](Theia::UInt64 size) {
+			return Theia::UInt32(std::clamp<Theia::UInt64>(size / (1 << 20), 1, thread_count));
+		};
+
+		if (format == PLYFormat::ASCII) {
+			const char* cursor = body;
+			for (const PLYElement& element : elements) {
+				const char* element_end = Theia::SkipLines(cursor, end, element.m_count);
+				if (&element != vertex_element && &element != face_element) {
+					cursor = element_end;
+					continue;
+				}
+
+				// Chunks start on lines, and the lines before each chunk give the index of its first record.
+				Theia::UInt32 chunk_count = chunk_count_for(Theia::UInt64(element_end - cursor));
+				std::vector<const char*> boundaries = Theia::SplitLines(cursor, element_end, chunk_count);
+				std::vector<Theia::UInt64> first_records(chunk_count + 1, 0);
+				std::vector<Theia::UInt64> first_triangles(chunk_count + 1, 0);
+				std::vector<Theia::UInt8> chunk_is_malformed(chunk_count, 0);
+				Theia::RunChunks(chunk_count, [&](Theia::UInt32 chunk) {
+					first_records[chunk + 1] = Theia::CountByte(boundaries[chunk], boundaries[chunk + 1], '\n');
+					if (&element != face_element) {
+						return;
+					}
+					for (const char* line = boundaries[chunk]; line < boundaries[chunk + 1]; line = Theia::NextLine(line, boundaries[chunk + 1])) {
+						const char* value = line;
+						for (Theia::Int32 i = 0; i <= face_list; ++i) {
+							value = Theia::SkipSpaces(value, boundaries[chunk + 1]);
+							if (i < face_list && !IsList(element.m_properties[i])) {
+								value = Theia::SkipToken(value, boundaries[chunk + 1]);
+								continue;
+							}
+							Theia::Int64 count = 0;
+							if (!Theia::ParseInt(value, boundaries[chunk + 1], count) || count < 0) {
+								chunk_is_malformed[chunk] = 1;
+								return;
+							}
+							if (i == face_list) {
+								first_triangles[chunk + 1] += count > 2 ? Theia::UInt64(count - 2) : 0;
+							}
+							else if (IsList(element.m_properties[i])) {
+								for (Theia::Int64 j = 0; j < count; ++j) {
+									value = Theia::SkipToken(Theia::SkipSpaces(value, boundaries[chunk + 1]), boundaries[chunk + 1]);
+								}
+							}
+						}
+					}
+				});
+				for (Theia::UInt32 chunk = 0; chunk < chunk_count; ++chunk) {
+					first_records[chunk + 1] += first_records[chunk];
+					first_triangles[chunk + 1] += first_triangles[chunk];
+				}
+				// The last line may lack its newline.
+				if (first_records[chunk_count] + 1 == element.m_count && element_end > cursor && element_end[-1] != '\n') {
+					first_records[chunk_count] += 1;
+				}
+				if (first_records[chunk_count] < element.m_count) {
+					return fail("ends before the last " + element.m_name);
+				}
+				if (std::any_of(chunk_is_malformed.begin(), chunk_is_malformed.end(), [](Theia::UInt8 is_malformed) { return is_malformed != 0; })) {
+					return fail("has a malformed list in " + element.m_name);
+				}
+				if (&element == face_element) {
+					if (3 * first_triangles[chunk_count] >= 0xFFFFFFFF) {
+						return fail("has too many triangles for 32-bit indices");
+					}
+					indices.resize(3 * first_triangles[chunk_count]);
+				}
+
+				std::vector<std::string> chunk_errors(chunk_count);
+				Theia::RunChunks(chunk_count, [&](Theia::UInt32 chunk) {
+					std::vector<Theia::Float64> values(element.m_properties.size());
+					std::vector<Theia::UInt32> corners;
+					Theia::UInt64 record = first_records[chunk];
+					Theia::UInt32* triangles = indices.data() + 3 * first_triangles[chunk];
+					const Theia::UInt32* triangles_end = indices.data() + 3 * first_triangles[chunk + 1];
+					const char* chunk_end = boundaries[chunk + 1];
+					for (const char* line = boundaries[chunk]; line < chunk_end; line = Theia::NextLine(line, chunk_end), ++record) {
+						const char* value = line;
+						for (size_t i = 0; i < element.m_properties.size(); ++i) {
+							value = Theia::SkipSpaces(value, chunk_end);
+							if (!IsList(element.m_properties[i])) {
+								Theia::Float parsed = 0.0f;
+								if (!Theia::ParseFloat(value, chunk_end, parsed)) {
+									chunk_errors[chunk] = "has a malformed " + element.m_name;
+									return;
+								}
+								values[i] = parsed;
+								continue;
+							}
+
+							Theia::Int64 count = 0;
+							if (!Theia::ParseInt(value, chunk_end, count) || count < 0) {
+								chunk_errors[chunk] = "has a malformed list in " + element.m_name;
+								return;
+							}
+							bool is_face_list = &element == face_element && Theia::Int32(i) == face_list;
+							corners.clear();
+							for (Theia::Int64 j = 0; j < count; ++j) {
+								value = Theia::SkipSpaces(value, chunk_end);
+								Theia::Int64 index = 0;
+								if (is_face_list && (!Theia::ParseInt(value, chunk_end, index) || index < 0 || index >= Theia::Int64(positions.size()))) {
+									chunk_errors[chunk] = "has a malformed or out of range vertex index";
+									return;
+								}
+								corners.push_back(Theia::UInt32(index));
+								value = Theia::SkipToken(value, chunk_end);
+							}
+							if (is_face_list) {
+								// The counting pass sized the chunk; a line it read differently must not write past it.
+								if (corners.size() > 2 && Theia::UInt64(triangles_end - triangles) < 3 * (corners.size() - 2)) {
+									chunk_errors[chunk] = "has a malformed list in " + element.m_name;
+									return;
+								}
+								StoreFan(corners.data(), corners.size(), triangles);
+								triangles += corners.size() > 2 ? 3 * (corners.size() - 2) : 0;
+							}
+						}
+						if (&element == vertex_element) {
+							StoreVertex(values.data(), layout, record, positions, normals, uvs);
+						}
+					}
+				});
+				for (const std::string& chunk_error : chunk_errors) {
+					if (!chunk_error.empty()) {
+						return fail(chunk_error);
+					}
+				}
+				cursor = element_end;
+			}
+		}
+		else {
+			bool swap_bytes = (format == PLYFormat::BinaryBigEndian) == (std::endian::native == std::endian::little);
+			const Theia::UInt8* cursor = reinterpret_cast<const Theia::UInt8*>(body);
+			const Theia::UInt8* data_end = bytes.data() + bytes.size();
+			for (const PLYElement& element : elements) {
+				Theia::UInt32 record_size = RecordSize(element);
+				if (record_size > 0) {
+					// Compared before multiplying, so a count from a damaged header cannot wrap the size.
+					if (element.m_count > Theia::UInt64(data_end - cursor) / record_size) {
+						return fail("ends before the last " + element.m_name);
+					}
+					if (&element == vertex_element) {
+						std::vector<Theia::UInt32> offsets;
+						for (Theia::UInt32 i = 0, offset = 0; i < element.m_properties.size(); offset += TypeSize(element.m_properties[i].m_type), ++i) {
+							offsets.push_back(offset);
+						}
+						Theia::UInt32 chunk_count = chunk_count_for(element.m_count * record_size);
+						Theia::RunChunks(chunk_count, [&](Theia::UInt32 chunk) {
+							std::vector<Theia::Float64> values(element.m_properties.size());
+							for (Theia::UInt64 vertex = element.m_count * chunk / chunk_count; vertex < element.m_count * (chunk + 1) / chunk_count; ++vertex) {
+								const Theia::UInt8* record = cursor + vertex * record_size;
+								for (size_t i = 0; i < values.size(); ++i) {
+									values[i] = LoadValue(record + offsets[i], element.m_properties[i].m_type, swap_bytes);
+								}
+								StoreVertex(values.data(), layout, vertex, positions, normals, uvs);
+							}
+						});
+					}
+					cursor += element.m_count * record_size;
+					continue;
+				}
+
+				// Records with lists: a prefix of fixed properties, the list, then a suffix. Faces are usually all triangles, which makes their records the same size and lets them be read in parallel; anything else is walked in order.
+				const std::vector<PLYProperty>& properties = element.m_properties;
+				Theia::Int32 list = &element == face_element ? face_list : -1;
+				Theia::UInt32 prefix_size = 0, suffix_size = 0;
+				bool has_other_lists = false;
+				for (Theia::Int32 i = 0; i < Theia::Int32(properties.size()); ++i) {
+					if (i == list) {
+						continue;
+					}
+					has_other_lists |= IsList(properties[i]);
+					(list < 0 || i < list ? prefix_size : suffix_size) += TypeSize(properties[i].m_type);
+				}
+
+				if (list >= 0 && !has_other_lists) {
+					PLYType count_type = properties[list].m_count_type;
+					PLYType index_type = properties[list].m_type;
+					Theia::UInt32 count_size = TypeSize(count_type), index_size = TypeSize(index_type);
+					Theia::UInt32 triangle_record_size = prefix_size + count_size + 3 * index_size + suffix_size;
+					bool all_triangles = element.m_count <= Theia::UInt64(data_end - cursor) / triangle_record_size;
+					if (all_triangles && 3 * element.m_count >= 0xFFFFFFFF) {
+						return fail("has too many triangles for 32-bit indices");
+					}
+					if (all_triangles) {
+						indices.resize(3 * element.m_count);
+						Theia::UInt32 chunk_count = chunk_count_for(element.m_count * triangle_record_size);
+						std::vector<Theia::UInt8> chunk_is_triangles(chunk_count, 1);
+						Theia::RunChunks(chunk_count, [&](Theia::UInt32 chunk) {
+							for (Theia::UInt64 face = element.m_count * chunk / chunk_count; face < element.m_count * (chunk + 1) / chunk_count; ++face) {
+								const Theia::UInt8* record = cursor + face * triangle_record_size + prefix_size;
+								if (LoadValue(record, count_type, swap_bytes) != 3.0) {
+									chunk_is_triangles[chunk] = 0;
+									return;
+								}
+								for (Theia::UInt32 k = 0; k < 3; ++k) {
+									indices[3 * face + k] = LoadIndex(record + count_size + k * index_size, index_type, swap_bytes);
+								}
+							}
+						});
+						all_triangles = std::all_of(chunk_is_triangles.begin(), chunk_is_triangles.end(), [](Theia::UInt8 is_triangles) { return is_triangles != 0; });
+					}
+
+					if (all_triangles) {
+						cursor += element.m_count * triangle_record_size;
+						continue;
+					}
+
+					// Polygons: count the triangles of the fans, then write them.
+					Theia::UInt64 triangle_count = 0;
+					const Theia::UInt8* record = cursor;
+					for (Theia::UInt64 face = 0; face < element.m_count; ++face) {
+						if (record + prefix_size + count_size > data_end) {
+							return fail("ends before the last face");
+						}
+						Theia::Float64 count = LoadValue(record + prefix_size, count_type, swap_bytes);
+						if (count < 0.0 || record + prefix_size + count_size + Theia::UInt64(count) * index_size + suffix_size > data_end) {
+							return fail("ends before the last face");
+						}
+						triangle_count += count > 2.0 ? Theia::UInt64(count) - 2 : 0;
+						record += prefix_size + count_size + Theia::UInt64(count) * index_size + suffix_size;
+					}
+					if (3 * triangle_count >= 0xFFFFFFFF) {
+						return fail("has too many triangles for 32-bit indices");
+					}
+
+					indices.resize(3 * triangle_count);
+					Theia::UInt32* triangles = indices.data();
+					std::vector<Theia::UInt32> corners;
+					for (Theia::UInt64 face = 0; face < element.m_count; ++face) {
+						Theia::UInt64 count = Theia::UInt64(LoadValue(cursor + prefix_size, count_type, swap_bytes));
+						corners.resize(count);
+						for (Theia::UInt64 k = 0; k < count; ++k) {
+							corners[k] = LoadIndex(cursor + prefix_size + count_size + k * index_size, index_type, swap_bytes);
+						}
+						StoreFan(corners.data(), count, triangles);
+						triangles += count > 2 ? 3 * (count - 2) : 0;
+						cursor += prefix_size + count_size + count * index_size + suffix_size;
+					}
+					continue;
+				}
+
+				// Other elements with lists are skipped record by record.
+				for (Theia::UInt64 record = 0; record < element.m_count; ++record) {
+					for (const PLYProperty& property : properties) {
+						Theia::UInt64 size = TypeSize(property.m_type);
+						if (IsList(property)) {
+							if (cursor + TypeSize(property.m_count_type) > data_end) {
+								return fail("ends before the last " + element.m_name);
+							}
+							Theia::Float64 count = LoadValue(cursor, property.m_count_type, swap_bytes);
+							cursor += TypeSize(property.m_count_type);
+							size = count > 0.0 ? Theia::UInt64(count) * size : 0;
+						}
+						if (cursor + size > data_end) {
+							return fail("ends before the last " + element.m_name);
+						}
+						cursor += size;
+					}
+				}
+			}
+		}
+
+		if (std::any_of(indices.begin(), indices.end(), [&](Theia::UInt32 index) { return index >= positions.size(); })) {
+			return fail("has an out of range vertex index");
+		}
+		result.m_mesh = std::make_unique<Theia::TriangleMesh>(render_from_object, std::move(positions), std::move(indices), std::move(normals), std::move(uvs));
+		return result;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,261 @@
+#ifndef _THEIA_IO_PARSING_H_
+#define _THEIA_IO_PARSING_H_
+#include "../Types.h"
+#include "../Parallel/ThreadPool.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <span>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Theia {
+	inline bool IsDigit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	inline bool IsSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* SkipSpaces(const char* cursor, const char* end) {
+		while (cursor < end && IsSpace(*cursor)) {
+			++cursor;
+		}
+		return cursor;
+	}
+
+	inline const char* SkipToken(const char* cursor, const char* end) {
+		while (cursor < end && !IsSpace(*cursor) && *cursor != '\n') {
+			++cursor;
+		}
+		return cursor;
+	}
+
+	// First occurrence of byte in [begin, end), or end.
+	inline const char* FindByte(const char* begin, const char* end, char byte) {
+#if defined(__AVX2__)
+		__m256i pattern = _mm256_set1_epi8(byte);
+		for (; begin + 32 <= end; begin += 32) {
+			Theia::UInt32 mask = Theia::UInt32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)), pattern)));
+			if (mask != 0) {
+				return begin + std::countr_zero(mask);
+			}
+		}
+#endif
+		const void* found = std::memchr(begin, byte, size_t(end - begin));
+		return found ? static_cast<const char*>(found) : end;
+	}
+
+	inline Theia::UInt64 CountByte(const char* begin, const char* end, char byte) {
+		Theia::UInt64 count = 0;
+#if defined(__AVX2__)
+		__m256i pattern = _mm256_set1_epi8(byte);
+		for (; begin + 32 <= end; begin += 32) {
+			count += std::popcount(Theia::UInt32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)), pattern))));
+		}
+#endif
+		return count + Theia::UInt64(std::count(begin, end, byte));
+	}
+
+	// Start of the line after the one cursor is on, or end.
+	inline const char* NextLine(const char* cursor, const char* end) {
+		const char* line_end = Theia::FindByte(cursor, end, '\n');
+		return line_end == end ? end : line_end + 1;
+	}
+
+	// Start of the line after the line_count lines that begin at cursor, or end. Newlines are counted a block at a time, so short lines cost no more than long ones.
+	inline const char* SkipLines(const char* cursor, const char* end, Theia::UInt64 line_count) {
+		if (line_count == 0) {
+			return cursor;
+		}
+#if defined(__AVX2__)
+		__m256i newline = _mm256_set1_epi8('\n');
+		for (; cursor + 32 <= end; cursor += 32) {
+			Theia::UInt32 mask = Theia::UInt32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor)), newline)));
+			Theia::UInt32 count = Theia::UInt32(std::popcount(mask));
+			if (count >= line_count) {
+				for (; line_count > 1; --line_count) {
+					mask &= mask - 1;
+				}
+				return cursor + std::countr_zero(mask) + 1;
+			}
+			line_count -= count;
+		}
+#endif
+		for (; line_count > 0 && cursor < end; --line_count) {
+			cursor = Theia::NextLine(cursor, end);
+		}
+		return cursor;
+	}
+
+	inline bool IsEightDigits(const char* cursor) {
+		Theia::UInt64 value;
+		std::memcpy(&value, cursor, sizeof(value));
+		return (((value & 0xF0F0F0F0F0F0F0F0ull) | (((value + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+	}
+
+	// Value of eight ASCII digits, combined pairwise in SIMD lanes rather than one digit at a time.
+	inline Theia::UInt32 ParseEightDigits(const char* cursor) {
+#if defined(__AVX2__)
+		__m128i digits = _mm_sub_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cursor)), _mm_set1_epi8('0'));
+		__m128i pairs = _mm_maddubs_epi16(digits, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0, 0, 0, 0, 0));
+		__m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 0, 0, 0, 0));
+		__m128i packed = _mm_packus_epi32(quads, quads);
+		return Theia::UInt32(_mm_cvtsi128_si32(_mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 0, 0, 0, 0, 0, 0))));
+#else
+		Theia::UInt64 value;
+		std::memcpy(&value, cursor, sizeof(value));
+		value = (value & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+		value = (value & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+		return Theia::UInt32((value & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+#endif
+	}
+
+	// Accumulates the digits at cursor into value, eight at a time while they last. Digits past max_digits only count towards dropped_digits.
+	inline const char* ParseDigits(const char* cursor, const char* end, Theia::UInt64& value, Theia::Int32& digit_count, Theia::Int32& dropped_digits, Theia::Int32 max_digits) {
+		while (end - cursor >= 8 && digit_count + 8 <= max_digits && Theia::IsEightDigits(cursor)) {
+			value = value * 100000000 + Theia::ParseEightDigits(cursor);
+			cursor += 8;
+			digit_count += 8;
+		}
+		for (; cursor < end && Theia::IsDigit(*cursor); ++cursor) {
+			if (digit_count < max_digits) {
+				value = value * 10 + Theia::UInt64(*cursor - '0');
+				++digit_count;
+			}
+			else {
+				++dropped_digits;
+			}
+		}
+		return cursor;
+	}
+
+	// Parses a decimal number at cursor and moves past it. Numbers with up to 19 significant digits and small exponents are converted exactly; anything else goes through std::from_chars.
+	inline bool ParseFloat(const char*& cursor, const char* end, Theia::Float& value) {
+		const char* start = cursor;
+		const char* p = cursor;
+		bool is_negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+')) {
+			++p;
+		}
+
+		Theia::UInt64 mantissa = 0;
+		Theia::Int32 digit_count = 0;
+		Theia::Int32 dropped_digits = 0;
+		// Leading zeros are not significant.
+		while (p < end && *p == '0') {
+			++p;
+		}
+		const char* integer_end = Theia::ParseDigits(p, end, mantissa, digit_count, dropped_digits, 19);
+		bool has_digits = integer_end != p || (p != start && p[-1] == '0');
+		Theia::Int32 exponent = dropped_digits;
+		p = integer_end;
+
+		if (p < end && *p == '.') {
+			++p;
+			if (mantissa == 0) {
+				const char* zeros_begin = p;
+				while (p < end && *p == '0') {
+					++p;
+				}
+				exponent -= Theia::Int32(p - zeros_begin);
+				has_digits |= p != zeros_begin;
+			}
+			Theia::Int32 fraction_digits = digit_count;
+			Theia::Int32 ignored_digits = 0;
+			const char* fraction_end = Theia::ParseDigits(p, end, mantissa, digit_count, ignored_digits, 19);
+			exponent -= digit_count - fraction_digits;
+			has_digits |= fraction_end != p;
+			p = fraction_end;
+		}
+
+		if (!has_digits) {
+			// Also covers inf and nan.
+			std::from_chars_result result = std::from_chars(start + (*start == '+'), end, value);
+			cursor = result.ptr;
+			return result.ec == std::errc();
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* q = p + 1;
+			bool is_exponent_negative = q < end && *q == '-';
+			if (q < end && (*q == '-' || *q == '+')) {
+				++q;
+			}
+			if (q < end && Theia::IsDigit(*q)) {
+				Theia::Int32 written_exponent = 0;
+				for (; q < end && Theia::IsDigit(*q); ++q) {
+					written_exponent = std::min(written_exponent * 10 + (*q - '0'), 100000);
+				}
+				exponent += is_exponent_negative ? -written_exponent : written_exponent;
+				p = q;
+			}
+		}
+		cursor = p;
+
+		static constexpr Theia::Float64 Powers_Of_Ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		if (dropped_digits == 0 && mantissa <= (Theia::UInt64(1) << 53) && exponent >= -22 && exponent <= 22) {
+			// Both operands are exact doubles, so the product or quotient is correctly rounded.
+			Theia::Float64 result = Theia::Float64(mantissa);
+			result = exponent < 0 ? result / Powers_Of_Ten[-exponent] : result * Powers_Of_Ten[exponent];
+			value = Theia::Float(is_negative ? -result : result);
+			return true;
+		}
+
+		std::from_chars_result result = std::from_chars(start + (*start == '+'), end, value);
+		cursor = result.ptr;
+		if (result.ec == std::errc::result_out_of_range) {
+			Theia::Float magnitude = exponent > 0 ? Theia::Infinity : 0.0f;
+			value = is_negative ? -magnitude : magnitude;
+		}
+		return result.ec == std::errc() || result.ec == std::errc::result_out_of_range;
+	}
+
+	inline bool ParseInt(const char*& cursor, const char* end, Theia::Int64& value) {
+		const char* p = cursor;
+		bool is_negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+')) {
+			++p;
+		}
+		Theia::UInt64 magnitude = 0;
+		Theia::Int32 digit_count = 0;
+		Theia::Int32 dropped_digits = 0;
+		const char* digits_end = Theia::ParseDigits(p, end, magnitude, digit_count, dropped_digits, 18);
+		if (digits_end == p || dropped_digits > 0) {
+			return false;
+		}
+		value = is_negative ? -Theia::Int64(magnitude) : Theia::Int64(magnitude);
+		cursor = digits_end;
+		return true;
+	}
+
+	inline Theia::UInt32 ReadThreadCount(Theia::UInt32 thread_count) {
+		return thread_count > 0 ? thread_count : Theia::ThreadPool::Default().GetThreadCount();
+	}
+
+	// Boundaries of chunk_count pieces of text of about equal size, each starting at the beginning of a line. Pieces may be empty.
+	inline std::vector<const char*> SplitLines(const char* begin, const char* end, Theia::UInt32 chunk_count) {
+		std::vector<const char*> boundaries = { begin };
+		for (Theia::UInt32 i = 1; i < chunk_count; ++i) {
+			const char* boundary = std::max(boundaries.back(), begin + (end - begin) * Theia::Int64(i) / chunk_count);
+			if (boundary != begin && boundary[-1] != '\n') {
+				boundary = Theia::NextLine(boundary, end);
+			}
+			boundaries.push_back(boundary);
+		}
+		boundaries.push_back(end);
+		return boundaries;
+	}
+
+	// Runs function(chunk_index) for every chunk as a task of the default thread pool.
+	template <typename F> void RunChunks(Theia::UInt32 chunk_count, F function) {
+		Theia::ParallelFor(0, chunk_count, [&](Theia::Int64 chunk) {
+			function(Theia::UInt32(chunk));
+		}, 1);
+	}
+}
+#endif
\ No newline at end of file
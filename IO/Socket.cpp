@@ -0,0 +1,225 @@
+#include "Socket.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace Theia {
+	namespace {
+		constexpr Theia::UInt64 Invalid_Handle = ~Theia::UInt64(0);
+
+#ifdef _WIN32
+		using NativeSocket = SOCKET;
+
+		void InitializeSockets() {
+			static const bool Is_Initialized = []() {
+				WSADATA data;
+				return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+			}();
+			(void)Is_Initialized;
+		}
+
+		void CloseSocket(Theia::UInt64 handle) {
+			closesocket(NativeSocket(handle));
+		}
+#else
+		using NativeSocket = int;
+
+		void InitializeSockets() {
+
+		}
+
+		void CloseSocket(Theia::UInt64 handle) {
+			close(NativeSocket(handle));
+		}
+#endif
+
+		bool MakeAddress(const std::string& address, Theia::UInt16 port, sockaddr_in& socket_address) {
+			std::memset(&socket_address, 0, sizeof(socket_address));
+			socket_address.sin_family = AF_INET;
+			socket_address.sin_port = htons(port);
+			return inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) == 1;
+		}
+	}
+
+	Socket::Socket(Theia::UInt64 handle) :
+		m_handle(handle)
+	{
+		// Tile requests and results are small messages that wait on each other, which Nagle's algorithm would delay.
+		int no_delay = 1;
+		setsockopt(NativeSocket(m_handle), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+	}
+
+	Socket::Socket(Socket&& socket) noexcept {
+		*this = std::move(socket);
+	}
+
+	Socket& Socket::operator=(Socket&& socket) noexcept {
+		if (this != &socket) {
+			Close();
+			m_handle = std::exchange(socket.m_handle, Invalid_Handle);
+		}
+		return *this;
+	}
+
+	Socket::~Socket() {
+		Close();
+	}
+
+	Theia::Socket Socket::Connect(const std::string& host, Theia::UInt16 port) {
+		InitializeSockets();
+		sockaddr_in socket_address;
+		if (!MakeAddress(host, port, socket_address)) {
+			return Theia::Socket();
+		}
+		NativeSocket handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (Theia::UInt64(handle) == Invalid_Handle) {
+			return Theia::Socket();
+		}
+		if (connect(handle, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) != 0) {
+			CloseSocket(Theia::UInt64(handle));
+			return Theia::Socket();
+		}
+		return Theia::Socket(Theia::UInt64(handle));
+	}
+
+	bool Socket::IsOpen() const {
+		return m_handle != Invalid_Handle;
+	}
+
+	bool Socket::Send(const void* data, size_t size) {
+		const char* bytes = static_cast<const char*>(data);
+		while (IsOpen() && size > 0) {
+#ifdef _WIN32
+			int sent = send(NativeSocket(m_handle), bytes, int(std::min<size_t>(size, 1 << 30)), 0);
+#else
+			// A peer that has gone away is reported by the return value instead of SIGPIPE.
+			ssize_t sent = send(NativeSocket(m_handle), bytes, size, MSG_NOSIGNAL);
+#endif
+			if (sent <= 0) {
+				return false;
+			}
+			bytes += sent;
+			size -= size_t(sent);
+		}
+		return size == 0;
+	}
+
+	bool Socket::Receive(void* data, size_t size) {
+		char* bytes = static_cast<char*>(data);
+		while (IsOpen() && size > 0) {
+#ifdef _WIN32
+			int received = recv(NativeSocket(m_handle), bytes, int(std::min<size_t>(size, 1 << 30)), 0);
+#else
+			ssize_t received = recv(NativeSocket(m_handle), bytes, size, 0);
+#endif
+			if (received <= 0) {
+				return false;
+			}
+			bytes += received;
+			size -= size_t(received);
+		}
+		return size == 0;
+	}
+
+	bool Socket::SetReceiveTimeout(Theia::Float64 timeout_milliseconds) {
+		if (!IsOpen()) {
+			return false;
+		}
+#ifdef _WIN32
+		DWORD timeout = DWORD(timeout_milliseconds);
+#else
+		timeval timeout;
+		timeout.tv_sec = time_t(timeout_milliseconds / 1000.0);
+		timeout.tv_usec = suseconds_t((timeout_milliseconds - 1000.0 * Theia::Float64(timeout.tv_sec)) * 1000.0);
+#endif
+		return setsockopt(NativeSocket(m_handle), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) == 0;
+	}
+
+	void Socket::Shutdown() {
+		if (IsOpen()) {
+#ifdef _WIN32
+			shutdown(NativeSocket(m_handle), SD_BOTH);
+#else
+			shutdown(NativeSocket(m_handle), SHUT_RDWR);
+#endif
+		}
+	}
+
+	void Socket::Close() {
+		if (IsOpen()) {
+			CloseSocket(m_handle);
+		}
+		m_handle = Invalid_Handle;
+	}
+
+	SocketListener::SocketListener(const std::string& address, Theia::UInt16 port) {
+		InitializeSockets();
+		sockaddr_in socket_address;
+		if (!MakeAddress(address, port, socket_address)) {
+			return;
+		}
+		NativeSocket handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (Theia::UInt64(handle) == Invalid_Handle) {
+			return;
+		}
+		socklen_t address_size = sizeof(socket_address);
+		if (bind(handle, reinterpret_cast<const sockaddr*>(&socket_address), sizeof(socket_address)) != 0 ||
+			listen(handle, SOMAXCONN) != 0 ||
+			getsockname(handle, reinterpret_cast<sockaddr*>(&socket_address), &address_size) != 0) {
+			CloseSocket(Theia::UInt64(handle));
+			return;
+		}
+		m_handle = Theia::UInt64(handle);
+		m_port = ntohs(socket_address.sin_port);
+	}
+
+	SocketListener::~SocketListener() {
+		if (IsOpen()) {
+			CloseSocket(m_handle);
+		}
+	}
+
+	bool SocketListener::IsOpen() const {
+		return m_handle != Invalid_Handle;
+	}
+
+	Theia::UInt16 SocketListener::GetPort() const {
+		return m_port;
+	}
+
+	Theia::Socket SocketListener::Accept(Theia::Float64 timeout_milliseconds) {
+		if (!IsOpen()) {
+			return Theia::Socket();
+		}
+#ifdef _WIN32
+		WSAPOLLFD poll_descriptor = { NativeSocket(m_handle), POLLIN, 0 };
+		int ready = WSAPoll(&poll_descriptor, 1, int(timeout_milliseconds));
+#else
+		pollfd poll_descriptor = { NativeSocket(m_handle), POLLIN, 0 };
+		int ready = poll(&poll_descriptor, 1, int(timeout_milliseconds));
+#endif
+		if (ready <= 0) {
+			return Theia::Socket();
+		}
+		NativeSocket handle = accept(NativeSocket(m_handle), nullptr, nullptr);
+		if (Theia::UInt64(handle) == Invalid_Handle) {
+			return Theia::Socket();
+		}
+		return Theia::Socket(Theia::UInt64(handle));
+	}
+}
\ No newline at end of file
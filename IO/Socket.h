@@ -0,0 +1,55 @@
+#ifndef _THEIA_IO_SOCKET_H_
+#define _THEIA_IO_SOCKET_H_
+#include "../Types.h"
+#include <string>
+
+namespace Theia {
+	// Blocking TCP connection. Send and Receive move whole buffers, and fail once the connection is closed or broken.
+	class Socket {
+	public:
+		Socket() = default;
+		Socket(Socket&& socket) noexcept;
+		Socket& operator=(Socket&& socket) noexcept;
+		Socket(const Socket&) = delete;
+		Socket& operator=(const Socket&) = delete;
+		~Socket();
+
+		// IsOpen() is false when nothing listening at host and port accepts the connection. host is an IPv4 address.
+		static Theia::Socket Connect(const std::string& host, Theia::UInt16 port);
+
+		bool IsOpen() const;
+		bool Send(const void* data, size_t size);
+		bool Receive(void* data, size_t size);
+		// Receive fails once it has waited this long for data; 0 waits forever. The connection should be closed after such a failure.
+		bool SetReceiveTimeout(Theia::Float64 timeout_milliseconds);
+		// Ends the connection in both directions while keeping the socket open, so a thread blocked in Receive on it returns.
+		void Shutdown();
+	protected:
+	private:
+		friend class SocketListener;
+
+		explicit Socket(Theia::UInt64 handle);
+		void Close();
+
+		Theia::UInt64 m_handle = ~Theia::UInt64(0);
+	};
+
+	class SocketListener {
+	public:
+		// Listens on address, an IPv4 address, and port. Port 0 takes a free port, which GetPort returns. IsOpen() is false when the address cannot be bound.
+		explicit SocketListener(const std::string& address = "127.0.0.1", Theia::UInt16 port = 0);
+		SocketListener(const SocketListener&) = delete;
+		SocketListener& operator=(const SocketListener&) = delete;
+		~SocketListener();
+
+		bool IsOpen() const;
+		Theia::UInt16 GetPort() const;
+		// Waits up to timeout_milliseconds for a connection. The socket is not open when none arrives.
+		Theia::Socket Accept(Theia::Float64 timeout_milliseconds);
+	protected:
+	private:
+		Theia::UInt64 m_handle = ~Theia::UInt64(0);
+		Theia::UInt16 m_port = 0;
+	};
+}
+#endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef _THEIA_MATH_AABB2_H_
 #define _THEIA_MATH_AABB2_H_
 #include "Point2.h"
+#include <algorithm>
 #include <limits>
 
 namespace Theia {
@@ -9,20 +10,31 @@ namespace Theia {
 		AABB2() {
 			T min = std::numeric_limits<T>::lowest();
 			T max = std::numeric_limits<T>::max();
-			m_min = Point2<T>(max);
-			m_max = Point2<T>(min);
+			m_min = Point2<T>(max, max);
+			m_max = Point2<T>(min, min);
 		}
 
-		Vector2<T> Diagonal() { return m_max - m_min; }
+		AABB2(const Point2<T>& point1, const Point2<T>& point2) :
+			m_min(std::min(point1.m_x, point2.m_x), std::min(point1.m_y, point2.m_y)),
+			m_max(std::max(point1.m_x, point2.m_x), std::max(point1.m_y, point2.m_y))
+		{
+
+		}
+
+		Vector2<T> Diagonal() const { return m_max - m_min; }
 		
-		T Area() {
+		T Area() const {
 			Vector2<T> diagonal = m_max - m_min;
 			return diagonal.m_x * diagonal.m_y;
 		}
 
+		// For integer bounds m_max is exclusive, so bounds with a zero extent are empty.
+		bool IsEmpty() const {
+			return m_min.m_x >= m_max.m_x || m_min.m_y >= m_max.m_y;
+		}
 
-	private:
 		Theia::Point2<T> m_min, m_max;
+	private:
 	};
 }
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define _THEIA_MATH_AABB3_H_
 #include "Point3.h"
 #include "Vector3.h"
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 namespace Theia {
@@ -14,6 +16,20 @@ namespace Theia {
 			m_max = Point3<T>(min, min, min);
 		}
 
+		explicit AABB3(const Point3<T>& point) :
+			m_min(point),
+			m_max(point)
+		{
+
+		}
+
+		AABB3(const Point3<T>& point1, const Point3<T>& point2) :
+			m_min(Min(point1, point2)),
+			m_max(Max(point1, point2))
+		{
+
+		}
+
 		Point3<T> operator[](uint32_t index) const {
 			return (index == 0) ? m_min : m_max;
 		}
@@ -30,15 +46,69 @@ namespace Theia {
 			);
 		}
 
-		Vector3<T> Diagonal() {
+		Vector3<T> Diagonal() const {
 			return m_max - m_min;
 		}
 
-		T Volume() {
+		T Volume() const {
 			Vector3<T> diagonal = m_max - m_min;
 			return diagonal.m_x * diagonal.m_y * diagonal.m_z;
 		}
 
+		T SurfaceArea() const {
+			Vector3<T> diagonal = m_max - m_min;
+			return 2 * (diagonal.m_x * diagonal.m_y + diagonal.m_x * diagonal.m_z + diagonal.m_y * diagonal.m_z);
+		}
+
+		Point3<T> Centroid() const {
+			return m_min + (m_max - m_min) / 2;
+		}
+
+		bool IsEmpty() const {
+			return m_min.m_x > m_max.m_x || m_min.m_y > m_max.m_y || m_min.m_z > m_max.m_z;
+		}
+
+		bool IsDegenerate() const {
+			return m_min.m_x >= m_max.m_x || m_min.m_y >= m_max.m_y || m_min.m_z >= m_max.m_z;
+		}
+
+		bool IntersectP(const Point3<T>& origin, const Vector3<T>& inverse_direction, const Int32 direction_is_negative[3], T t_max) const {
+			const AABB3& aabb = *this;
+			T t_near = (aabb[direction_is_negative[0]].m_x - origin.m_x) * inverse_direction.m_x;
+			T t_far = (aabb[1 - direction_is_negative[0]].m_x - origin.m_x) * inverse_direction.m_x;
+			T t_y_min = (aabb[direction_is_negative[1]].m_y - origin.m_y) * inverse_direction.m_y;
+			T t_y_max = (aabb[1 - direction_is_negative[1]].m_y - origin.m_y) * inverse_direction.m_y;
+
+			t_far *= 1 + 2 * Theia::Gamma(3);
+			t_y_max *= 1 + 2 * Theia::Gamma(3);
+
+			if (t_near > t_y_max || t_y_min > t_far) {
+				return false;
+			}
+			if (t_y_min > t_near) {
+				t_near = t_y_min;
+			}
+			if (t_y_max < t_far) {
+				t_far = t_y_max;
+			}
+
+			T t_z_min = (aabb[direction_is_negative[2]].m_z - origin.m_z) * inverse_direction.m_z;
+			T t_z_max = (aabb[1 - direction_is_negative[2]].m_z - origin.m_z) * inverse_direction.m_z;
+			t_z_max *= 1 + 2 * Theia::Gamma(3);
+
+			if (t_near > t_z_max || t_z_min > t_far) {
+				return false;
+			}
+			if (t_z_min > t_near) {
+				t_near = t_z_min;
+			}
+			if (t_z_max < t_far) {
+				t_far = t_z_max;
+			}
+
+			return (t_near < t_max) && (t_far > 0);
+		}
+
 		Point3<T> m_min, m_max;
 	private:
 	};
@@ -61,12 +131,30 @@ namespace Theia {
 		return return_aabb;
 	}
 
-	template <typename T, typename U> T DistanceSquared(const Point3<T>& point, const AABB3<U>& aabb) {
+	template <typename T> AABB3<T> Intersection(const AABB3<T>& aabb1, const AABB3<T>& aabb2) {
+		AABB3<T> return_aabb;
+
+		return_aabb.m_min = Max(aabb1.m_min, aabb2.m_min);
+		return_aabb.m_max = Min(aabb1.m_max, aabb2.m_max);
 
+		return return_aabb;
 	}
 
-	template <typename T, typename U> T Distance(const Point3<T>& point, const AABB3<U>& aabb) {
+	template <typename T> bool Overlaps(const AABB3<T>& aabb1, const AABB3<T>& aabb2) {
+		return aabb1.m_max.m_x >= aabb2.m_min.m_x && aabb1.m_min.m_x <= aabb2.m_max.m_x &&
+			aabb1.m_max.m_y >= aabb2.m_min.m_y && aabb1.m_min.m_y <= aabb2.m_max.m_y &&
+			aabb1.m_max.m_z >= aabb2.m_min.m_z && aabb1.m_min.m_z <= aabb2.m_max.m_z;
+	}
+
+	template <typename T, typename U> T DistanceSquared(const Point3<T>& point, const AABB3<U>& aabb) {
+		T dx = std::max<T>({ T(0), T(aabb.m_min.m_x) - point.m_x, point.m_x - T(aabb.m_max.m_x) });
+		T dy = std::max<T>({ T(0), T(aabb.m_min.m_y) - point.m_y, point.m_y - T(aabb.m_max.m_y) });
+		T dz = std::max<T>({ T(0), T(aabb.m_min.m_z) - point.m_z, point.m_z - T(aabb.m_max.m_z) });
+		return dx * dx + dy * dy + dz * dz;
+	}
 
+	template <typename T, typename U> T Distance(const Point3<T>& point, const AABB3<U>& aabb) {
+		return std::sqrt(DistanceSquared(point, aabb));
 	}
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef _THEIA_MATH_HALF_H_
+#define _THEIA_MATH_HALF_H_
+#include "../Types.h"
+
+namespace Theia {
+	// IEEE 754 binary16, for data that only needs 11 bits of precision such as texture coordinates. Conversion from Float rounds to nearest even.
+	class Half {
+	public:
+		Half() = default;
+
+		explicit Half(Theia::Float value) :
+			m_bits(FromFloat(value))
+		{
+
+		}
+
+		explicit operator Theia::Float() const {
+			Theia::FloatBits sign = Theia::FloatBits(m_bits & 0x8000) << 16;
+			Theia::FloatBits exponent = (m_bits >> 10) & 0x1F;
+			Theia::FloatBits mantissa = m_bits & 0x3FF;
+			if (exponent == 0) {
+				Theia::Float value = Theia::Float(mantissa) * 0x1p-24f;
+				return sign ? -value : value;
+			}
+			if (exponent == 0x1F) {
+				return Theia::FloatBitsToFloat(sign | 0x7F800000 | (mantissa << 13));
+			}
+			return Theia::FloatBitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+		}
+
+		Theia::UInt16 Bits() const {
+			return m_bits;
+		}
+
+		static Theia::Half FromBits(Theia::UInt16 bits) {
+			Theia::Half half;
+			half.m_bits = bits;
+			return half;
+		}
+	protected:
+	private:
+		static Theia::UInt16 FromFloat(Theia::Float value) {
+			Theia::FloatBits bits = Theia::FloatToFloatBits(value);
+			Theia::UInt16 sign = Theia::UInt16((bits >> 16) & 0x8000);
+			Theia::FloatBits magnitude = bits & 0x7FFFFFFF;
+			if (magnitude > 0x7F800000) {
+				return sign | 0x7E00;
+			}
+			// 65520 and above round to infinity.
+			if (magnitude >= 0x477FF000) {
+				return sign | 0x7C00;
+			}
+			// Below 2^-14 the result is subnormal, with a fixed step of 2^-24.
+			if (magnitude < 0x38800000) {
+				return sign | Theia::UInt16(std::nearbyint(Theia::FloatBitsToFloat(magnitude) * 0x1p24f));
+			}
+
+			Theia::FloatBits half = (magnitude - 0x38000000) >> 13;
+			Theia::FloatBits remainder = magnitude & 0x1FFF;
+			if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+				half++;
+			}
+			return sign | Theia::UInt16(half);
+		}
+
+		Theia::UInt16 m_bits = 0;
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef _THEIA_MATH_HASH_H_
+#define _THEIA_MATH_HASH_H_
+#include "../Types.h"
+#include <cstring>
+
+namespace Theia {
+	// MurmurHash64A by Austin Appleby. Chaining calls through seed hashes several buffers as one.
+	inline Theia::UInt64 MurmurHash64A(const Theia::UInt8* key, size_t length, Theia::UInt64 seed) {
+		constexpr Theia::UInt64 m = 0xC6A4A7935BD1E995ull;
+		constexpr Theia::Int32 r = 47;
+
+		Theia::UInt64 hash = seed ^ (length * m);
+		const Theia::UInt8* end = key + 8 * (length / 8);
+		while (key != end) {
+			Theia::UInt64 k;
+			std::memcpy(&k, key, sizeof(Theia::UInt64));
+			key += 8;
+
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+			hash ^= k;
+			hash *= m;
+		}
+
+		switch (length & 7) {
+		case 7:
+			hash ^= Theia::UInt64(key[6]) << 48;
+			[[fallthrough]];
+		case 6:
+			hash ^= Theia::UInt64(key[5]) << 40;
+			[[fallthrough]];
+		case 5:
+			hash ^= Theia::UInt64(key[4]) << 32;
+			[[fallthrough]];
+		case 4:
+			hash ^= Theia::UInt64(key[3]) << 24;
+			[[fallthrough]];
+		case 3:
+			hash ^= Theia::UInt64(key[2]) << 16;
+			[[fallthrough]];
+		case 2:
+			hash ^= Theia::UInt64(key[1]) << 8;
+			[[fallthrough]];
+		case 1:
+			hash ^= Theia::UInt64(key[0]);
+			hash *= m;
+		}
+
+		hash ^= hash >> r;
+		hash *= m;
+		hash ^= hash >> r;
+		return hash;
+	}
+
+	inline Theia::UInt64 HashBuffer(const void* data, size_t size, Theia::UInt64 seed = 0) {
+		return Theia::MurmurHash64A(static_cast<const Theia::UInt8*>(data), size, seed);
+	}
+}
+#endif
\ No newline at end of file
@@ -55,10 +55,12 @@ namespace Theia {
 		return Interval(NextFloatDown(m_low - interval.m_high), NextFloatUp(m_high - interval.m_low));
 	}
 
+	// NextFloatDown and NextFloatUp are monotonic, so rounding only the extreme products gives the same bounds as rounding all four.
 	Interval Interval::operator*(const Interval& interval) const {
+		Theia::Float products[4] = { m_low * interval.m_low, m_low * interval.m_high, m_high * interval.m_low, m_high * interval.m_high };
 		return Interval(
-			std::min({ NextFloatDown(m_low * interval.m_low), NextFloatDown(m_low * interval.m_high), NextFloatDown(m_high * interval.m_low), NextFloatDown(m_high * interval.m_high) }),
-			std::max({ NextFloatUp(m_low * interval.m_low), NextFloatUp(m_low * interval.m_high), NextFloatUp(m_high * interval.m_low), NextFloatUp(m_high * interval.m_high) })
+			NextFloatDown(std::min({ products[0], products[1], products[2], products[3] })),
+			NextFloatUp(std::max({ products[0], products[1], products[2], products[3] }))
 		);
 	}
 
@@ -67,9 +69,10 @@ namespace Theia {
 			return Interval(-Theia::Infinity, Theia::Infinity);
 		}
 
+		Theia::Float quotients[4] = { m_low / interval.m_low, m_low / interval.m_high, m_high / interval.m_low, m_high / interval.m_high };
 		return Interval(
-			std::min({ NextFloatDown(m_low / interval.m_low), NextFloatDown(m_low / interval.m_high), NextFloatDown(m_high / interval.m_low), NextFloatDown(m_high / interval.m_high) }),
-			std::max({ NextFloatUp(m_low / interval.m_low), NextFloatUp(m_low / interval.m_high), NextFloatUp(m_high / interval.m_low), NextFloatUp(m_high / interval.m_high) })
+			NextFloatDown(std::min({ quotients[0], quotients[1], quotients[2], quotients[3] })),
+			NextFloatUp(std::max({ quotients[0], quotients[1], quotients[2], quotients[3] }))
 		);
 	}
 
@@ -160,4 +163,20 @@ namespace Theia {
 	bool InRange(const Interval& interval1, const Interval& interval2) {
 		return interval1.GetLow() <= interval2.GetHigh() && interval1.GetHigh() >= interval2.GetLow();
 	}
+
+	Interval Sqr(const Interval& interval) {
+		Theia::Float low = std::abs(interval.GetLow());
+		Theia::Float high = std::abs(interval.GetHigh());
+		if (low > high) {
+			std::swap(low, high);
+		}
+		if (InRange(0.0f, interval)) {
+			return Interval(0.0f, NextFloatUp(high * high));
+		}
+		return Interval(NextFloatDown(low * low), NextFloatUp(high * high));
+	}
+
+	Interval Sqrt(const Interval& interval) {
+		return Interval(std::max<Theia::Float>(0.0f, NextFloatDown(std::sqrt(interval.GetLow()))), NextFloatUp(std::sqrt(interval.GetHigh())));
+	}
 }
\ No newline at end of file
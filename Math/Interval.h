@@ -64,5 +64,7 @@ namespace Theia {
 	Interval operator/(Theia::Float value, const Interval& interval);
 	bool InRange(Theia::Float value, const Interval& interval);
 	bool InRange(const Interval& interval1, const Interval& interval2);
+	Interval Sqr(const Interval& interval);
+	Interval Sqrt(const Interval& interval);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef _THEIA_MATH_LANES_H_
+#define _THEIA_MATH_LANES_H_
+#include "../Types.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Theia {
+#if defined(__AVX2__)
+	// Thin wrappers over SSE and AVX so that SIMD kernels are written once for 4 and 8 lanes.
+	template <Theia::UInt32 Width> struct Lanes;
+
+	template <> struct Lanes<4> {
+		typedef __m128 Type;
+		static Type Load(const Theia::Float* values) { return _mm_load_ps(values); }
+		static void Store(Theia::Float* values, Type a) { _mm_store_ps(values, a); }
+		static Type Set(Theia::Float value) { return _mm_set1_ps(value); }
+		static Type Add(Type a, Type b) { return _mm_add_ps(a, b); }
+		static Type Subtract(Type a, Type b) { return _mm_sub_ps(a, b); }
+		static Type Multiply(Type a, Type b) { return _mm_mul_ps(a, b); }
+		static Type Divide(Type a, Type b) { return _mm_div_ps(a, b); }
+		static Type MultiplySubtract(Type a, Type b, Type c) { return _mm_fmsub_ps(a, b, c); }
+		static Type NegativeMultiplyAdd(Type a, Type b, Type c) { return _mm_fnmadd_ps(a, b, c); }
+		static Type Min(Type a, Type b) { return _mm_min_ps(a, b); }
+		static Type Max(Type a, Type b) { return _mm_max_ps(a, b); }
+		static Type Abs(Type a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static Type Less(Type a, Type b) { return _mm_cmp_ps(a, b, _CMP_LT_OQ); }
+		static Type LessEqual(Type a, Type b) { return _mm_cmp_ps(a, b, _CMP_LE_OQ); }
+		static Type Greater(Type a, Type b) { return _mm_cmp_ps(a, b, _CMP_GT_OQ); }
+		static Type GreaterEqual(Type a, Type b) { return _mm_cmp_ps(a, b, _CMP_GE_OQ); }
+		static Type Equal(Type a, Type b) { return _mm_cmp_ps(a, b, _CMP_EQ_OQ); }
+		static Type And(Type a, Type b) { return _mm_and_ps(a, b); }
+		static Type Or(Type a, Type b) { return _mm_or_ps(a, b); }
+		static Theia::UInt32 Mask(Type a) { return Theia::UInt32(_mm_movemask_ps(a)); }
+	};
+
+	template <> struct Lanes<8> {
+		typedef __m256 Type;
+		static Type Load(const Theia::Float* values) { return _mm256_load_ps(values); }
+		static void Store(Theia::Float* values, Type a) { _mm256_store_ps(values, a); }
+		static Type Set(Theia::Float value) { return _mm256_set1_ps(value); }
+		static Type Add(Type a, Type b) { return _mm256_add_ps(a, b); }
+		static Type Subtract(Type a, Type b) { return _mm256_sub_ps(a, b); }
+		static Type Multiply(Type a, Type b) { return _mm256_mul_ps(a, b); }
+		static Type Divide(Type a, Type b) { return _mm256_div_ps(a, b); }
+		static Type MultiplySubtract(Type a, Type b, Type c) { return _mm256_fmsub_ps(a, b, c); }
+		static Type NegativeMultiplyAdd(Type a, Type b, Type c) { return _mm256_fnmadd_ps(a, b, c); }
+		static Type Min(Type a, Type b) { return _mm256_min_ps(a, b); }
+		static Type Max(Type a, Type b) { return _mm256_max_ps(a, b); }
+		static Type Abs(Type a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static Type Less(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static Type LessEqual(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		static Type Greater(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static Type GreaterEqual(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static Type Equal(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+		static Type And(Type a, Type b) { return _mm256_and_ps(a, b); }
+		static Type Or(Type a, Type b) { return _mm256_or_ps(a, b); }
+		static Theia::UInt32 Mask(Type a) { return Theia::UInt32(_mm256_movemask_ps(a)); }
+	};
+#endif
+}
+#endif
\ No newline at end of file
@@ -125,7 +125,7 @@ namespace Theia {
 
 		matrix[0][0] = a.m_x * a.m_x + (1.0f - a.m_x * a.m_x) * cos_theta;
 		matrix[0][1] = a.m_x * a.m_y * (1.0f - cos_theta) - a.m_z * sin_theta;
-		matrix[0][2] = a.m_x * a.m_z * (1.0f - cos_theta) - a.m_y * sin_theta;
+		matrix[0][2] = a.m_x * a.m_z * (1.0f - cos_theta) + a.m_y * sin_theta;
 		matrix[0][3] = 0.0f;
 
 		matrix[1][0] = a.m_x * a.m_y * (1 - cos_theta) + a.m_z * sin_theta;
@@ -122,5 +122,12 @@ namespace Theia {
 	inline Float Lerp(Float x, Float a, Float b) {
 		return (1.0f - x) * a + x * b;
 	}
+
+	template <typename T> inline T DifferenceOfProducts(T a, T b, T c, T d) {
+		T cd = c * d;
+		T difference_of_products = std::fma(a, b, -cd);
+		T error = std::fma(-c, d, cd);
+		return difference_of_products + error;
+	}
 }
 #endif
\ No newline at end of file
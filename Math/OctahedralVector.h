@@ -0,0 +1,50 @@
+#ifndef _THEIA_MATH_OCTAHEDRAL_VECTOR_H_
+#define _THEIA_MATH_OCTAHEDRAL_VECTOR_H_
+#include "Vector3.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Theia {
+	// Unit vector in 4 bytes: the direction is projected onto the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper one, and the two remaining coordinates are stored with 16 bits each.
+	class OctahedralVector {
+	public:
+		OctahedralVector() = default;
+
+		explicit OctahedralVector(Theia::Vector3<Theia::Float> vector) {
+			vector /= std::abs(vector.m_x) + std::abs(vector.m_y) + std::abs(vector.m_z);
+			if (vector.m_z >= 0.0f) {
+				m_x = Encode(vector.m_x);
+				m_y = Encode(vector.m_y);
+			}
+			else {
+				m_x = Encode((1.0f - std::abs(vector.m_y)) * Sign(vector.m_x));
+				m_y = Encode((1.0f - std::abs(vector.m_x)) * Sign(vector.m_y));
+			}
+		}
+
+		explicit operator Theia::Vector3<Theia::Float>() const {
+			Theia::Vector3<Theia::Float> vector;
+			vector.m_x = -1.0f + 2.0f * (Theia::Float(m_x) / 65535.0f);
+			vector.m_y = -1.0f + 2.0f * (Theia::Float(m_y) / 65535.0f);
+			vector.m_z = 1.0f - (std::abs(vector.m_x) + std::abs(vector.m_y));
+			if (vector.m_z < 0.0f) {
+				Theia::Float x = vector.m_x;
+				vector.m_x = (1.0f - std::abs(vector.m_y)) * Sign(x);
+				vector.m_y = (1.0f - std::abs(x)) * Sign(vector.m_y);
+			}
+			return Theia::Normalize(vector);
+		}
+	protected:
+	private:
+		static Theia::Float Sign(Theia::Float value) {
+			return std::copysign(1.0f, value);
+		}
+
+		static Theia::UInt16 Encode(Theia::Float value) {
+			return Theia::UInt16(std::round(std::clamp((value + 1.0f) / 2.0f, 0.0f, 1.0f) * 65535.0f));
+		}
+
+		Theia::UInt16 m_x = 0, m_y = 0;
+	};
+}
+#endif
\ No newline at end of file
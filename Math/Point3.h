@@ -133,6 +133,10 @@ namespace Theia {
 		return Point3<T>(std::max(point1.m_x, point2.m_x), std::max(point1.m_y, point2.m_y), std::max(point1.m_z, point2.m_z));
 	}
 
+	template <typename T> Point3<T> Lerp(Theia::Float t, const Point3<T>& point1, const Point3<T>& point2) {
+		return Point3<T>((1 - t) * point1.m_x + t * point2.m_x, (1 - t) * point1.m_y + t * point2.m_y, (1 - t) * point1.m_z + t * point2.m_z);
+	}
+
 	template <typename T> T DistanceSquared(const Point3<T>& point1, const Point3<T>& point2) {
 		return (point1.m_x * point2.m_x) + (point1.m_y * point2.m_y) + (point1.m_z * point2.m_z);
 	}
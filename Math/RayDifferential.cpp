@@ -13,8 +13,23 @@ namespace Theia {
 
 	RayDifferential::RayDifferential(const Ray& ray) :
 		m_origin(ray.GetOrigin()),
-		m_direction(ray.GetDirection())
+		m_direction(ray.GetDirection()),
+		m_time(ray.GetTime()),
+		m_medium(ray.GetMedium())
+	{
+
+	}
 
+	RayDifferential::RayDifferential(const Ray& ray, const Theia::Point3<Theia::Float>& rx_origin, const Theia::Vector3<Theia::Float>& rx_direction, const Theia::Point3<Theia::Float>& ry_origin, const Theia::Vector3<Theia::Float>& ry_direction) :
+		m_origin(ray.GetOrigin()),
+		m_rx_origin(rx_origin),
+		m_ry_origin(ry_origin),
+		m_direction(ray.GetDirection()),
+		m_rx_direction(rx_direction),
+		m_ry_direction(ry_direction),
+		m_time(ray.GetTime()),
+		m_medium(ray.GetMedium()),
+		m_has_differentials(true)
 	{
 
 	}
@@ -25,4 +40,23 @@ namespace Theia {
 		m_rx_direction = m_direction + (m_rx_direction - m_direction) * s;
 		m_ry_direction = m_direction + (m_ry_direction - m_direction) * s;
 	}
+
+	Theia::Ray RayDifferential::GetRay() const {
+		return Theia::Ray(m_origin, m_direction, m_time, m_medium);
+	}
+
+	bool RayDifferential::HasDifferentials() const {
+		return m_has_differentials;
+	}
+
+	Theia::Float RayDifferential::FootprintWidth(Theia::Float distance) const {
+		if (!m_has_differentials) {
+			return 0.0f;
+		}
+
+		Theia::Point3<Theia::Float> point = m_origin + distance * Theia::Normalize(m_direction);
+		Theia::Point3<Theia::Float> point_x = m_rx_origin + distance * Theia::Normalize(m_rx_direction);
+		Theia::Point3<Theia::Float> point_y = m_ry_origin + distance * Theia::Normalize(m_ry_direction);
+		return std::max(Theia::Length(point_x - point), Theia::Length(point_y - point));
+	}
 }
\ No newline at end of file
@@ -12,12 +12,20 @@ namespace Theia {
 	public:
 		RayDifferential(const Theia::Point3<Theia::Float>& origin, const Theia::Vector3<Theia::Float>& direction, Theia::Float time = 0.0f, Medium medium = nullptr);
 		RayDifferential(const Ray& ray);
+		// A ray with the rays through the neighbouring pixels in x and y, as generated by cameras.
+		RayDifferential(const Ray& ray, const Theia::Point3<Theia::Float>& rx_origin, const Theia::Vector3<Theia::Float>& rx_direction, const Theia::Point3<Theia::Float>& ry_origin, const Theia::Vector3<Theia::Float>& ry_direction);
 		void ScaleDifferential(Theia::Float s);
+
+		Theia::Ray GetRay() const;
+		bool HasDifferentials() const;
+		// Width of the pixel footprint at the given distance along the ray, the larger of the distances to the x and y offset rays. Zero without differentials.
+		Theia::Float FootprintWidth(Theia::Float distance) const;
 	private:
 		Theia::Point3<Theia::Float> m_origin, m_rx_origin, m_ry_origin;
 		Theia::Vector3<Theia::Float> m_direction, m_rx_direction, m_ry_direction;
 		Theia::Float m_time;
 		Theia::Medium m_medium;
+		bool m_has_differentials = false;
 	};
 }
 #endif
\ No newline at end of file
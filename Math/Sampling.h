@@ -0,0 +1,72 @@
+#ifndef _THEIA_MATH_SAMPLING_H_
+#define _THEIA_MATH_SAMPLING_H_
+#include "Math.h"
+#include <array>
+
+namespace Theia {
+	inline Theia::Vector3f SampleUniformSphere(const Theia::Point2f& u) {
+		Theia::Float z = 1.0f - 2.0f * u.m_x;
+		Theia::Float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+		Theia::Float phi = 2.0f * Theia::Pi * u.m_y;
+		return Theia::Vector3f(r * std::cos(phi), r * std::sin(phi), z);
+	}
+
+	// Direction about +z with density cos(theta) / pi, by Malley's method on a concentric disk sample.
+	inline Theia::Vector3f SampleCosineHemisphere(const Theia::Point2f& u) {
+		Theia::Float x = 2.0f * u.m_x - 1.0f;
+		Theia::Float y = 2.0f * u.m_y - 1.0f;
+		Theia::Float r = 0.0f;
+		Theia::Float phi = 0.0f;
+		if (x != 0.0f || y != 0.0f) {
+			if (std::abs(x) > std::abs(y)) {
+				r = x;
+				phi = Theia::Pi / 4.0f * (y / x);
+			}
+			else {
+				r = y;
+				phi = Theia::Pi / 2.0f - Theia::Pi / 4.0f * (x / y);
+			}
+		}
+		Theia::Float disk_x = r * std::cos(phi);
+		Theia::Float disk_y = r * std::sin(phi);
+		return Theia::Vector3f(disk_x, disk_y, std::sqrt(std::max(0.0f, 1.0f - disk_x * disk_x - disk_y * disk_y)));
+	}
+
+	// Density on [0, 1] proportional to the line from a at 0 to b at 1.
+	inline Theia::Float LinearPDF(Theia::Float x, Theia::Float a, Theia::Float b) {
+		if (x < 0.0f || x > 1.0f) {
+			return 0.0f;
+		}
+
+		return 2.0f * Theia::Lerp(x, a, b) / (a + b);
+	}
+
+	inline Theia::Float SampleLinear(Theia::Float u, Theia::Float a, Theia::Float b) {
+		if (u == 0.0f && a == 0.0f) {
+			return 0.0f;
+		}
+
+		Theia::Float x = u * (a + b) / (a + std::sqrt(Theia::Lerp(u, a * a, b * b)));
+		return std::min(x, Theia::OneMinusEpsilon);
+	}
+
+	// Density on [0, 1]^2 that interpolates the weights w given at the corners (0, 0), (1, 0), (0, 1) and (1, 1).
+	inline Theia::Float BilinearPDF(const Theia::Point2f& p, const std::array<Theia::Float, 4>& w) {
+		if (p.m_x < 0.0f || p.m_x > 1.0f || p.m_y < 0.0f || p.m_y > 1.0f) {
+			return 0.0f;
+		}
+
+		if (w[0] + w[1] + w[2] + w[3] == 0.0f) {
+			return 1.0f;
+		}
+
+		return 4.0f * ((1.0f - p.m_x) * (1.0f - p.m_y) * w[0] + p.m_x * (1.0f - p.m_y) * w[1] + (1.0f - p.m_x) * p.m_y * w[2] + p.m_x * p.m_y * w[3]) / (w[0] + w[1] + w[2] + w[3]);
+	}
+
+	inline Theia::Point2f SampleBilinear(const Theia::Point2f& u, const std::array<Theia::Float, 4>& w) {
+		Theia::Float y = Theia::SampleLinear(u.m_y, w[0] + w[1], w[2] + w[3]);
+		Theia::Float x = Theia::SampleLinear(u.m_x, Theia::Lerp(y, w[0], w[2]), Theia::Lerp(y, w[1], w[3]));
+		return Theia::Point2f(x, y);
+	}
+}
+#endif
\ No newline at end of file
@@ -1,7 +1,10 @@
 #ifndef _THEIA_MATH_SQUARE_MATRIX_H_
 #define _THEIA_MATH_SQUARE_MATRIX_H_
 #include <stdint.h>
+#include <cmath>
+#include <limits>
 #include <span>
+#include <utility>
 
 namespace Theia {
 	template <typename T, int N> class SquareMatrix {
@@ -344,10 +347,87 @@ namespace Theia {
 		return SquareMatrix<T, N>();
 	}
 
+	// Gauss-Jordan elimination with full pivoting, in double precision. Singular matrices have no inverse and give a matrix of NaNs.
 	template <typename T, int N> SquareMatrix<T, N> Inverse(const SquareMatrix<T, N>& matrix) {
-		//TODO Implement Inverse Matrix Computation.
+		int column_index[N], row_index[N];
+		bool is_pivot[N] = {};
+		double inverse[N][N];
+		for (int i = 0; i < N; ++i) {
+			for (int j = 0; j < N; ++j) {
+				inverse[i][j] = double(matrix[i][j]);
+			}
+		}
 
-		return SquareMatrix<T, N>();
+		for (int i = 0; i < N; ++i) {
+			int row = 0, column = 0;
+			double largest = 0.0;
+			for (int j = 0; j < N; ++j) {
+				if (is_pivot[j]) {
+					continue;
+				}
+				for (int k = 0; k < N; ++k) {
+					if (!is_pivot[k] && std::abs(inverse[j][k]) >= largest) {
+						largest = std::abs(inverse[j][k]);
+						row = j;
+						column = k;
+					}
+				}
+			}
+
+			if (largest == 0.0) {
+				SquareMatrix<T, N> nan_matrix;
+				for (int j = 0; j < N; ++j) {
+					for (int k = 0; k < N; ++k) {
+						nan_matrix[j][k] = std::numeric_limits<T>::quiet_NaN();
+					}
+				}
+				return nan_matrix;
+			}
+			is_pivot[column] = true;
+
+			if (row != column) {
+				for (int k = 0; k < N; ++k) {
+					std::swap(inverse[row][k], inverse[column][k]);
+				}
+			}
+			row_index[i] = row;
+			column_index[i] = column;
+
+			double inverse_pivot = 1.0 / inverse[column][column];
+			inverse[column][column] = 1.0;
+			for (int j = 0; j < N; ++j) {
+				inverse[column][j] *= inverse_pivot;
+			}
+
+			for (int j = 0; j < N; ++j) {
+				if (j == column) {
+					continue;
+				}
+				double factor = inverse[j][column];
+				inverse[j][column] = 0.0;
+				for (int k = 0; k < N; ++k) {
+					inverse[j][k] -= inverse[column][k] * factor;
+				}
+			}
+		}
+
+		// Undoes the column swaps in reverse order.
+		for (int j = N - 1; j >= 0; --j) {
+			if (row_index[j] != column_index[j]) {
+				for (int k = 0; k < N; ++k) {
+					std::swap(inverse[k][row_index[j]], inverse[k][column_index[j]]);
+				}
+			}
+		}
+
+		SquareMatrix<T, N> return_matrix;
+		for (int i = 0; i < N; ++i) {
+			for (int j = 0; j < N; ++j) {
+				return_matrix[i][j] = T(inverse[i][j]);
+			}
+		}
+
+		return return_matrix;
 	}
 }
 #endif
\ No newline at end of file
@@ -37,6 +37,8 @@ namespace Theia {
 		Transform& operator=(const Transform& transform) {
 			m_matrix = transform.m_matrix;
 			m_inverse_matrix = transform.m_inverse_matrix;
+
+			return *this;
 		}
 
 		Transform operator*(const Transform& transform) const {
@@ -67,7 +69,7 @@ namespace Theia {
 				return Theia::Point3<T>(x, y, z);
 			}
 			else {
-				return Theia::Point3<T>(x, y, z) / w;
+				return Theia::Point3<T>(x / w, y / w, z / w);
 			}
 		}
 
@@ -95,10 +97,33 @@ namespace Theia {
 			return Theia::Normal3<T>(x, y, z);
 		}
 
+		// Exact and interval points and vectors are transformed at their midpoints with a bound on the rounding error of the matrix product, which is much cheaper than evaluating it in interval arithmetic and just as conservative.
+		Theia::Point3<Theia::Interval> operator()(const Theia::Point3<Theia::Interval>& point) const {
+			return TransformPoint(m_matrix, point);
+		}
+
+		Theia::Point3<Theia::Interval> ApplyInverse(const Theia::Point3<Theia::Interval>& point) const {
+			return TransformPoint(m_inverse_matrix, point);
+		}
+
+		Theia::Vector3<Theia::Interval> operator()(const Theia::Vector3<Theia::Interval>& vector) const {
+			return TransformVector(m_matrix, vector);
+		}
+
+		Theia::Vector3<Theia::Interval> ApplyInverse(const Theia::Vector3<Theia::Interval>& vector) const {
+			return TransformVector(m_inverse_matrix, vector);
+		}
+
 		Theia::Ray operator()(const Ray& ray, Theia::Float& time_max) const {
 			Point3<Theia::Interval> origin = (*this)(Theia::Point3<Theia::Interval>(ray.GetOrigin()));
 			Vector3<Theia::Float> direction = (*this)(ray.GetDirection());
-			return Ray(Point3<Theia::Float>(origin), direction, ray.GetTime(), ray.GetMedium());
+			return OffsetRayOrigin(origin, direction, ray, time_max);
+		}
+
+		Theia::Ray ApplyInverse(const Ray& ray, Theia::Float& time_max) const {
+			Point3<Theia::Interval> origin = ApplyInverse(Theia::Point3<Theia::Interval>(ray.GetOrigin()));
+			Vector3<Theia::Float> direction = ApplyInverse(ray.GetDirection());
+			return OffsetRayOrigin(origin, direction, ray, time_max);
 		}
 
 		Theia::AABB3<Theia::Float> operator()(const Theia::AABB3<Theia::Float>& aabb) const {
@@ -111,11 +136,72 @@ namespace Theia {
 			return return_aabb;
 		}
 
+		const Theia::SquareMatrix<Theia::Float32, 4>& GetMatrix() const {
+			return m_matrix;
+		}
+
+		const Theia::SquareMatrix<Theia::Float32, 4>& GetInverseMatrix() const {
+			return m_inverse_matrix;
+		}
+
 		bool SwapsHandedness() const {
 			//TODO implement Check of SwapHandedness.
 			return false;
 		}
 	private:
+		// Moves the origin to the far edge of its rounding error along the direction so the transformed ray cannot start behind the surface it left.
+		static Theia::Ray OffsetRayOrigin(Point3<Theia::Interval> origin, const Vector3<Theia::Float>& direction, const Ray& ray, Theia::Float& time_max) {
+			Theia::Float length_squared = LengthSquared(direction);
+			if (length_squared > 0.0f) {
+				Vector3<Theia::Float> error = Vector3<Theia::Float>(origin.m_x.GetRange(), origin.m_y.GetRange(), origin.m_z.GetRange()) / 2.0f;
+				Theia::Float delta_t = Dot(Abs(direction), error) / length_squared;
+				origin += direction * delta_t;
+				time_max -= delta_t;
+			}
+
+			return Ray(Point3<Theia::Float>(origin), direction, ray.GetTime(), ray.GetMedium());
+		}
+
+		static Theia::Point3<Theia::Interval> TransformPoint(const Theia::SquareMatrix<Theia::Float32, 4>& matrix, const Theia::Point3<Theia::Interval>& point) {
+			Theia::Float x = Theia::Float(point.m_x);
+			Theia::Float y = Theia::Float(point.m_y);
+			Theia::Float z = Theia::Float(point.m_z);
+			Theia::Float input_error[3] = { point.m_x.GetRange() / 2.0f, point.m_y.GetRange() / 2.0f, point.m_z.GetRange() / 2.0f };
+
+			Theia::Interval result[3];
+			for (Theia::UInt32 i = 0; i < 3; ++i) {
+				Theia::Float value = matrix[i][0] * x + matrix[i][1] * y + matrix[i][2] * z + matrix[i][3];
+				Theia::Float error = Theia::Gamma(3) * (std::abs(matrix[i][0] * x) + std::abs(matrix[i][1] * y) + std::abs(matrix[i][2] * z) + std::abs(matrix[i][3]));
+				error += (Theia::Gamma(3) + 1.0f) * (std::abs(matrix[i][0]) * input_error[0] + std::abs(matrix[i][1]) * input_error[1] + std::abs(matrix[i][2]) * input_error[2]);
+				result[i] = Theia::Interval::FromValueAndError(value, error);
+			}
+			Theia::Float w = matrix[3][0] * x + matrix[3][1] * y + matrix[3][2] * z + matrix[3][3];
+
+			if (w == 1.0f) {
+				return Theia::Point3<Theia::Interval>(result[0], result[1], result[2]);
+			}
+			else {
+				return Theia::Point3<Theia::Interval>(result[0] / w, result[1] / w, result[2] / w);
+			}
+		}
+
+		static Theia::Vector3<Theia::Interval> TransformVector(const Theia::SquareMatrix<Theia::Float32, 4>& matrix, const Theia::Vector3<Theia::Interval>& vector) {
+			Theia::Float x = Theia::Float(vector.m_x);
+			Theia::Float y = Theia::Float(vector.m_y);
+			Theia::Float z = Theia::Float(vector.m_z);
+			Theia::Float input_error[3] = { vector.m_x.GetRange() / 2.0f, vector.m_y.GetRange() / 2.0f, vector.m_z.GetRange() / 2.0f };
+
+			Theia::Interval result[3];
+			for (Theia::UInt32 i = 0; i < 3; ++i) {
+				Theia::Float value = matrix[i][0] * x + matrix[i][1] * y + matrix[i][2] * z;
+				Theia::Float error = Theia::Gamma(3) * (std::abs(matrix[i][0] * x) + std::abs(matrix[i][1] * y) + std::abs(matrix[i][2] * z));
+				error += (Theia::Gamma(3) + 1.0f) * (std::abs(matrix[i][0]) * input_error[0] + std::abs(matrix[i][1]) * input_error[1] + std::abs(matrix[i][2]) * input_error[2]);
+				result[i] = Theia::Interval::FromValueAndError(value, error);
+			}
+
+			return Theia::Vector3<Theia::Interval>(result[0], result[1], result[2]);
+		}
+
 		Theia::SquareMatrix<Theia::Float32, 4> m_matrix, m_inverse_matrix;
 	};
 }
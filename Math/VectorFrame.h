@@ -2,6 +2,7 @@
 #define _THEIA_MATH_VECTOR_FRAME_H_
 #include "../Types.h"
 #include "Vector3.h"
+#include <cmath>
 
 namespace Theia {
 	class VectorFrame {
@@ -14,6 +15,26 @@ namespace Theia {
 
 		}
 
+		VectorFrame(const Theia::Vector3<Theia::Float>& x, const Theia::Vector3<Theia::Float>& y, const Theia::Vector3<Theia::Float>& z) :
+			m_x(x),
+			m_y(y),
+			m_z(z)
+		{
+
+		}
+
+		// Orthonormal frame around the unit vector z, by the branchless construction of Duff et al.
+		static VectorFrame FromZ(const Theia::Vector3<Theia::Float>& z) {
+			Theia::Float sign = std::copysign(1.0f, z.m_z);
+			Theia::Float a = -1.0f / (sign + z.m_z);
+			Theia::Float b = z.m_x * z.m_y * a;
+			return VectorFrame(Theia::Vector3<Theia::Float>(1.0f + sign * z.m_x * z.m_x * a, sign * b, -sign * z.m_x), Theia::Vector3<Theia::Float>(b, sign + z.m_y * z.m_y * a, -z.m_y), z);
+		}
+
+		Theia::Vector3<Theia::Float> FromLocal(const Theia::Vector3<Theia::Float>& vector) const {
+			return vector.m_x * m_x + vector.m_y * m_y + vector.m_z * m_z;
+		}
+
 		Theia::Vector3<Theia::Float> m_x, m_y, m_z;
 	};
 }
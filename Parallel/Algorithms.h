@@ -0,0 +1,270 @@
+#ifndef _THEIA_PARALLEL_ALGORITHMS_H_
+#define _THEIA_PARALLEL_ALGORITHMS_H_
+#include "ThreadPool.h"
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <type_traits>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Theia {
+	// Elements a thread takes at a time in the algorithms below; inputs are split into at least this much per block, and into about 4 blocks per thread when they are larger. A pool of one thread takes inputs in a single block, which the algorithms finish in one pass.
+	constexpr Theia::Int64 Parallel_Min_Block_Size = 4096;
+	constexpr Theia::UInt32 Radix_Sort_Digit_Bits = 8;
+
+	namespace Detail {
+		inline Theia::Int64 ParallelBlockSize(Theia::Int64 count, const Theia::ThreadPool& pool) {
+			if (pool.GetThreadCount() == 1) {
+				return std::max(Theia::Parallel_Min_Block_Size, count);
+			}
+			Theia::Int64 block_count = 4 * Theia::Int64(pool.GetThreadCount());
+			return std::max(Theia::Parallel_Min_Block_Size, (count + block_count - 1) / block_count);
+		}
+
+		// Calls function(block, begin, end) for the blocks of [0, count) on the threads of the pool, and returns the block count.
+		template <typename F> Theia::Int64 ForEachBlock(Theia::Int64 count, Theia::Int64 block_size, const F& function, Theia::ThreadPool& pool) {
+			Theia::Int64 block_count = (count + block_size - 1) / block_size;
+			Theia::ParallelFor(0, block_count, [&](Theia::Int64 block) {
+				Theia::Int64 begin = block * block_size;
+				function(block, begin, std::min(begin + block_size, count));
+			}, 1, pool);
+			return block_count;
+		}
+
+		// Exclusive prefix sums of input[0, count) from offset, written to output, which may be input. Returns the sum that follows the last element.
+		template <typename T> T ScanBlock(const T* input, T* output, Theia::Int64 count, T offset) {
+			Theia::Int64 i = 0;
+#if defined(__AVX2__)
+			if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+				// Sums within each 128-bit lane by shifting and adding, then carries the low lane into the high one and the running offset into both.
+				__m256i carry = _mm256_set1_epi32(Theia::Int32(offset));
+				__m256i last_lane = _mm256_set1_epi32(7);
+				for (; i + 8 <= count; i += 8) {
+					__m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+					__m256i sums = _mm256_add_epi32(values, _mm256_slli_si256(values, 4));
+					sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 8));
+					sums = _mm256_add_epi32(sums, _mm256_blend_epi32(_mm256_setzero_si256(), _mm256_permutevar8x32_epi32(sums, _mm256_set1_epi32(3)), 0xF0));
+					sums = _mm256_add_epi32(sums, carry);
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_sub_epi32(sums, values));
+					carry = _mm256_permutevar8x32_epi32(sums, last_lane);
+				}
+				offset = T(_mm256_cvtsi256_si32(carry));
+			}
+#endif
+			for (; i < count; i++) {
+				T value = input[i];
+				output[i] = offset;
+				offset += value;
+			}
+			return offset;
+		}
+
+		// Indices of the entries of values[begin, end) that equal value, written in order from output. Returns the end of the written indices.
+		template <typename Index> Index* FindMatches(const Theia::UInt8* values, Theia::Int64 begin, Theia::Int64 end, Theia::UInt8 value, Index* output) {
+			Theia::Int64 i = begin;
+#if defined(__AVX2__)
+			__m256i pattern = _mm256_set1_epi8(char(value));
+			for (; i + 32 <= end; i += 32) {
+				Theia::UInt32 mask = Theia::UInt32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), pattern)));
+				for (; mask != 0; mask &= mask - 1) {
+					*output++ = Index(i + std::countr_zero(mask));
+				}
+			}
+#endif
+			for (; i < end; i++) {
+				if (values[i] == value) {
+					*output++ = Index(i);
+				}
+			}
+			return output;
+		}
+
+		inline Theia::UInt64 CountMatches(const Theia::UInt8* values, Theia::Int64 begin, Theia::Int64 end, Theia::UInt8 value) {
+			Theia::UInt64 count = 0;
+			Theia::Int64 i = begin;
+#if defined(__AVX2__)
+			__m256i pattern = _mm256_set1_epi8(char(value));
+			for (; i + 32 <= end; i += 32) {
+				count += std::popcount(Theia::UInt32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), pattern))));
+			}
+#endif
+			return count + Theia::UInt64(std::count(values + i, values + end, value));
+		}
+
+		template <bool Has_Values, typename Key, typename Value> Theia::UInt32 RadixSort(std::vector<Key>& keys, std::vector<Value>& values, std::vector<Key>& key_scratch, std::vector<Value>& value_scratch, Theia::UInt32 key_bits, Theia::ThreadPool& pool) {
+			static_assert(std::is_unsigned_v<Key>, "RadixSort sorts unsigned integer keys.");
+			constexpr Theia::UInt32 Digit_Count = 1u << Theia::Radix_Sort_Digit_Bits;
+			Theia::Int64 count = Theia::Int64(keys.size());
+			key_scratch.resize(keys.size());
+			if constexpr (Has_Values) {
+				assert(values.size() == keys.size(), "RadixSort needs a value for every key.");
+				value_scratch.resize(values.size());
+			}
+
+			// Every block counts its digits, the counts are turned into where each block writes each digit, and the blocks then scatter their keys in order, so each pass is stable.
+			Theia::Int64 block_size = Detail::ParallelBlockSize(count, pool);
+			Theia::Int64 block_count = (count + block_size - 1) / block_size;
+			std::vector<Theia::UInt64> offsets(size_t(block_count) * Digit_Count);
+			Theia::UInt32 pass_count = 0;
+			for (Theia::UInt32 shift = 0; shift < std::min<Theia::UInt32>(key_bits, sizeof(Key) * 8); shift += Theia::Radix_Sort_Digit_Bits) {
+				Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+					Theia::UInt64* histogram = offsets.data() + size_t(block) * Digit_Count;
+					std::fill(histogram, histogram + Digit_Count, 0);
+					for (Theia::Int64 i = begin; i < end; i++) {
+						histogram[(keys[i] >> shift) & (Digit_Count - 1)]++;
+					}
+				}, pool);
+
+				Theia::UInt64 offset = 0;
+				bool is_shared_digit = false;
+				for (Theia::UInt32 digit = 0; digit < Digit_Count && !is_shared_digit; digit++) {
+					Theia::UInt64 digit_begin = offset;
+					for (Theia::Int64 block = 0; block < block_count; block++) {
+						Theia::UInt64 digit_count = offsets[size_t(block) * Digit_Count + digit];
+						offsets[size_t(block) * Digit_Count + digit] = offset;
+						offset += digit_count;
+					}
+					is_shared_digit = offset - digit_begin == Theia::UInt64(count);
+				}
+				if (is_shared_digit) {
+					continue;
+				}
+
+				Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+					Theia::UInt64* block_offsets = offsets.data() + size_t(block) * Digit_Count;
+					for (Theia::Int64 i = begin; i < end; i++) {
+						Theia::UInt64 output = block_offsets[(keys[i] >> shift) & (Digit_Count - 1)]++;
+						key_scratch[output] = keys[i];
+						if constexpr (Has_Values) {
+							value_scratch[output] = values[i];
+						}
+					}
+				}, pool);
+				std::swap(keys, key_scratch);
+				if constexpr (Has_Values) {
+					std::swap(values, value_scratch);
+				}
+				pass_count++;
+			}
+			return pass_count;
+		}
+	}
+
+	// Writes the exclusive prefix sums of input to output, which may alias input, and returns the sum of all of input. Every block is summed in parallel, the block sums are scanned, and every block is then scanned from its offset in parallel; 32-bit integers are scanned eight at a time in AVX2 registers.
+	template <typename T> T ExclusiveScan(std::span<const T> input, std::span<T> output, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		assert(output.size() >= input.size(), "ExclusiveScan output is shorter than its input.");
+		Theia::Int64 count = Theia::Int64(input.size());
+		Theia::Int64 block_size = Detail::ParallelBlockSize(count, pool);
+		if (count <= block_size) {
+			return Detail::ScanBlock(input.data(), output.data(), count, T(0));
+		}
+
+		std::vector<T> block_offsets(size_t((count + block_size - 1) / block_size));
+		Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			T sum = T(0);
+			for (Theia::Int64 i = begin; i < end; i++) {
+				sum += input[i];
+			}
+			block_offsets[block] = sum;
+		}, pool);
+		T total = Detail::ScanBlock(block_offsets.data(), block_offsets.data(), Theia::Int64(block_offsets.size()), T(0));
+		Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			Detail::ScanBlock(input.data() + begin, output.data() + begin, end - begin, block_offsets[block]);
+		}, pool);
+		return total;
+	}
+
+	// Writes the indices i in [0, count) for which keep(i) holds to indices, in order, and returns how many there are. indices needs room for all of them. keep is called twice for every index, once to count and once to write, so it must be cheap and give the same answer both times.
+	template <typename Index, typename Keep> Index CompactIndices(Index count, const Keep& keep, std::span<Index> indices, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		Theia::Int64 block_size = Detail::ParallelBlockSize(Theia::Int64(count), pool);
+		if (Theia::Int64(count) <= block_size) {
+			Index kept_count = 0;
+			for (Index i = 0; i < count; i++) {
+				if (keep(i)) {
+					indices[kept_count++] = i;
+				}
+			}
+			return kept_count;
+		}
+		std::vector<Index> block_offsets(size_t((Theia::Int64(count) + block_size - 1) / block_size));
+		Detail::ForEachBlock(Theia::Int64(count), block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			Index kept = 0;
+			for (Theia::Int64 i = begin; i < end; i++) {
+				kept += keep(Index(i)) ? 1 : 0;
+			}
+			block_offsets[block] = kept;
+		}, pool);
+		Index kept_count = Detail::ScanBlock(block_offsets.data(), block_offsets.data(), Theia::Int64(block_offsets.size()), Index(0));
+		assert(indices.size() >= size_t(kept_count), "CompactIndices output is too short.");
+		Detail::ForEachBlock(Theia::Int64(count), block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			Index output = block_offsets[block];
+			for (Theia::Int64 i = begin; i < end; i++) {
+				if (keep(Index(i))) {
+					indices[output++] = Index(i);
+				}
+			}
+		}, pool);
+		return kept_count;
+	}
+
+	// Writes the indices of the entries of values that equal value to indices, in order, and returns how many there are; the usual case of CompactIndices over byte flags or tags, compared 32 at a time with AVX2.
+	template <typename Index> Index CompactMatches(std::span<const Theia::UInt8> values, Theia::UInt8 value, std::span<Index> indices, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		Theia::Int64 count = Theia::Int64(values.size());
+		Theia::Int64 block_size = Detail::ParallelBlockSize(count, pool);
+		if (count <= block_size) {
+			return Index(Detail::FindMatches(values.data(), 0, count, value, indices.data()) - indices.data());
+		}
+		std::vector<Index> block_offsets(size_t((count + block_size - 1) / block_size));
+		Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			block_offsets[block] = Index(Detail::CountMatches(values.data(), begin, end, value));
+		}, pool);
+		Index kept_count = Detail::ScanBlock(block_offsets.data(), block_offsets.data(), Theia::Int64(block_offsets.size()), Index(0));
+		assert(indices.size() >= size_t(kept_count), "CompactMatches output is too short.");
+		Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			Detail::FindMatches(values.data(), begin, end, value, indices.data() + block_offsets[block]);
+		}, pool);
+		return kept_count;
+	}
+
+	// Copies the elements of input for which keep(element) holds to output, in order, and returns how many there are.
+	template <typename T, typename Keep> size_t Compact(std::span<const T> input, std::span<T> output, const Keep& keep, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		Theia::Int64 count = Theia::Int64(input.size());
+		Theia::Int64 block_size = Detail::ParallelBlockSize(count, pool);
+		if (count <= block_size) {
+			return size_t(std::copy_if(input.begin(), input.end(), output.begin(), keep) - output.begin());
+		}
+		std::vector<size_t> block_offsets(size_t((count + block_size - 1) / block_size));
+		Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			size_t kept = 0;
+			for (Theia::Int64 i = begin; i < end; i++) {
+				kept += keep(input[i]) ? 1 : 0;
+			}
+			block_offsets[block] = kept;
+		}, pool);
+		size_t kept_count = Detail::ScanBlock(block_offsets.data(), block_offsets.data(), Theia::Int64(block_offsets.size()), size_t(0));
+		assert(output.size() >= kept_count, "Compact output is too short.");
+		Detail::ForEachBlock(count, block_size, [&](Theia::Int64 block, Theia::Int64 begin, Theia::Int64 end) {
+			size_t written = block_offsets[block];
+			for (Theia::Int64 i = begin; i < end; i++) {
+				if (keep(input[i])) {
+					output[written++] = input[i];
+				}
+			}
+		}, pool);
+		return kept_count;
+	}
+
+	// Stable least significant digit radix sort of 32- or 64-bit unsigned keys, moving values along with their keys, in passes of Radix_Sort_Digit_Bits bits. Only the low key_bits bits are sorted, and a pass over a digit that every key shares is skipped, so keys that span few bits sort in few passes. Every pass swaps keys with key_scratch, which is resized as needed: callers that keep the scratch vectors between sorts reuse their memory. Returns the passes that moved keys.
+	template <typename Key, typename Value> Theia::UInt32 RadixSort(std::vector<Key>& keys, std::vector<Value>& values, std::vector<Key>& key_scratch, std::vector<Value>& value_scratch, Theia::UInt32 key_bits = sizeof(Key) * 8, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		return Detail::RadixSort<true>(keys, values, key_scratch, value_scratch, key_bits, pool);
+	}
+
+	template <typename Key> Theia::UInt32 RadixSort(std::vector<Key>& keys, std::vector<Key>& key_scratch, Theia::UInt32 key_bits = sizeof(Key) * 8, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		std::vector<Theia::UInt8> no_values;
+		return Detail::RadixSort<false>(keys, no_values, key_scratch, no_values, key_bits, pool);
+	}
+}
+#endif
\ No newline at end of file
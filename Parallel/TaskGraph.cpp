@@ -0,0 +1,80 @@
+#include "TaskGraph.h"
+#include <assert.h>
+
+namespace Theia {
+	TaskGraph::TaskGraph(Theia::UInt32 thread_count) :
+		m_own_pool(thread_count == 0 ? nullptr : std::make_unique<Theia::ThreadPool>(Theia::ThreadPoolOptions{ thread_count })),
+		m_pool(m_own_pool ? *m_own_pool : Theia::ThreadPool::Default()),
+		m_group(m_pool)
+	{
+
+	}
+
+	TaskGraph::TaskGraph(Theia::ThreadPool& pool) :
+		m_pool(pool),
+		m_group(pool)
+	{
+
+	}
+
+	TaskGraph::~TaskGraph() {
+		Wait();
+	}
+
+	Theia::TaskHandle TaskGraph::Add(std::function<void()> function, std::span<const Theia::TaskHandle> dependencies) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Theia::UInt32 index = Theia::UInt32(m_tasks.size());
+		Task& task = m_tasks.emplace_back();
+		task.m_function = std::move(function);
+		for (const Theia::TaskHandle& dependency : dependencies) {
+			assert(dependency.m_index < index, "TaskGraph::Add dependency is not an earlier task.");
+			if (!m_tasks[dependency.m_index].m_is_done) {
+				m_tasks[dependency.m_index].m_dependents.push_back(index);
+				task.m_pending_dependency_count++;
+			}
+		}
+
+		if (task.m_pending_dependency_count == 0) {
+			Schedule(index);
+		}
+		return { index };
+	}
+
+	void TaskGraph::Wait(Theia::TaskHandle task) {
+		m_pool.WaitUntil([&]() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_tasks[task.m_index].m_is_done;
+		});
+	}
+
+	void TaskGraph::Wait() {
+		m_group.Wait();
+	}
+
+	Theia::UInt32 TaskGraph::GetThreadCount() const {
+		return m_pool.GetThreadCount();
+	}
+
+	void TaskGraph::Schedule(Theia::UInt32 index) {
+		m_group.Run([this, index, function = std::move(m_tasks[index].m_function)]() {
+			function();
+			Finish(index);
+		});
+	}
+
+	void TaskGraph::Finish(Theia::UInt32 index) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			Task& task = m_tasks[index];
+			task.m_is_done = true;
+			for (Theia::UInt32 dependent : task.m_dependents) {
+				if (--m_tasks[dependent].m_pending_dependency_count == 0) {
+					Schedule(dependent);
+				}
+			}
+			task.m_dependents = std::vector<Theia::UInt32>();
+		}
+		// Wakes threads waiting on this task; the lock is released first, as their condition takes it.
+		m_pool.NotifyWaiters();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef _THEIA_PARALLEL_TASK_GRAPH_H_
+#define _THEIA_PARALLEL_TASK_GRAPH_H_
+#include "ThreadPool.h"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace Theia {
+	typedef struct TaskHandle {
+		Theia::UInt32 m_index;
+	} TaskHandle;
+
+	// Tasks that start once every task they depend on has finished. Tasks can be added at any time, also from inside a running task, so work is scheduled as soon as it is discovered rather than after all of it is known. Ready tasks run on a ThreadPool, and threads that wait run tasks of the pool instead of blocking.
+	class TaskGraph {
+	public:
+		// Runs on the default pool when thread_count is 0, otherwise on a pool of its own; thread_count counts the waiting thread, so 1 runs every task inside Wait().
+		explicit TaskGraph(Theia::UInt32 thread_count = 0);
+		explicit TaskGraph(Theia::ThreadPool& pool);
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph& operator=(const TaskGraph&) = delete;
+		// Waits for all tasks.
+		~TaskGraph();
+
+		Theia::TaskHandle Add(std::function<void()> function, std::span<const Theia::TaskHandle> dependencies = {});
+		void Wait(Theia::TaskHandle task);
+		// Waits until no task is left, including the ones added while waiting.
+		void Wait();
+
+		Theia::UInt32 GetThreadCount() const;
+	protected:
+	private:
+		typedef struct Task {
+			std::function<void()> m_function;
+			Theia::UInt32 m_pending_dependency_count = 0;
+			std::vector<Theia::UInt32> m_dependents;
+			bool m_is_done = false;
+		} Task;
+
+		// Must be called with m_mutex held.
+		void Schedule(Theia::UInt32 index);
+		void Finish(Theia::UInt32 index);
+
+		std::unique_ptr<Theia::ThreadPool> m_own_pool;
+		Theia::ThreadPool& m_pool;
+		std::mutex m_mutex;
+		// A deque, so that tasks keep their address while others are added.
+		std::deque<Task> m_tasks;
+		// Tasks whose dependencies are done are run by the group, which cannot finish while unfinished tasks remain: dependents are scheduled before the task they wait on leaves the group.
+		Theia::TaskGroup m_group;
+	};
+}
+#endif
\ No newline at end of file
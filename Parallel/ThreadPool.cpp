@@ -0,0 +1,185 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Theia {
+	namespace {
+		// Pool and queue index of the current thread, so tasks spawned by a worker go to its own deque.
+		thread_local const Theia::ThreadPool* Current_Pool = nullptr;
+		thread_local Theia::UInt32 Current_Thread_Index = 0;
+
+		constexpr Theia::UInt32 Spin_Count = 64;
+
+		void PinThread(std::thread& thread, Theia::UInt32 hardware_thread) {
+#ifdef _WIN32
+			// Without processor groups only the first 64 hardware threads can be addressed.
+			SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (hardware_thread % 64));
+#else
+			cpu_set_t cpu_set;
+			CPU_ZERO(&cpu_set);
+			CPU_SET(hardware_thread % CPU_SETSIZE, &cpu_set);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+#endif
+		}
+	}
+
+	ThreadPool::ThreadPool(const Theia::ThreadPoolOptions& options) :
+		m_thread_count(options.m_thread_count == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : options.m_thread_count)
+	{
+		for (Theia::UInt32 i = 0; i < m_thread_count; ++i) {
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+
+		Theia::UInt32 hardware_thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+		for (Theia::UInt32 i = 1; i < m_thread_count; ++i) {
+			m_workers.push_back(std::thread([this, i]() { RunWorker(i); }));
+			if (options.m_pin_threads) {
+				PinThread(m_workers.back(), i % hardware_thread_count);
+			}
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		assert(m_queued_count == 0, "ThreadPool::~ThreadPool tasks are still queued.");
+		{
+			std::lock_guard<std::mutex> lock(m_sleep_mutex);
+			m_is_stopping = true;
+		}
+		m_sleep_condition.notify_all();
+		for (std::thread& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	Theia::ThreadPool& ThreadPool::Default() {
+		static Theia::ThreadPool pool;
+		return pool;
+	}
+
+	void ThreadPool::Submit(std::function<void()> task) {
+		// Counting the task before queueing it keeps m_queued_count from dropping below the tasks in the deques. Sleepers count themselves before they check m_queued_count, and this checks for sleepers after counting the task, so one of the two always sees the other.
+		m_queued_count++;
+		Queue& queue = *m_queues[GetThreadIndex()];
+		{
+			std::lock_guard<std::mutex> lock(queue.m_mutex);
+			queue.m_tasks.push_back(std::move(task));
+		}
+		if (m_sleeping_count > 0) {
+			std::lock_guard<std::mutex> lock(m_sleep_mutex);
+			m_sleep_condition.notify_one();
+		}
+	}
+
+	void ThreadPool::WaitUntil(const std::function<bool()>& is_done) {
+		Theia::UInt32 thread_index = GetThreadIndex();
+		std::function<void()> task;
+		Theia::UInt32 idle_count = 0;
+		while (!is_done()) {
+			if (PopTask(thread_index, task)) {
+				task();
+				task = nullptr;
+				idle_count = 0;
+			}
+			else if (++idle_count < Spin_Count) {
+				std::this_thread::yield();
+			}
+			else {
+				Sleep(is_done);
+				idle_count = 0;
+			}
+		}
+	}
+
+	void ThreadPool::NotifyWaiters() {
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_sleep_condition.notify_all();
+	}
+
+	Theia::UInt32 ThreadPool::GetThreadCount() const {
+		return m_thread_count;
+	}
+
+	Theia::UInt32 ThreadPool::GetThreadIndex() const {
+		return Current_Pool == this ? Current_Thread_Index : 0;
+	}
+
+	bool ThreadPool::PopTask(Theia::UInt32 thread_index, std::function<void()>& task) {
+		if (m_queued_count == 0) {
+			return false;
+		}
+
+		// The own deque is used as a stack, the others as queues.
+		{
+			Queue& queue = *m_queues[thread_index];
+			std::lock_guard<std::mutex> lock(queue.m_mutex);
+			if (!queue.m_tasks.empty()) {
+				task = std::move(queue.m_tasks.back());
+				queue.m_tasks.pop_back();
+				m_queued_count--;
+				return true;
+			}
+		}
+
+		for (Theia::UInt32 i = 1; i < m_thread_count; ++i) {
+			Queue& queue = *m_queues[(thread_index + i) % m_thread_count];
+			std::unique_lock<std::mutex> lock(queue.m_mutex, std::try_to_lock);
+			if (lock.owns_lock() && !queue.m_tasks.empty()) {
+				task = std::move(queue.m_tasks.front());
+				queue.m_tasks.pop_front();
+				m_queued_count--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::Sleep(const std::function<bool()>& is_done) {
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		m_sleeping_count++;
+		m_sleep_condition.wait(lock, [&]() { return m_queued_count > 0 || m_is_stopping || is_done(); });
+		m_sleeping_count--;
+	}
+
+	void ThreadPool::RunWorker(Theia::UInt32 thread_index) {
+		Current_Pool = this;
+		Current_Thread_Index = thread_index;
+		WaitUntil([this]() { return m_is_stopping.load(); });
+	}
+
+	TaskGroup::TaskGroup(Theia::ThreadPool& pool) :
+		m_pool(pool)
+	{
+
+	}
+
+	TaskGroup::~TaskGroup() {
+		Wait();
+	}
+
+	void TaskGroup::Run(std::function<void()> task) {
+		m_pending_count++;
+		m_pool.Submit([this, task = std::move(task)]() {
+			task();
+			// The waiter may destroy the group as soon as the count reaches 0, so only the pool is used afterwards.
+			Theia::ThreadPool& pool = m_pool;
+			if (--m_pending_count == 0) {
+				pool.NotifyWaiters();
+			}
+		});
+	}
+
+	void TaskGroup::Wait() {
+		m_pool.WaitUntil([this]() { return m_pending_count == 0; });
+	}
+
+	Theia::ThreadPool& TaskGroup::GetPool() const {
+		return m_pool;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#ifndef _THEIA_PARALLEL_THREAD_POOL_H_
+#define _THEIA_PARALLEL_THREAD_POOL_H_
+#include "../Math/Math.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Theia {
+	typedef struct ThreadPoolOptions {
+		// Counts the thread that waits on the pool, so the pool starts thread_count - 1 workers; 0 uses one thread per hardware thread.
+		Theia::UInt32 m_thread_count = 0;
+		// Pins worker i to hardware thread i, which keeps caches warm when the pool owns the machine.
+		bool m_pin_threads = false;
+	} ThreadPoolOptions;
+
+	// Work-stealing scheduler. Every worker pushes and pops the tasks it spawns at the back of its own deque, so related work stays on one core, and idle workers steal the oldest task, usually the largest piece of a split range, from the front of another deque. Threads outside the pool push into a shared deque. Threads that wait on the pool run tasks instead of blocking, so tasks can wait on tasks they spawn.
+	class ThreadPool {
+	public:
+		explicit ThreadPool(const Theia::ThreadPoolOptions& options = Theia::ThreadPoolOptions());
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		// Tasks must be finished, that is every TaskGroup waited on.
+		~ThreadPool();
+
+		// Shared by integrators, BVH builds and loaders. Created with one thread per hardware thread on first use.
+		static Theia::ThreadPool& Default();
+
+		void Submit(std::function<void()> task);
+		// Runs tasks until is_done() is true. is_done is checked again after every task and after every NotifyWaiters(), which must not be called while holding a lock that is_done takes.
+		void WaitUntil(const std::function<bool()>& is_done);
+		// Wakes threads in WaitUntil() to check their condition.
+		void NotifyWaiters();
+
+		Theia::UInt32 GetThreadCount() const;
+		// 1 to thread_count - 1 on the workers of this pool, 0 on any other thread, so per-thread scratch can be indexed with it.
+		Theia::UInt32 GetThreadIndex() const;
+	protected:
+	private:
+		typedef struct Queue {
+			std::mutex m_mutex;
+			std::deque<std::function<void()>> m_tasks;
+		} Queue;
+
+		bool PopTask(Theia::UInt32 thread_index, std::function<void()>& task);
+		// Sleeps until a task is queued, the condition holds or the pool stops.
+		void Sleep(const std::function<bool()>& is_done);
+		void RunWorker(Theia::UInt32 thread_index);
+
+		Theia::UInt32 m_thread_count;
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::atomic<Theia::UInt64> m_queued_count = 0;
+		std::atomic<Theia::UInt32> m_sleeping_count = 0;
+		std::mutex m_sleep_mutex;
+		std::condition_variable m_sleep_condition;
+		std::atomic<bool> m_is_stopping = false;
+		std::vector<std::thread> m_workers;
+	};
+
+	// Tasks that can be waited on together. Wait() runs tasks of the pool, not only of the group, until the tasks of the group are finished.
+	class TaskGroup {
+	public:
+		explicit TaskGroup(Theia::ThreadPool& pool = Theia::ThreadPool::Default());
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+		// Waits for the tasks.
+		~TaskGroup();
+
+		void Run(std::function<void()> task);
+		void Wait();
+
+		Theia::ThreadPool& GetPool() const;
+	protected:
+	private:
+		Theia::ThreadPool& m_pool;
+		std::atomic<Theia::UInt64> m_pending_count = 0;
+	};
+
+	namespace Detail {
+		template <typename F> void ParallelForRange(Theia::TaskGroup& group, Theia::Int64 begin, Theia::Int64 end, Theia::Int64 grain_size, const F& function) {
+			// Halving, with the upper half left to thieves, spreads a range over the pool in log2(threads) steps from a single task.
+			while (end - begin > grain_size) {
+				Theia::Int64 middle = begin + (end - begin) / 2;
+				group.Run([&group, middle, end, grain_size, &function]() {
+					Detail::ParallelForRange(group, middle, end, grain_size, function);
+				});
+				end = middle;
+			}
+			for (Theia::Int64 i = begin; i < end; i++) {
+				function(i);
+			}
+		}
+	}
+
+	// Runs function(i) for every i in [begin, end). Ranges are split down to grain_size iterations; 0 picks a grain that gives each thread about 8 pieces.
+	template <typename F> void ParallelFor(Theia::Int64 begin, Theia::Int64 end, const F& function, Theia::Int64 grain_size = 0, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		if (begin >= end) {
+			return;
+		}
+		if (grain_size <= 0) {
+			grain_size = std::max<Theia::Int64>(1, (end - begin) / (8 * Theia::Int64(pool.GetThreadCount())));
+		}
+		if (end - begin <= grain_size || pool.GetThreadCount() == 1) {
+			for (Theia::Int64 i = begin; i < end; i++) {
+				function(i);
+			}
+			return;
+		}
+
+		Theia::TaskGroup group(pool);
+		Detail::ParallelForRange(group, begin, end, grain_size, function);
+		group.Wait();
+	}
+
+	// Runs function(tile) over tiles of tile_size x tile_size covering bounds; tiles at the upper edges are clipped to bounds. Tiles are handed out in scanline order, so neighbouring tiles tend to run at the same time.
+	template <typename F> void ParallelFor2D(const Theia::AABB2i& bounds, const F& function, Theia::Int32 tile_size = 16, Theia::ThreadPool& pool = Theia::ThreadPool::Default()) {
+		assert(tile_size > 0, "ParallelFor2D tile size must be positive.");
+		if (bounds.IsEmpty()) {
+			return;
+		}
+
+		Theia::Vector2i extent = bounds.Diagonal();
+		Theia::Int64 tile_count_x = (extent.m_x + tile_size - 1) / tile_size;
+		Theia::Int64 tile_count_y = (extent.m_y + tile_size - 1) / tile_size;
+		Theia::ParallelFor(0, tile_count_x * tile_count_y, [&](Theia::Int64 tile_index) {
+			Theia::Point2i min(bounds.m_min.m_x + Theia::Int32(tile_index % tile_count_x) * tile_size, bounds.m_min.m_y + Theia::Int32(tile_index / tile_count_x) * tile_size);
+			Theia::Point2i max(std::min(min.m_x + tile_size, bounds.m_max.m_x), std::min(min.m_y + tile_size, bounds.m_max.m_y));
+			function(Theia::AABB2i(min, max));
+		}, 1, pool);
+	}
+}
+#endif
\ No newline at end of file
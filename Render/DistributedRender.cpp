@@ -0,0 +1,262 @@
+#include "DistributedRender.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace Theia {
+	namespace {
+		constexpr Theia::UInt32 Protocol_Version = 1;
+		// Longest the coordinator waits for a connection before checking whether the render is done.
+		constexpr Theia::Float64 Accept_Poll_Milliseconds = 50.0;
+
+		enum class MessageType : Theia::UInt32 {
+			// Worker to coordinator, once: the render hash and the render threads of the worker.
+			Hello = 1,
+			// Coordinator to worker: a tile to render.
+			Tile = 2,
+			// Worker to coordinator: a rendered tile, followed by its pixels row by row.
+			Result = 3,
+			// Coordinator to worker: every tile is merged.
+			Done = 4
+		};
+
+		// Every message is one of these, in the byte order of the sender; a worker of another byte order fails the render hash check.
+		typedef struct TileMessage {
+			MessageType m_type = MessageType::Hello;
+			Theia::UInt32 m_tile_index = 0;
+			Theia::AABB2i m_pixel_bounds;
+			Theia::UInt64 m_render_hash = 0;
+			Theia::UInt64 m_sample_count = 0;
+			Theia::UInt32 m_thread_count = 0;
+			Theia::UInt32 m_version = Protocol_Version;
+			Theia::Float64 m_render_milliseconds = 0.0;
+		} TileMessage;
+
+		static_assert(sizeof(TileMessage) == 56, "TileMessage is not 56 bytes");
+
+		Theia::Float64 MillisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<Theia::Float64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	TileCoordinator::TileCoordinator(Theia::Film& film, Theia::UInt64 render_hash, const Theia::TileCoordinatorOptions& options) :
+		m_film(film),
+		m_render_hash(render_hash),
+		m_options(options),
+		m_listener(options.m_address, options.m_port)
+	{
+		assert(m_options.m_tile_size > 0, "TileCoordinator::TileCoordinator tile size is not positive.");
+	}
+
+	Theia::UInt16 TileCoordinator::GetPort() const {
+		return m_listener.GetPort();
+	}
+
+	bool TileCoordinator::Render(Theia::UInt32 worker_count) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const Theia::AABB2i& bounds = m_film.GetPixelBounds();
+		m_tiles.clear();
+		m_queued_tiles.clear();
+		for (Theia::Int32 y = bounds.m_min.m_y; y < bounds.m_max.m_y; y += m_options.m_tile_size) {
+			for (Theia::Int32 x = bounds.m_min.m_x; x < bounds.m_max.m_x; x += m_options.m_tile_size) {
+				m_queued_tiles.push_back(Theia::UInt32(m_tiles.size()));
+				m_tiles.push_back(Theia::AABB2i(Theia::Point2i(x, y), Theia::Point2i(std::min(x + m_options.m_tile_size, bounds.m_max.m_x), std::min(y + m_options.m_tile_size, bounds.m_max.m_y))));
+			}
+		}
+		m_merged_tile_count = 0;
+		m_statistics = Theia::DistributedRenderStatistics();
+
+		// Workers are served as they connect; the last ones need not connect at all once the others have rendered every tile.
+		std::vector<std::thread> servers;
+		auto is_done = [&]() {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_merged_tile_count == m_tiles.size();
+		};
+		while (servers.size() < worker_count && !is_done() && MillisecondsSince(start) < m_options.m_connect_timeout_milliseconds) {
+			Theia::Socket socket = m_listener.Accept(Accept_Poll_Milliseconds);
+			if (socket.IsOpen()) {
+				servers.push_back(std::thread(&TileCoordinator::ServeWorker, this, std::move(socket)));
+			}
+		}
+		// Workers that connected as the last tiles were merged are told the render is done.
+		while (servers.size() < worker_count) {
+			Theia::Socket socket = m_listener.Accept(0.0);
+			if (!socket.IsOpen()) {
+				break;
+			}
+			servers.push_back(std::thread(&TileCoordinator::ServeWorker, this, std::move(socket)));
+		}
+		for (std::thread& server : servers) {
+			server.join();
+		}
+
+		m_statistics.m_render_milliseconds = MillisecondsSince(start);
+		if (m_statistics.m_thread_count > 0 && m_statistics.m_render_milliseconds > 0.0) {
+			m_statistics.m_efficiency = m_statistics.m_worker_milliseconds / (Theia::Float64(m_statistics.m_thread_count) * m_statistics.m_render_milliseconds);
+		}
+		return m_merged_tile_count == m_tiles.size();
+	}
+
+	const Theia::DistributedRenderStatistics& TileCoordinator::GetStatistics() const {
+		return m_statistics;
+	}
+
+	void TileCoordinator::ServeWorker(Theia::Socket socket) {
+		// A worker that hangs would otherwise keep its tiles, and Render waiting, forever.
+		socket.SetReceiveTimeout(m_options.m_receive_timeout_milliseconds);
+		TileMessage hello;
+		if (!socket.Receive(&hello, sizeof(hello)) || hello.m_type != MessageType::Hello || hello.m_version != Protocol_Version || hello.m_render_hash != m_render_hash || hello.m_thread_count == 0) {
+			// A worker of another render learns so from the closed connection.
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_statistics.m_worker_count++;
+			m_statistics.m_thread_count += hello.m_thread_count;
+		}
+
+		Theia::UInt32 tile_limit = std::max(1u, hello.m_thread_count * m_options.m_tiles_per_thread);
+		std::vector<Theia::UInt32> held_tiles;
+		Theia::FilmTile film_tile;
+		bool is_connected = true;
+		while (is_connected) {
+			Theia::UInt32 tile = 0;
+			while (is_connected && held_tiles.size() < tile_limit && TakeTile(tile, held_tiles.empty())) {
+				TileMessage message;
+				message.m_type = MessageType::Tile;
+				message.m_tile_index = tile;
+				message.m_pixel_bounds = m_tiles[tile];
+				held_tiles.push_back(tile);
+				is_connected = socket.Send(&message, sizeof(message));
+			}
+			if (!is_connected || held_tiles.empty()) {
+				break;
+			}
+
+			TileMessage result;
+			std::vector<Theia::UInt32>::iterator held_tile = held_tiles.end();
+			if (socket.Receive(&result, sizeof(result)) && result.m_type == MessageType::Result) {
+				held_tile = std::find(held_tiles.begin(), held_tiles.end(), result.m_tile_index);
+			}
+			if (held_tile == held_tiles.end()) {
+				is_connected = false;
+				break;
+			}
+			film_tile.Reset(m_tiles[result.m_tile_index]);
+			std::span<Theia::FilmPixel> pixels = film_tile.GetPixels();
+			if (!socket.Receive(pixels.data(), pixels.size_bytes())) {
+				is_connected = false;
+				break;
+			}
+			// Tiles do not overlap, so servers merge without holding the lock.
+			m_film.MergeTile(film_tile);
+			held_tiles.erase(held_tile);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_merged_tile_count++;
+			m_statistics.m_tile_count++;
+			m_statistics.m_sample_count += result.m_sample_count;
+			m_statistics.m_received_bytes += sizeof(result) + pixels.size_bytes();
+			m_statistics.m_worker_milliseconds += result.m_render_milliseconds;
+			if (m_merged_tile_count == m_tiles.size()) {
+				m_condition.notify_all();
+			}
+		}
+
+		if (is_connected) {
+			TileMessage done;
+			done.m_type = MessageType::Done;
+			socket.Send(&done, sizeof(done));
+			return;
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Theia::UInt32 tile : held_tiles) {
+			m_queued_tiles.push_back(tile);
+		}
+		m_statistics.m_reissued_tile_count += Theia::UInt32(held_tiles.size());
+		m_condition.notify_all();
+	}
+
+	bool TileCoordinator::TakeTile(Theia::UInt32& tile, bool wait) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (wait) {
+			m_condition.wait(lock, [this]() { return !m_queued_tiles.empty() || m_merged_tile_count == m_tiles.size(); });
+		}
+		if (m_queued_tiles.empty()) {
+			return false;
+		}
+		tile = m_queued_tiles.front();
+		m_queued_tiles.pop_front();
+		return true;
+	}
+
+	TileWorker::TileWorker(const Theia::ImageTileIntegrator& integrator, Theia::ThreadPool& pool) :
+		m_integrator(integrator),
+		m_pool(pool)
+	{
+
+	}
+
+	bool TileWorker::Run(const std::string& host, Theia::UInt16 port) {
+		Theia::Socket socket = Theia::Socket::Connect(host, port);
+		TileMessage hello;
+		hello.m_render_hash = m_integrator.GetRenderHash();
+		hello.m_thread_count = m_pool.GetThreadCount();
+		if (!socket.Send(&hello, sizeof(hello))) {
+			return false;
+		}
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<TileMessage> tiles;
+		bool is_closed = false;
+		bool is_done = false;
+		// Receives on a thread of its own, so the next tiles arrive while the pool renders.
+		std::thread receiver([&]() {
+			TileMessage message;
+			bool is_received = false;
+			while ((is_received = socket.Receive(&message, sizeof(message))) && message.m_type == MessageType::Tile) {
+				std::lock_guard<std::mutex> lock(mutex);
+				tiles.push_back(message);
+				condition.notify_one();
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			is_done = is_received && message.m_type == MessageType::Done;
+			is_closed = true;
+			condition.notify_all();
+		});
+
+		std::mutex send_mutex;
+		Theia::ParallelFor(0, m_pool.GetThreadCount(), [&](Theia::Int64) {
+			Theia::FilmTile film_tile;
+			for (;;) {
+				TileMessage message;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [&]() { return !tiles.empty() || is_closed; });
+					// Results can no longer be sent once the connection is lost.
+					if (tiles.empty() || (is_closed && !is_done)) {
+						return;
+					}
+					message = tiles.front();
+					tiles.pop_front();
+				}
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				film_tile.Reset(message.m_pixel_bounds);
+				message.m_type = MessageType::Result;
+				message.m_sample_count = m_integrator.RenderTile(film_tile);
+				message.m_render_milliseconds = MillisecondsSince(start);
+
+				std::span<const Theia::FilmPixel> pixels = film_tile.GetPixels();
+				std::lock_guard<std::mutex> send_lock(send_mutex);
+				if (!socket.Send(&message, sizeof(message)) || !socket.Send(pixels.data(), pixels.size_bytes())) {
+					// Wakes the receiver, which then stops the other threads.
+					socket.Shutdown();
+				}
+			}
+		}, 1, m_pool);
+		receiver.join();
+		return is_done;
+	}
+}
\ No newline at end of file
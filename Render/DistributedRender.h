@@ -0,0 +1,87 @@
+#ifndef _THEIA_RENDER_DISTRIBUTED_RENDER_H_
+#define _THEIA_RENDER_DISTRIBUTED_RENDER_H_
+#include "Film.h"
+#include "ImageTileIntegrator.h"
+#include "../IO/Socket.h"
+#include "../Parallel/ThreadPool.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Theia {
+	typedef struct TileCoordinatorOptions {
+		// IPv4 address and port workers connect to. Port 0 takes a free port, which TileCoordinator::GetPort returns.
+		std::string m_address = "127.0.0.1";
+		Theia::UInt16 m_port = 0;
+		Theia::Int32 m_tile_size = 32;
+		// Tiles a worker holds per render thread, so its threads keep rendering while results and new tiles cross the connection.
+		Theia::UInt32 m_tiles_per_thread = 2;
+		// Time Render waits for workers to connect.
+		Theia::Float64 m_connect_timeout_milliseconds = 10000.0;
+		// Time a worker may go without sending its hello or its next result before it is dropped and its tiles are handed to the others; 0 waits forever.
+		Theia::Float64 m_receive_timeout_milliseconds = 60000.0;
+	} TileCoordinatorOptions;
+
+	typedef struct DistributedRenderStatistics {
+		Theia::Float64 m_render_milliseconds = 0.0;
+		// Workers that connected with the render hash of the coordinator, and their render threads.
+		Theia::UInt32 m_worker_count = 0;
+		Theia::UInt32 m_thread_count = 0;
+		Theia::UInt32 m_tile_count = 0;
+		// Tiles handed out again after the worker rendering them went away.
+		Theia::UInt32 m_reissued_tile_count = 0;
+		Theia::UInt64 m_sample_count = 0;
+		Theia::UInt64 m_received_bytes = 0;
+		// Time the render threads of the workers spent rendering the merged tiles.
+		Theia::Float64 m_worker_milliseconds = 0.0;
+		// m_worker_milliseconds over m_thread_count times m_render_milliseconds: the share of the render the worker threads spent rendering.
+		Theia::Float64 m_efficiency = 0.0;
+	} DistributedRenderStatistics;
+
+	// Renders a film with worker processes that connect over TCP with TileWorker. It hands out tiles, a few per worker thread, merges the results and gives tiles lost with a worker to the others.
+	// Workers must render with an integrator of the same render hash; the film then ends as ImageTileIntegrator::Integrate would leave an empty film.
+	class TileCoordinator {
+	public:
+		TileCoordinator(Theia::Film& film, Theia::UInt64 render_hash, const Theia::TileCoordinatorOptions& options = Theia::TileCoordinatorOptions());
+
+		// 0 when the address could not be bound.
+		Theia::UInt16 GetPort() const;
+		// Renders the film with up to worker_count workers, each served from the moment it connects. True once every tile is merged; false when no worker connected within the timeout or every worker that did went away first.
+		bool Render(Theia::UInt32 worker_count);
+
+		const Theia::DistributedRenderStatistics& GetStatistics() const;
+	protected:
+	private:
+		// Hands tiles to one worker and merges its results until every tile is merged or the worker goes away.
+		void ServeWorker(Theia::Socket socket);
+		// Next tile to hand out. With wait set, waits for one to be queued again while other workers still hold tiles. False once none are left.
+		bool TakeTile(Theia::UInt32& tile, bool wait);
+
+		Theia::Film& m_film;
+		Theia::UInt64 m_render_hash;
+		Theia::TileCoordinatorOptions m_options;
+		Theia::SocketListener m_listener;
+		std::vector<Theia::AABB2i> m_tiles;
+		std::deque<Theia::UInt32> m_queued_tiles;
+		Theia::UInt32 m_merged_tile_count = 0;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		Theia::DistributedRenderStatistics m_statistics;
+	};
+
+	// Renders the tiles a TileCoordinator hands out, one per thread of the pool at a time, and sends them back.
+	class TileWorker {
+	public:
+		TileWorker(const Theia::ImageTileIntegrator& integrator, Theia::ThreadPool& pool = Theia::ThreadPool::Default());
+
+		// Renders tiles until the coordinator has none left. False when the coordinator cannot be reached, rejects the render hash or goes away first.
+		bool Run(const std::string& host, Theia::UInt16 port);
+	protected:
+	private:
+		const Theia::ImageTileIntegrator& m_integrator;
+		Theia::ThreadPool& m_pool;
+	};
+}
+#endif
\ No newline at end of file
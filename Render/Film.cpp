@@ -0,0 +1,163 @@
+#include "Film.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Theia {
+	namespace {
+		size_t PixelOffset(const Theia::AABB2i& pixel_bounds, const Theia::Point2i& pixel) {
+			assert(pixel.m_x >= pixel_bounds.m_min.m_x && pixel.m_x < pixel_bounds.m_max.m_x && pixel.m_y >= pixel_bounds.m_min.m_y && pixel.m_y < pixel_bounds.m_max.m_y, "Film pixel is outside the pixel bounds.");
+			Theia::Int32 width = pixel_bounds.m_max.m_x - pixel_bounds.m_min.m_x;
+			return size_t(pixel.m_y - pixel_bounds.m_min.m_y) * size_t(width) + size_t(pixel.m_x - pixel_bounds.m_min.m_x);
+		}
+
+		// Rec. 709 luminance.
+		Theia::Float64 Luminance(const Theia::Vector3f& rgb) {
+			return 0.2126 * rgb.m_x + 0.7152 * rgb.m_y + 0.0722 * rgb.m_z;
+		}
+
+		void AddToPixel(Theia::FilmPixel& film_pixel, const Theia::Vector3f& rgb, Theia::Float weight) {
+			film_pixel.m_rgb_sum[0] += Theia::Float64(weight) * rgb.m_x;
+			film_pixel.m_rgb_sum[1] += Theia::Float64(weight) * rgb.m_y;
+			film_pixel.m_rgb_sum[2] += Theia::Float64(weight) * rgb.m_z;
+			film_pixel.m_weight_sum += weight;
+
+			Theia::Float64 luminance = Luminance(rgb);
+			film_pixel.m_sample_count++;
+			Theia::Float64 delta = luminance - film_pixel.m_luminance_mean;
+			film_pixel.m_luminance_mean += delta / Theia::Float64(film_pixel.m_sample_count);
+			film_pixel.m_luminance_m2 += delta * (luminance - film_pixel.m_luminance_mean);
+		}
+
+		// Adds the samples of source to film_pixel. Luminance statistics are combined as in Chan et al., which gives what adding every sample one at a time would, up to rounding.
+		void MergePixel(Theia::FilmPixel& film_pixel, const Theia::FilmPixel& source) {
+			if (source.m_sample_count == 0) {
+				return;
+			}
+			// Copied rather than merged, since delta * n / n need not give back the mean exactly.
+			if (film_pixel.m_sample_count == 0) {
+				film_pixel = source;
+				return;
+			}
+			for (Theia::UInt32 i = 0; i < 3; i++) {
+				film_pixel.m_rgb_sum[i] += source.m_rgb_sum[i];
+			}
+			film_pixel.m_weight_sum += source.m_weight_sum;
+
+			Theia::Float64 count = Theia::Float64(film_pixel.m_sample_count);
+			Theia::Float64 source_count = Theia::Float64(source.m_sample_count);
+			Theia::Float64 total_count = count + source_count;
+			Theia::Float64 delta = source.m_luminance_mean - film_pixel.m_luminance_mean;
+			film_pixel.m_luminance_mean += delta * source_count / total_count;
+			film_pixel.m_luminance_m2 += source.m_luminance_m2 + delta * delta * count * source_count / total_count;
+			film_pixel.m_sample_count += source.m_sample_count;
+		}
+	}
+
+	FilmTile::FilmTile(const Theia::AABB2i& pixel_bounds) {
+		Reset(pixel_bounds);
+	}
+
+	void FilmTile::Reset(const Theia::AABB2i& pixel_bounds) {
+		m_pixel_bounds = pixel_bounds;
+		m_pixels.assign(pixel_bounds.IsEmpty() ? 0 : size_t(pixel_bounds.Area()), Theia::FilmPixel());
+	}
+
+	void FilmTile::Reset(const Theia::AABB2i& pixel_bounds, const Theia::Film& film) {
+		m_pixel_bounds = pixel_bounds;
+		m_pixels.resize(pixel_bounds.IsEmpty() ? 0 : size_t(pixel_bounds.Area()));
+		for (Theia::Int32 y = pixel_bounds.m_min.m_y; y < pixel_bounds.m_max.m_y; y++) {
+			for (Theia::Int32 x = pixel_bounds.m_min.m_x; x < pixel_bounds.m_max.m_x; x++) {
+				m_pixels[PixelOffset(m_pixel_bounds, Theia::Point2i(x, y))] = film.GetPixel(Theia::Point2i(x, y));
+			}
+		}
+	}
+
+	void FilmTile::AddSample(const Theia::Point2i& pixel, const Theia::Vector3f& rgb, Theia::Float weight) {
+		AddToPixel(m_pixels[PixelOffset(m_pixel_bounds, pixel)], rgb, weight);
+	}
+
+	const Theia::AABB2i& FilmTile::GetPixelBounds() const {
+		return m_pixel_bounds;
+	}
+
+	const Theia::FilmPixel& FilmTile::GetPixel(const Theia::Point2i& pixel) const {
+		return m_pixels[PixelOffset(m_pixel_bounds, pixel)];
+	}
+
+	std::span<const Theia::FilmPixel> FilmTile::GetPixels() const {
+		return m_pixels;
+	}
+
+	std::span<Theia::FilmPixel> FilmTile::GetPixels() {
+		return m_pixels;
+	}
+
+	Film::Film(const Theia::Point2i& resolution) :
+		m_pixel_bounds(Theia::Point2i(0, 0), resolution),
+		m_pixels(size_t(resolution.m_x) * size_t(resolution.m_y))
+	{
+
+	}
+
+	void Film::MergeTile(const Theia::FilmTile& tile) {
+		const Theia::AABB2i& tile_bounds = tile.GetPixelBounds();
+		for (Theia::Int32 y = tile_bounds.m_min.m_y; y < tile_bounds.m_max.m_y; y++) {
+			for (Theia::Int32 x = tile_bounds.m_min.m_x; x < tile_bounds.m_max.m_x; x++) {
+				MergePixel(m_pixels[PixelOffset(m_pixel_bounds, Theia::Point2i(x, y))], tile.GetPixel(Theia::Point2i(x, y)));
+			}
+		}
+	}
+
+	void Film::StoreTile(const Theia::FilmTile& tile) {
+		const Theia::AABB2i& tile_bounds = tile.GetPixelBounds();
+		for (Theia::Int32 y = tile_bounds.m_min.m_y; y < tile_bounds.m_max.m_y; y++) {
+			for (Theia::Int32 x = tile_bounds.m_min.m_x; x < tile_bounds.m_max.m_x; x++) {
+				m_pixels[PixelOffset(m_pixel_bounds, Theia::Point2i(x, y))] = tile.GetPixel(Theia::Point2i(x, y));
+			}
+		}
+	}
+
+	void Film::AddSample(const Theia::Point2i& pixel, const Theia::Vector3f& rgb, Theia::Float weight) {
+		AddToPixel(m_pixels[PixelOffset(m_pixel_bounds, pixel)], rgb, weight);
+	}
+
+	void Film::Clear() {
+		m_pixels.assign(m_pixels.size(), Theia::FilmPixel());
+	}
+
+	const Theia::AABB2i& Film::GetPixelBounds() const {
+		return m_pixel_bounds;
+	}
+
+	const Theia::FilmPixel& Film::GetPixel(const Theia::Point2i& pixel) const {
+		return m_pixels[PixelOffset(m_pixel_bounds, pixel)];
+	}
+
+	std::span<const Theia::FilmPixel> Film::GetPixels() const {
+		return m_pixels;
+	}
+
+	void Film::SetPixels(std::span<const Theia::FilmPixel> pixels) {
+		assert(pixels.size() == m_pixels.size(), "Film::SetPixels pixel count does not match the film.");
+		std::copy(pixels.begin(), pixels.end(), m_pixels.begin());
+	}
+
+	Theia::Vector3f Film::GetPixelRGB(const Theia::Point2i& pixel) const {
+		const Theia::FilmPixel& film_pixel = GetPixel(pixel);
+		if (film_pixel.m_weight_sum == 0.0) {
+			return Theia::Vector3f(0.0f, 0.0f, 0.0f);
+		}
+		return Theia::Vector3f(Theia::Float(film_pixel.m_rgb_sum[0] / film_pixel.m_weight_sum), Theia::Float(film_pixel.m_rgb_sum[1] / film_pixel.m_weight_sum), Theia::Float(film_pixel.m_rgb_sum[2] / film_pixel.m_weight_sum));
+	}
+
+	Theia::Float64 Film::GetRelativeStandardError(const Theia::Point2i& pixel, Theia::Float64 min_luminance) const {
+		const Theia::FilmPixel& film_pixel = GetPixel(pixel);
+		if (film_pixel.m_sample_count < 2) {
+			return std::numeric_limits<Theia::Float64>::infinity();
+		}
+		Theia::Float64 count = Theia::Float64(film_pixel.m_sample_count);
+		Theia::Float64 standard_error = std::sqrt(std::max(film_pixel.m_luminance_m2, 0.0) / ((count - 1.0) * count));
+		return standard_error / std::max(film_pixel.m_luminance_mean, min_luminance);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef _THEIA_RENDER_FILM_H_
+#define _THEIA_RENDER_FILM_H_
+#include "../Math/Math.h"
+#include <array>
+#include <span>
+#include <vector>
+
+namespace Theia {
+	// Sums of box-filtered samples. Sums are kept in double precision, so pixels with many samples do not lose the last ones to rounding.
+	typedef struct FilmPixel {
+		std::array<Theia::Float64, 3> m_rgb_sum = {};
+		Theia::Float64 m_weight_sum = 0.0;
+		// Running mean and sum of squared deviations of the luminance of the samples, kept with Welford's algorithm, which tell how noisy the pixel still is.
+		Theia::UInt64 m_sample_count = 0;
+		Theia::Float64 m_luminance_mean = 0.0;
+		Theia::Float64 m_luminance_m2 = 0.0;
+	} FilmPixel;
+
+	class Film;
+
+	// Pixels of one tile, owned by the thread rendering it, so samples are added without synchronization.
+	class FilmTile {
+	public:
+		FilmTile() = default;
+		explicit FilmTile(const Theia::AABB2i& pixel_bounds);
+
+		// Clears the tile and moves it to pixel_bounds, keeping its memory.
+		void Reset(const Theia::AABB2i& pixel_bounds);
+		// Moves the tile to pixel_bounds and starts its pixels from those of film, for Film::StoreTile to put back.
+		void Reset(const Theia::AABB2i& pixel_bounds, const Theia::Film& film);
+		// rgb is the RGB radiance of a sample in the pixel, weight its filter weight.
+		void AddSample(const Theia::Point2i& pixel, const Theia::Vector3f& rgb, Theia::Float weight);
+
+		const Theia::AABB2i& GetPixelBounds() const;
+		const Theia::FilmPixel& GetPixel(const Theia::Point2i& pixel) const;
+		// Every pixel, row by row, for sending the tile to another process.
+		std::span<const Theia::FilmPixel> GetPixels() const;
+		std::span<Theia::FilmPixel> GetPixels();
+	protected:
+	private:
+		Theia::AABB2i m_pixel_bounds;
+		std::vector<Theia::FilmPixel> m_pixels;
+	};
+
+	class Film {
+	public:
+		explicit Film(const Theia::Point2i& resolution);
+
+		// Adds the sums of the tile to the film. Tiles that do not overlap can be merged concurrently.
+		void MergeTile(const Theia::FilmTile& tile);
+		// Replaces the pixels under the tile with its pixels, which must have started from them with FilmTile::Reset(pixel_bounds, film). Tiles that do not overlap can be stored concurrently.
+		void StoreTile(const Theia::FilmTile& tile);
+		// Adds one sample to the pixel. Like MergeTile this takes no locks, so concurrent callers must add to different pixels.
+		void AddSample(const Theia::Point2i& pixel, const Theia::Vector3f& rgb, Theia::Float weight);
+		void Clear();
+
+		const Theia::AABB2i& GetPixelBounds() const;
+		const Theia::FilmPixel& GetPixel(const Theia::Point2i& pixel) const;
+		// Every pixel, row by row, for saving and restoring the film.
+		std::span<const Theia::FilmPixel> GetPixels() const;
+		void SetPixels(std::span<const Theia::FilmPixel> pixels);
+		// Weighted mean of the samples of the pixel, black without samples.
+		Theia::Vector3f GetPixelRGB(const Theia::Point2i& pixel) const;
+		// Standard error of the mean luminance of the pixel, relative to that mean. Means below min_luminance count as min_luminance, so noise too dark to see does not keep a pixel from converging. Infinite with fewer than 2 samples.
+		Theia::Float64 GetRelativeStandardError(const Theia::Point2i& pixel, Theia::Float64 min_luminance) const;
+	protected:
+	private:
+		Theia::AABB2i m_pixel_bounds;
+		std::vector<Theia::FilmPixel> m_pixels;
+	};
+}
+#endif
\ No newline at end of file
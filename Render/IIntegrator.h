@@ -4,7 +4,7 @@
 namespace Theia {
 	class IIntegrator {
 	public:
-		virtual ~IIntegrator();
+		virtual ~IIntegrator() = default;
 		virtual void Integrate() = 0;
 	protected:
 	private:
@@ -0,0 +1,395 @@
+#include "ImageTileIntegrator.h"
+#include "../Math/Hash.h"
+#include "../Parallel/Algorithms.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+namespace Theia {
+	namespace {
+		constexpr Theia::Int32 Initial_Tile_Size = 16;
+		constexpr Theia::Int32 Min_Tile_Size = 4;
+		constexpr Theia::Int32 Max_Tile_Size = 128;
+		// Tiles per thread the remaining image is still split into, so no thread is left with a large tile at the end.
+		constexpr Theia::Int64 Tail_Tiles_Per_Thread = 4;
+		// Side of the tiles of sample passes when the tile size adapts. Small tiles skip more of the converged image and bound how far a pass overruns a deadline.
+		constexpr Theia::Int32 Pass_Tile_Size = 16;
+		// Part of the remaining budget a progressive pass is planned to fill, leaving room for a pass slower than the one before it.
+		constexpr Theia::Float64 Pass_Budget_Fraction = 0.9;
+
+		Theia::Float64 MillisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<Theia::Float64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// Step through [0, count) that visits every entry once and spreads consecutive ones across the range, so a pass cut short leaves its missing tiles scattered over the image rather than in a band at the bottom.
+		Theia::UInt32 ScrambleStride(Theia::UInt32 count) {
+			Theia::UInt32 stride = std::max(1u, Theia::UInt32(Theia::Float64(count) * 0.618));
+			while (std::gcd(stride, count) > 1) {
+				stride--;
+			}
+			return stride;
+		}
+
+		// Hands out tiles in bands from the top of the image. Every band is one tile high, and its tile size is chosen when the band starts; the last band is clipped to the image.
+		class TileCursor {
+		public:
+			TileCursor(const Theia::AABB2i& bounds, const Theia::ImageTileIntegratorOptions& options, Theia::UInt32 thread_count) :
+				m_bounds(bounds),
+				m_options(options),
+				m_thread_count(thread_count),
+				m_x(bounds.m_max.m_x),
+				m_y(bounds.m_min.m_y)
+			{
+
+			}
+
+			// False once the image is handed out.
+			bool Next(Theia::AABB2i& tile) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_x >= m_bounds.m_max.m_x) {
+					m_y += m_tile_size;
+					m_tile_size = 0;
+					if (m_y >= m_bounds.m_max.m_y) {
+						return false;
+					}
+					m_x = m_bounds.m_min.m_x;
+					m_tile_size = TileSize();
+				}
+
+				tile = Theia::AABB2i(Theia::Point2i(m_x, m_y), Theia::Point2i(std::min(m_x + m_tile_size, m_bounds.m_max.m_x), std::min(m_y + m_tile_size, m_bounds.m_max.m_y)));
+				m_x += m_tile_size;
+				return true;
+			}
+
+			void Record(const Theia::AABB2i& tile, Theia::Float64 milliseconds) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_measured_pixels += Theia::Float64(tile.Area());
+				m_measured_milliseconds += milliseconds;
+				Theia::Int32 tile_size = std::max(tile.Diagonal().m_x, tile.Diagonal().m_y);
+				m_statistics.m_min_tile_size = m_statistics.m_tile_count == 0 ? tile_size : std::min(m_statistics.m_min_tile_size, tile_size);
+				m_statistics.m_max_tile_size = std::max(m_statistics.m_max_tile_size, tile_size);
+				m_statistics.m_tile_count++;
+			}
+
+			// Tile counts and sizes of the recorded tiles.
+			const Theia::ImageTileStatistics& GetStatistics() const {
+				return m_statistics;
+			}
+		protected:
+		private:
+			Theia::Int32 TileSize() const {
+				if (m_options.m_tile_size > 0) {
+					return m_options.m_tile_size;
+				}
+
+				Theia::Float64 tile_size = Initial_Tile_Size;
+				if (m_measured_milliseconds > 0.0) {
+					tile_size = std::sqrt(m_options.m_target_tile_milliseconds * m_measured_pixels / m_measured_milliseconds);
+				}
+				Theia::Float64 remaining_pixels = Theia::Float64(m_bounds.m_max.m_y - m_y) * Theia::Float64(m_bounds.m_max.m_x - m_bounds.m_min.m_x);
+				tile_size = std::min(tile_size, std::sqrt(remaining_pixels / Theia::Float64(Tail_Tiles_Per_Thread * m_thread_count)));
+				return std::clamp(Theia::Int32(tile_size), Min_Tile_Size, Max_Tile_Size);
+			}
+
+			const Theia::AABB2i& m_bounds;
+			const Theia::ImageTileIntegratorOptions& m_options;
+			Theia::UInt32 m_thread_count;
+			std::mutex m_mutex;
+			Theia::Int32 m_x;
+			Theia::Int32 m_y;
+			Theia::Int32 m_tile_size = 0;
+			Theia::Float64 m_measured_pixels = 0.0;
+			Theia::Float64 m_measured_milliseconds = 0.0;
+			Theia::ImageTileStatistics m_statistics;
+		};
+	}
+
+	Theia::CameraSample GetCameraSample(const Theia::Point2i& pixel, Theia::UInt32 sample_index, Theia::UInt64 seed, Theia::RandomNumberGenerator& rng) {
+		Theia::Int32 coordinates[2] = { pixel.m_x, pixel.m_y };
+		rng.SetSequence(Theia::HashBuffer(coordinates, sizeof(coordinates), seed));
+		// Every sample gets its own stretch of the sequence, far longer than a path uses.
+		rng.Advance(Theia::UInt64(sample_index) * Theia::Sample_Dimension_Count);
+
+		Theia::CameraSample sample;
+		sample.Film_Point = Theia::Point2f(Theia::Float(pixel.m_x) + rng.Uniform<Theia::Float>(), Theia::Float(pixel.m_y) + rng.Uniform<Theia::Float>());
+		sample.Point_Lens = Theia::Point2f(rng.Uniform<Theia::Float>(), rng.Uniform<Theia::Float>());
+		sample.Time = rng.Uniform<Theia::Float>();
+		sample.Filter_Weight = 1.0f;
+		return sample;
+	}
+
+	ImageTileIntegrator::ImageTileIntegrator(const Theia::ICamera& camera, Theia::Film& film, const Theia::ImageTileIntegratorOptions& options, Theia::ThreadPool& pool) :
+		m_camera(camera),
+		m_film(film),
+		m_options(options),
+		m_pool(pool)
+	{
+
+	}
+
+	void ImageTileIntegrator::Integrate() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Theia::UInt32 thread_count = m_pool.GetThreadCount();
+		const Theia::AABB2i& bounds = m_film.GetPixelBounds();
+		bool is_progressive = m_options.m_time_budget_milliseconds > 0.0;
+		m_statistics = Theia::ImageTileStatistics();
+		if (!m_options.m_checkpoint_path.empty()) {
+			m_checkpoint_writer = std::make_unique<Theia::CheckpointWriter>(m_options.m_checkpoint_path, GetRenderHash());
+			m_last_checkpoint = start;
+		}
+
+		if (!is_progressive) {
+			TileCursor cursor(bounds, m_options, thread_count);
+			std::atomic<Theia::UInt64> sample_count = 0;
+
+			// One loop per thread, each with its own tile, claims tiles until the image is done.
+			Theia::ParallelFor(0, thread_count, [&](Theia::Int64) {
+				Theia::FilmTile film_tile;
+				Theia::AABB2i tile;
+				while (!m_is_cancelled && cursor.Next(tile)) {
+					std::chrono::steady_clock::time_point tile_start = std::chrono::steady_clock::now();
+					film_tile.Reset(tile, m_film);
+					sample_count += RenderTile(film_tile);
+					StoreTile(film_tile);
+					cursor.Record(tile, MillisecondsSince(tile_start));
+				}
+			}, 1, m_pool);
+
+			Theia::ImageTileStatistics cursor_statistics = cursor.GetStatistics();
+			m_statistics.m_tile_count = cursor_statistics.m_tile_count;
+			m_statistics.m_min_tile_size = cursor_statistics.m_min_tile_size;
+			m_statistics.m_max_tile_size = cursor_statistics.m_max_tile_size;
+			m_statistics.m_sample_count = sample_count;
+		}
+		m_statistics.m_thread_count = thread_count;
+		if ((is_progressive || m_options.m_error_threshold > 0.0) && !m_is_cancelled) {
+			m_statistics.m_sample_count += RenderPasses(start);
+		}
+
+		if (m_checkpoint_writer) {
+			m_checkpoint_writer->Wait();
+			m_checkpoint_writer->Start(m_film);
+			m_checkpoint_writer->Wait();
+			m_statistics.m_checkpoint_count = m_checkpoint_writer->GetWriteCount();
+			m_checkpoint_writer.reset();
+		}
+		m_statistics.m_is_cancelled = m_is_cancelled.exchange(false);
+		m_statistics.m_render_milliseconds = MillisecondsSince(start);
+	}
+
+	bool ImageTileIntegrator::Resume() {
+		if (m_options.m_checkpoint_path.empty() || !Theia::RenderCheckpoint::Read(m_options.m_checkpoint_path, GetRenderHash(), m_film)) {
+			return false;
+		}
+		m_is_resuming = true;
+		Integrate();
+		m_is_resuming = false;
+		return true;
+	}
+
+	void ImageTileIntegrator::Cancel() {
+		m_is_cancelled = true;
+	}
+
+	const Theia::ImageTileStatistics& ImageTileIntegrator::GetStatistics() const {
+		return m_statistics;
+	}
+
+	Theia::UInt64 ImageTileIntegrator::RenderTile(Theia::FilmTile& film_tile) const {
+		const Theia::AABB2i& tile = film_tile.GetPixelBounds();
+		Theia::RandomNumberGenerator rng;
+		Theia::UInt64 sample_count = 0;
+		for (Theia::Int32 y = tile.m_min.m_y; y < tile.m_max.m_y; y++) {
+			for (Theia::Int32 x = tile.m_min.m_x; x < tile.m_max.m_x; x++) {
+				Theia::Point2i pixel(x, y);
+				Theia::UInt32 pixel_sample_count = m_options.m_samples_per_pixel;
+				if (m_is_resuming) {
+					pixel_sample_count -= Theia::UInt32(std::min<Theia::UInt64>(m_film.GetPixel(pixel).m_sample_count, pixel_sample_count));
+				}
+				RenderPixel(pixel, pixel_sample_count, film_tile, rng);
+				sample_count += pixel_sample_count;
+			}
+		}
+		return sample_count;
+	}
+
+	void ImageTileIntegrator::RenderPixel(const Theia::Point2i& pixel, Theia::UInt32 sample_count, Theia::FilmTile& film_tile, Theia::RandomNumberGenerator& rng) const {
+		// Differentials span the pixel footprint of one sample, which shrinks as samples are added.
+		Theia::Float differential_scale = 1.0f / std::sqrt(Theia::Float(std::max(m_options.m_samples_per_pixel, 1u)));
+		Theia::UInt32 first_sample = Theia::UInt32(m_film.GetPixel(pixel).m_sample_count);
+		for (Theia::UInt32 sample_index = first_sample; sample_index < first_sample + sample_count; sample_index++) {
+			Theia::CameraSample sample = Theia::GetCameraSample(pixel, sample_index, m_options.m_seed, rng);
+			Theia::Vector3f rgb(0.0f, 0.0f, 0.0f);
+			std::optional<Theia::CameraRayDifferential> camera_ray = m_camera.GenerateRayDifferentials(sample);
+			if (camera_ray) {
+				camera_ray->Ray_Differential.ScaleDifferential(differential_scale);
+				rgb = Li(camera_ray->Ray_Differential, rng);
+			}
+			film_tile.AddSample(pixel, rgb, sample.Filter_Weight);
+		}
+	}
+
+	Theia::UInt64 ImageTileIntegrator::RenderPasses(std::chrono::steady_clock::time_point start) {
+		const Theia::AABB2i& bounds = m_film.GetPixelBounds();
+		if (bounds.IsEmpty() || m_options.m_samples_per_pixel == 0) {
+			return 0;
+		}
+
+		bool is_progressive = m_options.m_time_budget_milliseconds > 0.0;
+		bool is_adaptive = m_options.m_error_threshold > 0.0;
+		std::chrono::steady_clock::time_point deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<Theia::Float64, std::milli>(m_options.m_time_budget_milliseconds));
+		Theia::Int32 tile_size = m_options.m_tile_size > 0 ? m_options.m_tile_size : Pass_Tile_Size;
+		Theia::Vector2i extent = bounds.Diagonal();
+		Theia::Int32 tile_count_x = (extent.m_x + tile_size - 1) / tile_size;
+		Theia::Int32 tile_count_y = (extent.m_y + tile_size - 1) / tile_size;
+		auto tile_bounds = [&](Theia::UInt32 tile) {
+			Theia::Point2i min(bounds.m_min.m_x + Theia::Int32(tile % Theia::UInt32(tile_count_x)) * tile_size, bounds.m_min.m_y + Theia::Int32(tile / Theia::UInt32(tile_count_x)) * tile_size);
+			return Theia::AABB2i(min, Theia::Point2i(std::min(min.m_x + tile_size, bounds.m_max.m_x), std::min(min.m_y + tile_size, bounds.m_max.m_y)));
+		};
+		auto pixel_offset = [&](const Theia::Point2i& pixel) {
+			return size_t(pixel.m_y - bounds.m_min.m_y) * size_t(extent.m_x) + size_t(pixel.m_x - bounds.m_min.m_x);
+		};
+
+		std::vector<Theia::UInt8> is_sampled_pixel(size_t(bounds.Area()));
+		std::vector<Theia::UInt8> is_sampled_tile(size_t(tile_count_x) * size_t(tile_count_y));
+		std::vector<Theia::UInt32> sampled_tiles(is_sampled_tile.size());
+		std::vector<Theia::UInt64> sampled_counts(is_sampled_tile.size());
+		Theia::UInt64 sample_count = 0;
+		// Wall-clock time per sample of the last pass, which predicts the next pass better than the average over all passes as adaptive passes move to the costlier pixels.
+		Theia::Float64 milliseconds_per_sample = 0.0;
+		while (!m_is_cancelled) {
+			// A pixel takes another pass while it is below the sample limit and, with adaptive sampling, above the error threshold; a tile while any of its pixels does.
+			Theia::ParallelFor(0, Theia::Int64(is_sampled_tile.size()), [&](Theia::Int64 tile) {
+				Theia::AABB2i pixels = tile_bounds(Theia::UInt32(tile));
+				Theia::UInt64 sampled_count = 0;
+				for (Theia::Int32 y = pixels.m_min.m_y; y < pixels.m_max.m_y; y++) {
+					for (Theia::Int32 x = pixels.m_min.m_x; x < pixels.m_max.m_x; x++) {
+						Theia::Point2i pixel(x, y);
+						bool is_noisy = !is_adaptive || m_film.GetRelativeStandardError(pixel, m_options.m_error_min_luminance) > m_options.m_error_threshold;
+						Theia::UInt8 is_sampled = is_noisy && m_film.GetPixel(pixel).m_sample_count < m_options.m_max_samples_per_pixel ? 1 : 0;
+						is_sampled_pixel[pixel_offset(pixel)] = is_sampled;
+						sampled_count += is_sampled;
+					}
+				}
+				is_sampled_tile[tile] = sampled_count > 0 ? 1 : 0;
+				sampled_counts[tile] = sampled_count;
+			}, 0, m_pool);
+			Theia::UInt32 sampled_tile_count = Theia::CompactMatches(std::span<const Theia::UInt8>(is_sampled_tile), Theia::UInt8(1), std::span<Theia::UInt32>(sampled_tiles), m_pool);
+			if (sampled_tile_count == 0) {
+				break;
+			}
+
+			// Progressive passes start with one sample per pixel to measure the cost of a sample, and a pass that would overrun the budget shrinks to the samples per pixel that fit, so every pixel of the pass gets the same number.
+			Theia::UInt32 pass_samples_per_pixel = m_options.m_samples_per_pixel;
+			if (is_progressive) {
+				if (milliseconds_per_sample == 0.0) {
+					pass_samples_per_pixel = 1;
+				} else {
+					Theia::Float64 sampled_pixel_count = Theia::Float64(std::accumulate(sampled_counts.begin(), sampled_counts.end(), Theia::UInt64(0)));
+					Theia::Float64 remaining_milliseconds = std::chrono::duration<Theia::Float64, std::milli>(deadline - std::chrono::steady_clock::now()).count();
+					Theia::Float64 fitting_samples_per_pixel = std::floor(Pass_Budget_Fraction * remaining_milliseconds / (milliseconds_per_sample * sampled_pixel_count));
+					if (fitting_samples_per_pixel < 1.0) {
+						break;
+					}
+					pass_samples_per_pixel = Theia::UInt32(std::min(fitting_samples_per_pixel, Theia::Float64(pass_samples_per_pixel)));
+				}
+			}
+
+			// Tiles are taken in a scrambled order; once the deadline passes no more are started, and the tiles left out keep one pass fewer.
+			std::chrono::steady_clock::time_point pass_start = std::chrono::steady_clock::now();
+			Theia::UInt32 stride = ScrambleStride(sampled_tile_count);
+			std::atomic<Theia::UInt32> next_tile = 0;
+			std::atomic<Theia::UInt32> rendered_tile_count = 0;
+			std::atomic<Theia::UInt64> pass_sample_count = 0;
+			std::atomic<bool> is_cut_short = false;
+			Theia::ParallelFor(0, m_pool.GetThreadCount(), [&](Theia::Int64) {
+				Theia::FilmTile film_tile;
+				Theia::RandomNumberGenerator rng;
+				Theia::UInt64 tile_sample_count = 0;
+				for (Theia::UInt32 entry = next_tile++; entry < sampled_tile_count; entry = next_tile++) {
+					if (m_is_cancelled || (is_progressive && std::chrono::steady_clock::now() >= deadline)) {
+						is_cut_short = true;
+						break;
+					}
+					film_tile.Reset(tile_bounds(sampled_tiles[Theia::UInt64(entry) * stride % sampled_tile_count]), m_film);
+					const Theia::AABB2i& pixels = film_tile.GetPixelBounds();
+					for (Theia::Int32 y = pixels.m_min.m_y; y < pixels.m_max.m_y; y++) {
+						for (Theia::Int32 x = pixels.m_min.m_x; x < pixels.m_max.m_x; x++) {
+							Theia::Point2i pixel(x, y);
+							if (is_sampled_pixel[pixel_offset(pixel)]) {
+								Theia::UInt32 pixel_sample_count = std::min<Theia::UInt32>(pass_samples_per_pixel, m_options.m_max_samples_per_pixel - Theia::UInt32(m_film.GetPixel(pixel).m_sample_count));
+								RenderPixel(pixel, pixel_sample_count, film_tile, rng);
+								tile_sample_count += pixel_sample_count;
+							}
+						}
+					}
+					StoreTile(film_tile);
+					rendered_tile_count++;
+				}
+				pass_sample_count += tile_sample_count;
+			}, 1, m_pool);
+			sample_count += pass_sample_count;
+			m_statistics.m_pass_count++;
+			m_statistics.m_pass_tile_count += rendered_tile_count;
+			if (is_cut_short) {
+				m_statistics.m_is_cut_short = true;
+				break;
+			}
+			if (pass_sample_count > 0) {
+				milliseconds_per_sample = MillisecondsSince(pass_start) / Theia::Float64(pass_sample_count);
+			}
+		}
+
+		if (is_adaptive) {
+			std::vector<Theia::UInt64> unconverged_counts(size_t(extent.m_y));
+			Theia::ParallelFor(0, extent.m_y, [&](Theia::Int64 row) {
+				Theia::UInt64 unconverged_count = 0;
+				for (Theia::Int32 x = bounds.m_min.m_x; x < bounds.m_max.m_x; x++) {
+					unconverged_count += m_film.GetRelativeStandardError(Theia::Point2i(x, bounds.m_min.m_y + Theia::Int32(row)), m_options.m_error_min_luminance) > m_options.m_error_threshold ? 1 : 0;
+				}
+				unconverged_counts[row] = unconverged_count;
+			}, 0, m_pool);
+			m_statistics.m_unconverged_pixel_count = std::accumulate(unconverged_counts.begin(), unconverged_counts.end(), Theia::UInt64(0));
+		}
+		return sample_count;
+	}
+
+	void ImageTileIntegrator::StoreTile(const Theia::FilmTile& film_tile) {
+		if (!m_checkpoint_writer) {
+			m_film.StoreTile(film_tile);
+			return;
+		}
+		{
+			std::shared_lock<std::shared_mutex> merge_lock(m_merge_mutex);
+			m_film.StoreTile(film_tile);
+		}
+
+		std::unique_lock<std::mutex> checkpoint_lock(m_checkpoint_mutex, std::try_to_lock);
+		if (!checkpoint_lock.owns_lock() || m_checkpoint_writer->IsWriting() || MillisecondsSince(m_last_checkpoint) < m_options.m_checkpoint_interval_milliseconds) {
+			return;
+		}
+		std::chrono::steady_clock::time_point copy_start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::shared_mutex> merge_lock(m_merge_mutex);
+			m_checkpoint_writer->Start(m_film);
+		}
+		m_last_checkpoint = std::chrono::steady_clock::now();
+		m_statistics.m_checkpoint_milliseconds += MillisecondsSince(copy_start);
+	}
+
+	Theia::UInt64 ImageTileIntegrator::GetRenderHash() const {
+		// What decides the samples a pixel takes; the time budget and the tiles only decide when they are taken.
+		Theia::Vector2i resolution = m_film.GetPixelBounds().Diagonal();
+		Theia::UInt64 hash = Theia::HashBuffer(&m_options.m_scene_hash, sizeof(m_options.m_scene_hash));
+		hash = Theia::HashBuffer(&resolution.m_x, sizeof(resolution.m_x), hash);
+		hash = Theia::HashBuffer(&resolution.m_y, sizeof(resolution.m_y), hash);
+		hash = Theia::HashBuffer(&m_options.m_seed, sizeof(m_options.m_seed), hash);
+		hash = Theia::HashBuffer(&m_options.m_samples_per_pixel, sizeof(m_options.m_samples_per_pixel), hash);
+		hash = Theia::HashBuffer(&m_options.m_max_samples_per_pixel, sizeof(m_options.m_max_samples_per_pixel), hash);
+		hash = Theia::HashBuffer(&m_options.m_error_threshold, sizeof(m_options.m_error_threshold), hash);
+		return Theia::HashBuffer(&m_options.m_error_min_luminance, sizeof(m_options.m_error_min_luminance), hash);
+	}
+}
\ No newline at end of file
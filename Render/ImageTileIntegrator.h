@@ -0,0 +1,106 @@
+#ifndef _THEIA_RENDER_IMAGE_TILE_INTEGRATOR_H_
+#define _THEIA_RENDER_IMAGE_TILE_INTEGRATOR_H_
+#include "IIntegrator.h"
+#include "Film.h"
+#include "RenderCheckpoint.h"
+#include "../Engine/ICamera.h"
+#include "../Parallel/ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+namespace Theia {
+	typedef struct ImageTileIntegratorOptions {
+		Theia::UInt32 m_samples_per_pixel = 16;
+		// Side of the square tiles in pixels. 0 adapts it to the measured cost of the tiles rendered so far.
+		Theia::Int32 m_tile_size = 0;
+		// Time per tile the adaptive tile size aims for.
+		Theia::Float64 m_target_tile_milliseconds = 4.0;
+		// Adaptive sampling, off while 0: passes of m_samples_per_pixel more samples go to the pixels whose relative standard error of luminance is above this, until each has m_max_samples_per_pixel.
+		Theia::Float64 m_error_threshold = 0.0;
+		// Progressive rendering, off while 0: Integrate renders passes until the next would overrun this budget or every pixel has m_max_samples_per_pixel samples.
+		Theia::Float64 m_time_budget_milliseconds = 0.0;
+		Theia::UInt32 m_max_samples_per_pixel = 1024;
+		// Luminance that the error of darker pixels is measured against.
+		Theia::Float64 m_error_min_luminance = 0.01;
+		Theia::UInt64 m_seed = 0;
+		// Checkpointing, off while empty: the film is saved here every m_checkpoint_interval_milliseconds and when Integrate returns.
+		std::string m_checkpoint_path;
+		Theia::Float64 m_checkpoint_interval_milliseconds = 60000.0;
+		// Identifies the scene and camera, for example a hash from SceneCache::HashFiles.
+		Theia::UInt64 m_scene_hash = 0;
+	} ImageTileIntegratorOptions;
+
+	typedef struct ImageTileStatistics {
+		Theia::Float64 m_render_milliseconds = 0.0;
+		Theia::UInt32 m_thread_count = 0;
+		Theia::UInt32 m_tile_count = 0;
+		// Longer side of the smallest and largest tile, including tiles clipped by the image.
+		Theia::Int32 m_min_tile_size = 0;
+		Theia::Int32 m_max_tile_size = 0;
+		Theia::UInt64 m_sample_count = 0;
+		// Adaptive and progressive sample passes, the tiles they rendered, and the pixels still above the error threshold when sampling stopped.
+		Theia::UInt32 m_pass_count = 0;
+		Theia::UInt64 m_pass_tile_count = 0;
+		Theia::UInt64 m_unconverged_pixel_count = 0;
+		// The last pass reached the deadline, or was cancelled, before all of its tiles.
+		bool m_is_cut_short = false;
+		bool m_is_cancelled = false;
+		// Checkpoints written, and the time render threads spent copying the film for them; the files themselves are written on a thread of their own.
+		Theia::UInt32 m_checkpoint_count = 0;
+		Theia::Float64 m_checkpoint_milliseconds = 0.0;
+	} ImageTileStatistics;
+
+	// Random numbers a pixel sample may draw. Every sample has a stretch of this many numbers of the sequence of its pixel to itself.
+	constexpr Theia::UInt64 Sample_Dimension_Count = 65536;
+
+	// Seeds rng for a pixel sample and draws its film position, lens position and time. What rng draws next depends only on the seed, the pixel, the sample index and the dimension.
+	Theia::CameraSample GetCameraSample(const Theia::Point2i& pixel, Theia::UInt32 sample_index, Theia::UInt64 seed, Theia::RandomNumberGenerator& rng);
+
+	// Renders the film in square tiles claimed by the threads of the pool, optionally with adaptive sampling, a time budget and checkpoints.
+	// The film comes out the same to the bit whatever the tile size, the thread count or the checkpoints resumed from.
+	class ImageTileIntegrator : public Theia::IIntegrator {
+	public:
+		ImageTileIntegrator(const Theia::ICamera& camera, Theia::Film& film, const Theia::ImageTileIntegratorOptions& options = Theia::ImageTileIntegratorOptions(), Theia::ThreadPool& pool = Theia::ThreadPool::Default());
+
+		// Adds m_samples_per_pixel samples to every pixel of the film, and with adaptive sampling more to the noisy pixels.
+		void Integrate() override;
+		// Loads the checkpoint at m_checkpoint_path into the film and finishes its render. False, with nothing rendered, when there is no checkpoint of this render.
+		bool Resume();
+		// Makes the running or next Integrate return once the tiles in flight are stored and a last checkpoint is written. Safe to call from any thread.
+		void Cancel();
+		// Adds m_samples_per_pixel samples to every pixel of film_tile and returns the samples added. Safe to call concurrently on different tiles.
+		Theia::UInt64 RenderTile(Theia::FilmTile& film_tile) const;
+		// Hash of the scene hash, the resolution, the seed and the sampling options, which checkpoints and distributed renders must match.
+		Theia::UInt64 GetRenderHash() const;
+
+		const Theia::ImageTileStatistics& GetStatistics() const;
+	protected:
+		// RGB radiance arriving along a camera ray. rng continues the random sequence of the pixel sample.
+		virtual Theia::Vector3f Li(const Theia::RayDifferential& ray, Theia::RandomNumberGenerator& rng) const = 0;
+
+		const Theia::ICamera& m_camera;
+		Theia::Film& m_film;
+		Theia::ImageTileIntegratorOptions m_options;
+		Theia::ThreadPool& m_pool;
+		Theia::ImageTileStatistics m_statistics;
+	private:
+		void RenderPixel(const Theia::Point2i& pixel, Theia::UInt32 sample_count, Theia::FilmTile& film_tile, Theia::RandomNumberGenerator& rng) const;
+		// Adaptive and progressive passes of an Integrate that began at start; returns the samples they added.
+		Theia::UInt64 RenderPasses(std::chrono::steady_clock::time_point start);
+		// Stores a finished tile into the film and, when a checkpoint is due and no other thread is taking one, hands a copy of the film to the checkpoint writer.
+		void StoreTile(const Theia::FilmTile& film_tile);
+
+		std::atomic<bool> m_is_cancelled = false;
+		bool m_is_resuming = false;
+		// Held shared while tiles are stored and exclusively while the film is copied, so checkpoints never hold part of a tile.
+		std::shared_mutex m_merge_mutex;
+		std::mutex m_checkpoint_mutex;
+		std::unique_ptr<Theia::CheckpointWriter> m_checkpoint_writer;
+		std::chrono::steady_clock::time_point m_last_checkpoint;
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include "PathIntegrator.h"
+
+namespace Theia {
+	PathIntegrator::PathIntegrator(const Theia::ICamera& camera, Theia::Film& film, const Theia::PathTracingScene& scene, Theia::UInt32 max_depth, const Theia::ImageTileIntegratorOptions& options, Theia::ThreadPool& pool) :
+		Theia::ImageTileIntegrator(camera, film, options, pool),
+		m_scene(scene),
+		m_max_depth(max_depth)
+	{
+
+	}
+
+	Theia::Vector3f PathIntegrator::Li(const Theia::RayDifferential& ray_differential, Theia::RandomNumberGenerator& rng) const {
+		Theia::Vector3f radiance(0.0f, 0.0f, 0.0f);
+		Theia::Vector3f beta(1.0f, 1.0f, 1.0f);
+		Theia::Ray ray = ray_differential.GetRay();
+		for (Theia::UInt32 depth = 0; depth < m_max_depth; depth++) {
+			std::optional<Theia::ShapeIntersection> shape_intersection = m_scene.m_aggregate->Intersect(ray);
+			if (!shape_intersection) {
+				radiance += beta * m_scene.m_environment;
+				break;
+			}
+
+			const Theia::SurfaceMaterial& material = m_scene.m_materials[m_scene.GetMaterialIndex(*shape_intersection)];
+			Theia::ShadedVertex vertex = Theia::ShadeVertex(m_scene, material, shape_intersection->m_interaction, -Theia::Normalize(ray.GetDirection()), beta, depth + 1 < m_max_depth, rng);
+			if (vertex.m_shadow_ray && !m_scene.m_aggregate->Occluded(*vertex.m_shadow_ray, Theia::Shadow_Ray_T_Max)) {
+				radiance += vertex.m_light_contribution;
+			}
+			if (!vertex.m_next_ray) {
+				break;
+			}
+			ray = *vertex.m_next_ray;
+		}
+		return radiance;
+	}
+}
\ No newline at end of file
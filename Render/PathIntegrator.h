@@ -0,0 +1,19 @@
+#ifndef _THEIA_RENDER_PATH_INTEGRATOR_H_
+#define _THEIA_RENDER_PATH_INTEGRATOR_H_
+#include "ImageTileIntegrator.h"
+#include "PathTracing.h"
+
+namespace Theia {
+	// Traces every path depth first, one after the other: the renderer's reference for the wavefront integrator, which renders the same image.
+	class PathIntegrator : public Theia::ImageTileIntegrator {
+	public:
+		// max_depth counts the surfaces a path scatters from, so 1 renders direct lighting only.
+		PathIntegrator(const Theia::ICamera& camera, Theia::Film& film, const Theia::PathTracingScene& scene, Theia::UInt32 max_depth = 5, const Theia::ImageTileIntegratorOptions& options = Theia::ImageTileIntegratorOptions(), Theia::ThreadPool& pool = Theia::ThreadPool::Default());
+	protected:
+		Theia::Vector3f Li(const Theia::RayDifferential& ray, Theia::RandomNumberGenerator& rng) const override;
+	private:
+		const Theia::PathTracingScene& m_scene;
+		Theia::UInt32 m_max_depth;
+	};
+}
+#endif
\ No newline at end of file
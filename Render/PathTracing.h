@@ -0,0 +1,104 @@
+#ifndef _THEIA_RENDER_PATH_TRACING_H_
+#define _THEIA_RENDER_PATH_TRACING_H_
+#include "../Accelerator/BVHAggregate.h"
+#include "../Math/Sampling.h"
+#include "../Math/VectorFrame.h"
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace Theia {
+	enum class MaterialType : Theia::UInt8 {
+		Diffuse,
+		Mirror
+	};
+
+	constexpr Theia::UInt32 Material_Type_Count = 2;
+
+	typedef struct SurfaceMaterial {
+		Theia::MaterialType m_type = Theia::MaterialType::Diffuse;
+		Theia::Vector3f m_reflectance = Theia::Vector3f(0.5f, 0.5f, 0.5f);
+	} SurfaceMaterial;
+
+	typedef struct PointLight {
+		Theia::Point3f m_position;
+		// RGB radiant intensity.
+		Theia::Vector3f m_intensity;
+	} PointLight;
+
+	// What the path integrators render: geometry in a BVH, a material per primitive, point lights and a constant environment seen by rays that leave the scene. The renderer has no material or light interfaces yet, so this is the small fixed model both the depth-first and the wavefront integrator share.
+	typedef struct PathTracingScene {
+		const Theia::BVHAggregate* m_aggregate = nullptr;
+		std::vector<Theia::SurfaceMaterial> m_materials = { Theia::SurfaceMaterial() };
+		// Index in m_materials of the primitives a hit can report; the others use the first material.
+		std::unordered_map<const Theia::IPrimitive*, Theia::UInt32> m_primitive_materials;
+		std::vector<Theia::PointLight> m_lights;
+		Theia::Vector3f m_environment = Theia::Vector3f(0.0f, 0.0f, 0.0f);
+
+		Theia::UInt32 GetMaterialIndex(const Theia::ShapeIntersection& shape_intersection) const {
+			auto material = m_primitive_materials.find(shape_intersection.m_primitive);
+			return material == m_primitive_materials.end() ? 0 : material->second;
+		}
+	} PathTracingScene;
+
+	// Shadow rays end just short of the light they were aimed at.
+	constexpr Theia::Float Shadow_Ray_T_Max = 1.0f - 1e-4f;
+
+	typedef struct ShadedVertex {
+		// To the sampled light; its contribution is added to the path when nothing blocks the ray up to Shadow_Ray_T_Max.
+		std::optional<Theia::Ray> m_shadow_ray;
+		Theia::Vector3f m_light_contribution = Theia::Vector3f(0.0f, 0.0f, 0.0f);
+		std::optional<Theia::Ray> m_next_ray;
+	} ShadedVertex;
+
+	// Shades one path vertex on a surface of material type Type: samples a light for direct lighting, and when is_continued samples the direction the path continues in and scales beta by the weight of that sample. Both path integrators shade vertices with this, drawing the same random numbers in the same order, so they render the same image.
+	template <Theia::MaterialType Type> Theia::ShadedVertex ShadeVertex(const Theia::PathTracingScene& scene, const Theia::SurfaceMaterial& material, const Theia::IInteraction& interaction, const Theia::Vector3f& w_o, Theia::Vector3f& beta, bool is_continued, Theia::RandomNumberGenerator& rng) {
+		Theia::ShadedVertex vertex;
+		Theia::Vector3f normal = Theia::Normalize(Theia::Vector3f(interaction.m_normal.m_x, interaction.m_normal.m_y, interaction.m_normal.m_z));
+		if (Theia::Dot(normal, w_o) < 0.0f) {
+			normal = -normal;
+		}
+
+		if constexpr (Type == Theia::MaterialType::Diffuse) {
+			Theia::Float u_light = rng.Uniform<Theia::Float>();
+			if (!scene.m_lights.empty()) {
+				Theia::UInt32 light_index = std::min(Theia::UInt32(u_light * Theia::Float(scene.m_lights.size())), Theia::UInt32(scene.m_lights.size() - 1));
+				const Theia::PointLight& light = scene.m_lights[light_index];
+				Theia::Vector3f to_light = light.m_position - Theia::Point3f(interaction.m_point_interval);
+				Theia::Float distance_squared = Theia::LengthSquared(to_light);
+				Theia::Float cos_theta = Theia::Dot(normal, to_light) / std::sqrt(distance_squared);
+				if (cos_theta > 0.0f && distance_squared > 0.0f) {
+					Theia::Point3f origin = interaction.OffsetRayOrigin(to_light);
+					vertex.m_shadow_ray = Theia::Ray(origin, light.m_position - origin, interaction.m_time, interaction.GetMedium(to_light));
+					// Uniform light selection has probability 1 / light count.
+					Theia::Float scale = cos_theta / (distance_squared * Theia::Pi) * Theia::Float(scene.m_lights.size());
+					vertex.m_light_contribution = scale * (beta * material.m_reflectance * light.m_intensity);
+				}
+			}
+
+			if (is_continued) {
+				Theia::Point2f u(rng.Uniform<Theia::Float>(), rng.Uniform<Theia::Float>());
+				Theia::Vector3f w_i = Theia::VectorFrame::FromZ(normal).FromLocal(Theia::SampleCosineHemisphere(u));
+				// Lambertian reflectance over cosine-weighted sampling leaves only the albedo.
+				beta *= material.m_reflectance;
+				vertex.m_next_ray = interaction.SpawnRay(w_i);
+			}
+		}
+		else if constexpr (Type == Theia::MaterialType::Mirror) {
+			if (is_continued) {
+				Theia::Vector3f w_i = 2.0f * Theia::Dot(w_o, normal) * normal - w_o;
+				beta *= material.m_reflectance;
+				vertex.m_next_ray = interaction.SpawnRay(w_i);
+			}
+		}
+		return vertex;
+	}
+
+	inline Theia::ShadedVertex ShadeVertex(const Theia::PathTracingScene& scene, const Theia::SurfaceMaterial& material, const Theia::IInteraction& interaction, const Theia::Vector3f& w_o, Theia::Vector3f& beta, bool is_continued, Theia::RandomNumberGenerator& rng) {
+		if (material.m_type == Theia::MaterialType::Mirror) {
+			return Theia::ShadeVertex<Theia::MaterialType::Mirror>(scene, material, interaction, w_o, beta, is_continued, rng);
+		}
+		return Theia::ShadeVertex<Theia::MaterialType::Diffuse>(scene, material, interaction, w_o, beta, is_continued, rng);
+	}
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "RenderCheckpoint.h"
+#include "../IO/MappedFile.h"
+#include "../Math/Hash.h"
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace Theia {
+	namespace {
+		constexpr char Magic[8] = { 'T', 'H', 'E', 'I', 'A', 'C', 'P', '\0' };
+
+		typedef struct Header {
+			char m_magic[8];
+			Theia::UInt32 m_version;
+			// Checkpoints are not portable between byte orders.
+			Theia::UInt32 m_byte_order;
+			Theia::UInt64 m_render_hash;
+			Theia::UInt64 m_payload_hash;
+			Theia::Int32 m_width;
+			Theia::Int32 m_height;
+			Theia::UInt8 m_padding[24];
+		} Header;
+
+		static_assert(sizeof(Header) == 64, "RenderCheckpoint Header is not 64 bytes");
+		static_assert(std::is_trivially_copyable_v<Theia::FilmPixel>, "RenderCheckpoint pixels must be trivially copyable");
+
+		Theia::UInt32 ByteOrder() {
+			return std::endian::native == std::endian::little ? 1 : 2;
+		}
+	}
+
+	bool RenderCheckpoint::Write(const std::string& path, Theia::UInt64 render_hash, const Theia::Point2i& resolution, std::span<const Theia::FilmPixel> pixels) {
+		Header header;
+		std::memset(&header, 0, sizeof(Header));
+		std::memcpy(header.m_magic, Magic, sizeof(Magic));
+		header.m_version = Version;
+		header.m_byte_order = ByteOrder();
+		header.m_render_hash = render_hash;
+		header.m_payload_hash = Theia::HashBuffer(pixels.data(), pixels.size_bytes());
+		header.m_width = resolution.m_x;
+		header.m_height = resolution.m_y;
+
+		std::string temporary_path = path + ".tmp";
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(reinterpret_cast<const char*>(pixels.data()), std::streamsize(pixels.size_bytes()));
+		file.close();
+		if (!file) {
+			std::filesystem::remove(temporary_path);
+			return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary_path, path, error);
+		return !error;
+	}
+
+	bool RenderCheckpoint::Read(const std::string& path, Theia::UInt64 render_hash, Theia::Film& film) {
+		Theia::MappedFile file(path);
+		std::span<const Theia::UInt8> bytes = file.GetBytes();
+		if (bytes.size() < sizeof(Header)) {
+			return false;
+		}
+
+		Header header;
+		std::memcpy(&header, bytes.data(), sizeof(Header));
+		Theia::Vector2i resolution = film.GetPixelBounds().Diagonal();
+		size_t pixels_size = size_t(resolution.m_x) * size_t(resolution.m_y) * sizeof(Theia::FilmPixel);
+		bool header_matches = std::memcmp(header.m_magic, Magic, sizeof(Magic)) == 0 &&
+			header.m_version == Version &&
+			header.m_byte_order == ByteOrder() &&
+			header.m_render_hash == render_hash &&
+			header.m_width == resolution.m_x &&
+			header.m_height == resolution.m_y &&
+			bytes.size() == sizeof(Header) + pixels_size;
+		if (!header_matches || Theia::HashBuffer(bytes.data() + sizeof(Header), pixels_size) != header.m_payload_hash) {
+			return false;
+		}
+
+		std::vector<Theia::FilmPixel> pixels(pixels_size / sizeof(Theia::FilmPixel));
+		std::memcpy(pixels.data(), bytes.data() + sizeof(Header), pixels_size);
+		film.SetPixels(pixels);
+		return true;
+	}
+
+	CheckpointWriter::CheckpointWriter(const std::string& path, Theia::UInt64 render_hash) :
+		m_path(path),
+		m_render_hash(render_hash)
+	{
+
+	}
+
+	CheckpointWriter::~CheckpointWriter() {
+		Wait();
+	}
+
+	bool CheckpointWriter::IsWriting() const {
+		return m_is_writing;
+	}
+
+	void CheckpointWriter::Start(const Theia::Film& film) {
+		assert(!m_is_writing, "CheckpointWriter::Start called while a write is in flight.");
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+		std::span<const Theia::FilmPixel> pixels = film.GetPixels();
+		m_pixels.assign(pixels.begin(), pixels.end());
+		Theia::Vector2i extent = film.GetPixelBounds().Diagonal();
+		m_resolution = Theia::Point2i(extent.m_x, extent.m_y);
+		m_is_writing = true;
+		m_thread = std::thread([this]() {
+			bool is_written = Theia::RenderCheckpoint::Write(m_path, m_render_hash, m_resolution, m_pixels);
+			m_has_failed |= !is_written;
+			m_write_count += is_written ? 1 : 0;
+			m_is_writing = false;
+		});
+	}
+
+	bool CheckpointWriter::Wait() {
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+		return !m_has_failed;
+	}
+
+	Theia::UInt32 CheckpointWriter::GetWriteCount() const {
+		return m_write_count;
+	}
+}
\ No newline at end of file
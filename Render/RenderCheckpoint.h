@@ -0,0 +1,52 @@
+#ifndef _THEIA_RENDER_RENDER_CHECKPOINT_H_
+#define _THEIA_RENDER_RENDER_CHECKPOINT_H_
+#include "Film.h"
+#include <atomic>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Theia {
+	// Snapshot of a render in progress: the sums, sample counts and luminance statistics of every pixel of the film. Samples are drawn from sequences that depend only on the seed, the pixel and the sample index, so the sample count of a pixel is all the sampler state there is; render_hash identifies the scene, the seed and the sampling options, and a checkpoint only resumes the render it was taken from.
+	class RenderCheckpoint {
+	public:
+		// Written next to the destination and renamed at the end, so a process killed while writing leaves the previous checkpoint in place.
+		static bool Write(const std::string& path, Theia::UInt64 render_hash, const Theia::Point2i& resolution, std::span<const Theia::FilmPixel> pixels);
+		// Restores the pixels of film. False, with film untouched, when the file is missing, truncated, corrupt, or from another render or resolution.
+		static bool Read(const std::string& path, Theia::UInt64 render_hash, Theia::Film& film);
+
+		static constexpr Theia::UInt32 Version = 1;
+	protected:
+	private:
+	};
+
+	// Writes checkpoints on a thread of its own, so rendering goes on while a snapshot of the film is written out.
+	class CheckpointWriter {
+	public:
+		CheckpointWriter(const std::string& path, Theia::UInt64 render_hash);
+		CheckpointWriter(const CheckpointWriter&) = delete;
+		CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+		// Waits for the write in flight.
+		~CheckpointWriter();
+
+		bool IsWriting() const;
+		// Copies the pixels of film and starts writing them. The film must not change during the copy, and no write may be in flight.
+		void Start(const Theia::Film& film);
+		// Waits for the write in flight, and returns whether every write so far succeeded.
+		bool Wait();
+		// Writes that succeeded so far.
+		Theia::UInt32 GetWriteCount() const;
+	protected:
+	private:
+		std::string m_path;
+		Theia::UInt64 m_render_hash;
+		Theia::Point2i m_resolution;
+		std::vector<Theia::FilmPixel> m_pixels;
+		std::thread m_thread;
+		std::atomic<bool> m_is_writing = false;
+		bool m_has_failed = false;
+		std::atomic<Theia::UInt32> m_write_count = 0;
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "WavefrontPathIntegrator.h"
+#include "ImageTileIntegrator.h"
+#include "../Parallel/Algorithms.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+namespace Theia {
+	namespace {
+		// Material type of queue entries whose ray left the scene.
+		constexpr Theia::UInt8 Missed_Type = Theia::UInt8(Theia::Material_Type_Count);
+
+		Theia::Float64 MillisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<Theia::Float64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	// State of the paths of a wave, indexed by the offset of their sample in the wave, and the queues the stages pass on to each other, which are indexed by entry. Every array is allocated for a full wave up front.
+	struct WavefrontPathIntegrator::Wave {
+		Wave(Theia::UInt32 size, Theia::ThreadPool& pool) :
+			m_beta(size),
+			m_radiance(size),
+			m_filter_weight(size),
+			m_rng(size),
+			m_rays(size, Theia::Ray(Theia::Point3f(0.0f, 0.0f, 0.0f), Theia::Vector3f(0.0f, 0.0f, 1.0f))),
+			m_ray_paths(size),
+			m_hits(size),
+			m_material_types(size),
+			m_material_indices(size),
+			m_shadow_rays(m_rays),
+			m_light_contributions(size),
+			m_has_shadow_ray(size),
+			m_next_rays(m_rays),
+			m_has_next_ray(size),
+			m_shadow_indices(size),
+			m_shadow_queue(m_rays),
+			m_shadow_t_max(size, Theia::Shadow_Ray_T_Max),
+			m_occluded(new bool[size]),
+			m_next_indices(size),
+			m_next_queue(m_rays),
+			m_next_paths(size),
+			m_ray_sorter(pool)
+		{
+			for (std::vector<Theia::UInt32>& queue : m_material_queues) {
+				queue.resize(size);
+			}
+		}
+
+		std::vector<Theia::Vector3f> m_beta;
+		std::vector<Theia::Vector3f> m_radiance;
+		std::vector<Theia::Float> m_filter_weight;
+		std::vector<Theia::RandomNumberGenerator> m_rng;
+
+		// Rays of the current bounce and the paths they extend.
+		Theia::UInt32 m_ray_count = 0;
+		std::vector<Theia::Ray> m_rays;
+		std::vector<Theia::UInt32> m_ray_paths;
+		std::vector<std::optional<Theia::ShapeIntersection>> m_hits;
+		std::vector<Theia::UInt8> m_material_types;
+		std::vector<Theia::UInt32> m_material_indices;
+		// Entries that hit a surface, one queue per material type.
+		std::array<std::vector<Theia::UInt32>, Theia::Material_Type_Count> m_material_queues;
+		std::array<Theia::UInt32, Theia::Material_Type_Count> m_material_counts = {};
+
+		// Results of shading, per entry.
+		std::vector<Theia::Ray> m_shadow_rays;
+		std::vector<Theia::Vector3f> m_light_contributions;
+		std::vector<Theia::UInt8> m_has_shadow_ray;
+		std::vector<Theia::Ray> m_next_rays;
+		std::vector<Theia::UInt8> m_has_next_ray;
+
+		// Shadow rays gathered into one batch.
+		std::vector<Theia::UInt32> m_shadow_indices;
+		std::vector<Theia::Ray> m_shadow_queue;
+		std::vector<Theia::Float> m_shadow_t_max;
+		std::unique_ptr<bool[]> m_occluded;
+
+		// Rays of the next bounce, swapped with m_rays once gathered.
+		std::vector<Theia::UInt32> m_next_indices;
+		std::vector<Theia::Ray> m_next_queue;
+		std::vector<Theia::UInt32> m_next_paths;
+
+		Theia::RaySorter m_ray_sorter;
+	};
+
+	WavefrontPathIntegrator::WavefrontPathIntegrator(const Theia::ICamera& camera, Theia::Film& film, const Theia::PathTracingScene& scene, const Theia::WavefrontPathIntegratorOptions& options, Theia::ThreadPool& pool) :
+		m_camera(camera),
+		m_film(film),
+		m_scene(scene),
+		m_options(options),
+		m_pool(pool)
+	{
+
+	}
+
+	WavefrontPathIntegrator::~WavefrontPathIntegrator() = default;
+
+	template <typename F> void WavefrontPathIntegrator::ForEachBatch(Theia::UInt32 count, const F& function) {
+		Theia::UInt32 batch_size = std::max(m_options.m_batch_size, 1u);
+		Theia::Int64 batch_count = (Theia::Int64(count) + batch_size - 1) / batch_size;
+		Theia::ParallelFor(0, batch_count, [&](Theia::Int64 batch) {
+			Theia::UInt32 begin = Theia::UInt32(batch) * batch_size;
+			function(begin, std::min(begin + batch_size, count));
+		}, 1, m_pool);
+	}
+
+	void WavefrontPathIntegrator::Integrate() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const Theia::AABB2i& bounds = m_film.GetPixelBounds();
+		Theia::UInt64 sample_count = bounds.IsEmpty() ? 0 : Theia::UInt64(bounds.Area()) * m_options.m_samples_per_pixel;
+		Theia::UInt32 wave_size = Theia::UInt32(std::min<Theia::UInt64>(std::max(m_options.m_wave_size, 1u), sample_count));
+
+		m_statistics = Theia::WavefrontStatistics();
+		m_statistics.m_thread_count = m_pool.GetThreadCount();
+		m_statistics.m_sample_count = sample_count;
+		m_wave = std::make_unique<Theia::WavefrontPathIntegrator::Wave>(wave_size, m_pool);
+		for (Theia::UInt64 first_sample = 0; first_sample < sample_count; first_sample += wave_size) {
+			Theia::UInt32 path_count = Theia::UInt32(std::min<Theia::UInt64>(wave_size, sample_count - first_sample));
+			std::chrono::steady_clock::time_point stage_start = std::chrono::steady_clock::now();
+			GenerateCameraRays(first_sample, path_count);
+			m_statistics.m_camera_milliseconds += MillisecondsSince(stage_start);
+
+			for (Theia::UInt32 depth = 0; depth < m_options.m_max_depth && m_wave->m_ray_count > 0; depth++) {
+				m_statistics.m_ray_count += m_wave->m_ray_count;
+				if (m_options.m_sort_rays && depth > 0) {
+					stage_start = std::chrono::steady_clock::now();
+					SortRays();
+					m_statistics.m_sort_milliseconds += MillisecondsSince(stage_start);
+				}
+
+				stage_start = std::chrono::steady_clock::now();
+				IntersectRays();
+				m_statistics.m_intersect_milliseconds += MillisecondsSince(stage_start);
+
+				stage_start = std::chrono::steady_clock::now();
+				SortByMaterial();
+				m_statistics.m_queue_milliseconds += MillisecondsSince(stage_start);
+
+				stage_start = std::chrono::steady_clock::now();
+				ShadeVertices<Theia::MaterialType::Diffuse>(depth);
+				ShadeVertices<Theia::MaterialType::Mirror>(depth);
+				m_statistics.m_shade_milliseconds += MillisecondsSince(stage_start);
+
+				stage_start = std::chrono::steady_clock::now();
+				TraceShadowRays();
+				m_statistics.m_shadow_milliseconds += MillisecondsSince(stage_start);
+
+				stage_start = std::chrono::steady_clock::now();
+				ContinuePaths();
+				m_statistics.m_queue_milliseconds += MillisecondsSince(stage_start);
+			}
+
+			stage_start = std::chrono::steady_clock::now();
+			AddSamplesToFilm(first_sample, path_count);
+			m_statistics.m_film_milliseconds += MillisecondsSince(stage_start);
+			m_statistics.m_wave_count++;
+		}
+		m_wave.reset();
+		m_statistics.m_render_milliseconds = MillisecondsSince(start);
+	}
+
+	const Theia::WavefrontStatistics& WavefrontPathIntegrator::GetStatistics() const {
+		return m_statistics;
+	}
+
+	void WavefrontPathIntegrator::GenerateCameraRays(Theia::UInt64 first_sample, Theia::UInt32 path_count) {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		const Theia::AABB2i& bounds = m_film.GetPixelBounds();
+		Theia::UInt64 width = Theia::UInt64(bounds.m_max.m_x - bounds.m_min.m_x);
+		Theia::UInt64 samples_per_pixel = m_options.m_samples_per_pixel;
+		ForEachBatch(path_count, [&](Theia::UInt32 begin, Theia::UInt32 end) {
+			for (Theia::UInt32 path = begin; path < end; path++) {
+				Theia::UInt64 sample_index = first_sample + path;
+				Theia::UInt64 pixel_index = sample_index / samples_per_pixel;
+				Theia::Point2i pixel(bounds.m_min.m_x + Theia::Int32(pixel_index % width), bounds.m_min.m_y + Theia::Int32(pixel_index / width));
+				Theia::CameraSample sample = Theia::GetCameraSample(pixel, Theia::UInt32(sample_index % samples_per_pixel), m_options.m_seed, wave.m_rng[path]);
+				wave.m_beta[path] = Theia::Vector3f(1.0f, 1.0f, 1.0f);
+				wave.m_radiance[path] = Theia::Vector3f(0.0f, 0.0f, 0.0f);
+				wave.m_filter_weight[path] = sample.Filter_Weight;
+				wave.m_ray_paths[path] = path;
+
+				// Paths carry no differentials, as no stage filters textures yet.
+				std::optional<Theia::CameraRayDifferential> camera_ray = m_camera.GenerateRayDifferentials(sample);
+				wave.m_has_next_ray[path] = camera_ray ? 1 : 0;
+				if (camera_ray) {
+					wave.m_next_rays[path] = camera_ray->Ray_Differential.GetRay();
+				}
+			}
+		});
+		wave.m_ray_count = path_count;
+		ContinuePaths();
+	}
+
+	void WavefrontPathIntegrator::SortRays() {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		wave.m_ray_sorter.Sort(std::span<const Theia::Ray>(wave.m_rays.data(), wave.m_ray_count));
+		std::span<const Theia::UInt32> order = wave.m_ray_sorter.GetOrder();
+		ForEachBatch(wave.m_ray_count, [&](Theia::UInt32 begin, Theia::UInt32 end) {
+			for (Theia::UInt32 entry = begin; entry < end; entry++) {
+				wave.m_next_queue[entry] = wave.m_rays[order[entry]];
+				wave.m_next_paths[entry] = wave.m_ray_paths[order[entry]];
+			}
+		});
+		std::swap(wave.m_rays, wave.m_next_queue);
+		std::swap(wave.m_ray_paths, wave.m_next_paths);
+	}
+
+	void WavefrontPathIntegrator::IntersectRays() {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		ForEachBatch(wave.m_ray_count, [&](Theia::UInt32 begin, Theia::UInt32 end) {
+			m_scene.m_aggregate->Intersect(std::span<const Theia::Ray>(wave.m_rays.data() + begin, end - begin), std::span<std::optional<Theia::ShapeIntersection>>(wave.m_hits.data() + begin, end - begin), m_options.m_traversal);
+		});
+	}
+
+	void WavefrontPathIntegrator::SortByMaterial() {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		ForEachBatch(wave.m_ray_count, [&](Theia::UInt32 begin, Theia::UInt32 end) {
+			for (Theia::UInt32 i = begin; i < end; i++) {
+				wave.m_has_shadow_ray[i] = 0;
+				wave.m_has_next_ray[i] = 0;
+				if (!wave.m_hits[i]) {
+					Theia::UInt32 path = wave.m_ray_paths[i];
+					wave.m_radiance[path] += wave.m_beta[path] * m_scene.m_environment;
+					wave.m_material_types[i] = Missed_Type;
+					continue;
+				}
+				Theia::UInt32 material_index = m_scene.GetMaterialIndex(*wave.m_hits[i]);
+				wave.m_material_indices[i] = material_index;
+				wave.m_material_types[i] = Theia::UInt8(m_scene.m_materials[material_index].m_type);
+			}
+		});
+
+		for (Theia::UInt32 type = 0; type < Theia::Material_Type_Count; type++) {
+			wave.m_material_counts[type] = Theia::CompactMatches(std::span<const Theia::UInt8>(wave.m_material_types.data(), wave.m_ray_count), Theia::UInt8(type), std::span<Theia::UInt32>(wave.m_material_queues[type]), m_pool);
+		}
+	}
+
+	template <Theia::MaterialType Type> void WavefrontPathIntegrator::ShadeVertices(Theia::UInt32 depth) {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		const std::vector<Theia::UInt32>& queue = wave.m_material_queues[Theia::UInt32(Type)];
+		bool is_continued = depth + 1 < m_options.m_max_depth;
+		ForEachBatch(wave.m_material_counts[Theia::UInt32(Type)], [&](Theia::UInt32 begin, Theia::UInt32 end) {
+			for (Theia::UInt32 entry = begin; entry < end; entry++) {
+				Theia::UInt32 i = queue[entry];
+				Theia::UInt32 path = wave.m_ray_paths[i];
+				const Theia::SurfaceMaterial& material = m_scene.m_materials[wave.m_material_indices[i]];
+				Theia::ShadedVertex vertex = Theia::ShadeVertex<Type>(m_scene, material, wave.m_hits[i]->m_interaction, -Theia::Normalize(wave.m_rays[i].GetDirection()), wave.m_beta[path], is_continued, wave.m_rng[path]);
+				if (vertex.m_shadow_ray) {
+					wave.m_shadow_rays[i] = *vertex.m_shadow_ray;
+					wave.m_light_contributions[i] = vertex.m_light_contribution;
+					wave.m_has_shadow_ray[i] = 1;
+				}
+				if (vertex.m_next_ray) {
+					wave.m_next_rays[i] = *vertex.m_next_ray;
+					wave.m_has_next_ray[i] = 1;
+				}
+			}
+		});
+	}
+
+	void WavefrontPathIntegrator::TraceShadowRays() {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		Theia::UInt32 shadow_count = Theia::CompactMatches(std::span<const Theia::UInt8>(wave.m_has_shadow_ray.data(), wave.m_ray_count), Theia::UInt8(1), std::span<Theia::UInt32>(wave.m_shadow_indices), m_pool);
+		m_statistics.m_shadow_ray_count += shadow_count;
+
+		ForEachBatch(shadow_count, [&](Theia::UInt32 begin, Theia::UInt32 end) {
+			for (Theia::UInt32 entry = begin; entry < end; entry++) {
+				wave.m_shadow_queue[entry] = wave.m_shadow_rays[wave.m_shadow_indices[entry]];
+			}
+			m_scene.m_aggregate->Occluded(std::span<const Theia::Ray>(wave.m_shadow_queue.data() + begin, end - begin), std::span<const Theia::Float>(wave.m_shadow_t_max.data() + begin, end - begin), std::span<bool>(wave.m_occluded.get() + begin, end - begin));
+			for (Theia::UInt32 entry = begin; entry < end; entry++) {
+				if (!wave.m_occluded[entry]) {
+					Theia::UInt32 i = wave.m_shadow_indices[entry];
+					wave.m_radiance[wave.m_ray_paths[i]] += wave.m_light_contributions[i];
+				}
+			}
+		});
+	}
+
+	void WavefrontPathIntegrator::ContinuePaths() {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		Theia::UInt32 next_count = Theia::CompactMatches(std::span<const Theia::UInt8>(wave.m_has_next_ray.data(), wave.m_ray_count), Theia::UInt8(1), std::span<Theia::UInt32>(wave.m_next_indices), m_pool);
+		ForEachBatch(next_count, [&](Theia::UInt32 begin, Theia::UInt32 end) {
+			for (Theia::UInt32 entry = begin; entry < end; entry++) {
+				Theia::UInt32 i = wave.m_next_indices[entry];
+				wave.m_next_queue[entry] = wave.m_next_rays[i];
+				wave.m_next_paths[entry] = wave.m_ray_paths[i];
+			}
+		});
+		std::swap(wave.m_rays, wave.m_next_queue);
+		std::swap(wave.m_ray_paths, wave.m_next_paths);
+		wave.m_ray_count = next_count;
+	}
+
+	void WavefrontPathIntegrator::AddSamplesToFilm(Theia::UInt64 first_sample, Theia::UInt32 path_count) {
+		Theia::WavefrontPathIntegrator::Wave& wave = *m_wave;
+		const Theia::AABB2i& bounds = m_film.GetPixelBounds();
+		Theia::UInt64 width = Theia::UInt64(bounds.m_max.m_x - bounds.m_min.m_x);
+		Theia::UInt64 samples_per_pixel = m_options.m_samples_per_pixel;
+		Theia::UInt64 end_sample = first_sample + path_count;
+		// One pixel per iteration, so no two threads add to the same pixel; the first and last pixel may have samples in the neighbouring waves, which are added before and after this one.
+		Theia::ParallelFor(Theia::Int64(first_sample / samples_per_pixel), Theia::Int64((end_sample + samples_per_pixel - 1) / samples_per_pixel), [&](Theia::Int64 pixel_index) {
+			Theia::Point2i pixel(bounds.m_min.m_x + Theia::Int32(Theia::UInt64(pixel_index) % width), bounds.m_min.m_y + Theia::Int32(Theia::UInt64(pixel_index) / width));
+			Theia::UInt64 begin = std::max(first_sample, Theia::UInt64(pixel_index) * samples_per_pixel);
+			Theia::UInt64 end = std::min(end_sample, Theia::UInt64(pixel_index + 1) * samples_per_pixel);
+			for (Theia::UInt64 sample_index = begin; sample_index < end; sample_index++) {
+				Theia::UInt32 path = Theia::UInt32(sample_index - first_sample);
+				m_film.AddSample(pixel, wave.m_radiance[path], wave.m_filter_weight[path]);
+			}
+		}, 0, m_pool);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef _THEIA_RENDER_WAVEFRONT_PATH_INTEGRATOR_H_
+#define _THEIA_RENDER_WAVEFRONT_PATH_INTEGRATOR_H_
+#include "IIntegrator.h"
+#include "Film.h"
+#include "PathTracing.h"
+#include "../Accelerator/RaySorter.h"
+#include "../Engine/ICamera.h"
+#include "../Parallel/ThreadPool.h"
+#include <memory>
+
+namespace Theia {
+	typedef struct WavefrontPathIntegratorOptions {
+		Theia::UInt32 m_samples_per_pixel = 16;
+		// Surfaces a path scatters from, as for PathIntegrator.
+		Theia::UInt32 m_max_depth = 5;
+		// Paths in flight at once. Larger waves give the stages longer queues to work through, at the cost of memory for the state of every path.
+		Theia::UInt32 m_wave_size = 1u << 18;
+		// Queue entries a thread takes at a time in every stage.
+		Theia::UInt32 m_batch_size = 4096;
+		Theia::BVHTraversal m_traversal = Theia::BVHTraversal::Automatic;
+		// Sorts the bounce rays of every wave with a RaySorter before they are traced, so that later stages also work through the paths in that order. Camera rays are coherent already and are never sorted.
+		bool m_sort_rays = false;
+		Theia::UInt64 m_seed = 0;
+	} WavefrontPathIntegratorOptions;
+
+	typedef struct WavefrontStatistics {
+		Theia::Float64 m_render_milliseconds = 0.0;
+		// Time of every stage, summed over the waves.
+		Theia::Float64 m_camera_milliseconds = 0.0;
+		Theia::Float64 m_sort_milliseconds = 0.0;
+		Theia::Float64 m_intersect_milliseconds = 0.0;
+		// Sorting hits into the queues of their material types and compacting the queues between stages.
+		Theia::Float64 m_queue_milliseconds = 0.0;
+		Theia::Float64 m_shade_milliseconds = 0.0;
+		Theia::Float64 m_shadow_milliseconds = 0.0;
+		Theia::Float64 m_film_milliseconds = 0.0;
+		Theia::UInt32 m_thread_count = 0;
+		Theia::UInt32 m_wave_count = 0;
+		Theia::UInt64 m_sample_count = 0;
+		Theia::UInt64 m_ray_count = 0;
+		Theia::UInt64 m_shadow_ray_count = 0;
+	} WavefrontStatistics;
+
+	// Path tracer that advances a whole wave of paths one stage at a time instead of following each path to its end: camera rays for every path of the wave, then the closest hits of all rays, then shading, then all shadow rays, and so on for every bounce. The state of the paths is kept in arrays of one field each, and every stage runs over compact queues in batches spread across the pool. Hits are sorted into a queue per material type, so each shading kernel runs over a run of vertices of one type with no branching on the material.
+	// Samples are seeded like those of the tile integrators and are added to the film in sample order, so the image equals that of PathIntegrator with the same seed, whatever the wave size or thread count.
+	class WavefrontPathIntegrator : public Theia::IIntegrator {
+	public:
+		WavefrontPathIntegrator(const Theia::ICamera& camera, Theia::Film& film, const Theia::PathTracingScene& scene, const Theia::WavefrontPathIntegratorOptions& options = Theia::WavefrontPathIntegratorOptions(), Theia::ThreadPool& pool = Theia::ThreadPool::Default());
+		~WavefrontPathIntegrator();
+
+		// Adds m_samples_per_pixel samples to every pixel of the film.
+		void Integrate() override;
+
+		const Theia::WavefrontStatistics& GetStatistics() const;
+	protected:
+	private:
+		struct Wave;
+
+		// Stages of one wave, which holds the samples [first_sample, first_sample + path count).
+		void GenerateCameraRays(Theia::UInt64 first_sample, Theia::UInt32 path_count);
+		void SortRays();
+		void IntersectRays();
+		void SortByMaterial();
+		template <Theia::MaterialType Type> void ShadeVertices(Theia::UInt32 depth);
+		void TraceShadowRays();
+		void ContinuePaths();
+		void AddSamplesToFilm(Theia::UInt64 first_sample, Theia::UInt32 path_count);
+
+		// Calls function(begin, end) for batches of [0, count) on the threads of the pool.
+		template <typename F> void ForEachBatch(Theia::UInt32 count, const F& function);
+
+		const Theia::ICamera& m_camera;
+		Theia::Film& m_film;
+		const Theia::PathTracingScene& m_scene;
+		Theia::WavefrontPathIntegratorOptions m_options;
+		Theia::ThreadPool& m_pool;
+		Theia::WavefrontStatistics m_statistics;
+		std::unique_ptr<Theia::WavefrontPathIntegrator::Wave> m_wave;
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,1198 @@
+#include "PBRTParser.h"
+#include "../IO/MappedFile.h"
+#include "../IO/Parsing.h"
+#include "../Parallel/TaskGraph.h"
+#include "../Shape/Cylinder.h"
+#include "../Shape/Disk.h"
+#include "../Shape/Sphere.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+namespace Theia {
+	const Theia::PBRTParameter* PBRTParameterList::Find(const std::string& name) const {
+		for (const Theia::PBRTParameter& parameter : m_parameters) {
+			if (parameter.m_name == name) {
+				return &parameter;
+			}
+		}
+		return nullptr;
+	}
+
+	Theia::Float PBRTParameterList::GetFloat(const std::string& name, Theia::Float default_value) const {
+		const Theia::PBRTParameter* parameter = Find(name);
+		return parameter && !parameter->m_floats.empty() ? parameter->m_floats[0] : default_value;
+	}
+
+	Theia::Int32 PBRTParameterList::GetInteger(const std::string& name, Theia::Int32 default_value) const {
+		const Theia::PBRTParameter* parameter = Find(name);
+		return parameter && !parameter->m_integers.empty() ? parameter->m_integers[0] : default_value;
+	}
+
+	bool PBRTParameterList::GetBool(const std::string& name, bool default_value) const {
+		const Theia::PBRTParameter* parameter = Find(name);
+		return parameter && !parameter->m_bools.empty() ? parameter->m_bools[0] != 0 : default_value;
+	}
+
+	std::string PBRTParameterList::GetString(const std::string& name, const std::string& default_value) const {
+		const Theia::PBRTParameter* parameter = Find(name);
+		return parameter && !parameter->m_strings.empty() ? parameter->m_strings[0] : default_value;
+	}
+
+	std::span<const Theia::Float> PBRTParameterList::GetFloats(const std::string& name) const {
+		const Theia::PBRTParameter* parameter = Find(name);
+		return parameter ? std::span<const Theia::Float>(parameter->m_floats) : std::span<const Theia::Float>();
+	}
+
+	std::span<const Theia::Int32> PBRTParameterList::GetIntegers(const std::string& name) const {
+		const Theia::PBRTParameter* parameter = Find(name);
+		return parameter ? std::span<const Theia::Int32>(parameter->m_integers) : std::span<const Theia::Int32>();
+	}
+
+	std::vector<Theia::Point2f> PBRTParameterList::GetPoint2s(const std::string& name) const {
+		std::span<const Theia::Float> values = GetFloats(name);
+		std::vector<Theia::Point2f> points(values.size() / 2);
+		for (size_t i = 0; i < points.size(); i++) {
+			points[i] = Theia::Point2f(values[2 * i], values[2 * i + 1]);
+		}
+		return points;
+	}
+
+	std::vector<Theia::Point3f> PBRTParameterList::GetPoint3s(const std::string& name) const {
+		std::span<const Theia::Float> values = GetFloats(name);
+		std::vector<Theia::Point3f> points(values.size() / 3);
+		for (size_t i = 0; i < points.size(); i++) {
+			points[i] = Theia::Point3f(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+		}
+		return points;
+	}
+
+	std::vector<Theia::Normal3f> PBRTParameterList::GetNormals(const std::string& name) const {
+		std::span<const Theia::Float> values = GetFloats(name);
+		std::vector<Theia::Normal3f> normals(values.size() / 3);
+		for (size_t i = 0; i < normals.size(); i++) {
+			normals[i] = Theia::Normal3f(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+		}
+		return normals;
+	}
+
+	namespace {
+		Theia::Float64 MillisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<Theia::Float64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		Theia::Transform InverseTransform(const Theia::Transform& transform) {
+			return Theia::Transform(transform.GetInverseMatrix(), transform.GetMatrix());
+		}
+
+		// Targets of the Attribute directive, whose parameters are added to every later entity of that kind.
+		constexpr const char* Attribute_Targets[] = { "shape", "light", "material", "medium", "texture" };
+		constexpr Theia::UInt32 Attribute_Target_Count = 5;
+		constexpr Theia::UInt32 Shape_Attributes = 0;
+		constexpr Theia::UInt32 Light_Attributes = 1;
+		constexpr Theia::UInt32 Material_Attributes = 2;
+		constexpr Theia::UInt32 Medium_Attributes = 3;
+		constexpr Theia::UInt32 Texture_Attributes = 4;
+
+		typedef struct GraphicsState {
+			// Current transformation matrix at the start and end of the shutter interval.
+			std::array<Theia::Transform, 2> m_ctm;
+			std::array<bool, 2> m_is_active = { true, true };
+			bool m_reverse_orientation = false;
+			Theia::Int32 m_material_index = 0;
+			std::string m_material_name;
+			Theia::Int32 m_area_light_index = -1;
+			std::string m_inside_medium, m_outside_medium;
+			std::array<Theia::PBRTParameterList, Attribute_Target_Count> m_attributes;
+		} GraphicsState;
+
+		// The scene contents of one file and its includes. Material and area light indices below the bases refer to entities of the importing file, the others to this file's own, offset by the base.
+		typedef struct Fragment {
+			Theia::PBRTScene m_scene;
+			Theia::Int32 m_material_base = 0;
+			Theia::Int32 m_area_light_base = 0;
+			std::vector<std::unique_ptr<Fragment>> m_imports;
+		} Fragment;
+
+		// Shared by the parsers of all files and the tasks they start.
+		typedef struct ParseContext {
+			Theia::PBRTParseOptions m_options;
+			std::string m_directory;
+			Theia::TaskGraph* m_task_graph;
+			std::mutex m_mutex;
+			std::vector<Theia::TaskHandle> m_import_tasks;
+			std::vector<std::string> m_errors;
+			std::vector<std::string> m_warnings;
+			std::atomic<Theia::UInt32> m_file_count = 0;
+			std::atomic<Theia::UInt64> m_scene_bytes = 0;
+			std::atomic<Theia::UInt64> m_mesh_bytes = 0;
+			std::atomic<Theia::Float64> m_import_task_milliseconds = 0.0;
+			std::atomic<Theia::Float64> m_shape_task_milliseconds = 0.0;
+			std::atomic<Theia::Float64> m_bvh_task_milliseconds = 0.0;
+		} ParseContext;
+
+		std::string ResolvePath(const ParseContext& context, const std::string& name) {
+			std::filesystem::path path(name);
+			return path.is_absolute() || context.m_directory.empty() ? name : (std::filesystem::path(context.m_directory) / path).string();
+		}
+
+		void AddMessage(ParseContext& context, std::vector<std::string>& messages, std::string message) {
+			std::lock_guard<std::mutex> lock(context.m_mutex);
+			messages.push_back(std::move(message));
+		}
+
+		// Empty when the vertex attributes and indices of a mesh with corner_count corners per face fit together.
+		std::string CheckMesh(size_t vertex_count, std::span<const Theia::UInt32> indices, size_t corner_count, size_t normal_count, size_t uv_count) {
+			if (vertex_count == 0) {
+				return "has no vertices";
+			}
+			else if (indices.empty() || indices.size() % corner_count != 0) {
+				return "needs a multiple of " + std::to_string(corner_count) + " indices";
+			}
+			else if (std::any_of(indices.begin(), indices.end(), [&](Theia::UInt32 index) { return index >= vertex_count; })) {
+				return "has an index out of range";
+			}
+			else if (normal_count != 0 && normal_count != vertex_count) {
+				return "needs one normal per vertex";
+			}
+			else if (uv_count != 0 && uv_count != vertex_count) {
+				return "needs one uv per vertex";
+			}
+			return "";
+		}
+
+		std::vector<Theia::UInt32> GetIndices(const Theia::PBRTParameterList& parameters, size_t vertex_count, size_t corner_count) {
+			std::span<const Theia::Int32> values = parameters.GetIntegers("indices");
+			if (values.empty() && vertex_count == corner_count) {
+				std::vector<Theia::UInt32> indices(corner_count);
+				std::iota(indices.begin(), indices.end(), 0);
+				return indices;
+			}
+			// Negative indices wrap around to values that CheckMesh rejects.
+			return std::vector<Theia::UInt32>(values.begin(), values.end());
+		}
+
+		// Fills geometry for the shape, returning an error message, or "unsupported" for shape types without an implementation.
+		std::string CreateShapeGeometry(ParseContext& context, const Theia::PBRTShape& shape, Theia::PBRTShapeGeometry& geometry) {
+			const Theia::PBRTEntity& entity = shape.m_entity;
+			const Theia::PBRTParameterList& parameters = entity.m_parameters;
+			constexpr Theia::Float Radians_Per_Degree = Theia::Pi / 180.0f;
+
+			if (entity.m_type == "trianglemesh") {
+				std::vector<Theia::Point3f> positions = parameters.GetPoint3s("P");
+				std::vector<Theia::UInt32> indices = GetIndices(parameters, positions.size(), 3);
+				std::vector<Theia::Normal3f> normals = parameters.GetNormals("N");
+				std::vector<Theia::Point2f> uvs = parameters.GetPoint2s("uv");
+				std::string error = CheckMesh(positions.size(), indices, 3, normals.size(), uvs.size());
+				if (!error.empty()) {
+					return error;
+				}
+				geometry.m_triangle_mesh = std::make_unique<Theia::TriangleMesh>(entity.m_render_from_object, std::move(positions), std::move(indices), std::move(normals), std::move(uvs));
+			}
+			else if (entity.m_type == "plymesh") {
+				std::string filename = parameters.GetString("filename", "");
+				if (filename.empty()) {
+					return "needs a filename";
+				}
+				Theia::MeshReadResult result = Theia::ReadPLY(ResolvePath(context, filename), entity.m_render_from_object, context.m_options.m_mesh_read_options);
+				if (!result.m_mesh) {
+					return result.m_error;
+				}
+				context.m_mesh_bytes += result.m_file_bytes;
+				geometry.m_triangle_mesh = std::move(result.m_mesh);
+			}
+			else if (entity.m_type == "sphere" || entity.m_type == "disk" || entity.m_type == "cylinder") {
+				geometry.m_render_from_object = std::make_unique<Theia::Transform>(entity.m_render_from_object);
+				Theia::Float radius = parameters.GetFloat("radius", 1.0f);
+				Theia::Float phi_max = std::clamp(parameters.GetFloat("phimax", 360.0f), 0.0f, 360.0f) * Radians_Per_Degree;
+				if (entity.m_type == "sphere") {
+					geometry.m_quadric = std::make_unique<Theia::Sphere>(geometry.m_render_from_object.get(), radius, parameters.GetFloat("zmin", -radius), parameters.GetFloat("zmax", radius), phi_max);
+				}
+				else if (entity.m_type == "disk") {
+					geometry.m_quadric = std::make_unique<Theia::Disk>(geometry.m_render_from_object.get(), radius, parameters.GetFloat("innerradius", 0.0f), parameters.GetFloat("height", 0.0f), phi_max);
+				}
+				else {
+					geometry.m_quadric = std::make_unique<Theia::Cylinder>(geometry.m_render_from_object.get(), radius, parameters.GetFloat("zmin", -1.0f), parameters.GetFloat("zmax", 1.0f), phi_max);
+				}
+				geometry.m_primitives.push_back(geometry.m_quadric.get());
+			}
+			else if (entity.m_type == "bilinearmesh") {
+				std::vector<Theia::Point3f> positions = parameters.GetPoint3s("P");
+				std::vector<Theia::UInt32> indices = GetIndices(parameters, positions.size(), 4);
+				std::vector<Theia::Normal3f> normals = parameters.GetNormals("N");
+				std::vector<Theia::Point2f> uvs = parameters.GetPoint2s("uv");
+				std::string error = CheckMesh(positions.size(), indices, 4, normals.size(), uvs.size());
+				if (!error.empty()) {
+					return error;
+				}
+				geometry.m_bilinear_patch_mesh = std::make_unique<Theia::BilinearPatchMesh>(entity.m_render_from_object, std::move(positions), std::move(indices), std::move(normals), std::move(uvs));
+				geometry.m_bilinear_patches = Theia::BilinearPatch::CreatePatches(geometry.m_bilinear_patch_mesh.get());
+				for (Theia::BilinearPatch& patch : geometry.m_bilinear_patches) {
+					geometry.m_primitives.push_back(&patch);
+				}
+			}
+			else if (entity.m_type == "curve") {
+				std::vector<Theia::Point3f> control_points = parameters.GetPoint3s("P");
+				std::vector<Theia::Normal3f> normals = parameters.GetNormals("N");
+				std::string basis_name = parameters.GetString("basis", "bezier");
+				std::string type_name = parameters.GetString("type", "flat");
+				if (parameters.GetInteger("degree", 3) != 3) {
+					return "only supports cubic curves";
+				}
+				else if (basis_name != "bezier" && basis_name != "bspline") {
+					return "has an unknown basis \"" + basis_name + "\"";
+				}
+				else if (type_name != "flat" && type_name != "cylinder" && type_name != "ribbon") {
+					return "has an unknown type \"" + type_name + "\"";
+				}
+
+				Theia::CurveBasis basis = basis_name == "bezier" ? Theia::CurveBasis::Bezier : Theia::CurveBasis::BSpline;
+				Theia::CurveType type = type_name == "flat" ? Theia::CurveType::Flat : (type_name == "cylinder" ? Theia::CurveType::Cylinder : Theia::CurveType::Ribbon);
+				if (control_points.size() < 4 || (basis == Theia::CurveBasis::Bezier && (control_points.size() - 1) % 3 != 0)) {
+					return "has the wrong number of control points";
+				}
+				size_t segment_count = basis == Theia::CurveBasis::Bezier ? (control_points.size() - 1) / 3 : control_points.size() - 3;
+				if (type == Theia::CurveType::Ribbon && normals.size() != segment_count + 1) {
+					return "needs one normal per segment end";
+				}
+
+				Theia::Float width = parameters.GetFloat("width", 1.0f);
+				Theia::UInt32 split_count = Theia::UInt32(1) << std::clamp(parameters.GetInteger("splitdepth", 3), 0, 10);
+				geometry.m_curve_commons = Theia::CurveCommon::CreateStrand(entity.m_render_from_object, control_points, basis, parameters.GetFloat("width0", width), parameters.GetFloat("width1", width), type, normals);
+				for (const Theia::CurveCommon& common : geometry.m_curve_commons) {
+					std::vector<Theia::Curve> curves = Theia::Curve::CreateCurves(&common, split_count);
+					geometry.m_curves.insert(geometry.m_curves.end(), curves.begin(), curves.end());
+				}
+				for (Theia::Curve& curve : geometry.m_curves) {
+					geometry.m_primitives.push_back(&curve);
+				}
+			}
+			else {
+				return "unsupported";
+			}
+
+			if (geometry.m_triangle_mesh) {
+				geometry.m_triangles = Theia::Triangle::CreateTriangles(geometry.m_triangle_mesh.get());
+				for (Theia::Triangle& triangle : geometry.m_triangles) {
+					geometry.m_primitives.push_back(&triangle);
+				}
+			}
+			return "";
+		}
+
+		void CreateShape(ParseContext& context, Theia::PBRTShape& shape) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::unique_ptr<Theia::PBRTShapeGeometry> geometry = std::make_unique<Theia::PBRTShapeGeometry>();
+			std::string error = CreateShapeGeometry(context, shape, *geometry);
+			if (error == "unsupported") {
+				AddMessage(context, context.m_warnings, shape.m_entity.m_location + ": Shape \"" + shape.m_entity.m_type + "\" is not supported and was skipped.");
+			}
+			else if (!error.empty()) {
+				AddMessage(context, context.m_errors, shape.m_entity.m_location + ": Shape \"" + shape.m_entity.m_type + "\" " + error + ".");
+			}
+			else {
+				shape.m_geometry = std::move(geometry);
+			}
+			context.m_shape_task_milliseconds += MillisecondsSince(start);
+		}
+
+		// Parses one file, with the files it includes, into a fragment. Imported files get a parser and a fragment of their own, which start from a copy of the graphics state.
+		class Parser {
+		public:
+			Parser(ParseContext& context, Fragment& fragment, const GraphicsState& graphics_state, const std::map<std::string, std::array<Theia::Transform, 2>>& named_coordinate_systems, bool is_in_world) :
+				m_context(context),
+				m_fragment(fragment),
+				m_graphics_state(graphics_state),
+				m_named_coordinate_systems(named_coordinate_systems),
+				m_is_in_world(is_in_world)
+			{
+
+			}
+
+			// Parses the file, then starts a task for each of its shapes.
+			void ParseFragment(const std::string& path) {
+				ParseFile(path);
+				if (m_has_error) {
+					return;
+				}
+				else if (m_object_index >= 0) {
+					AddMessage(m_context, m_context.m_errors, path + ": ObjectBegin \"" + m_fragment.m_scene.m_objects[m_object_index].m_name + "\" has no ObjectEnd.");
+					return;
+				}
+				else if (!m_graphics_stack.empty()) {
+					AddMessage(m_context, m_context.m_warnings, path + ": AttributeBegin has no AttributeEnd.");
+				}
+
+				if (!m_context.m_options.m_create_shapes) {
+					return;
+				}
+				// The shape vectors of the fragment no longer change, so the tasks can hold on to their shapes.
+				ParseContext& context = m_context;
+				auto add_task = [&](Theia::PBRTShape& shape) {
+					Theia::PBRTShape* shape_pointer = &shape;
+					context.m_task_graph->Add([&context, shape_pointer]() { CreateShape(context, *shape_pointer); });
+				};
+				for (Theia::PBRTShape& shape : m_fragment.m_scene.m_shapes) {
+					add_task(shape);
+				}
+				for (Theia::PBRTObject& object : m_fragment.m_scene.m_objects) {
+					for (Theia::PBRTShape& shape : object.m_shapes) {
+						add_task(shape);
+					}
+				}
+			}
+		protected:
+		private:
+			void ParseFile(const std::string& path) {
+				Theia::MappedFile file(path);
+				if (!file.IsOpen()) {
+					Error("cannot open " + path);
+					return;
+				}
+				m_context.m_file_count++;
+				m_context.m_scene_bytes += file.GetBytes().size();
+
+				// Includes parse in place, so the position in the including file is kept on the stack.
+				std::string file_name = m_file_name;
+				const char* cursor = m_cursor;
+				const char* end = m_end;
+				Theia::UInt32 line = m_line;
+				m_file_name = path;
+				m_cursor = reinterpret_cast<const char*>(file.GetBytes().data());
+				m_end = m_cursor + file.GetBytes().size();
+				m_line = 1;
+
+				while (!m_has_error) {
+					SkipSpace();
+					if (m_cursor == m_end) {
+						break;
+					}
+					std::string_view directive = ReadWord();
+					if (directive.empty()) {
+						Error("expected a directive");
+						break;
+					}
+					ParseDirective(directive);
+				}
+
+				m_file_name = file_name;
+				m_cursor = cursor;
+				m_end = end;
+				m_line = line;
+			}
+
+			void ParseDirective(std::string_view directive) {
+				if (directive == "AttributeBegin") {
+					m_graphics_stack.push_back(m_graphics_state);
+				}
+				else if (directive == "AttributeEnd") {
+					if (m_graphics_stack.empty()) {
+						Error("AttributeEnd has no AttributeBegin");
+						return;
+					}
+					m_graphics_state = std::move(m_graphics_stack.back());
+					m_graphics_stack.pop_back();
+				}
+				else if (directive == "Attribute") {
+					std::string target;
+					Theia::PBRTParameterList parameters;
+					if (!ReadString(target) || !ReadParameters(parameters)) {
+						return;
+					}
+					const char* const* found = std::find_if(std::begin(Attribute_Targets), std::end(Attribute_Targets), [&](const char* name) { return target == name; });
+					if (found == std::end(Attribute_Targets)) {
+						Error("Attribute has an unknown target \"" + target + "\"");
+						return;
+					}
+					std::vector<Theia::PBRTParameter>& attributes = m_graphics_state.m_attributes[found - std::begin(Attribute_Targets)].m_parameters;
+					attributes.insert(attributes.end(), parameters.m_parameters.begin(), parameters.m_parameters.end());
+				}
+				else if (directive == "TransformBegin") {
+					m_transform_stack.push_back(m_graphics_state.m_ctm);
+				}
+				else if (directive == "TransformEnd") {
+					if (m_transform_stack.empty()) {
+						Error("TransformEnd has no TransformBegin");
+						return;
+					}
+					m_graphics_state.m_ctm = m_transform_stack.back();
+					m_transform_stack.pop_back();
+				}
+				else if (directive == "ActiveTransform") {
+					SkipSpace();
+					std::string_view which = ReadWord();
+					if (which == "StartTime") {
+						m_graphics_state.m_is_active = { true, false };
+					}
+					else if (which == "EndTime") {
+						m_graphics_state.m_is_active = { false, true };
+					}
+					else if (which == "All") {
+						m_graphics_state.m_is_active = { true, true };
+					}
+					else {
+						Error("ActiveTransform expects StartTime, EndTime or All");
+					}
+				}
+				else if (directive == "TransformTimes") {
+					Theia::Float times[2];
+					ReadNumbers(times, 2, "TransformTimes");
+				}
+				else if (directive == "Identity") {
+					ApplyTransform([](const Theia::Transform&) { return Theia::Transform(); });
+				}
+				else if (directive == "Translate") {
+					Theia::Float values[3];
+					if (ReadNumbers(values, 3, "Translate")) {
+						Theia::Transform translate = Theia::Translate(Theia::Vector3f(values[0], values[1], values[2]));
+						ApplyTransform([&](const Theia::Transform& ctm) { return ctm * translate; });
+					}
+				}
+				else if (directive == "Scale") {
+					Theia::Float values[3];
+					if (ReadNumbers(values, 3, "Scale")) {
+						Theia::Transform scale = Theia::Scale(Theia::Vector3f(values[0], values[1], values[2]));
+						ApplyTransform([&](const Theia::Transform& ctm) { return ctm * scale; });
+					}
+				}
+				else if (directive == "Rotate") {
+					Theia::Float values[4];
+					if (ReadNumbers(values, 4, "Rotate")) {
+						Theia::Transform rotate = Theia::Rotate(values[0] * Theia::Pi / 180.0f, Theia::Vector3f(values[1], values[2], values[3]));
+						ApplyTransform([&](const Theia::Transform& ctm) { return ctm * rotate; });
+					}
+				}
+				else if (directive == "LookAt") {
+					Theia::Float values[9];
+					if (ReadNumbers(values, 9, "LookAt")) {
+						Theia::Transform look_at = Theia::LookAt(Theia::Point3f(values[0], values[1], values[2]), Theia::Point3f(values[3], values[4], values[5]), Theia::Vector3f(values[6], values[7], values[8]));
+						ApplyTransform([&](const Theia::Transform& ctm) { return ctm * look_at; });
+					}
+				}
+				else if (directive == "ConcatTransform" || directive == "Transform") {
+					Theia::Float values[16];
+					if (!ReadNumbers(values, 16, std::string(directive))) {
+						return;
+					}
+					// The values are the matrix in column-major order.
+					Theia::Mat4 matrix;
+					for (Theia::UInt32 i = 0; i < 4; i++) {
+						for (Theia::UInt32 j = 0; j < 4; j++) {
+							matrix[i][j] = values[4 * j + i];
+						}
+					}
+					Theia::Transform transform(matrix, Theia::Inverse(matrix));
+					bool is_concatenated = directive == "ConcatTransform";
+					ApplyTransform([&](const Theia::Transform& ctm) { return is_concatenated ? ctm * transform : transform; });
+				}
+				else if (directive == "CoordinateSystem") {
+					std::string name;
+					if (ReadString(name)) {
+						m_named_coordinate_systems[name] = m_graphics_state.m_ctm;
+					}
+				}
+				else if (directive == "CoordSysTransform") {
+					std::string name;
+					if (!ReadString(name)) {
+						return;
+					}
+					auto found = m_named_coordinate_systems.find(name);
+					if (found == m_named_coordinate_systems.end()) {
+						Warning("CoordSysTransform has an unknown coordinate system \"" + name + "\"");
+						return;
+					}
+					m_graphics_state.m_ctm = found->second;
+				}
+				else if (directive == "ReverseOrientation") {
+					m_graphics_state.m_reverse_orientation = !m_graphics_state.m_reverse_orientation;
+				}
+				else if (directive == "Option") {
+					ReadParameters(m_fragment.m_scene.m_options);
+				}
+				else if (directive == "ColorSpace") {
+					ReadString(m_fragment.m_scene.m_color_space);
+				}
+				else if (directive == "Camera" || directive == "Sampler" || directive == "Film" || directive == "PixelFilter" || directive == "Integrator" || directive == "Accelerator") {
+					if (m_is_in_world) {
+						Error(std::string(directive) + " must come before WorldBegin");
+						return;
+					}
+					Theia::PBRTEntity entity;
+					if (!ReadEntity(entity, Attribute_Target_Count)) {
+						return;
+					}
+
+					Theia::PBRTScene& scene = m_fragment.m_scene;
+					if (directive == "Camera") {
+						// The CTM at the camera is camera from world; the camera is placed by its inverse.
+						std::array<Theia::Transform, 2> world_from_camera = { InverseTransform(m_graphics_state.m_ctm[0]), InverseTransform(m_graphics_state.m_ctm[1]) };
+						m_named_coordinate_systems["camera"] = world_from_camera;
+						entity.m_render_from_object = world_from_camera[0];
+						scene.m_camera = std::move(entity);
+					}
+					else if (directive == "Sampler") {
+						scene.m_sampler = std::move(entity);
+					}
+					else if (directive == "Film") {
+						scene.m_film = std::move(entity);
+					}
+					else if (directive == "PixelFilter") {
+						scene.m_pixel_filter = std::move(entity);
+					}
+					else if (directive == "Integrator") {
+						scene.m_integrator = std::move(entity);
+					}
+					else {
+						scene.m_accelerator = std::move(entity);
+					}
+				}
+				else if (directive == "WorldBegin") {
+					if (m_is_in_world) {
+						Error("WorldBegin appears twice");
+						return;
+					}
+					m_is_in_world = true;
+					m_graphics_state.m_ctm = { Theia::Transform(), Theia::Transform() };
+					m_named_coordinate_systems["world"] = m_graphics_state.m_ctm;
+				}
+				else if (directive == "WorldEnd") {
+					// Only marks the end of the file in pbrt-v3 scenes.
+				}
+				else if (directive == "MakeNamedMedium") {
+					Theia::PBRTEntity entity;
+					if (!ReadString(entity.m_name) || !ReadParameters(entity.m_parameters)) {
+						return;
+					}
+					AddAttributes(entity.m_parameters, Medium_Attributes);
+					entity.m_type = entity.m_parameters.GetString("type", "");
+					entity.m_render_from_object = m_graphics_state.m_ctm[0];
+					entity.m_location = Location();
+					m_fragment.m_scene.m_media.push_back(std::move(entity));
+				}
+				else if (directive == "MediumInterface") {
+					if (!ReadString(m_graphics_state.m_inside_medium)) {
+						return;
+					}
+					SkipSpace();
+					m_graphics_state.m_outside_medium = m_graphics_state.m_inside_medium;
+					if (m_cursor < m_end && *m_cursor == '"') {
+						ReadString(m_graphics_state.m_outside_medium);
+					}
+				}
+				else if (directive == "Material") {
+					Theia::PBRTEntity entity;
+					if (ReadEntity(entity, Material_Attributes)) {
+						m_fragment.m_scene.m_materials.push_back(std::move(entity));
+						m_graphics_state.m_material_index = m_fragment.m_material_base + Theia::Int32(m_fragment.m_scene.m_materials.size()) - 1;
+						m_graphics_state.m_material_name.clear();
+					}
+				}
+				else if (directive == "MakeNamedMaterial") {
+					Theia::PBRTEntity entity;
+					if (!ReadString(entity.m_name) || !ReadParameters(entity.m_parameters)) {
+						return;
+					}
+					AddAttributes(entity.m_parameters, Material_Attributes);
+					entity.m_type = entity.m_parameters.GetString("type", "");
+					entity.m_render_from_object = m_graphics_state.m_ctm[0];
+					entity.m_location = Location();
+					m_fragment.m_scene.m_named_materials.push_back(std::move(entity));
+				}
+				else if (directive == "NamedMaterial") {
+					if (ReadString(m_graphics_state.m_material_name)) {
+						m_graphics_state.m_material_index = -1;
+					}
+				}
+				else if (directive == "Texture") {
+					Theia::PBRTEntity entity;
+					std::string value_type;
+					if (!ReadString(entity.m_name) || !ReadString(value_type) || !ReadEntity(entity, Texture_Attributes)) {
+						return;
+					}
+					if (value_type == "float") {
+						m_fragment.m_scene.m_float_textures.push_back(std::move(entity));
+					}
+					else if (value_type == "spectrum" || value_type == "color") {
+						m_fragment.m_scene.m_spectrum_textures.push_back(std::move(entity));
+					}
+					else {
+						Error("Texture \"" + entity.m_name + "\" has an unknown value type \"" + value_type + "\"");
+					}
+				}
+				else if (directive == "LightSource") {
+					Theia::PBRTEntity entity;
+					if (ReadEntity(entity, Light_Attributes)) {
+						m_fragment.m_scene.m_lights.push_back(std::move(entity));
+					}
+				}
+				else if (directive == "AreaLightSource") {
+					Theia::PBRTEntity entity;
+					if (ReadEntity(entity, Light_Attributes)) {
+						m_fragment.m_scene.m_area_lights.push_back(std::move(entity));
+						m_graphics_state.m_area_light_index = m_fragment.m_area_light_base + Theia::Int32(m_fragment.m_scene.m_area_lights.size()) - 1;
+					}
+				}
+				else if (directive == "Shape") {
+					Theia::PBRTShape shape;
+					if (!ReadEntity(shape.m_entity, Shape_Attributes)) {
+						return;
+					}
+					shape.m_material_index = m_graphics_state.m_material_index;
+					shape.m_material_name = m_graphics_state.m_material_name;
+					shape.m_area_light_index = m_graphics_state.m_area_light_index;
+					shape.m_inside_medium = m_graphics_state.m_inside_medium;
+					shape.m_reverse_orientation = m_graphics_state.m_reverse_orientation;
+					if (m_object_index >= 0) {
+						m_fragment.m_scene.m_objects[m_object_index].m_shapes.push_back(std::move(shape));
+					}
+					else {
+						m_fragment.m_scene.m_shapes.push_back(std::move(shape));
+					}
+				}
+				else if (directive == "ObjectBegin") {
+					std::string name;
+					if (!ReadString(name)) {
+						return;
+					}
+					else if (m_object_index >= 0) {
+						Error("ObjectBegin \"" + name + "\" is inside another object");
+						return;
+					}
+					// Objects keep their own graphics state, like AttributeBegin.
+					m_graphics_stack.push_back(m_graphics_state);
+					m_object_index = Theia::Int32(m_fragment.m_scene.m_objects.size());
+					Theia::PBRTObject& object = m_fragment.m_scene.m_objects.emplace_back();
+					object.m_name = name;
+				}
+				else if (directive == "ObjectEnd") {
+					if (m_object_index < 0 || m_graphics_stack.empty()) {
+						Error("ObjectEnd has no ObjectBegin");
+						return;
+					}
+					m_object_index = -1;
+					m_graphics_state = std::move(m_graphics_stack.back());
+					m_graphics_stack.pop_back();
+				}
+				else if (directive == "ObjectInstance") {
+					Theia::PBRTInstance instance;
+					if (!ReadString(instance.m_object_name)) {
+						return;
+					}
+					else if (m_object_index >= 0) {
+						Error("ObjectInstance is inside an object");
+						return;
+					}
+					instance.m_render_from_instance = m_graphics_state.m_ctm[0];
+					instance.m_location = Location();
+					m_fragment.m_scene.m_instances.push_back(std::move(instance));
+				}
+				else if (directive == "Include") {
+					std::string name;
+					if (ReadString(name)) {
+						ParseFile(ResolvePath(m_context, name));
+					}
+				}
+				else if (directive == "Import") {
+					std::string name;
+					if (!ReadString(name)) {
+						return;
+					}
+					else if (!m_is_in_world || m_object_index >= 0) {
+						Error("Import must be in the world block and outside objects");
+						return;
+					}
+					Import(ResolvePath(m_context, name));
+				}
+				else {
+					Error("has an unknown directive " + std::string(directive));
+				}
+			}
+
+			void Import(const std::string& path) {
+				std::unique_ptr<Fragment> child = std::make_unique<Fragment>();
+				child->m_material_base = m_fragment.m_material_base + Theia::Int32(m_fragment.m_scene.m_materials.size());
+				child->m_area_light_base = m_fragment.m_area_light_base + Theia::Int32(m_fragment.m_scene.m_area_lights.size());
+				std::shared_ptr<Parser> parser = std::make_shared<Parser>(m_context, *child, m_graphics_state, m_named_coordinate_systems, true);
+				m_fragment.m_imports.push_back(std::move(child));
+
+				ParseContext& context = m_context;
+				Theia::TaskHandle task = m_context.m_task_graph->Add([&context, parser, path]() {
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					parser->ParseFragment(path);
+					context.m_import_task_milliseconds += MillisecondsSince(start);
+				});
+				std::lock_guard<std::mutex> lock(m_context.m_mutex);
+				m_context.m_import_tasks.push_back(task);
+			}
+
+			template <typename F> void ApplyTransform(F function) {
+				for (Theia::UInt32 i = 0; i < 2; i++) {
+					if (m_graphics_state.m_is_active[i]) {
+						m_graphics_state.m_ctm[i] = function(m_graphics_state.m_ctm[i]);
+					}
+				}
+			}
+
+			// Adds the parameters set with Attribute that the entity does not set itself.
+			void AddAttributes(Theia::PBRTParameterList& parameters, Theia::UInt32 attribute_target) {
+				if (attribute_target >= Attribute_Target_Count) {
+					return;
+				}
+				for (const Theia::PBRTParameter& attribute : m_graphics_state.m_attributes[attribute_target].m_parameters) {
+					if (!parameters.Find(attribute.m_name)) {
+						parameters.m_parameters.push_back(attribute);
+					}
+				}
+			}
+
+			// The quoted type and the parameters of a directive like Shape or LightSource.
+			bool ReadEntity(Theia::PBRTEntity& entity, Theia::UInt32 attribute_target) {
+				entity.m_location = Location();
+				if (!ReadString(entity.m_type) || !ReadParameters(entity.m_parameters)) {
+					return false;
+				}
+				AddAttributes(entity.m_parameters, attribute_target);
+				entity.m_render_from_object = m_graphics_state.m_ctm[0];
+				entity.m_medium = m_graphics_state.m_outside_medium;
+				return true;
+			}
+
+			bool ReadParameters(Theia::PBRTParameterList& parameters) {
+				while (true) {
+					SkipSpace();
+					if (m_cursor == m_end || *m_cursor != '"') {
+						return true;
+					}
+
+					std::string declaration;
+					if (!ReadString(declaration)) {
+						return false;
+					}
+					Theia::PBRTParameter parameter;
+					const char* begin = Theia::SkipSpaces(declaration.data(), declaration.data() + declaration.size());
+					const char* type_end = Theia::SkipToken(begin, declaration.data() + declaration.size());
+					const char* name_begin = Theia::SkipSpaces(type_end, declaration.data() + declaration.size());
+					const char* name_end = Theia::SkipToken(name_begin, declaration.data() + declaration.size());
+					parameter.m_type.assign(begin, type_end);
+					parameter.m_name.assign(name_begin, name_end);
+					if (parameter.m_type.empty() || parameter.m_name.empty()) {
+						Error("has a malformed parameter \"" + declaration + "\"");
+						return false;
+					}
+
+					// pbrt-v3 names for the same types.
+					if (parameter.m_type == "point") {
+						parameter.m_type = "point3";
+					}
+					else if (parameter.m_type == "vector") {
+						parameter.m_type = "vector3";
+					}
+					else if (parameter.m_type == "normal") {
+						parameter.m_type = "normal3";
+					}
+					else if (parameter.m_type == "color") {
+						parameter.m_type = "rgb";
+					}
+
+					if (!ReadValues(parameter)) {
+						return false;
+					}
+					parameters.m_parameters.push_back(std::move(parameter));
+				}
+			}
+
+			// A single value, or any number of them in brackets.
+			bool ReadValues(Theia::PBRTParameter& parameter) {
+				SkipSpace();
+				bool is_bracketed = m_cursor < m_end && *m_cursor == '[';
+				if (is_bracketed) {
+					++m_cursor;
+				}
+
+				const std::string& type = parameter.m_type;
+				bool is_string = type == "string" || type == "texture";
+				bool is_numeric = !is_string && type != "bool";
+				for (Theia::UInt32 value_count = 0;; value_count++) {
+					SkipSpace();
+					if (is_bracketed && m_cursor < m_end && *m_cursor == ']') {
+						++m_cursor;
+						break;
+					}
+					else if ((!is_bracketed && value_count == 1) || m_cursor == m_end) {
+						if (is_bracketed) {
+							Error("parameter \"" + parameter.m_name + "\" has no closing bracket");
+							return false;
+						}
+						break;
+					}
+
+					if (*m_cursor == '"') {
+						std::string value;
+						if (!ReadString(value)) {
+							return false;
+						}
+						if (type == "bool" && (value == "true" || value == "false")) {
+							parameter.m_bools.push_back(value == "true");
+						}
+						else if (is_string || type == "spectrum") {
+							parameter.m_strings.push_back(std::move(value));
+						}
+						else {
+							Error("parameter \"" + parameter.m_name + "\" has a string value");
+							return false;
+						}
+					}
+					else if (type == "bool") {
+						std::string_view word = ReadWord();
+						if (word != "true" && word != "false") {
+							Error("parameter \"" + parameter.m_name + "\" has a value that is not true or false");
+							return false;
+						}
+						parameter.m_bools.push_back(word == "true");
+					}
+					else if (type == "integer") {
+						Theia::Int64 value;
+						if (!Theia::ParseInt(m_cursor, m_end, value) || !IsAtDelimiter()) {
+							Error("parameter \"" + parameter.m_name + "\" has a malformed integer");
+							return false;
+						}
+						parameter.m_integers.push_back(Theia::Int32(value));
+					}
+					else if (is_numeric) {
+						Theia::Float value;
+						if (!Theia::ParseFloat(m_cursor, m_end, value) || !IsAtDelimiter()) {
+							Error("parameter \"" + parameter.m_name + "\" has a malformed number");
+							return false;
+						}
+						parameter.m_floats.push_back(value);
+					}
+					else {
+						Error("parameter \"" + parameter.m_name + "\" expects strings");
+						return false;
+					}
+				}
+
+				size_t tuple_size = 1;
+				if (type == "point2" || type == "vector2" || type == "spectrum") {
+					tuple_size = 2;
+				}
+				else if (type == "point3" || type == "vector3" || type == "normal3" || type == "rgb") {
+					tuple_size = 3;
+				}
+				if (parameter.m_floats.size() % tuple_size != 0) {
+					Error("parameter \"" + parameter.m_name + "\" needs a multiple of " + std::to_string(tuple_size) + " values");
+					return false;
+				}
+				return true;
+			}
+
+			// count numbers, in brackets or not.
+			bool ReadNumbers(Theia::Float* values, Theia::UInt32 count, const std::string& directive) {
+				SkipSpace();
+				bool is_bracketed = m_cursor < m_end && *m_cursor == '[';
+				if (is_bracketed) {
+					++m_cursor;
+				}
+				for (Theia::UInt32 i = 0; i < count; i++) {
+					SkipSpace();
+					if (!Theia::ParseFloat(m_cursor, m_end, values[i]) || !IsAtDelimiter()) {
+						Error(directive + " expects " + std::to_string(count) + " numbers");
+						return false;
+					}
+				}
+				SkipSpace();
+				if (is_bracketed) {
+					if (m_cursor == m_end || *m_cursor != ']') {
+						Error(directive + " expects " + std::to_string(count) + " numbers");
+						return false;
+					}
+					++m_cursor;
+				}
+				return true;
+			}
+
+			bool ReadString(std::string& value) {
+				SkipSpace();
+				if (m_cursor == m_end || *m_cursor != '"') {
+					Error("expected a quoted string");
+					return false;
+				}
+
+				value.clear();
+				for (++m_cursor; m_cursor < m_end && *m_cursor != '"'; ++m_cursor) {
+					char c = *m_cursor;
+					if (c == '\n') {
+						break;
+					}
+					else if (c == '\\' && m_cursor + 1 < m_end) {
+						c = *++m_cursor;
+						c = c == 'n' ? '\n' : (c == 't' ? '\t' : (c == 'r' ? '\r' : c));
+					}
+					value += c;
+				}
+				if (m_cursor == m_end || *m_cursor != '"') {
+					Error("has a string without a closing quote");
+					return false;
+				}
+				++m_cursor;
+				return true;
+			}
+
+			// A bare word such as a directive name, empty when the cursor is not on one.
+			std::string_view ReadWord() {
+				const char* begin = m_cursor;
+				while (m_cursor < m_end && !IsAtDelimiter()) {
+					++m_cursor;
+				}
+				return std::string_view(begin, m_cursor - begin);
+			}
+
+			bool IsAtDelimiter() const {
+				if (m_cursor == m_end) {
+					return true;
+				}
+				char c = *m_cursor;
+				return Theia::IsSpace(c) || c == '\n' || c == '"' || c == '[' || c == ']' || c == '#';
+			}
+
+			// Skips white space and comments, counting lines.
+			void SkipSpace() {
+				while (m_cursor < m_end) {
+					if (*m_cursor == '\n') {
+						m_line++;
+						++m_cursor;
+					}
+					else if (Theia::IsSpace(*m_cursor)) {
+						++m_cursor;
+					}
+					else if (*m_cursor == '#') {
+						m_cursor = Theia::FindByte(m_cursor, m_end, '\n');
+					}
+					else {
+						break;
+					}
+				}
+			}
+
+			std::string Location() const {
+				return m_file_name + ":" + std::to_string(m_line);
+			}
+
+			void Error(const std::string& message) {
+				m_has_error = true;
+				AddMessage(m_context, m_context.m_errors, Location() + ": " + message + ".");
+			}
+
+			void Warning(const std::string& message) {
+				AddMessage(m_context, m_context.m_warnings, Location() + ": " + message + ".");
+			}
+
+			ParseContext& m_context;
+			Fragment& m_fragment;
+			GraphicsState m_graphics_state;
+			std::vector<GraphicsState> m_graphics_stack;
+			std::vector<std::array<Theia::Transform, 2>> m_transform_stack;
+			std::map<std::string, std::array<Theia::Transform, 2>> m_named_coordinate_systems;
+			bool m_is_in_world;
+			// Object being defined, in m_fragment.m_scene.m_objects.
+			Theia::Int32 m_object_index = -1;
+			bool m_has_error = false;
+
+			std::string m_file_name;
+			const char* m_cursor = nullptr;
+			const char* m_end = nullptr;
+			Theia::UInt32 m_line = 0;
+		};
+
+		template <typename T> void Append(std::vector<T>& destination, std::vector<T>& source) {
+			destination.insert(destination.end(), std::make_move_iterator(source.begin()), std::make_move_iterator(source.end()));
+		}
+
+		// Moves the contents of child, an import of parent, to the end of parent and renumbers the material and area light indices of its shapes.
+		void AppendFragment(Fragment& parent, Fragment& child) {
+			Theia::Int32 material_offset = parent.m_material_base + Theia::Int32(parent.m_scene.m_materials.size()) - child.m_material_base;
+			Theia::Int32 area_light_offset = parent.m_area_light_base + Theia::Int32(parent.m_scene.m_area_lights.size()) - child.m_area_light_base;
+			auto renumber = [&](std::vector<Theia::PBRTShape>& shapes) {
+				for (Theia::PBRTShape& shape : shapes) {
+					if (shape.m_material_index >= child.m_material_base) {
+						shape.m_material_index += material_offset;
+					}
+					if (shape.m_area_light_index >= child.m_area_light_base) {
+						shape.m_area_light_index += area_light_offset;
+					}
+				}
+			};
+
+			Theia::PBRTScene& scene = parent.m_scene;
+			Theia::PBRTScene& child_scene = child.m_scene;
+			renumber(child_scene.m_shapes);
+			for (Theia::PBRTObject& object : child_scene.m_objects) {
+				renumber(object.m_shapes);
+			}
+			Append(scene.m_materials, child_scene.m_materials);
+			Append(scene.m_named_materials, child_scene.m_named_materials);
+			Append(scene.m_float_textures, child_scene.m_float_textures);
+			Append(scene.m_spectrum_textures, child_scene.m_spectrum_textures);
+			Append(scene.m_media, child_scene.m_media);
+			Append(scene.m_lights, child_scene.m_lights);
+			Append(scene.m_area_lights, child_scene.m_area_lights);
+			Append(scene.m_shapes, child_scene.m_shapes);
+			Append(scene.m_objects, child_scene.m_objects);
+			Append(scene.m_instances, child_scene.m_instances);
+			Append(scene.m_options.m_parameters, child_scene.m_options.m_parameters);
+		}
+
+		// Depth first, so every file's contents are followed by those of its imports in order.
+		void FlattenImports(Fragment& fragment) {
+			for (std::unique_ptr<Fragment>& child : fragment.m_imports) {
+				FlattenImports(*child);
+				AppendFragment(fragment, *child);
+			}
+			fragment.m_imports.clear();
+		}
+
+		std::string JoinLines(std::vector<std::string>& lines) {
+			std::string joined;
+			for (const std::string& line : lines) {
+				joined += (joined.empty() ? "" : "\n") + line;
+			}
+			return joined;
+		}
+	}
+
+	Theia::PBRTParseResult ParsePBRT(const std::string& path, const Theia::PBRTParseOptions& options) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Theia::TaskGraph task_graph(options.m_thread_count);
+		ParseContext context;
+		context.m_options = options;
+		context.m_directory = std::filesystem::path(path).parent_path().string();
+		context.m_task_graph = &task_graph;
+
+		Fragment root;
+		Theia::PBRTScene& scene = root.m_scene;
+		// pbrt-v4 defaults for directives the file leaves out.
+		scene.m_camera.m_type = "perspective";
+		scene.m_film.m_type = "rgb";
+		scene.m_sampler.m_type = "zsobol";
+		scene.m_integrator.m_type = "volpath";
+		scene.m_pixel_filter.m_type = "gaussian";
+		scene.m_accelerator.m_type = "bvh";
+		scene.m_color_space = "srgb";
+		Theia::PBRTEntity& default_material = scene.m_materials.emplace_back();
+		default_material.m_type = "diffuse";
+
+		Parser parser(context, root, GraphicsState(), {}, false);
+		parser.ParseFragment(path);
+		Theia::PBRTParseStatistics& statistics = scene.m_statistics;
+		statistics.m_parse_milliseconds = MillisecondsSince(start);
+
+		// Imports add their own imports to the list while it is being waited on.
+		std::chrono::steady_clock::time_point stage_start = std::chrono::steady_clock::now();
+		for (size_t i = 0;; i++) {
+			Theia::TaskHandle task;
+			{
+				std::lock_guard<std::mutex> lock(context.m_mutex);
+				if (i == context.m_import_tasks.size()) {
+					break;
+				}
+				task = context.m_import_tasks[i];
+			}
+			task_graph.Wait(task);
+		}
+		statistics.m_import_milliseconds = MillisecondsSince(stage_start);
+
+		stage_start = std::chrono::steady_clock::now();
+		task_graph.Wait();
+		statistics.m_shape_milliseconds = MillisecondsSince(stage_start);
+
+		Theia::PBRTParseResult result;
+		if (!context.m_errors.empty()) {
+			// Sorted, as tasks report them in any order.
+			std::sort(context.m_errors.begin(), context.m_errors.end());
+			result.m_error = JoinLines(context.m_errors);
+			return result;
+		}
+		FlattenImports(root);
+
+		stage_start = std::chrono::steady_clock::now();
+		std::unordered_map<std::string, Theia::UInt32> object_indices;
+		for (Theia::UInt32 i = 0; i < scene.m_objects.size(); i++) {
+			if (!object_indices.emplace(scene.m_objects[i].m_name, i).second) {
+				context.m_warnings.push_back("ObjectBegin \"" + scene.m_objects[i].m_name + "\" is defined more than once; instances use the first definition.");
+			}
+		}
+
+		auto add_primitives = [](const std::vector<Theia::PBRTShape>& shapes, std::vector<Theia::Primitive>& primitives) {
+			for (const Theia::PBRTShape& shape : shapes) {
+				if (shape.m_geometry) {
+					primitives.insert(primitives.end(), shape.m_geometry->m_primitives.begin(), shape.m_geometry->m_primitives.end());
+				}
+			}
+		};
+		add_primitives(scene.m_shapes, scene.m_primitives);
+		statistics.m_primitive_count = scene.m_primitives.size();
+		statistics.m_shape_count = Theia::UInt32(scene.m_shapes.size());
+		std::vector<std::vector<Theia::Primitive>> object_primitives(scene.m_objects.size());
+		for (Theia::UInt32 i = 0; i < scene.m_objects.size(); i++) {
+			add_primitives(scene.m_objects[i].m_shapes, object_primitives[i]);
+			statistics.m_primitive_count += object_primitives[i].size();
+			statistics.m_shape_count += Theia::UInt32(scene.m_objects[i].m_shapes.size());
+		}
+
+		if (options.m_build_bvh) {
+			std::vector<Theia::TaskHandle> object_tasks;
+			for (Theia::UInt32 i = 0; i < scene.m_objects.size(); i++) {
+				std::vector<Theia::Primitive>& primitives = object_primitives[i];
+				if (primitives.empty()) {
+					continue;
+				}
+				Theia::PBRTObject& object = scene.m_objects[i];
+				Theia::PBRTObject* object_pointer = &object;
+				object_tasks.push_back(task_graph.Add([&context, &options, object_pointer, primitives = std::move(primitives)]() mutable {
+					std::chrono::steady_clock::time_point task_start = std::chrono::steady_clock::now();
+					object_pointer->m_bvh = std::make_unique<Theia::BVHAggregate>(std::move(primitives), options.m_bvh_options);
+					context.m_bvh_task_milliseconds += MillisecondsSince(task_start);
+				}));
+			}
+
+			// Instances need the bounds of their objects, so the scene BVH waits for every object BVH.
+			task_graph.Add([&]() {
+				std::chrono::steady_clock::time_point task_start = std::chrono::steady_clock::now();
+				for (Theia::PBRTInstance& instance : scene.m_instances) {
+					auto found = object_indices.find(instance.m_object_name);
+					if (found == object_indices.end() || !scene.m_objects[found->second].m_bvh) {
+						AddMessage(context, context.m_warnings, instance.m_location + ": ObjectInstance \"" + instance.m_object_name + "\" has no object with primitives.");
+						continue;
+					}
+					instance.m_instance = std::make_unique<Theia::Instance>(scene.m_objects[found->second].m_bvh.get(), instance.m_render_from_instance);
+					scene.m_primitives.push_back(instance.m_instance.get());
+				}
+				if (!scene.m_primitives.empty()) {
+					scene.m_bvh = std::make_unique<Theia::BVHAggregate>(scene.m_primitives, options.m_bvh_options);
+				}
+				context.m_bvh_task_milliseconds += MillisecondsSince(task_start);
+			}, object_tasks);
+			task_graph.Wait();
+		}
+		statistics.m_bvh_milliseconds = MillisecondsSince(stage_start);
+
+		std::sort(context.m_warnings.begin(), context.m_warnings.end());
+		scene.m_warnings = std::move(context.m_warnings);
+		statistics.m_total_milliseconds = MillisecondsSince(start);
+		statistics.m_import_task_milliseconds = context.m_import_task_milliseconds;
+		statistics.m_shape_task_milliseconds = context.m_shape_task_milliseconds;
+		statistics.m_bvh_task_milliseconds = context.m_bvh_task_milliseconds;
+		statistics.m_thread_count = task_graph.GetThreadCount();
+		statistics.m_file_count = context.m_file_count;
+		statistics.m_scene_bytes = context.m_scene_bytes;
+		statistics.m_mesh_bytes = context.m_mesh_bytes;
+		result.m_scene = std::make_unique<Theia::PBRTScene>(std::move(scene));
+		return result;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#ifndef _THEIA_SCENE_PBRT_PARSER_H_
+#define _THEIA_SCENE_PBRT_PARSER_H_
+#include "../Accelerator/BVHAggregate.h"
+#include "../Accelerator/Instance.h"
+#include "../IO/MeshReader.h"
+#include "../Shape/BilinearPatch.h"
+#include "../Shape/Curve.h"
+#include "../Shape/Triangle.h"
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Theia {
+	// One "type name" [values] parameter. Integers are kept in m_integers and bools in m_bools; strings, textures and spectra given by name are kept in m_strings; every other type keeps its numbers in m_floats.
+	typedef struct PBRTParameter {
+		std::string m_type;
+		std::string m_name;
+		std::vector<Theia::Float> m_floats;
+		std::vector<Theia::Int32> m_integers;
+		std::vector<std::string> m_strings;
+		std::vector<Theia::UInt8> m_bools;
+	} PBRTParameter;
+
+	class PBRTParameterList {
+	public:
+		// Null when no parameter has the name.
+		const Theia::PBRTParameter* Find(const std::string& name) const;
+
+		Theia::Float GetFloat(const std::string& name, Theia::Float default_value) const;
+		Theia::Int32 GetInteger(const std::string& name, Theia::Int32 default_value) const;
+		bool GetBool(const std::string& name, bool default_value) const;
+		std::string GetString(const std::string& name, const std::string& default_value) const;
+		std::span<const Theia::Float> GetFloats(const std::string& name) const;
+		std::span<const Theia::Int32> GetIntegers(const std::string& name) const;
+		std::vector<Theia::Point2f> GetPoint2s(const std::string& name) const;
+		std::vector<Theia::Point3f> GetPoint3s(const std::string& name) const;
+		std::vector<Theia::Normal3f> GetNormals(const std::string& name) const;
+
+		std::vector<Theia::PBRTParameter> m_parameters;
+	protected:
+	private:
+	};
+
+	// A directive such as Camera "perspective" or LightSource "point" with its parameters, and the state it was given in. m_name is set for named materials, textures and media.
+	typedef struct PBRTEntity {
+		std::string m_type;
+		std::string m_name;
+		Theia::PBRTParameterList m_parameters;
+		Theia::Transform m_render_from_object;
+		// Outside medium of the MediumInterface in effect.
+		std::string m_medium;
+		// "file:line" of the directive.
+		std::string m_location;
+	} PBRTEntity;
+
+	// Shapes, and the meshes they point into, created from one Shape directive. m_primitives points at whichever of them the shape type uses.
+	typedef struct PBRTShapeGeometry {
+		std::unique_ptr<Theia::Transform> m_render_from_object;
+		std::unique_ptr<Theia::TriangleMesh> m_triangle_mesh;
+		std::vector<Theia::Triangle> m_triangles;
+		std::unique_ptr<Theia::BilinearPatchMesh> m_bilinear_patch_mesh;
+		std::vector<Theia::BilinearPatch> m_bilinear_patches;
+		std::vector<Theia::CurveCommon> m_curve_commons;
+		std::vector<Theia::Curve> m_curves;
+		std::unique_ptr<Theia::IShape> m_quadric;
+		std::vector<Theia::Primitive> m_primitives;
+	} PBRTShapeGeometry;
+
+	typedef struct PBRTShape {
+		Theia::PBRTEntity m_entity;
+		// Index of the anonymous material in PBRTScene::m_materials, or -1 when m_material_name names a MakeNamedMaterial.
+		Theia::Int32 m_material_index = -1;
+		std::string m_material_name;
+		// Index in PBRTScene::m_area_lights, -1 when the shape does not emit.
+		Theia::Int32 m_area_light_index = -1;
+		std::string m_inside_medium;
+		bool m_reverse_orientation = false;
+		// Created by a task once the file of the shape is parsed. Null for shape types that are not supported.
+		std::unique_ptr<Theia::PBRTShapeGeometry> m_geometry;
+	} PBRTShape;
+
+	typedef struct PBRTObject {
+		std::string m_name;
+		std::vector<Theia::PBRTShape> m_shapes;
+		// Over the primitives of m_shapes, null when there are none.
+		std::unique_ptr<Theia::BVHAggregate> m_bvh;
+	} PBRTObject;
+
+	typedef struct PBRTInstance {
+		std::string m_object_name;
+		Theia::Transform m_render_from_instance;
+		std::string m_location;
+		// Null when the object does not exist or is empty.
+		std::unique_ptr<Theia::Instance> m_instance;
+	} PBRTInstance;
+
+	typedef struct PBRTParseOptions {
+		// 0 uses one thread per hardware thread.
+		Theia::UInt32 m_thread_count = 0;
+		// Shapes are created in parallel with each other already, so meshes are read with one thread each by default.
+		Theia::MeshReadOptions m_mesh_read_options = { 1 };
+		bool m_create_shapes = true;
+		// Builds the BVHs of objects and of the whole scene once the shapes exist.
+		bool m_build_bvh = true;
+		Theia::BVHBuildOptions m_bvh_options;
+	} PBRTParseOptions;
+
+	// The stages overlap, so each one is timed from the end of the previous one: shapes of a file are created while other imported files are still being parsed. The task times are summed over all threads.
+	typedef struct PBRTParseStatistics {
+		// Main file and its includes, on the calling thread.
+		Theia::Float64 m_parse_milliseconds = 0.0;
+		Theia::Float64 m_import_milliseconds = 0.0;
+		Theia::Float64 m_shape_milliseconds = 0.0;
+		Theia::Float64 m_bvh_milliseconds = 0.0;
+		Theia::Float64 m_total_milliseconds = 0.0;
+		Theia::Float64 m_import_task_milliseconds = 0.0;
+		Theia::Float64 m_shape_task_milliseconds = 0.0;
+		Theia::Float64 m_bvh_task_milliseconds = 0.0;
+		Theia::UInt32 m_thread_count = 0;
+		Theia::UInt32 m_file_count = 0;
+		Theia::UInt64 m_scene_bytes = 0;
+		// Bytes of the PLY files that shapes were read from.
+		Theia::UInt64 m_mesh_bytes = 0;
+		Theia::UInt32 m_shape_count = 0;
+		Theia::UInt64 m_primitive_count = 0;
+	} PBRTParseStatistics;
+
+	// Everything a pbrt-v4 scene file describes, with world space as render space. Shapes are turned into primitives; the other directives are kept as entities for the parts of the renderer that use them.
+	typedef struct PBRTScene {
+		Theia::PBRTEntity m_camera;
+		Theia::PBRTEntity m_film;
+		Theia::PBRTEntity m_sampler;
+		Theia::PBRTEntity m_integrator;
+		Theia::PBRTEntity m_pixel_filter;
+		Theia::PBRTEntity m_accelerator;
+		Theia::PBRTParameterList m_options;
+		std::string m_color_space;
+		// Anonymous Material directives; the first is the default diffuse material.
+		std::vector<Theia::PBRTEntity> m_materials;
+		std::vector<Theia::PBRTEntity> m_named_materials;
+		std::vector<Theia::PBRTEntity> m_float_textures;
+		std::vector<Theia::PBRTEntity> m_spectrum_textures;
+		std::vector<Theia::PBRTEntity> m_media;
+		std::vector<Theia::PBRTEntity> m_lights;
+		std::vector<Theia::PBRTEntity> m_area_lights;
+		std::vector<Theia::PBRTShape> m_shapes;
+		std::vector<Theia::PBRTObject> m_objects;
+		std::vector<Theia::PBRTInstance> m_instances;
+		// Primitives of m_shapes followed by the instances.
+		std::vector<Theia::Primitive> m_primitives;
+		// Over m_primitives, null when the BVH was not requested or the scene is empty.
+		std::unique_ptr<Theia::BVHAggregate> m_bvh;
+		std::vector<std::string> m_warnings;
+		Theia::PBRTParseStatistics m_statistics;
+	} PBRTScene;
+
+	typedef struct PBRTParseResult {
+		// Null when the scene has errors, which are listed in m_error one per line.
+		std::unique_ptr<Theia::PBRTScene> m_scene;
+		std::string m_error;
+	} PBRTParseResult;
+
+	// Parses a pbrt-v4 scene file. Include is read in place, while every Import is parsed by a task of its own; the contents of imported files follow those of the file that imports them, in the order of the Import directives, so the scene does not depend on the thread count. Each file hands its shapes to tasks as soon as it is parsed, and the BVHs are built once every shape exists. Relative paths are resolved against the directory of the main file.
+	Theia::PBRTParseResult ParsePBRT(const std::string& path, const Theia::PBRTParseOptions& options = Theia::PBRTParseOptions());
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,376 @@
+#include "SceneCache.h"
+#include "../Math/Hash.h"
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace Theia {
+	namespace {
+		constexpr char Magic[8] = { 'T', 'H', 'E', 'I', 'A', 'S', 'C', '\0' };
+		constexpr Theia::UInt64 Array_Alignment = 64;
+
+		typedef struct Header {
+			char m_magic[8];
+			Theia::UInt32 m_version;
+			// Caches are not portable between byte orders.
+			Theia::UInt32 m_byte_order;
+			Theia::UInt64 m_source_hash;
+			Theia::UInt64 m_payload_hash;
+			Theia::UInt64 m_file_size;
+			Theia::UInt32 m_mesh_count;
+			Theia::UInt32 m_instance_count;
+			Theia::UInt8 m_padding[16];
+		} Header;
+
+		// Offsets are from the start of the file, 0 for absent arrays.
+		typedef struct MeshRecord {
+			Theia::UInt64 m_positions_offset;
+			Theia::UInt64 m_indices_offset;
+			Theia::UInt64 m_normals_offset;
+			Theia::UInt64 m_uvs_offset;
+			Theia::UInt64 m_nodes_offset;
+			Theia::UInt64 m_primitive_indices_offset;
+			Theia::UInt32 m_vertex_count;
+			Theia::UInt32 m_triangle_count;
+			Theia::UInt32 m_node_count;
+			Theia::UInt32 m_reference_count;
+			Theia::BVHBuildOptions m_bvh_options;
+			Theia::BVHStatistics m_bvh_statistics;
+		} MeshRecord;
+
+		typedef struct InstanceRecord {
+			Theia::UInt32 m_mesh_index;
+			Theia::Float m_render_from_object[16];
+			Theia::Float m_object_from_render[16];
+		} InstanceRecord;
+
+		typedef struct ArrayRange {
+			Theia::UInt64 m_offset;
+			Theia::UInt64 m_size;
+		} ArrayRange;
+
+		static_assert(sizeof(Header) == 64, "SceneCache Header is not 64 bytes");
+		static_assert(std::is_trivially_copyable_v<MeshRecord> && std::is_trivially_copyable_v<InstanceRecord>, "SceneCache records must be trivially copyable");
+		static_assert(sizeof(Theia::Point3f) == 12 && sizeof(Theia::Normal3f) == 12 && sizeof(Theia::Point2f) == 8, "SceneCache vertex layouts are not packed");
+
+		Theia::UInt64 AlignOffset(Theia::UInt64 offset) {
+			return (offset + Array_Alignment - 1) & ~(Array_Alignment - 1);
+		}
+
+		// Arrays in the order Write lays them out, which is also the order they are hashed in.
+		std::vector<ArrayRange> ArrayRanges(std::span<const MeshRecord> mesh_records) {
+			std::vector<ArrayRange> ranges;
+			for (const MeshRecord& record : mesh_records) {
+				ranges.push_back(ArrayRange{ record.m_positions_offset, record.m_vertex_count * sizeof(Theia::Point3f) });
+				ranges.push_back(ArrayRange{ record.m_indices_offset, 3 * Theia::UInt64(record.m_triangle_count) * sizeof(Theia::UInt32) });
+				ranges.push_back(ArrayRange{ record.m_normals_offset, record.m_normals_offset ? record.m_vertex_count * sizeof(Theia::Normal3f) : 0 });
+				ranges.push_back(ArrayRange{ record.m_uvs_offset, record.m_uvs_offset ? record.m_vertex_count * sizeof(Theia::Point2f) : 0 });
+				ranges.push_back(ArrayRange{ record.m_nodes_offset, record.m_node_count * sizeof(Theia::BVHNode) });
+				ranges.push_back(ArrayRange{ record.m_primitive_indices_offset, record.m_reference_count * sizeof(Theia::UInt32) });
+			}
+			return ranges;
+		}
+
+		void ToFloats(const Theia::SquareMatrix<Theia::Float32, 4>& matrix, Theia::Float floats[16]) {
+			for (Theia::UInt32 i = 0; i < 4; ++i) {
+				for (Theia::UInt32 j = 0; j < 4; ++j) {
+					floats[4 * i + j] = matrix[i][j];
+				}
+			}
+		}
+
+		Theia::SquareMatrix<Theia::Float32, 4> FromFloats(const Theia::Float floats[16]) {
+			Theia::SquareMatrix<Theia::Float32, 4> matrix;
+			for (Theia::UInt32 i = 0; i < 4; ++i) {
+				for (Theia::UInt32 j = 0; j < 4; ++j) {
+					matrix[i][j] = floats[4 * i + j];
+				}
+			}
+			return matrix;
+		}
+
+		template <typename T> std::span<const T> ViewArray(std::span<const Theia::UInt8> bytes, Theia::UInt64 offset, Theia::UInt64 count) {
+			if (offset == 0 || count == 0) {
+				return {};
+			}
+			return std::span<const T>(reinterpret_cast<const T*>(bytes.data() + offset), size_t(count));
+		}
+	}
+
+	bool SceneCache::Write(const std::string& path, Theia::UInt64 source_hash, std::span<const Theia::SceneCacheMesh> meshes, std::span<const Theia::SceneCacheInstance> instances) {
+		std::vector<MeshRecord> mesh_records(meshes.size());
+		Theia::UInt64 offset = AlignOffset(sizeof(Header) + meshes.size() * sizeof(MeshRecord) + instances.size() * sizeof(InstanceRecord));
+		auto allocate = [&](Theia::UInt64 size) {
+			if (size == 0) {
+				return Theia::UInt64(0);
+			}
+			Theia::UInt64 array_offset = offset;
+			offset = AlignOffset(offset + size);
+			return array_offset;
+		};
+
+		for (size_t i = 0; i < meshes.size(); ++i) {
+			const Theia::TriangleMesh* mesh = meshes[i].m_mesh;
+			// Value-initialized and written field by field, so the padding that is hashed and written stays zero.
+			MeshRecord record{};
+			record.m_vertex_count = mesh->VertexCount();
+			record.m_triangle_count = mesh->TriangleCount();
+			record.m_positions_offset = allocate(record.m_vertex_count * sizeof(Theia::Point3f));
+			record.m_indices_offset = allocate(3 * Theia::UInt64(record.m_triangle_count) * sizeof(Theia::UInt32));
+			record.m_normals_offset = mesh->HasNormals() ? allocate(record.m_vertex_count * sizeof(Theia::Normal3f)) : 0;
+			record.m_uvs_offset = mesh->HasUVs() ? allocate(record.m_vertex_count * sizeof(Theia::Point2f)) : 0;
+
+			if (meshes[i].m_bvh) {
+				record.m_node_count = Theia::UInt32(meshes[i].m_bvh->GetNodes().size());
+				record.m_reference_count = Theia::UInt32(meshes[i].m_bvh->GetOrderedPrimitives().size());
+				const Theia::BVHBuildOptions& options = meshes[i].m_bvh->GetOptions();
+				record.m_bvh_options.m_split_method = options.m_split_method;
+				record.m_bvh_options.m_max_primitives_in_node = options.m_max_primitives_in_node;
+				record.m_bvh_options.m_spatial_split_alpha = options.m_spatial_split_alpha;
+				record.m_bvh_options.m_spatial_split_budget = options.m_spatial_split_budget;
+				record.m_bvh_options.m_rebuild_threshold = options.m_rebuild_threshold;
+				record.m_bvh_options.m_leaf_format = options.m_leaf_format;
+				record.m_bvh_options.m_group_meshlets = options.m_group_meshlets;
+				const Theia::BVHStatistics& statistics = meshes[i].m_bvh->GetStatistics();
+				record.m_bvh_statistics.m_primitive_count = statistics.m_primitive_count;
+				record.m_bvh_statistics.m_reference_count = statistics.m_reference_count;
+				record.m_bvh_statistics.m_spatial_split_count = statistics.m_spatial_split_count;
+				record.m_bvh_statistics.m_node_count = statistics.m_node_count;
+				record.m_bvh_statistics.m_leaf_count = statistics.m_leaf_count;
+				record.m_bvh_statistics.m_max_depth = statistics.m_max_depth;
+				record.m_bvh_statistics.m_memory_bytes = statistics.m_memory_bytes;
+				record.m_bvh_statistics.m_sah_cost = statistics.m_sah_cost;
+				record.m_nodes_offset = allocate(record.m_node_count * sizeof(Theia::BVHNode));
+				record.m_primitive_indices_offset = allocate(record.m_reference_count * sizeof(Theia::UInt32));
+			}
+			std::memcpy(&mesh_records[i], &record, sizeof(MeshRecord));
+		}
+
+		std::vector<InstanceRecord> instance_records(instances.size());
+		for (size_t i = 0; i < instances.size(); ++i) {
+			std::memset(&instance_records[i], 0, sizeof(InstanceRecord));
+			instance_records[i].m_mesh_index = instances[i].m_mesh_index;
+			ToFloats(instances[i].m_render_from_object.GetMatrix(), instance_records[i].m_render_from_object);
+			ToFloats(instances[i].m_render_from_object.GetInverseMatrix(), instance_records[i].m_object_from_render);
+		}
+
+		// Written next to the destination and renamed at the end, so an interrupted write never leaves a cache that looks valid.
+		std::string temporary_path = path + ".tmp";
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+
+		Header header;
+		std::memset(&header, 0, sizeof(Header));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(reinterpret_cast<const char*>(mesh_records.data()), mesh_records.size() * sizeof(MeshRecord));
+		file.write(reinterpret_cast<const char*>(instance_records.data()), instance_records.size() * sizeof(InstanceRecord));
+		Theia::UInt64 payload_hash = Theia::HashBuffer(mesh_records.data(), mesh_records.size() * sizeof(MeshRecord));
+		payload_hash = Theia::HashBuffer(instance_records.data(), instance_records.size() * sizeof(InstanceRecord), payload_hash);
+
+		Theia::UInt64 written = sizeof(Header) + mesh_records.size() * sizeof(MeshRecord) + instance_records.size() * sizeof(InstanceRecord);
+		const char zeros[Array_Alignment] = {};
+		auto write_array = [&](Theia::UInt64 array_offset, const void* data, Theia::UInt64 size) {
+			payload_hash = Theia::HashBuffer(data, size, payload_hash);
+			if (array_offset == 0) {
+				return;
+			}
+			file.write(zeros, std::streamsize(array_offset - written));
+			file.write(static_cast<const char*>(data), std::streamsize(size));
+			written = array_offset + size;
+		};
+
+		for (size_t i = 0; i < meshes.size(); ++i) {
+			const Theia::TriangleMesh* mesh = meshes[i].m_mesh;
+			const MeshRecord& record = mesh_records[i];
+
+			std::vector<Theia::Point3f> positions(record.m_vertex_count);
+			for (Theia::UInt32 vertex = 0; vertex < record.m_vertex_count; ++vertex) {
+				positions[vertex] = mesh->Position(vertex);
+			}
+			write_array(record.m_positions_offset, positions.data(), positions.size() * sizeof(Theia::Point3f));
+
+			std::vector<Theia::UInt32> indices(3 * size_t(record.m_triangle_count));
+			for (Theia::UInt32 triangle_index = 0; triangle_index < record.m_triangle_count; ++triangle_index) {
+				const Theia::Meshlet* meshlet = mesh->FindMeshlet(triangle_index);
+				std::array<Theia::UInt32, 3> vertices = mesh->TriangleVertices(triangle_index, meshlet ? meshlet->m_vertex_offset : 0);
+				std::copy(vertices.begin(), vertices.end(), indices.begin() + 3 * size_t(triangle_index));
+			}
+			write_array(record.m_indices_offset, indices.data(), indices.size() * sizeof(Theia::UInt32));
+
+			std::vector<Theia::Normal3f> normals(record.m_normals_offset ? record.m_vertex_count : 0);
+			for (Theia::UInt32 vertex = 0; vertex < normals.size(); ++vertex) {
+				normals[vertex] = mesh->Normal(vertex);
+			}
+			write_array(record.m_normals_offset, normals.data(), normals.size() * sizeof(Theia::Normal3f));
+
+			std::vector<Theia::Point2f> uvs(record.m_uvs_offset ? record.m_vertex_count : 0);
+			for (Theia::UInt32 vertex = 0; vertex < uvs.size(); ++vertex) {
+				uvs[vertex] = mesh->UV(vertex);
+			}
+			write_array(record.m_uvs_offset, uvs.data(), uvs.size() * sizeof(Theia::Point2f));
+
+			std::vector<Theia::UInt32> primitive_indices;
+			if (meshes[i].m_bvh) {
+				for (Theia::Primitive primitive : meshes[i].m_bvh->GetOrderedPrimitives()) {
+					const Theia::Triangle* triangle = dynamic_cast<const Theia::Triangle*>(primitive);
+					if (!triangle || triangle->GetMesh() != mesh) {
+						file.close();
+						std::filesystem::remove(temporary_path);
+						return false;
+					}
+					primitive_indices.push_back(triangle->GetTriangleIndex());
+				}
+			}
+			std::span<const Theia::BVHNode> nodes = meshes[i].m_bvh ? meshes[i].m_bvh->GetNodes() : std::span<const Theia::BVHNode>();
+			write_array(record.m_nodes_offset, nodes.data(), nodes.size() * sizeof(Theia::BVHNode));
+			write_array(record.m_primitive_indices_offset, primitive_indices.data(), primitive_indices.size() * sizeof(Theia::UInt32));
+		}
+		file.write(zeros, std::streamsize(offset - written));
+
+		std::memcpy(header.m_magic, Magic, sizeof(Magic));
+		header.m_version = Version;
+		header.m_byte_order = std::endian::native == std::endian::little ? 1 : 2;
+		header.m_source_hash = source_hash;
+		header.m_payload_hash = payload_hash;
+		header.m_file_size = offset;
+		header.m_mesh_count = Theia::UInt32(meshes.size());
+		header.m_instance_count = Theia::UInt32(instances.size());
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.close();
+		if (!file) {
+			std::filesystem::remove(temporary_path);
+			return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary_path, path, error);
+		return !error;
+	}
+
+	std::unique_ptr<Theia::SceneCache> SceneCache::Open(const std::string& path, Theia::UInt64 source_hash, bool verify_payload) {
+		Theia::MappedFile file(path);
+		std::span<const Theia::UInt8> bytes = file.GetBytes();
+		if (bytes.size() < sizeof(Header)) {
+			return nullptr;
+		}
+
+		Header header;
+		std::memcpy(&header, bytes.data(), sizeof(Header));
+		bool header_matches = std::memcmp(header.m_magic, Magic, sizeof(Magic)) == 0 &&
+			header.m_version == Version &&
+			header.m_byte_order == (std::endian::native == std::endian::little ? 1u : 2u) &&
+			header.m_file_size == bytes.size() &&
+			header.m_source_hash == source_hash;
+		Theia::UInt64 records_size = header.m_mesh_count * sizeof(MeshRecord) + header.m_instance_count * sizeof(InstanceRecord);
+		if (!header_matches || sizeof(Header) + records_size > bytes.size()) {
+			return nullptr;
+		}
+
+		std::span<const MeshRecord> mesh_records(reinterpret_cast<const MeshRecord*>(bytes.data() + sizeof(Header)), header.m_mesh_count);
+		std::span<const InstanceRecord> instance_records(reinterpret_cast<const InstanceRecord*>(bytes.data() + sizeof(Header) + mesh_records.size_bytes()), header.m_instance_count);
+		std::vector<ArrayRange> ranges = ArrayRanges(mesh_records);
+		for (const ArrayRange& range : ranges) {
+			bool is_absent = range.m_offset == 0 && range.m_size == 0;
+			if (!is_absent && (range.m_offset % Array_Alignment != 0 || range.m_offset < sizeof(Header) + records_size || range.m_offset + range.m_size > bytes.size())) {
+				return nullptr;
+			}
+		}
+
+		if (verify_payload) {
+			Theia::UInt64 payload_hash = Theia::HashBuffer(mesh_records.data(), mesh_records.size_bytes());
+			payload_hash = Theia::HashBuffer(instance_records.data(), instance_records.size_bytes(), payload_hash);
+			for (const ArrayRange& range : ranges) {
+				payload_hash = Theia::HashBuffer(bytes.data() + range.m_offset, range.m_size, payload_hash);
+			}
+			if (payload_hash != header.m_payload_hash) {
+				return nullptr;
+			}
+		}
+
+		std::unique_ptr<Theia::SceneCache> scene_cache(new Theia::SceneCache(std::move(file)));
+		scene_cache->m_meshes.reserve(mesh_records.size());
+		scene_cache->m_triangles.reserve(mesh_records.size());
+		scene_cache->m_bvhs.reserve(mesh_records.size());
+		for (const MeshRecord& record : mesh_records) {
+			scene_cache->m_meshes.push_back(std::make_unique<Theia::TriangleMesh>(
+				ViewArray<Theia::Point3f>(bytes, record.m_positions_offset, record.m_vertex_count),
+				ViewArray<Theia::UInt32>(bytes, record.m_indices_offset, 3 * Theia::UInt64(record.m_triangle_count)),
+				ViewArray<Theia::Normal3f>(bytes, record.m_normals_offset, record.m_vertex_count),
+				ViewArray<Theia::Point2f>(bytes, record.m_uvs_offset, record.m_vertex_count)
+			));
+			scene_cache->m_triangles.push_back(Theia::Triangle::CreateTriangles(scene_cache->m_meshes.back().get()));
+
+			if (record.m_node_count == 0) {
+				scene_cache->m_bvhs.push_back(nullptr);
+				continue;
+			}
+
+			std::vector<Theia::Triangle>& triangles = scene_cache->m_triangles.back();
+			std::vector<Theia::Primitive> ordered_primitives(record.m_reference_count);
+			std::span<const Theia::UInt32> primitive_indices = ViewArray<Theia::UInt32>(bytes, record.m_primitive_indices_offset, record.m_reference_count);
+			for (Theia::UInt32 i = 0; i < record.m_reference_count; ++i) {
+				if (primitive_indices[i] >= triangles.size()) {
+					return nullptr;
+				}
+				ordered_primitives[i] = &triangles[primitive_indices[i]];
+			}
+			std::span<const Theia::BVHNode> nodes = ViewArray<Theia::BVHNode>(bytes, record.m_nodes_offset, record.m_node_count);
+			scene_cache->m_bvhs.push_back(std::make_unique<Theia::BVHAggregate>(std::move(ordered_primitives), nodes, record.m_bvh_statistics, record.m_bvh_options));
+		}
+
+		for (const InstanceRecord& record : instance_records) {
+			if (record.m_mesh_index >= mesh_records.size()) {
+				return nullptr;
+			}
+			Theia::Transform render_from_object(FromFloats(record.m_render_from_object), FromFloats(record.m_object_from_render));
+			scene_cache->m_instances.push_back(Theia::SceneCacheInstance{ record.m_mesh_index, render_from_object });
+		}
+		return scene_cache;
+	}
+
+	std::optional<Theia::UInt64> SceneCache::HashFiles(std::span<const std::string> paths) {
+		Theia::UInt64 hash = 0;
+		for (const std::string& path : paths) {
+			Theia::MappedFile file(path);
+			if (!file.IsOpen()) {
+				return {};
+			}
+			std::span<const Theia::UInt8> bytes = file.GetBytes();
+			Theia::UInt64 size = bytes.size();
+			hash = Theia::HashBuffer(&size, sizeof(size), hash);
+			hash = Theia::HashBuffer(bytes.data(), bytes.size(), hash);
+		}
+		return hash;
+	}
+
+	SceneCache::SceneCache(Theia::MappedFile file) :
+		m_file(std::move(file))
+	{
+
+	}
+
+	Theia::UInt32 SceneCache::GetMeshCount() const {
+		return Theia::UInt32(m_meshes.size());
+	}
+
+	const Theia::TriangleMesh* SceneCache::GetMesh(Theia::UInt32 mesh_index) const {
+		return m_meshes[mesh_index].get();
+	}
+
+	std::vector<Theia::Triangle>& SceneCache::GetTriangles(Theia::UInt32 mesh_index) {
+		return m_triangles[mesh_index];
+	}
+
+	const Theia::BVHAggregate* SceneCache::GetBVH(Theia::UInt32 mesh_index) const {
+		return m_bvhs[mesh_index].get();
+	}
+
+	const std::vector<Theia::SceneCacheInstance>& SceneCache::GetInstances() const {
+		return m_instances;
+	}
+}
\ No newline at end of file
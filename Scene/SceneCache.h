@@ -0,0 +1,55 @@
+#ifndef _THEIA_SCENE_SCENE_CACHE_H_
+#define _THEIA_SCENE_SCENE_CACHE_H_
+#include "../Accelerator/BVHAggregate.h"
+#include "../IO/MappedFile.h"
+#include "../Shape/Triangle.h"
+#include "../Shape/TriangleMesh.h"
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Theia {
+	typedef struct SceneCacheMesh {
+		const Theia::TriangleMesh* m_mesh;
+		// Optional BVH over the triangles of m_mesh alone, saved so that opening the cache skips the build.
+		const Theia::BVHAggregate* m_bvh = nullptr;
+	} SceneCacheMesh;
+
+	typedef struct SceneCacheInstance {
+		Theia::UInt32 m_mesh_index;
+		Theia::Transform m_render_from_object;
+	} SceneCacheInstance;
+
+	// Binary snapshot of the geometry of a scene, laid out so that a mapped file is used in place: every array starts on a 64-byte boundary and meshes view it without copying. Opening a cache only touches the headers and the BVH nodes, so an unchanged scene starts tracing without parsing its source files.
+	class SceneCache {
+	public:
+		// Saves meshes in their decoded, indexed form, whatever compression or meshlets they use. source_hash identifies the inputs the scene was loaded from, see HashFiles.
+		static bool Write(const std::string& path, Theia::UInt64 source_hash, std::span<const Theia::SceneCacheMesh> meshes, std::span<const Theia::SceneCacheInstance> instances = {});
+		// Null when the file is missing, truncated, written by another version or for other sources. verify_payload also checks the hash of all arrays, which reads the whole file.
+		static std::unique_ptr<Theia::SceneCache> Open(const std::string& path, Theia::UInt64 source_hash, bool verify_payload = false);
+		// Hash of the contents of the given files, empty if one of them cannot be read.
+		static std::optional<Theia::UInt64> HashFiles(std::span<const std::string> paths);
+
+		Theia::UInt32 GetMeshCount() const;
+		const Theia::TriangleMesh* GetMesh(Theia::UInt32 mesh_index) const;
+		std::vector<Theia::Triangle>& GetTriangles(Theia::UInt32 mesh_index);
+		// Null when the mesh was saved without a BVH.
+		const Theia::BVHAggregate* GetBVH(Theia::UInt32 mesh_index) const;
+		const std::vector<Theia::SceneCacheInstance>& GetInstances() const;
+
+		static constexpr Theia::UInt32 Version = 1;
+	protected:
+	private:
+		explicit SceneCache(Theia::MappedFile file);
+
+		// Declared first so that it is unmapped after everything that views it.
+		Theia::MappedFile m_file;
+		std::vector<std::unique_ptr<Theia::TriangleMesh>> m_meshes;
+		std::vector<std::vector<Theia::Triangle>> m_triangles;
+		std::vector<std::unique_ptr<Theia::BVHAggregate>> m_bvhs;
+		std::vector<Theia::SceneCacheInstance> m_instances;
+	};
+}
+#endif
\ No newline at end of file
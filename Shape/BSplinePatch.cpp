@@ -0,0 +1,71 @@
+#include "BSplinePatch.h"
+
+namespace Theia {
+	namespace {
+		void EvaluateBasis(Theia::Float t, Theia::Float basis[4], Theia::Float derivative[4]) {
+			Theia::Float s = 1.0f - t;
+			basis[0] = s * s * s / 6.0f;
+			basis[1] = (3.0f * t * t * t - 6.0f * t * t + 4.0f) / 6.0f;
+			basis[2] = (-3.0f * t * t * t + 3.0f * t * t + 3.0f * t + 1.0f) / 6.0f;
+			basis[3] = t * t * t / 6.0f;
+
+			derivative[0] = -s * s / 2.0f;
+			derivative[1] = (3.0f * t * t - 4.0f * t) / 2.0f;
+			derivative[2] = (-3.0f * t * t + 2.0f * t + 1.0f) / 2.0f;
+			derivative[3] = t * t / 2.0f;
+		}
+	}
+
+	BSplinePatch::BSplinePatch(const Theia::Transform& render_from_object, const std::array<Theia::Point3f, 16>& control_points) {
+		for (Theia::UInt32 i = 0; i < 16; i++) {
+			m_control_points[i] = render_from_object(control_points[i]);
+			m_bounds = Theia::Union(m_bounds, m_control_points[i]);
+		}
+	}
+
+	// The surface lies in the convex hull of its control points.
+	Theia::AABB3f BSplinePatch::Bounds() const {
+		return m_bounds;
+	}
+
+	Theia::PatchPoint BSplinePatch::Evaluate(const Theia::Point2f& uv) const {
+		Theia::Float basis_u[4], derivative_u[4], basis_v[4], derivative_v[4];
+		EvaluateBasis(uv.m_x, basis_u, derivative_u);
+		EvaluateBasis(uv.m_y, basis_v, derivative_v);
+
+		Theia::Vector3f position(0.0f, 0.0f, 0.0f), dpdu(0.0f, 0.0f, 0.0f), dpdv(0.0f, 0.0f, 0.0f);
+		for (Theia::UInt32 j = 0; j < 4; j++) {
+			for (Theia::UInt32 i = 0; i < 4; i++) {
+				Theia::Vector3f control_point(m_control_points[j * 4 + i].m_x, m_control_points[j * 4 + i].m_y, m_control_points[j * 4 + i].m_z);
+				position += (basis_u[i] * basis_v[j]) * control_point;
+				dpdu += (derivative_u[i] * basis_v[j]) * control_point;
+				dpdv += (basis_u[i] * derivative_v[j]) * control_point;
+			}
+		}
+
+		Theia::Vector3f normal = Theia::Cross(dpdu, dpdv);
+		if (Theia::LengthSquared(normal) > 0.0f) {
+			normal = Theia::Normalize(normal);
+		}
+		return Theia::PatchPoint{ Theia::Point3f(position.m_x, position.m_y, position.m_z), normal };
+	}
+
+	std::vector<Theia::BSplinePatch> BSplinePatch::CreatePatches(const Theia::Transform& render_from_object, std::span<const Theia::Point3f> control_points, Theia::UInt32 width, Theia::UInt32 height) {
+		assert(control_points.size() == size_t(width) * height && width >= 4 && height >= 4, "BSplinePatch::CreatePatches needs a control mesh of at least 4x4 points.");
+
+		std::vector<Theia::BSplinePatch> patches;
+		patches.reserve(size_t(width - 3) * (height - 3));
+		for (Theia::UInt32 y = 0; y + 3 < height; y++) {
+			for (Theia::UInt32 x = 0; x + 3 < width; x++) {
+				std::array<Theia::Point3f, 16> window;
+				for (Theia::UInt32 j = 0; j < 4; j++) {
+					for (Theia::UInt32 i = 0; i < 4; i++) {
+						window[j * 4 + i] = control_points[(y + j) * width + x + i];
+					}
+				}
+				patches.emplace_back(render_from_object, window);
+			}
+		}
+		return patches;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef _THEIA_SHAPE_B_SPLINE_PATCH_H_
+#define _THEIA_SHAPE_B_SPLINE_PATCH_H_
+#include "IParametricPatch.h"
+#include <array>
+#include <span>
+#include <vector>
+
+namespace Theia {
+	// Uniform bicubic B-spline patch over a 4x4 window of control points, which is the Catmull-Clark limit surface of a face whose vertices all have valence 4. The control points are transformed to render space once.
+	class BSplinePatch : public IParametricPatch {
+	public:
+		BSplinePatch(const Theia::Transform& render_from_object, const std::array<Theia::Point3f, 16>& control_points);
+
+		Theia::AABB3f Bounds() const override;
+		Theia::PatchPoint Evaluate(const Theia::Point2f& uv) const override;
+
+		// Patches of a regular control mesh of width x height points in row-major order, one for every interior face, so (width - 3) x (height - 3) patches.
+		static std::vector<Theia::BSplinePatch> CreatePatches(const Theia::Transform& render_from_object, std::span<const Theia::Point3f> control_points, Theia::UInt32 width, Theia::UInt32 height);
+	protected:
+	private:
+		std::array<Theia::Point3f, 16> m_control_points;
+		Theia::AABB3f m_bounds;
+	};
+}
+#endif
\ No newline at end of file
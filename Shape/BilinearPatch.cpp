@@ -0,0 +1,233 @@
+#include "BilinearPatch.h"
+#include "../Math/Sampling.h"
+
+namespace Theia {
+	namespace {
+		// Real roots of a t^2 + b t + c in increasing order, using the form that avoids cancellation between b and the square root.
+		bool SolveQuadratic(Theia::Float a, Theia::Float b, Theia::Float c, Theia::Float& t0, Theia::Float& t1) {
+			if (a == 0.0f) {
+				if (b == 0.0f) {
+					return false;
+				}
+				t0 = t1 = -c / b;
+				return true;
+			}
+
+			Theia::Float discriminant = Theia::DifferenceOfProducts(b, b, 4.0f * a, c);
+			if (discriminant < 0.0f) {
+				return false;
+			}
+
+			Theia::Float q = -0.5f * (b + std::copysign(std::sqrt(discriminant), b));
+			t0 = q / a;
+			t1 = c / q;
+			if (t0 > t1) {
+				std::swap(t0, t1);
+			}
+			return true;
+		}
+	}
+
+	std::optional<Theia::BilinearIntersection> IntersectBilinearPatch(const Theia::Ray& ray, Theia::Float t_max, const Theia::Point3f& p00, const Theia::Point3f& p10, const Theia::Point3f& p01, const Theia::Point3f& p11) {
+		Theia::Point3f origin = ray.GetOrigin();
+		Theia::Vector3f direction = ray.GetDirection();
+
+		// Distance from the ray to the line of constant u, as a quadratic in u.
+		Theia::Float a = Theia::Dot(Theia::Cross(p10 - p00, p01 - p11), direction);
+		Theia::Float c = Theia::Dot(Theia::Cross(p00 - origin, direction), p01 - p00);
+		Theia::Float b = Theia::Dot(Theia::Cross(p10 - origin, direction), p11 - p10) - (a + c);
+
+		Theia::Float u_roots[2];
+		if (!SolveQuadratic(a, b, c, u_roots[0], u_roots[1])) {
+			return {};
+		}
+
+		// Lower bound on t that keeps hits caused by rounding error at the ray origin out.
+		Theia::Float epsilon = Theia::Gamma(10) * (Theia::MaxComponentValue(Theia::Abs(origin - Theia::Point3f())) + Theia::MaxComponentValue(Theia::Abs(direction)) +
+			Theia::MaxComponentValue(Theia::Abs(p00 - Theia::Point3f())) + Theia::MaxComponentValue(Theia::Abs(p10 - Theia::Point3f())) +
+			Theia::MaxComponentValue(Theia::Abs(p01 - Theia::Point3f())) + Theia::MaxComponentValue(Theia::Abs(p11 - Theia::Point3f())));
+
+		Theia::Float t = t_max;
+		Theia::Point2f uv;
+		for (Theia::UInt32 i = 0; i < 2; ++i) {
+			Theia::Float u = u_roots[i];
+			if (u < 0.0f || u > 1.0f || (i == 1 && u == u_roots[0])) {
+				continue;
+			}
+
+			// v and t where the ray meets the line of constant u, from Cramer's rule with the common denominator p2.
+			Theia::Point3f u_origin = Theia::Lerp(u, p00, p10);
+			Theia::Vector3f u_direction = Theia::Lerp(u, p01, p11) - u_origin;
+			Theia::Vector3f delta_origin = u_origin - origin;
+			Theia::Vector3f perpendicular = Theia::Cross(direction, u_direction);
+			Theia::Float p2 = Theia::LengthSquared(perpendicular);
+			Theia::Float v_scaled = Theia::Dot(delta_origin, Theia::Cross(direction, perpendicular));
+			Theia::Float t_scaled = Theia::Dot(delta_origin, Theia::Cross(u_direction, perpendicular));
+			if (v_scaled < 0.0f || v_scaled > p2 || t_scaled <= p2 * epsilon || t_scaled >= t * p2) {
+				continue;
+			}
+
+			uv = Theia::Point2f(u, v_scaled / p2);
+			t = t_scaled / p2;
+		}
+
+		if (t >= t_max) {
+			return {};
+		}
+
+		return Theia::BilinearIntersection{ uv, t };
+	}
+
+	BilinearPatch::BilinearPatch(const Theia::BilinearPatchMesh* mesh, Theia::UInt32 patch_index) :
+		m_mesh(mesh),
+		m_patch_index(patch_index),
+		m_area(0.0f)
+	{
+		const Theia::UInt32* vertices = &m_mesh->m_indices[4 * m_patch_index];
+		const Theia::Point3f& p00 = m_mesh->m_positions[vertices[0]];
+		const Theia::Point3f& p10 = m_mesh->m_positions[vertices[1]];
+		const Theia::Point3f& p01 = m_mesh->m_positions[vertices[2]];
+		const Theia::Point3f& p11 = m_mesh->m_positions[vertices[3]];
+
+		// Sum of the areas of a 3x3 grid of quads, each from the cross product of its diagonals. Exact for planar patches.
+		constexpr Theia::UInt32 grid_size = 3;
+		Theia::Point3f p[grid_size + 1][grid_size + 1];
+		for (Theia::UInt32 i = 0; i <= grid_size; ++i) {
+			Theia::Float u = Theia::Float(i) / Theia::Float(grid_size);
+			for (Theia::UInt32 j = 0; j <= grid_size; ++j) {
+				Theia::Float v = Theia::Float(j) / Theia::Float(grid_size);
+				p[i][j] = Theia::Lerp(v, Theia::Lerp(u, p00, p10), Theia::Lerp(u, p01, p11));
+			}
+		}
+
+		for (Theia::UInt32 i = 0; i < grid_size; ++i) {
+			for (Theia::UInt32 j = 0; j < grid_size; ++j) {
+				m_area += 0.5f * Theia::Length(Theia::Cross(p[i + 1][j + 1] - p[i][j], p[i + 1][j] - p[i][j + 1]));
+			}
+		}
+	}
+
+	Theia::AABB3f BilinearPatch::Bounds() const {
+		const Theia::UInt32* vertices = &m_mesh->m_indices[4 * m_patch_index];
+		Theia::AABB3f aabb = Theia::AABB3f(m_mesh->m_positions[vertices[0]], m_mesh->m_positions[vertices[1]]);
+		return Theia::Union(Theia::Union(aabb, m_mesh->m_positions[vertices[2]]), m_mesh->m_positions[vertices[3]]);
+	}
+
+	std::optional<Theia::ShapeIntersection> BilinearPatch::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		const Theia::UInt32* vertices = &m_mesh->m_indices[4 * m_patch_index];
+		std::optional<Theia::BilinearIntersection> bilinear_intersection = Theia::IntersectBilinearPatch(ray, t_max, m_mesh->m_positions[vertices[0]], m_mesh->m_positions[vertices[1]], m_mesh->m_positions[vertices[2]], m_mesh->m_positions[vertices[3]]);
+
+		if (!bilinear_intersection) {
+			return {};
+		}
+
+		return InteractionFromIntersection(*bilinear_intersection, ray);
+	}
+
+	bool BilinearPatch::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		const Theia::UInt32* vertices = &m_mesh->m_indices[4 * m_patch_index];
+		return Theia::IntersectBilinearPatch(ray, t_max, m_mesh->m_positions[vertices[0]], m_mesh->m_positions[vertices[1]], m_mesh->m_positions[vertices[2]], m_mesh->m_positions[vertices[3]]).has_value();
+	}
+
+	Theia::Float BilinearPatch::Area() const {
+		return m_area;
+	}
+
+	std::optional<Theia::ShapeSample> BilinearPatch::Sample(const Theia::Point2f& u) const {
+		const Theia::UInt32* vertices = &m_mesh->m_indices[4 * m_patch_index];
+		const Theia::Point3f& p00 = m_mesh->m_positions[vertices[0]];
+		const Theia::Point3f& p10 = m_mesh->m_positions[vertices[1]];
+		const Theia::Point3f& p01 = m_mesh->m_positions[vertices[2]];
+		const Theia::Point3f& p11 = m_mesh->m_positions[vertices[3]];
+
+		// (u, v) is drawn in proportion to the bilinear interpolation of the area at the corners, which is uniform over parallelograms and close to it elsewhere; the pdf is then converted from (u, v) to area.
+		std::array<Theia::Float, 4> w = {
+			Theia::Length(Theia::Cross(p10 - p00, p01 - p00)),
+			Theia::Length(Theia::Cross(p10 - p00, p11 - p10)),
+			Theia::Length(Theia::Cross(p01 - p00, p11 - p01)),
+			Theia::Length(Theia::Cross(p11 - p10, p11 - p01))
+		};
+		Theia::Point2f uv = Theia::SampleBilinear(u, w);
+		Theia::Float pdf = Theia::BilinearPDF(uv, w);
+
+		Theia::Vector3f dpdu = Theia::Lerp(uv.m_y, p10, p11) - Theia::Lerp(uv.m_y, p00, p01);
+		Theia::Vector3f dpdv = Theia::Lerp(uv.m_x, p01, p11) - Theia::Lerp(uv.m_x, p00, p10);
+		Theia::Float area_scale = Theia::Length(Theia::Cross(dpdu, dpdv));
+		if (area_scale == 0.0f) {
+			return {};
+		}
+
+		return Theia::ShapeSample{ InteractionAt(uv, 0.0f, Theia::Vector3f(), nullptr), pdf / area_scale };
+	}
+
+	Theia::ShapeIntersection BilinearPatch::InteractionFromIntersection(const Theia::BilinearIntersection& bilinear_intersection, const Theia::Ray& ray) const {
+		return Theia::ShapeIntersection{ InteractionAt(bilinear_intersection.m_uv, ray.GetTime(), -ray.GetDirection(), ray.GetMedium()), bilinear_intersection.m_t };
+	}
+
+	std::vector<Theia::BilinearPatch> BilinearPatch::CreatePatches(const Theia::BilinearPatchMesh* mesh) {
+		std::vector<Theia::BilinearPatch> patches;
+		patches.reserve(mesh->PatchCount());
+
+		for (Theia::UInt32 i = 0; i < mesh->PatchCount(); ++i) {
+			patches.push_back(Theia::BilinearPatch(mesh, i));
+		}
+
+		return patches;
+	}
+
+	Theia::IInteraction BilinearPatch::InteractionAt(const Theia::Point2f& uv, Theia::Float time, const Theia::Vector3f& w_o, const Theia::Medium medium) const {
+		const Theia::UInt32* vertices = &m_mesh->m_indices[4 * m_patch_index];
+		const Theia::Point3f& p00 = m_mesh->m_positions[vertices[0]];
+		const Theia::Point3f& p10 = m_mesh->m_positions[vertices[1]];
+		const Theia::Point3f& p01 = m_mesh->m_positions[vertices[2]];
+		const Theia::Point3f& p11 = m_mesh->m_positions[vertices[3]];
+		Theia::Float u = uv.m_x;
+		Theia::Float v = uv.m_y;
+
+		Theia::Point3f hit = Theia::Lerp(v, Theia::Lerp(u, p00, p10), Theia::Lerp(u, p01, p11));
+		Theia::Vector3f error = Theia::Gamma(6) * Theia::Max(Theia::Max(Theia::Abs(p00 - Theia::Point3f()), Theia::Abs(p10 - Theia::Point3f())), Theia::Max(Theia::Abs(p01 - Theia::Point3f()), Theia::Abs(p11 - Theia::Point3f())));
+		Theia::Point3Interval point_interval = Theia::Point3Interval(
+			Theia::Interval::FromValueAndError(hit.m_x, error.m_x),
+			Theia::Interval::FromValueAndError(hit.m_y, error.m_y),
+			Theia::Interval::FromValueAndError(hit.m_z, error.m_z)
+		);
+
+		// At a degenerate corner one of the derivatives vanishes, and the normal comes from the diagonals instead.
+		Theia::Vector3f dpdu = Theia::Lerp(v, p10, p11) - Theia::Lerp(v, p00, p01);
+		Theia::Vector3f dpdv = Theia::Lerp(u, p01, p11) - Theia::Lerp(u, p00, p10);
+		Theia::Vector3f geometric_normal = Theia::Cross(dpdu, dpdv);
+		if (Theia::LengthSquared(geometric_normal) == 0.0f) {
+			geometric_normal = Theia::Cross(p11 - p00, p01 - p10);
+		}
+		geometric_normal = Theia::Normalize(geometric_normal);
+
+		if (!m_mesh->m_normals.empty()) {
+			const Theia::Normal3f& n00 = m_mesh->m_normals[vertices[0]];
+			const Theia::Normal3f& n10 = m_mesh->m_normals[vertices[1]];
+			const Theia::Normal3f& n01 = m_mesh->m_normals[vertices[2]];
+			const Theia::Normal3f& n11 = m_mesh->m_normals[vertices[3]];
+			Theia::Vector3f shading_normal = Theia::Vector3f(
+				Theia::Lerp(v, Theia::Lerp(u, n00.m_x, n10.m_x), Theia::Lerp(u, n01.m_x, n11.m_x)),
+				Theia::Lerp(v, Theia::Lerp(u, n00.m_y, n10.m_y), Theia::Lerp(u, n01.m_y, n11.m_y)),
+				Theia::Lerp(v, Theia::Lerp(u, n00.m_z, n10.m_z), Theia::Lerp(u, n01.m_z, n11.m_z))
+			);
+			if (Theia::Dot(geometric_normal, shading_normal) < 0.0f) {
+				geometric_normal = -geometric_normal;
+			}
+		}
+
+		Theia::Point2f surface_uv = uv;
+		if (!m_mesh->m_uvs.empty()) {
+			const Theia::Point2f& uv00 = m_mesh->m_uvs[vertices[0]];
+			const Theia::Point2f& uv10 = m_mesh->m_uvs[vertices[1]];
+			const Theia::Point2f& uv01 = m_mesh->m_uvs[vertices[2]];
+			const Theia::Point2f& uv11 = m_mesh->m_uvs[vertices[3]];
+			surface_uv = Theia::Point2f(
+				Theia::Lerp(v, Theia::Lerp(u, uv00.m_x, uv10.m_x), Theia::Lerp(u, uv01.m_x, uv11.m_x)),
+				Theia::Lerp(v, Theia::Lerp(u, uv00.m_y, uv10.m_y), Theia::Lerp(u, uv01.m_y, uv11.m_y))
+			);
+		}
+
+		return Theia::IInteraction(point_interval, time, w_o, Theia::Normal3f(geometric_normal.m_x, geometric_normal.m_y, geometric_normal.m_z), surface_uv, medium);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef _THEIA_SHAPE_BILINEAR_PATCH_H_
+#define _THEIA_SHAPE_BILINEAR_PATCH_H_
+#include "IShape.h"
+#include "BilinearPatchMesh.h"
+#include <vector>
+
+namespace Theia {
+	typedef struct BilinearIntersection {
+		Theia::Point2f m_uv;
+		Theia::Float m_t;
+	} BilinearIntersection;
+
+	// Closest hit of the ray with the patch p(u, v) = Lerp(v, Lerp(u, p00, p10), Lerp(u, p01, p11)), solving the quadratic in u for the line of constant u that the ray crosses.
+	std::optional<Theia::BilinearIntersection> IntersectBilinearPatch(const Theia::Ray& ray, Theia::Float t_max, const Theia::Point3f& p00, const Theia::Point3f& p10, const Theia::Point3f& p01, const Theia::Point3f& p11);
+
+	class BilinearPatch : public IShape {
+	public:
+		BilinearPatch(const Theia::BilinearPatchMesh* mesh, Theia::UInt32 patch_index);
+
+		Theia::AABB3f Bounds() const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		Theia::Float Area() const override;
+		std::optional<Theia::ShapeSample> Sample(const Theia::Point2f& u) const override;
+
+		Theia::ShapeIntersection InteractionFromIntersection(const Theia::BilinearIntersection& bilinear_intersection, const Theia::Ray& ray) const;
+
+		static std::vector<Theia::BilinearPatch> CreatePatches(const Theia::BilinearPatchMesh* mesh);
+	protected:
+	private:
+		Theia::IInteraction InteractionAt(const Theia::Point2f& uv, Theia::Float time, const Theia::Vector3f& w_o, const Theia::Medium medium) const;
+
+		const Theia::BilinearPatchMesh* m_mesh;
+		Theia::UInt32 m_patch_index;
+		Theia::Float m_area;
+	};
+}
+#endif
\ No newline at end of file
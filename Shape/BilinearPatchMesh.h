@@ -0,0 +1,36 @@
+#ifndef _THEIA_SHAPE_BILINEAR_PATCH_MESH_H_
+#define _THEIA_SHAPE_BILINEAR_PATCH_MESH_H_
+#include "../Math/Math.h"
+#include <vector>
+
+namespace Theia {
+	// Quads with shared vertices, stored like TriangleMesh. Each patch takes four indices in the order p00, p10, p01, p11, so the last two are swapped relative to going around the quad.
+	class BilinearPatchMesh {
+	public:
+		BilinearPatchMesh(const Theia::Transform& render_from_object, std::vector<Theia::Point3f> positions, std::vector<Theia::UInt32> indices, std::vector<Theia::Normal3f> normals = {}, std::vector<Theia::Point2f> uvs = {}) :
+			m_positions(std::move(positions)),
+			m_indices(std::move(indices)),
+			m_normals(std::move(normals)),
+			m_uvs(std::move(uvs))
+		{
+			for (Theia::Point3f& position : m_positions) {
+				position = render_from_object(position);
+			}
+
+			for (Theia::Normal3f& normal : m_normals) {
+				normal = render_from_object(normal);
+			}
+		}
+
+		Theia::UInt32 PatchCount() const {
+			return Theia::UInt32(m_indices.size() / 4);
+		}
+
+		std::vector<Theia::Point3f> m_positions;
+		std::vector<Theia::UInt32> m_indices;
+		std::vector<Theia::Normal3f> m_normals;
+		std::vector<Theia::Point2f> m_uvs;
+	private:
+	};
+}
+#endif
\ No newline at end of file
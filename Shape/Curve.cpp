@@ -0,0 +1,523 @@
+#include "Curve.h"
+#include "../Math/Lanes.h"
+#include <bit>
+
+namespace Theia {
+	namespace {
+		constexpr Theia::UInt32 Leaf_Segment_Count = 8;
+		constexpr Theia::Int32 Leaf_Segment_Depth = 3;
+		constexpr Theia::UInt32 Clipped_Bounds_Depth = 5;
+
+		typedef std::array<Theia::Point3f, 4> BezierControlPoints;
+
+		// Orthonormal frame with the ray origin at the origin and the ray direction along +z. Curve points are tested in this frame, where the ray becomes the z axis.
+		typedef struct CurveRaySpace {
+			Theia::Point3f m_origin;
+			Theia::Vector3f m_x, m_y, m_z;
+			Theia::Float m_direction_length;
+		} CurveRaySpace;
+
+		Theia::Vector3f ToVector(const Theia::Normal3f& normal) {
+			return Theia::Vector3f(normal.m_x, normal.m_y, normal.m_z);
+		}
+
+		Theia::Point3f BlossomBezier(const BezierControlPoints& cp, Theia::Float u0, Theia::Float u1, Theia::Float u2) {
+			Theia::Point3f a[3] = { Theia::Lerp(u0, cp[0], cp[1]), Theia::Lerp(u0, cp[1], cp[2]), Theia::Lerp(u0, cp[2], cp[3]) };
+			Theia::Point3f b[2] = { Theia::Lerp(u1, a[0], a[1]), Theia::Lerp(u1, a[1], a[2]) };
+			return Theia::Lerp(u2, b[0], b[1]);
+		}
+
+		BezierControlPoints SegmentControlPoints(const BezierControlPoints& cp, Theia::Float u_min, Theia::Float u_max) {
+			return { BlossomBezier(cp, u_min, u_min, u_min), BlossomBezier(cp, u_min, u_min, u_max), BlossomBezier(cp, u_min, u_max, u_max), BlossomBezier(cp, u_max, u_max, u_max) };
+		}
+
+		// The two halves share the middle point: the first uses [0, 3] and the second [3, 6].
+		std::array<Theia::Point3f, 7> SubdivideBezier(const BezierControlPoints& cp) {
+			Theia::Point3f a[3] = { Theia::Lerp(0.5f, cp[0], cp[1]), Theia::Lerp(0.5f, cp[1], cp[2]), Theia::Lerp(0.5f, cp[2], cp[3]) };
+			Theia::Point3f b[2] = { Theia::Lerp(0.5f, a[0], a[1]), Theia::Lerp(0.5f, a[1], a[2]) };
+			return { cp[0], a[0], b[0], Theia::Lerp(0.5f, b[0], b[1]), b[1], a[2], cp[3] };
+		}
+
+		// Bernstein form, written the same way as the lanes of IntersectLeafSegments so that both round alike.
+		Theia::Point3f EvaluateBezier(const BezierControlPoints& cp, Theia::Float u) {
+			Theia::Float s = 1.0f - u;
+			Theia::Float b0 = s * s * s;
+			Theia::Float b1 = 3.0f * s * s * u;
+			Theia::Float b2 = 3.0f * s * u * u;
+			Theia::Float b3 = u * u * u;
+			return Theia::Point3f(
+				b0 * cp[0].m_x + b1 * cp[1].m_x + b2 * cp[2].m_x + b3 * cp[3].m_x,
+				b0 * cp[0].m_y + b1 * cp[1].m_y + b2 * cp[2].m_y + b3 * cp[3].m_y,
+				b0 * cp[0].m_z + b1 * cp[1].m_z + b2 * cp[2].m_z + b3 * cp[3].m_z
+			);
+		}
+
+		Theia::Vector3f EvaluateBezierDerivative(const BezierControlPoints& cp, Theia::Float u) {
+			Theia::Float s = 1.0f - u;
+			return 3.0f * (s * s * (cp[1] - cp[0]) + 2.0f * s * u * (cp[2] - cp[1]) + u * u * (cp[3] - cp[2]));
+		}
+
+		Theia::AABB3f PadBounds(const Theia::AABB3f& aabb, Theia::Float padding) {
+			return Theia::AABB3f(aabb.m_min - Theia::Vector3f(padding, padding, padding), aabb.m_max + Theia::Vector3f(padding, padding, padding));
+		}
+
+		Theia::AABB3f ControlPointBounds(const BezierControlPoints& cp) {
+			return Theia::Union(Theia::AABB3f(cp[0], cp[1]), Theia::AABB3f(cp[2], cp[3]));
+		}
+
+		// Bounds of the curve itself rather than of its control points: the end points plus every extremum, where the derivative a (1 - u)^2 + 2 b (1 - u) u + c u^2 of an axis is zero.
+		Theia::AABB3f BezierBounds(const BezierControlPoints& cp) {
+			Theia::AABB3f aabb = Theia::AABB3f(cp[0], cp[3]);
+			for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+				Theia::Float a = cp[1][axis] - cp[0][axis];
+				Theia::Float b = cp[2][axis] - cp[1][axis];
+				Theia::Float c = cp[3][axis] - cp[2][axis];
+				Theia::Float quadratic = a - 2.0f * b + c;
+				Theia::Float linear = 2.0f * (b - a);
+				Theia::Float roots[2];
+				Theia::UInt32 root_count = 0;
+				if (std::abs(quadratic) <= 1e-7f * (std::abs(a) + std::abs(b) + std::abs(c))) {
+					if (linear != 0.0f) {
+						roots[root_count++] = -a / linear;
+					}
+				}
+				else {
+					Theia::Float discriminant = linear * linear - 4.0f * quadratic * a;
+					if (discriminant >= 0.0f) {
+						Theia::Float root = std::sqrt(discriminant);
+						roots[root_count++] = (-linear - root) / (2.0f * quadratic);
+						roots[root_count++] = (-linear + root) / (2.0f * quadratic);
+					}
+				}
+
+				for (Theia::UInt32 i = 0; i < root_count; ++i) {
+					if (roots[i] > 0.0f && roots[i] < 1.0f) {
+						Theia::Float value = EvaluateBezier(cp, roots[i])[axis];
+						aabb.m_min[axis] = std::min(aabb.m_min[axis], value);
+						aabb.m_max[axis] = std::max(aabb.m_max[axis], value);
+					}
+				}
+			}
+			return aabb;
+		}
+
+		Theia::AABB3f ClippedBezierBounds(const BezierControlPoints& cp, Theia::Float half_width, const Theia::AABB3f& clip_aabb, Theia::UInt32 depth) {
+			Theia::AABB3f hull = PadBounds(ControlPointBounds(cp), half_width);
+			if (!Theia::Overlaps(hull, clip_aabb)) {
+				return {};
+			}
+
+			bool inside = hull.m_min.m_x >= clip_aabb.m_min.m_x && hull.m_min.m_y >= clip_aabb.m_min.m_y && hull.m_min.m_z >= clip_aabb.m_min.m_z && hull.m_max.m_x <= clip_aabb.m_max.m_x && hull.m_max.m_y <= clip_aabb.m_max.m_y && hull.m_max.m_z <= clip_aabb.m_max.m_z;
+			if (depth == 0 || inside) {
+				return Theia::Intersection(PadBounds(BezierBounds(cp), half_width), clip_aabb);
+			}
+
+			std::array<Theia::Point3f, 7> split = SubdivideBezier(cp);
+			Theia::AABB3f first = ClippedBezierBounds({ split[0], split[1], split[2], split[3] }, half_width, clip_aabb, depth - 1);
+			Theia::AABB3f second = ClippedBezierBounds({ split[3], split[4], split[5], split[6] }, half_width, clip_aabb, depth - 1);
+			return Theia::Union(first, second);
+		}
+
+		CurveRaySpace MakeRaySpace(const Theia::Ray& ray, const BezierControlPoints& cp) {
+			Theia::Vector3f direction = ray.GetDirection();
+			Theia::Vector3f z = Theia::Normalize(direction);
+			Theia::Vector3f up = Theia::Cross(direction, cp[3] - cp[0]);
+			if (Theia::LengthSquared(up) == 0.0f) {
+				up = (std::abs(z.m_x) > std::abs(z.m_y)) ? Theia::Vector3f(-z.m_z, 0.0f, z.m_x) : Theia::Vector3f(0.0f, z.m_z, -z.m_y);
+			}
+			Theia::Vector3f x = Theia::Normalize(Theia::Cross(up, z));
+			Theia::Vector3f y = Theia::Cross(z, x);
+			return CurveRaySpace{ ray.GetOrigin(), x, y, z, Theia::Length(direction) };
+		}
+
+		Theia::Point3f ToRaySpace(const CurveRaySpace& ray_space, const Theia::Point3f& point) {
+			Theia::Vector3f offset = point - ray_space.m_origin;
+			return Theia::Point3f(Theia::Dot(offset, ray_space.m_x), Theia::Dot(offset, ray_space.m_y), Theia::Dot(offset, ray_space.m_z));
+		}
+
+		Theia::Vector3f ToRaySpace(const CurveRaySpace& ray_space, const Theia::Vector3f& vector) {
+			return Theia::Vector3f(Theia::Dot(vector, ray_space.m_x), Theia::Dot(vector, ray_space.m_y), Theia::Dot(vector, ray_space.m_z));
+		}
+
+		Theia::Vector3f FromRaySpace(const CurveRaySpace& ray_space, const Theia::Vector3f& vector) {
+			return vector.m_x * ray_space.m_x + vector.m_y * ray_space.m_y + vector.m_z * ray_space.m_z;
+		}
+
+		Theia::Float CurveWidth(const Theia::CurveCommon& common, Theia::Float u) {
+			return Theia::Lerp(u, common.m_width[0], common.m_width[1]);
+		}
+
+		Theia::Vector3f RibbonNormal(const Theia::CurveCommon& common, Theia::Float u) {
+			if (common.m_normal_angle == 0.0f) {
+				return ToVector(common.m_normals[0]);
+			}
+
+			Theia::Float sin0 = std::sin((1.0f - u) * common.m_normal_angle) * common.m_inverse_sin_normal_angle;
+			Theia::Float sin1 = std::sin(u * common.m_normal_angle) * common.m_inverse_sin_normal_angle;
+			return sin0 * ToVector(common.m_normals[0]) + sin1 * ToVector(common.m_normals[1]);
+		}
+
+		// True if the ray space box of a piece, padded by its half width, reaches the ray between 0 and z_max.
+		bool PieceOverlapsRay(const BezierControlPoints& cp, Theia::Float half_width, Theia::Float z_max) {
+			Theia::AABB3f aabb = PadBounds(ControlPointBounds(cp), half_width);
+			return aabb.m_min.m_x <= 0.0f && aabb.m_max.m_x >= 0.0f && aabb.m_min.m_y <= 0.0f && aabb.m_max.m_y >= 0.0f && aabb.m_max.m_z >= 0.0f && aabb.m_min.m_z <= z_max;
+		}
+
+		// A piece flat enough to be treated as the line between its end points, in ray space. The ray hits it if the closest point on that line lies between the end caps and the curve there is within half the width of the ray.
+		std::optional<Theia::CurveIntersection> IntersectSegment(const Theia::CurveCommon& common, const CurveRaySpace& ray_space, const BezierControlPoints& cp, Theia::Float u0, Theia::Float u1, Theia::Float z_max) {
+			Theia::Float edge = cp[0].m_x * (cp[0].m_x - cp[1].m_x) - cp[0].m_y * (cp[1].m_y - cp[0].m_y);
+			if (edge < 0.0f) {
+				return {};
+			}
+
+			edge = cp[3].m_x * (cp[3].m_x - cp[2].m_x) - cp[3].m_y * (cp[2].m_y - cp[3].m_y);
+			if (edge < 0.0f) {
+				return {};
+			}
+
+			Theia::Float segment_x = cp[3].m_x - cp[0].m_x;
+			Theia::Float segment_y = cp[3].m_y - cp[0].m_y;
+			Theia::Float denominator = segment_x * segment_x + segment_y * segment_y;
+			if (denominator == 0.0f) {
+				return {};
+			}
+
+			Theia::Float w = -(cp[0].m_x * segment_x + cp[0].m_y * segment_y) / denominator;
+			Theia::Float u = std::clamp(Theia::Lerp(w, u0, u1), u0, u1);
+			Theia::Float hit_width = CurveWidth(common, u);
+			if (common.m_type == Theia::CurveType::Ribbon) {
+				hit_width *= std::abs(Theia::Dot(RibbonNormal(common, u), ray_space.m_z));
+			}
+
+			Theia::Float w_clamped = std::clamp(w, 0.0f, 1.0f);
+			Theia::Point3f curve_point = EvaluateBezier(cp, w_clamped);
+			Theia::Float distance_squared = curve_point.m_x * curve_point.m_x + curve_point.m_y * curve_point.m_y;
+			if (distance_squared > 0.25f * hit_width * hit_width || curve_point.m_z < 0.0f || curve_point.m_z > z_max) {
+				return {};
+			}
+
+			// v runs across the curve from 0 to 1, increasing to the left of the tangent as seen along the ray.
+			Theia::Vector3f tangent = EvaluateBezierDerivative(cp, w_clamped);
+			Theia::Float distance = std::sqrt(distance_squared);
+			Theia::Float side = tangent.m_x * -curve_point.m_y + curve_point.m_x * tangent.m_y;
+			Theia::Float v = (side > 0.0f) ? 0.5f + distance / hit_width : 0.5f - distance / hit_width;
+			return Theia::CurveIntersection{ curve_point.m_z, u, v };
+		}
+
+		// Splits a piece into Leaf_Segment_Count equal parts and tests them all. With AVX2 the parts are tested in one pass of 8 lanes, and only the lanes that pass are confirmed by IntersectSegment, which also handles ribbon widths and computes v. m_t_hit of the result is the ray space z.
+		void IntersectLeafSegments(const Theia::CurveCommon& common, const CurveRaySpace& ray_space, const BezierControlPoints& cp, Theia::Float u0, Theia::Float u1, bool any_hit, Theia::Float& z_max, std::optional<Theia::CurveIntersection>& closest_intersection) {
+			// The parts are Bézier curves too, with control points one third of a derivative step in from their ends.
+			alignas(32) Theia::Float control_points[4][3][Leaf_Segment_Count];
+			Theia::Point3f point = cp[0];
+			Theia::Vector3f tangent = EvaluateBezierDerivative(cp, 0.0f) / Theia::Float(3 * Leaf_Segment_Count);
+			for (Theia::UInt32 lane = 0; lane < Leaf_Segment_Count; ++lane) {
+				Theia::Float u_next = Theia::Float(lane + 1) / Theia::Float(Leaf_Segment_Count);
+				Theia::Point3f next_point = (lane + 1 == Leaf_Segment_Count) ? cp[3] : EvaluateBezier(cp, u_next);
+				Theia::Vector3f next_tangent = EvaluateBezierDerivative(cp, u_next) / Theia::Float(3 * Leaf_Segment_Count);
+				Theia::Point3f lane_points[4] = { point, point + tangent, next_point - next_tangent, next_point };
+				for (Theia::UInt32 i = 0; i < 4; ++i) {
+					for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+						control_points[i][axis][lane] = lane_points[i][axis];
+					}
+				}
+				point = next_point;
+				tangent = next_tangent;
+			}
+
+#if defined(__AVX2__)
+			typedef Theia::Lanes<Leaf_Segment_Count> L;
+			typedef typename L::Type Type;
+
+			// The steps of IntersectSegment up to the width and depth tests, for all parts at once.
+			Type x[4], y[4], z[4];
+			for (Theia::UInt32 i = 0; i < 4; ++i) {
+				x[i] = L::Load(control_points[i][0]);
+				y[i] = L::Load(control_points[i][1]);
+				z[i] = L::Load(control_points[i][2]);
+			}
+
+			Type zero = L::Set(0.0f);
+			Type one = L::Set(1.0f);
+			Type edge0 = L::Subtract(L::Multiply(x[0], L::Subtract(x[0], x[1])), L::Multiply(y[0], L::Subtract(y[1], y[0])));
+			Type edge1 = L::Subtract(L::Multiply(x[3], L::Subtract(x[3], x[2])), L::Multiply(y[3], L::Subtract(y[2], y[3])));
+			Type segment_x = L::Subtract(x[3], x[0]);
+			Type segment_y = L::Subtract(y[3], y[0]);
+			Type denominator = L::Add(L::Multiply(segment_x, segment_x), L::Multiply(segment_y, segment_y));
+			Type accepted = L::And(L::And(L::GreaterEqual(edge0, zero), L::GreaterEqual(edge1, zero)), L::Greater(denominator, zero));
+
+			Type w = L::Divide(L::Subtract(zero, L::Add(L::Multiply(x[0], segment_x), L::Multiply(y[0], segment_y))), denominator);
+			alignas(32) Theia::Float lane_u0[Leaf_Segment_Count], lane_u1[Leaf_Segment_Count];
+			for (Theia::UInt32 lane = 0; lane < Leaf_Segment_Count; ++lane) {
+				lane_u0[lane] = Theia::Lerp(Theia::Float(lane) / Theia::Float(Leaf_Segment_Count), u0, u1);
+				lane_u1[lane] = Theia::Lerp(Theia::Float(lane + 1) / Theia::Float(Leaf_Segment_Count), u0, u1);
+			}
+			Type u_min = L::Load(lane_u0);
+			Type u_max = L::Load(lane_u1);
+			Type u = L::Add(L::Multiply(L::Subtract(one, w), u_min), L::Multiply(w, u_max));
+			u = L::Min(L::Max(u, u_min), u_max);
+			// Ribbons are never wider than their unscaled width, so the unscaled width keeps every lane IntersectSegment could accept.
+			Type hit_width = L::Add(L::Multiply(L::Subtract(one, u), L::Set(common.m_width[0])), L::Multiply(u, L::Set(common.m_width[1])));
+
+			Type t = L::Min(L::Max(w, zero), one);
+			Type s = L::Subtract(one, t);
+			Type b0 = L::Multiply(L::Multiply(s, s), s);
+			Type b1 = L::Multiply(L::Multiply(L::Multiply(L::Set(3.0f), s), s), t);
+			Type b2 = L::Multiply(L::Multiply(L::Multiply(L::Set(3.0f), s), t), t);
+			Type b3 = L::Multiply(L::Multiply(t, t), t);
+			Type point_x = L::Add(L::Add(L::Multiply(b0, x[0]), L::Multiply(b1, x[1])), L::Add(L::Multiply(b2, x[2]), L::Multiply(b3, x[3])));
+			Type point_y = L::Add(L::Add(L::Multiply(b0, y[0]), L::Multiply(b1, y[1])), L::Add(L::Multiply(b2, y[2]), L::Multiply(b3, y[3])));
+			Type point_z = L::Add(L::Add(L::Multiply(b0, z[0]), L::Multiply(b1, z[1])), L::Add(L::Multiply(b2, z[2]), L::Multiply(b3, z[3])));
+			Type distance_squared = L::Add(L::Multiply(point_x, point_x), L::Multiply(point_y, point_y));
+			Type max_distance_squared = L::Multiply(L::Set(0.25f), L::Multiply(hit_width, hit_width));
+			accepted = L::And(accepted, L::LessEqual(distance_squared, max_distance_squared));
+			accepted = L::And(accepted, L::And(L::GreaterEqual(point_z, zero), L::LessEqual(point_z, L::Set(z_max))));
+			Theia::UInt32 candidate_mask = L::Mask(accepted);
+#else
+			Theia::UInt32 candidate_mask = (1u << Leaf_Segment_Count) - 1;
+#endif
+
+			for (; candidate_mask != 0; candidate_mask &= candidate_mask - 1) {
+				Theia::UInt32 lane = Theia::UInt32(std::countr_zero(candidate_mask));
+				BezierControlPoints lane_cp;
+				for (Theia::UInt32 i = 0; i < 4; ++i) {
+					lane_cp[i] = Theia::Point3f(control_points[i][0][lane], control_points[i][1][lane], control_points[i][2][lane]);
+				}
+
+				Theia::Float lane_u_min = Theia::Lerp(Theia::Float(lane) / Theia::Float(Leaf_Segment_Count), u0, u1);
+				Theia::Float lane_u_max = Theia::Lerp(Theia::Float(lane + 1) / Theia::Float(Leaf_Segment_Count), u0, u1);
+				std::optional<Theia::CurveIntersection> curve_intersection = IntersectSegment(common, ray_space, lane_cp, lane_u_min, lane_u_max, z_max);
+				if (curve_intersection) {
+					z_max = curve_intersection->m_t_hit;
+					closest_intersection = curve_intersection;
+					if (any_hit) {
+						return;
+					}
+				}
+			}
+		}
+
+		void RecursiveIntersect(const Theia::CurveCommon& common, const CurveRaySpace& ray_space, const BezierControlPoints& cp, Theia::Float u0, Theia::Float u1, Theia::Int32 depth, bool any_hit, Theia::Float& z_max, std::optional<Theia::CurveIntersection>& closest_intersection) {
+			if (depth <= 0) {
+				IntersectLeafSegments(common, ray_space, cp, u0, u1, any_hit, z_max, closest_intersection);
+				return;
+			}
+
+			std::array<Theia::Point3f, 7> split = SubdivideBezier(cp);
+			Theia::Float u[3] = { u0, 0.5f * (u0 + u1), u1 };
+			for (Theia::UInt32 half = 0; half < 2; ++half) {
+				BezierControlPoints half_cp = { split[3 * half], split[3 * half + 1], split[3 * half + 2], split[3 * half + 3] };
+				Theia::Float max_width = std::max(CurveWidth(common, u[half]), CurveWidth(common, u[half + 1]));
+				if (!PieceOverlapsRay(half_cp, 0.5f * max_width, z_max)) {
+					continue;
+				}
+
+				RecursiveIntersect(common, ray_space, half_cp, u[half], u[half + 1], depth - 1, any_hit, z_max, closest_intersection);
+				if (any_hit && closest_intersection) {
+					return;
+				}
+			}
+		}
+	}
+
+	CurveCommon::CurveCommon(const Theia::Transform& render_from_object, const std::array<Theia::Point3f, 4>& control_points, Theia::Float width0, Theia::Float width1, Theia::CurveType type, const std::array<Theia::Normal3f, 2>& normals) :
+		m_width{ width0, width1 },
+		m_type(type),
+		m_normal_angle(0.0f),
+		m_inverse_sin_normal_angle(0.0f)
+	{
+		for (Theia::UInt32 i = 0; i < 4; ++i) {
+			m_control_points[i] = render_from_object(control_points[i]);
+		}
+
+		if (m_type == Theia::CurveType::Ribbon) {
+			Theia::Vector3f n[2];
+			for (Theia::UInt32 i = 0; i < 2; ++i) {
+				n[i] = Theia::Normalize(ToVector(render_from_object(normals[i])));
+				m_normals[i] = Theia::Normal3f(n[i].m_x, n[i].m_y, n[i].m_z);
+			}
+
+			// Angle between the normals, computed from the chord rather than with acos so that it stays accurate for nearly parallel normals.
+			if (Theia::Dot(n[0], n[1]) < 0.0f) {
+				m_normal_angle = Theia::Pi - 2.0f * std::asin(std::min(Theia::Length(n[0] + n[1]) / 2.0f, 1.0f));
+			}
+			else {
+				m_normal_angle = 2.0f * std::asin(std::min(Theia::Length(n[1] - n[0]) / 2.0f, 1.0f));
+			}
+			if (m_normal_angle != 0.0f) {
+				m_inverse_sin_normal_angle = 1.0f / std::sin(m_normal_angle);
+			}
+		}
+	}
+
+	std::vector<Theia::CurveCommon> CurveCommon::CreateStrand(const Theia::Transform& render_from_object, std::span<const Theia::Point3f> control_points, Theia::CurveBasis basis, Theia::Float width0, Theia::Float width1, Theia::CurveType type, std::span<const Theia::Normal3f> normals) {
+		assert(control_points.size() >= 4, "CurveCommon::CreateStrand needs at least 4 control points.");
+		assert(basis != Theia::CurveBasis::Bezier || (control_points.size() - 1) % 3 == 0, "CurveCommon::CreateStrand Bézier strands need 3n + 1 control points.");
+
+		Theia::UInt32 segment_count = (basis == Theia::CurveBasis::Bezier) ? Theia::UInt32((control_points.size() - 1) / 3) : Theia::UInt32(control_points.size() - 3);
+		assert(type != Theia::CurveType::Ribbon || normals.size() == segment_count + 1, "CurveCommon::CreateStrand ribbons need one normal per segment end.");
+
+		std::vector<Theia::CurveCommon> segments;
+		segments.reserve(segment_count);
+		for (Theia::UInt32 segment = 0; segment < segment_count; ++segment) {
+			std::array<Theia::Point3f, 4> segment_cp;
+			if (basis == Theia::CurveBasis::Bezier) {
+				segment_cp = { control_points[3 * segment], control_points[3 * segment + 1], control_points[3 * segment + 2], control_points[3 * segment + 3] };
+			}
+			else {
+				// Uniform cubic B-spline to Bézier: the inner control points sit at thirds of the middle edge, the ends at the midpoints between neighbouring thirds.
+				const Theia::Point3f* p = &control_points[segment];
+				Theia::Point3f p122 = Theia::Lerp(2.0f / 3.0f, p[0], p[1]);
+				Theia::Point3f p223 = Theia::Lerp(1.0f / 3.0f, p[1], p[2]);
+				Theia::Point3f p233 = Theia::Lerp(2.0f / 3.0f, p[1], p[2]);
+				Theia::Point3f p334 = Theia::Lerp(1.0f / 3.0f, p[2], p[3]);
+				segment_cp = { Theia::Lerp(0.5f, p122, p223), p223, p233, Theia::Lerp(0.5f, p233, p334) };
+			}
+
+			std::array<Theia::Normal3f, 2> segment_normals = {};
+			if (type == Theia::CurveType::Ribbon) {
+				segment_normals = { normals[segment], normals[segment + 1] };
+			}
+
+			Theia::Float segment_width0 = Theia::Lerp(Theia::Float(segment) / Theia::Float(segment_count), width0, width1);
+			Theia::Float segment_width1 = Theia::Lerp(Theia::Float(segment + 1) / Theia::Float(segment_count), width0, width1);
+			segments.push_back(Theia::CurveCommon(render_from_object, segment_cp, segment_width0, segment_width1, type, segment_normals));
+		}
+
+		return segments;
+	}
+
+	Curve::Curve(const Theia::CurveCommon* common, Theia::Float u_min, Theia::Float u_max) :
+		m_common(common),
+		m_u_min(u_min),
+		m_u_max(u_max)
+	{
+
+	}
+
+	Theia::AABB3f Curve::Bounds() const {
+		BezierControlPoints cp = SegmentControlPoints(m_common->m_control_points, m_u_min, m_u_max);
+		Theia::Float max_width = std::max(CurveWidth(*m_common, m_u_min), CurveWidth(*m_common, m_u_max));
+		return PadBounds(BezierBounds(cp), 0.5f * max_width);
+	}
+
+	Theia::AABB3f Curve::ClippedBounds(const Theia::AABB3f& clip_aabb) const {
+		BezierControlPoints cp = SegmentControlPoints(m_common->m_control_points, m_u_min, m_u_max);
+		Theia::Float max_width = std::max(CurveWidth(*m_common, m_u_min), CurveWidth(*m_common, m_u_max));
+		return ClippedBezierBounds(cp, 0.5f * max_width, clip_aabb, Clipped_Bounds_Depth);
+	}
+
+	std::optional<Theia::ShapeIntersection> Curve::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		std::optional<Theia::CurveIntersection> curve_intersection = BasicIntersect(ray, t_max);
+		if (!curve_intersection) {
+			return {};
+		}
+
+		return InteractionFromIntersection(*curve_intersection, ray);
+	}
+
+	bool Curve::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		return BasicIntersect(ray, t_max, true).has_value();
+	}
+
+	Theia::Float Curve::Area() const {
+		BezierControlPoints cp = SegmentControlPoints(m_common->m_control_points, m_u_min, m_u_max);
+		Theia::Float average_width = 0.5f * (CurveWidth(*m_common, m_u_min) + CurveWidth(*m_common, m_u_max));
+		Theia::Float approximate_length = 0.0f;
+		for (Theia::UInt32 i = 0; i < 3; ++i) {
+			approximate_length += Theia::Length(cp[i + 1] - cp[i]);
+		}
+		return approximate_length * average_width;
+	}
+
+	std::optional<Theia::CurveIntersection> Curve::BasicIntersect(const Theia::Ray& ray, Theia::Float t_max, bool any_hit) const {
+		BezierControlPoints render_cp = SegmentControlPoints(m_common->m_control_points, m_u_min, m_u_max);
+		CurveRaySpace ray_space = MakeRaySpace(ray, render_cp);
+		BezierControlPoints cp;
+		for (Theia::UInt32 i = 0; i < 4; ++i) {
+			cp[i] = ToRaySpace(ray_space, render_cp[i]);
+		}
+
+		Theia::Float z_max = (t_max == Theia::Infinity) ? Theia::Infinity : t_max * ray_space.m_direction_length;
+		Theia::Float max_width = std::max(CurveWidth(*m_common, m_u_min), CurveWidth(*m_common, m_u_max));
+		if (!PieceOverlapsRay(cp, 0.5f * max_width, z_max)) {
+			return {};
+		}
+
+		// Subdivisions needed before the pieces are within 5% of the width of straight lines, from the largest second difference of the control points.
+		Theia::Float l0 = 0.0f;
+		for (Theia::UInt32 i = 0; i < 2; ++i) {
+			Theia::Vector3f second_difference = Theia::Abs((cp[i] - cp[i + 1]) - (cp[i + 1] - cp[i + 2]));
+			l0 = std::max(l0, Theia::MaxComponentValue(second_difference));
+		}
+		Theia::Float epsilon = 0.05f * std::max(m_common->m_width[0], m_common->m_width[1]);
+		Theia::Float ratio = 1.41421356237f * 6.0f * l0 / (8.0f * epsilon);
+		Theia::Int32 max_depth = (ratio > 1.0f) ? std::clamp(Theia::Int32(std::lround(std::min(std::log2(ratio), 20.0f))) / 2, 0, 10) : 0;
+
+		// The last Leaf_Segment_Depth levels are replaced by one test of 2^Leaf_Segment_Depth pieces.
+		std::optional<Theia::CurveIntersection> curve_intersection = {};
+		RecursiveIntersect(*m_common, ray_space, cp, m_u_min, m_u_max, max_depth - Leaf_Segment_Depth, any_hit, z_max, curve_intersection);
+		if (curve_intersection) {
+			curve_intersection->m_t_hit /= ray_space.m_direction_length;
+		}
+		return curve_intersection;
+	}
+
+	Theia::ShapeIntersection Curve::InteractionFromIntersection(const Theia::CurveIntersection& curve_intersection, const Theia::Ray& ray) const {
+		BezierControlPoints render_cp = SegmentControlPoints(m_common->m_control_points, m_u_min, m_u_max);
+		CurveRaySpace ray_space = MakeRaySpace(ray, render_cp);
+		Theia::Float u = curve_intersection.m_u;
+		Theia::Float v = curve_intersection.m_v;
+		Theia::Float hit_width = CurveWidth(*m_common, u);
+
+		// Curves are open surfaces, so the normal always faces the incoming ray.
+		Theia::Vector3f normal;
+		if (m_common->m_type == Theia::CurveType::Ribbon) {
+			normal = Theia::Normalize(RibbonNormal(*m_common, u));
+			hit_width *= std::abs(Theia::Dot(normal, ray_space.m_z));
+			if (Theia::Dot(normal, ray_space.m_z) > 0.0f) {
+				normal = -normal;
+			}
+		}
+		else {
+			// In ray space the flat curve spans the tangent and the direction of increasing v; a cylinder tilts that normal towards the side of the hit.
+			Theia::Vector3f tangent = ToRaySpace(ray_space, EvaluateBezierDerivative(m_common->m_control_points, u));
+			Theia::Vector3f across = Theia::Vector3f(-tangent.m_y, tangent.m_x, 0.0f);
+			if (Theia::LengthSquared(across) == 0.0f) {
+				across = Theia::Vector3f(1.0f, 0.0f, 0.0f);
+			}
+			across = Theia::Normalize(across);
+			Theia::Vector3f flat_normal = (Theia::LengthSquared(tangent) == 0.0f) ? Theia::Vector3f(0.0f, 0.0f, -1.0f) : Theia::Normalize(Theia::Cross(tangent, across));
+			if (flat_normal.m_z > 0.0f) {
+				flat_normal = -flat_normal;
+			}
+
+			if (m_common->m_type == Theia::CurveType::Cylinder) {
+				Theia::Float sin_tilt = std::clamp(2.0f * v - 1.0f, -1.0f, 1.0f);
+				flat_normal = flat_normal * std::sqrt(1.0f - sin_tilt * sin_tilt) + across * sin_tilt;
+			}
+			normal = Theia::Normalize(FromRaySpace(ray_space, flat_normal));
+		}
+
+		// The hit is on a linear approximation of the curve, so the error bound covers the width of the curve rather than floating point error; spawned rays start clear of it.
+		Theia::Point3f hit = ray(curve_intersection.m_t_hit);
+		Theia::Point3Interval point_interval = Theia::Point3Interval(
+			Theia::Interval::FromValueAndError(hit.m_x, hit_width),
+			Theia::Interval::FromValueAndError(hit.m_y, hit_width),
+			Theia::Interval::FromValueAndError(hit.m_z, hit_width)
+		);
+
+		Theia::IInteraction interaction = Theia::IInteraction(point_interval, ray.GetTime(), -ray.GetDirection(), Theia::Normal3f(normal.m_x, normal.m_y, normal.m_z), Theia::Point2f(u, v), ray.GetMedium());
+		return Theia::ShapeIntersection{ interaction, curve_intersection.m_t_hit };
+	}
+
+	std::vector<Theia::Curve> Curve::CreateCurves(const Theia::CurveCommon* common, Theia::UInt32 split_count) {
+		std::vector<Theia::Curve> curves;
+		curves.reserve(split_count);
+
+		for (Theia::UInt32 i = 0; i < split_count; ++i) {
+			curves.push_back(Theia::Curve(common, Theia::Float(i) / Theia::Float(split_count), Theia::Float(i + 1) / Theia::Float(split_count)));
+		}
+
+		return curves;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef _THEIA_SHAPE_CURVE_H_
+#define _THEIA_SHAPE_CURVE_H_
+#include "IShape.h"
+#include <array>
+#include <span>
+#include <vector>
+
+namespace Theia {
+	// Flat curves always face the ray, cylinder curves are flat but shaded with the normal of a tube, and ribbons are oriented by the normals given at their two ends.
+	enum class CurveType {
+		Flat,
+		Cylinder,
+		Ribbon
+	};
+
+	enum class CurveBasis {
+		Bezier,
+		BSpline
+	};
+
+	typedef struct CurveIntersection {
+		Theia::Float m_t_hit;
+		Theia::Float m_u, m_v;
+	} CurveIntersection;
+
+	// One cubic Bézier segment, shared by the Curve primitives it is split into. As in TriangleMesh, the control points and normals are transformed to render space once, so widths are in render space units.
+	class CurveCommon {
+	public:
+		CurveCommon(const Theia::Transform& render_from_object, const std::array<Theia::Point3f, 4>& control_points, Theia::Float width0, Theia::Float width1, Theia::CurveType type, const std::array<Theia::Normal3f, 2>& normals = {});
+
+		// Cubic segments of one strand with its width interpolated from root to tip. Bézier strands have 3n + 1 control points with shared ends, B-spline strands turn each window of 4 control points into one segment. Ribbons take one normal per segment end.
+		static std::vector<Theia::CurveCommon> CreateStrand(const Theia::Transform& render_from_object, std::span<const Theia::Point3f> control_points, Theia::CurveBasis basis, Theia::Float width0, Theia::Float width1, Theia::CurveType type, std::span<const Theia::Normal3f> normals = {});
+
+		std::array<Theia::Point3f, 4> m_control_points;
+		Theia::Float m_width[2];
+		Theia::CurveType m_type;
+		Theia::Normal3f m_normals[2];
+		Theia::Float m_normal_angle, m_inverse_sin_normal_angle;
+	private:
+	};
+
+	// The [u_min, u_max] part of a CurveCommon. Intersection subdivides the segment against the ray until it is flat enough, then tests the last eight pieces at once.
+	class Curve : public IShape {
+	public:
+		Curve(const Theia::CurveCommon* common, Theia::Float u_min, Theia::Float u_max);
+
+		Theia::AABB3f Bounds() const override;
+		Theia::AABB3f ClippedBounds(const Theia::AABB3f& clip_aabb) const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		Theia::Float Area() const override;
+
+		std::optional<Theia::CurveIntersection> BasicIntersect(const Theia::Ray& ray, Theia::Float t_max, bool any_hit = false) const;
+		Theia::ShapeIntersection InteractionFromIntersection(const Theia::CurveIntersection& curve_intersection, const Theia::Ray& ray) const;
+
+		// Splits the segment into split_count curves of equal parameter length, so that long diagonal segments do not end up in one large box.
+		static std::vector<Theia::Curve> CreateCurves(const Theia::CurveCommon* common, Theia::UInt32 split_count = 1);
+	protected:
+	private:
+
+		const Theia::CurveCommon* m_common;
+		Theia::Float m_u_min, m_u_max;
+	};
+}
+#endif
\ No newline at end of file
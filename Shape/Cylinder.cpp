@@ -0,0 +1,121 @@
+#include "Cylinder.h"
+
+namespace Theia {
+	Cylinder::Cylinder(const Theia::Transform* render_from_object, Theia::Float radius, Theia::Float z_min, Theia::Float z_max, Theia::Float phi_max) :
+		m_render_from_object(render_from_object),
+		m_radius(radius),
+		m_z_min(std::min(z_min, z_max)),
+		m_z_max(std::max(z_min, z_max)),
+		m_phi_max(std::clamp(phi_max, 0.0f, 2.0f * Theia::Pi))
+	{
+
+	}
+
+	Theia::AABB3f Cylinder::Bounds() const {
+		return (*m_render_from_object)(Theia::AABB3f(Theia::Point3f(-m_radius, -m_radius, m_z_min), Theia::Point3f(m_radius, m_radius, m_z_max)));
+	}
+
+	std::optional<Theia::ShapeIntersection> Cylinder::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		std::optional<Theia::QuadricIntersection> quadric_intersection = BasicIntersect(ray, t_max);
+		if (!quadric_intersection) {
+			return {};
+		}
+
+		return InteractionFromIntersection(*quadric_intersection, ray);
+	}
+
+	bool Cylinder::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		return BasicIntersect(ray, t_max).has_value();
+	}
+
+	Theia::Float Cylinder::Area() const {
+		return (m_z_max - m_z_min) * m_radius * m_phi_max;
+	}
+
+	std::optional<Theia::QuadricIntersection> Cylinder::BasicIntersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		Theia::Point3Interval origin = m_render_from_object->ApplyInverse(Theia::Point3Interval(ray.GetOrigin()));
+		Theia::Vector3Interval direction = m_render_from_object->ApplyInverse(Theia::Vector3Interval(ray.GetDirection()));
+
+		// Same float rejection as Sphere, for the closest approach to the axis in the xy plane.
+		Theia::Point3f object_origin = Theia::Point3f(origin);
+		Theia::Vector3f object_direction = Theia::Vector3f(direction);
+		Theia::Vector2f o = Theia::Vector2f(object_origin.m_x, object_origin.m_y);
+		Theia::Vector2f d = Theia::Vector2f(object_direction.m_x, object_direction.m_y);
+		Theia::Float o_dot_o = o.m_x * o.m_x + o.m_y * o.m_y;
+		Theia::Float o_dot_d = o.m_x * d.m_x + o.m_y * d.m_y;
+		Theia::Float closest_distance_squared = o_dot_o - o_dot_d * o_dot_d / (d.m_x * d.m_x + d.m_y * d.m_y);
+		Theia::Float origin_error = (origin.m_x.GetRange() + origin.m_y.GetRange()) / 2.0f;
+		Theia::Float direction_error = (direction.m_x.GetRange() + direction.m_y.GetRange()) / 2.0f;
+		Theia::Float input_error = origin_error + 4.0f * (std::abs(o.m_x) + std::abs(o.m_y)) * direction_error / std::max(std::abs(d.m_x), std::abs(d.m_y));
+		if (closest_distance_squared - Theia::Gamma(16) * o_dot_o > (m_radius + input_error) * (m_radius + input_error)) {
+			return {};
+		}
+
+		Theia::Interval a = Theia::Sqr(direction.m_x) + Theia::Sqr(direction.m_y);
+		// Rays parallel to the axis, to within rounding, never cross the wall.
+		if (a.GetLow() <= 0.0f) {
+			return {};
+		}
+		Theia::Interval b = 2.0f * (direction.m_x * origin.m_x + direction.m_y * origin.m_y);
+		Theia::Interval c = Theia::Sqr(origin.m_x) + Theia::Sqr(origin.m_y) - Theia::Sqr(Theia::Interval(m_radius));
+
+		// Same closest approach form of the discriminant as Sphere, restricted to the xy plane.
+		Theia::Interval f = b / (2.0f * a);
+		Theia::Interval v_x = origin.m_x - f * direction.m_x;
+		Theia::Interval v_y = origin.m_y - f * direction.m_y;
+		Theia::Interval length = Theia::Sqrt(Theia::Sqr(v_x) + Theia::Sqr(v_y));
+		Theia::Interval discriminant = 4.0f * a * (Theia::Interval(m_radius) + length) * (Theia::Interval(m_radius) - length);
+		if (discriminant.GetLow() < 0.0f) {
+			return {};
+		}
+
+		Theia::Interval root_discriminant = Theia::Sqrt(discriminant);
+		Theia::Interval q = (b.GetMidpoint() < 0.0f) ? -0.5f * (b - root_discriminant) : -0.5f * (b + root_discriminant);
+		Theia::Interval t0 = q / a;
+		Theia::Interval t1 = c / q;
+		if (t0.GetLow() > t1.GetLow()) {
+			std::swap(t0, t1);
+		}
+
+		for (const Theia::Interval& t_hit : { t0, t1 }) {
+			if (t_hit.GetLow() <= 0.0f) {
+				continue;
+			}
+			if (t_hit.GetHigh() > t_max) {
+				return {};
+			}
+
+			Theia::Point3f object_point = object_origin + Theia::Float(t_hit) * object_direction;
+			Theia::Float radius_hit = std::sqrt(object_point.m_x * object_point.m_x + object_point.m_y * object_point.m_y);
+			object_point.m_x *= m_radius / radius_hit;
+			object_point.m_y *= m_radius / radius_hit;
+
+			if (object_point.m_z < m_z_min || object_point.m_z > m_z_max || (m_phi_max < 2.0f * Theia::Pi && Theia::QuadricPhi(object_point) > m_phi_max)) {
+				continue;
+			}
+
+			return Theia::QuadricIntersection{ Theia::Float(t_hit), object_point };
+		}
+
+		return {};
+	}
+
+	Theia::ShapeIntersection Cylinder::InteractionFromIntersection(const Theia::QuadricIntersection& quadric_intersection, const Theia::Ray& ray) const {
+		const Theia::Point3f& object_point = quadric_intersection.m_object_point;
+		Theia::Point2f uv = Theia::Point2f(Theia::QuadricPhi(object_point) / m_phi_max, (object_point.m_z - m_z_min) / (m_z_max - m_z_min));
+
+		// Reprojecting onto the wall leaves an error of at most gamma(3) in x and y. Error in z slides the point along the wall, so it never matters for offsetting.
+		Theia::Vector3f error = Theia::Gamma(3) * Theia::Abs(Theia::Vector3f(object_point.m_x, object_point.m_y, 0.0f));
+		Theia::Point3Interval object_point_interval = Theia::Point3Interval(
+			Theia::Interval::FromValueAndError(object_point.m_x, error.m_x),
+			Theia::Interval::FromValueAndError(object_point.m_y, error.m_y),
+			Theia::Interval(object_point.m_z)
+		);
+
+		Theia::Normal3f normal = (*m_render_from_object)(Theia::Normal3f(object_point.m_x, object_point.m_y, 0.0f));
+		Theia::Vector3f unit_normal = Theia::Normalize(Theia::Vector3f(normal.m_x, normal.m_y, normal.m_z));
+
+		Theia::IInteraction interaction = Theia::IInteraction((*m_render_from_object)(object_point_interval), ray.GetTime(), -ray.GetDirection(), Theia::Normal3f(unit_normal.m_x, unit_normal.m_y, unit_normal.m_z), uv, ray.GetMedium());
+		return Theia::ShapeIntersection{ interaction, quadric_intersection.m_t_hit };
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef _THEIA_SHAPE_CYLINDER_H_
+#define _THEIA_SHAPE_CYLINDER_H_
+#include "Quadric.h"
+
+namespace Theia {
+	// Open cylinder around the object space z axis between z_min and z_max, optionally clipped to the azimuth range [0, phi_max].
+	class Cylinder : public IShape {
+	public:
+		Cylinder(const Theia::Transform* render_from_object, Theia::Float radius, Theia::Float z_min, Theia::Float z_max, Theia::Float phi_max = 2.0f * Theia::Pi);
+
+		Theia::AABB3f Bounds() const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		Theia::Float Area() const override;
+
+		std::optional<Theia::QuadricIntersection> BasicIntersect(const Theia::Ray& ray, Theia::Float t_max) const;
+		Theia::ShapeIntersection InteractionFromIntersection(const Theia::QuadricIntersection& quadric_intersection, const Theia::Ray& ray) const;
+	protected:
+	private:
+
+		const Theia::Transform* m_render_from_object;
+		Theia::Float m_radius;
+		Theia::Float m_z_min, m_z_max;
+		Theia::Float m_phi_max;
+	};
+}
+#endif
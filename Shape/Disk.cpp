@@ -0,0 +1,77 @@
+#include "Disk.h"
+
+namespace Theia {
+	Disk::Disk(const Theia::Transform* render_from_object, Theia::Float radius, Theia::Float inner_radius, Theia::Float height, Theia::Float phi_max) :
+		m_render_from_object(render_from_object),
+		m_radius(radius),
+		m_inner_radius(inner_radius),
+		m_height(height),
+		m_phi_max(std::clamp(phi_max, 0.0f, 2.0f * Theia::Pi))
+	{
+
+	}
+
+	Theia::AABB3f Disk::Bounds() const {
+		return (*m_render_from_object)(Theia::AABB3f(Theia::Point3f(-m_radius, -m_radius, m_height), Theia::Point3f(m_radius, m_radius, m_height)));
+	}
+
+	std::optional<Theia::ShapeIntersection> Disk::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		std::optional<Theia::QuadricIntersection> quadric_intersection = BasicIntersect(ray, t_max);
+		if (!quadric_intersection) {
+			return {};
+		}
+
+		return InteractionFromIntersection(*quadric_intersection, ray);
+	}
+
+	bool Disk::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		return BasicIntersect(ray, t_max).has_value();
+	}
+
+	Theia::Float Disk::Area() const {
+		return 0.5f * m_phi_max * (m_radius * m_radius - m_inner_radius * m_inner_radius);
+	}
+
+	std::optional<Theia::QuadricIntersection> Disk::BasicIntersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		Theia::Point3Interval origin = m_render_from_object->ApplyInverse(Theia::Point3Interval(ray.GetOrigin()));
+		Theia::Vector3Interval direction = m_render_from_object->ApplyInverse(Theia::Vector3Interval(ray.GetDirection()));
+
+		// The hit point is snapped onto the plane below, so the plane crossing itself needs no interval bounds.
+		if (Theia::Float(direction.m_z) == 0.0f) {
+			return {};
+		}
+		Theia::Float t_hit = (m_height - Theia::Float(origin.m_z)) / Theia::Float(direction.m_z);
+		if (t_hit <= 0.0f || t_hit >= t_max) {
+			return {};
+		}
+
+		Theia::Point3f object_point = Theia::Point3f(origin) + t_hit * Theia::Vector3f(direction);
+		Theia::Float distance_squared = object_point.m_x * object_point.m_x + object_point.m_y * object_point.m_y;
+		if (distance_squared > m_radius * m_radius || distance_squared < m_inner_radius * m_inner_radius) {
+			return {};
+		}
+
+		// The azimuth is only needed for partial disks; full ones skip the atan2.
+		if (m_phi_max < 2.0f * Theia::Pi && Theia::QuadricPhi(object_point) > m_phi_max) {
+			return {};
+		}
+
+		object_point.m_z = m_height;
+		return Theia::QuadricIntersection{ t_hit, object_point };
+	}
+
+	Theia::ShapeIntersection Disk::InteractionFromIntersection(const Theia::QuadricIntersection& quadric_intersection, const Theia::Ray& ray) const {
+		const Theia::Point3f& object_point = quadric_intersection.m_object_point;
+		Theia::Float radius_hit = std::sqrt(object_point.m_x * object_point.m_x + object_point.m_y * object_point.m_y);
+		Theia::Point2f uv = Theia::Point2f(Theia::QuadricPhi(object_point) / m_phi_max, (m_radius - radius_hit) / (m_radius - m_inner_radius));
+
+		// The point lies exactly on the plane z = height, so only the render from object transform adds error.
+		Theia::Point3Interval object_point_interval = Theia::Point3Interval(object_point);
+
+		Theia::Normal3f normal = (*m_render_from_object)(Theia::Normal3f(0.0f, 0.0f, 1.0f));
+		Theia::Vector3f unit_normal = Theia::Normalize(Theia::Vector3f(normal.m_x, normal.m_y, normal.m_z));
+
+		Theia::IInteraction interaction = Theia::IInteraction((*m_render_from_object)(object_point_interval), ray.GetTime(), -ray.GetDirection(), Theia::Normal3f(unit_normal.m_x, unit_normal.m_y, unit_normal.m_z), uv, ray.GetMedium());
+		return Theia::ShapeIntersection{ interaction, quadric_intersection.m_t_hit };
+	}
+}
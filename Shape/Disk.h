@@ -0,0 +1,27 @@
+#ifndef _THEIA_SHAPE_DISK_H_
+#define _THEIA_SHAPE_DISK_H_
+#include "Quadric.h"
+
+namespace Theia {
+	// Disk, or annulus when inner_radius is positive, in the object space plane z = height, facing +z.
+	class Disk : public IShape {
+	public:
+		Disk(const Theia::Transform* render_from_object, Theia::Float radius, Theia::Float inner_radius = 0.0f, Theia::Float height = 0.0f, Theia::Float phi_max = 2.0f * Theia::Pi);
+
+		Theia::AABB3f Bounds() const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		Theia::Float Area() const override;
+
+		std::optional<Theia::QuadricIntersection> BasicIntersect(const Theia::Ray& ray, Theia::Float t_max) const;
+		Theia::ShapeIntersection InteractionFromIntersection(const Theia::QuadricIntersection& quadric_intersection, const Theia::Ray& ray) const;
+	protected:
+	private:
+
+		const Theia::Transform* m_render_from_object;
+		Theia::Float m_radius, m_inner_radius;
+		Theia::Float m_height;
+		Theia::Float m_phi_max;
+	};
+}
+#endif
@@ -0,0 +1,28 @@
+#ifndef _THEIA_SHAPE_I_PARAMETRIC_PATCH_H_
+#define _THEIA_SHAPE_I_PARAMETRIC_PATCH_H_
+#include "../Math/Math.h"
+#include <functional>
+
+namespace Theia {
+	typedef struct PatchPoint {
+		Theia::Point3f m_position;
+		Theia::Vector3f m_normal;
+	} PatchPoint;
+
+	// Offset along the surface normal at a point of a patch, in render space units.
+	typedef std::function<Theia::Float(const Theia::Point3f& position, const Theia::Point2f& uv)> DisplacementFunction;
+
+	// A smooth surface over [0, 1]^2 that is only turned into triangles when rays need it, see TessellatedPatch.
+	class IParametricPatch {
+	public:
+		virtual ~IParametricPatch() = default;
+		// Conservative bounds of the undisplaced surface.
+		virtual Theia::AABB3f Bounds() const = 0;
+		virtual Theia::PatchPoint Evaluate(const Theia::Point2f& uv) const = 0;
+	protected:
+	private:
+	};
+
+	typedef IParametricPatch* ParametricPatch;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef _THEIA_SHAPE_I_SHAPE_H_
+#define _THEIA_SHAPE_I_SHAPE_H_
+#include "../Engine/IPrimitive.h"
+
+namespace Theia {
+	// A point on a shape with its density with respect to surface area.
+	typedef struct ShapeSample {
+		Theia::IInteraction m_interaction;
+		Theia::Float m_pdf;
+	} ShapeSample;
+
+	class IShape : public IPrimitive {
+	public:
+		virtual Theia::Float Area() const = 0;
+
+		// Samples a point on the surface from u in [0, 1)^2. Shapes that do not support area sampling return no sample.
+		virtual std::optional<Theia::ShapeSample> Sample(const Theia::Point2f&) const {
+			return {};
+		}
+	protected:
+	private:
+	};
+
+	typedef IShape* Shape;
+}
+#endif
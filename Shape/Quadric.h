@@ -0,0 +1,21 @@
+#ifndef _THEIA_SHAPE_QUADRIC_H_
+#define _THEIA_SHAPE_QUADRIC_H_
+#include "IShape.h"
+
+namespace Theia {
+	// Hit on a quadric in its object space. Occluded stops here; Intersect turns it into an interaction.
+	typedef struct QuadricIntersection {
+		Theia::Float m_t_hit;
+		Theia::Point3f m_object_point;
+	} QuadricIntersection;
+
+	// Azimuth of point around the object space z axis, in [0, 2 pi].
+	inline Theia::Float QuadricPhi(const Theia::Point3f& point) {
+		Theia::Float phi = std::atan2(point.m_y, point.m_x);
+		if (phi < 0.0f) {
+			phi += 2.0f * Theia::Pi;
+		}
+		return phi;
+	}
+}
+#endif
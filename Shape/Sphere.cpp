@@ -0,0 +1,122 @@
+#include "Sphere.h"
+
+namespace Theia {
+	Sphere::Sphere(const Theia::Transform* render_from_object, Theia::Float radius, Theia::Float z_min, Theia::Float z_max, Theia::Float phi_max) :
+		m_render_from_object(render_from_object),
+		m_radius(radius),
+		m_z_min(std::clamp(std::min(z_min, z_max), -radius, radius)),
+		m_z_max(std::clamp(std::max(z_min, z_max), -radius, radius)),
+		m_theta_z_min(std::acos(std::clamp(std::min(z_min, z_max) / radius, -1.0f, 1.0f))),
+		m_theta_z_max(std::acos(std::clamp(std::max(z_min, z_max) / radius, -1.0f, 1.0f))),
+		m_phi_max(std::clamp(phi_max, 0.0f, 2.0f * Theia::Pi))
+	{
+
+	}
+
+	Theia::AABB3f Sphere::Bounds() const {
+		return (*m_render_from_object)(Theia::AABB3f(Theia::Point3f(-m_radius, -m_radius, m_z_min), Theia::Point3f(m_radius, m_radius, m_z_max)));
+	}
+
+	std::optional<Theia::ShapeIntersection> Sphere::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		std::optional<Theia::QuadricIntersection> quadric_intersection = BasicIntersect(ray, t_max);
+		if (!quadric_intersection) {
+			return {};
+		}
+
+		return InteractionFromIntersection(*quadric_intersection, ray);
+	}
+
+	bool Sphere::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		return BasicIntersect(ray, t_max).has_value();
+	}
+
+	Theia::Float Sphere::Area() const {
+		return m_phi_max * m_radius * (m_z_max - m_z_min);
+	}
+
+	std::optional<Theia::QuadricIntersection> Sphere::BasicIntersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		Theia::Point3Interval origin = m_render_from_object->ApplyInverse(Theia::Point3Interval(ray.GetOrigin()));
+		Theia::Vector3Interval direction = m_render_from_object->ApplyInverse(Theia::Vector3Interval(ray.GetDirection()));
+
+		// Many rays that reach a sphere in a BVH leaf still miss it, so lines that certainly pass outside are rejected in plain float before the interval solve. The float closest approach distance squared is off by at most gamma(12) |o|^2, and the error already in origin and direction moves the line by at most input_error.
+		Theia::Point3f object_origin = Theia::Point3f(origin);
+		Theia::Vector3f object_direction = Theia::Vector3f(direction);
+		Theia::Vector3f o = object_origin - Theia::Point3f();
+		Theia::Float o_dot_o = Theia::Dot(o, o);
+		Theia::Float o_dot_d = Theia::Dot(o, object_direction);
+		Theia::Float closest_distance_squared = o_dot_o - o_dot_d * o_dot_d / Theia::Dot(object_direction, object_direction);
+		Theia::Float origin_error = (origin.m_x.GetRange() + origin.m_y.GetRange() + origin.m_z.GetRange()) / 2.0f;
+		Theia::Float direction_error = (direction.m_x.GetRange() + direction.m_y.GetRange() + direction.m_z.GetRange()) / 2.0f;
+		Theia::Float input_error = origin_error + 4.0f * (std::abs(o.m_x) + std::abs(o.m_y) + std::abs(o.m_z)) * direction_error / Theia::MaxComponentValue(Theia::Abs(object_direction));
+		if (closest_distance_squared - Theia::Gamma(16) * o_dot_o > (m_radius + input_error) * (m_radius + input_error)) {
+			return {};
+		}
+
+		Theia::Interval a = Theia::Sqr(direction.m_x) + Theia::Sqr(direction.m_y) + Theia::Sqr(direction.m_z);
+		Theia::Interval b = 2.0f * (direction.m_x * origin.m_x + direction.m_y * origin.m_y + direction.m_z * origin.m_z);
+		Theia::Interval c = Theia::Sqr(origin.m_x) + Theia::Sqr(origin.m_y) + Theia::Sqr(origin.m_z) - Theia::Sqr(Theia::Interval(m_radius));
+
+		// b^2 - 4ac rewritten around the point of closest approach, which stays accurate for small, distant spheres.
+		Theia::Interval f = b / (2.0f * a);
+		Theia::Interval v_x = origin.m_x - f * direction.m_x;
+		Theia::Interval v_y = origin.m_y - f * direction.m_y;
+		Theia::Interval v_z = origin.m_z - f * direction.m_z;
+		Theia::Interval length = Theia::Sqrt(Theia::Sqr(v_x) + Theia::Sqr(v_y) + Theia::Sqr(v_z));
+		Theia::Interval discriminant = 4.0f * a * (Theia::Interval(m_radius) + length) * (Theia::Interval(m_radius) - length);
+		if (discriminant.GetLow() < 0.0f) {
+			return {};
+		}
+
+		Theia::Interval root_discriminant = Theia::Sqrt(discriminant);
+		Theia::Interval q = (b.GetMidpoint() < 0.0f) ? -0.5f * (b - root_discriminant) : -0.5f * (b + root_discriminant);
+		Theia::Interval t0 = q / a;
+		Theia::Interval t1 = c / q;
+		if (t0.GetLow() > t1.GetLow()) {
+			std::swap(t0, t1);
+		}
+
+		for (const Theia::Interval& t_hit : { t0, t1 }) {
+			// Only hits whose whole interval lies in (0, t_max] are certain to be in range.
+			if (t_hit.GetLow() <= 0.0f) {
+				continue;
+			}
+			if (t_hit.GetHigh() > t_max) {
+				return {};
+			}
+
+			Theia::Point3f object_point = object_origin + Theia::Float(t_hit) * object_direction;
+			object_point = Theia::Point3f() + (m_radius / Theia::Length(object_point - Theia::Point3f())) * (object_point - Theia::Point3f());
+			if (object_point.m_x == 0.0f && object_point.m_y == 0.0f) {
+				object_point.m_x = 1e-5f * m_radius;
+			}
+
+			if ((m_z_min > -m_radius && object_point.m_z < m_z_min) || (m_z_max < m_radius && object_point.m_z > m_z_max) || (m_phi_max < 2.0f * Theia::Pi && Theia::QuadricPhi(object_point) > m_phi_max)) {
+				continue;
+			}
+
+			return Theia::QuadricIntersection{ Theia::Float(t_hit), object_point };
+		}
+
+		return {};
+	}
+
+	Theia::ShapeIntersection Sphere::InteractionFromIntersection(const Theia::QuadricIntersection& quadric_intersection, const Theia::Ray& ray) const {
+		const Theia::Point3f& object_point = quadric_intersection.m_object_point;
+		Theia::Float theta = std::acos(std::clamp(object_point.m_z / m_radius, -1.0f, 1.0f));
+		Theia::Point2f uv = Theia::Point2f(Theia::QuadricPhi(object_point) / m_phi_max, (theta - m_theta_z_min) / (m_theta_z_max - m_theta_z_min));
+
+		// Reprojecting onto the sphere leaves an error of at most gamma(5) times each coordinate.
+		Theia::Vector3f error = Theia::Gamma(5) * Theia::Abs(object_point - Theia::Point3f());
+		Theia::Point3Interval object_point_interval = Theia::Point3Interval(
+			Theia::Interval::FromValueAndError(object_point.m_x, error.m_x),
+			Theia::Interval::FromValueAndError(object_point.m_y, error.m_y),
+			Theia::Interval::FromValueAndError(object_point.m_z, error.m_z)
+		);
+
+		Theia::Normal3f normal = (*m_render_from_object)(Theia::Normal3f(object_point.m_x, object_point.m_y, object_point.m_z));
+		Theia::Vector3f unit_normal = Theia::Normalize(Theia::Vector3f(normal.m_x, normal.m_y, normal.m_z));
+
+		Theia::IInteraction interaction = Theia::IInteraction((*m_render_from_object)(object_point_interval), ray.GetTime(), -ray.GetDirection(), Theia::Normal3f(unit_normal.m_x, unit_normal.m_y, unit_normal.m_z), uv, ray.GetMedium());
+		return Theia::ShapeIntersection{ interaction, quadric_intersection.m_t_hit };
+	}
+}
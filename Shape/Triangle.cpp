@@ -0,0 +1,383 @@
+#include "Triangle.h"
+#include "../Math/Lanes.h"
+#include <array>
+#include <bit>
+
+namespace Theia {
+	namespace {
+#if defined(__AVX2__)
+		// Same FMA sequence as Theia::DifferenceOfProducts, so that lanes round exactly like the scalar test.
+		template <Theia::UInt32 Width> typename Lanes<Width>::Type DifferenceOfProducts(typename Lanes<Width>::Type a, typename Lanes<Width>::Type b, typename Lanes<Width>::Type c, typename Lanes<Width>::Type d) {
+			typedef Lanes<Width> L;
+			typename L::Type cd = L::Multiply(c, d);
+			typename L::Type difference_of_products = L::MultiplySubtract(a, b, cd);
+			typename L::Type error = L::NegativeMultiplyAdd(c, d, cd);
+			return L::Add(difference_of_products, error);
+		}
+#endif
+
+		template <Theia::UInt32 Width> std::optional<Theia::TriangleIntersection> IntersectTriangleLane(const Theia::Ray& ray, Theia::Float t_max, const Theia::TriangleBlock<Width>& block, Theia::UInt32 lane) {
+			Theia::Point3f p[3];
+			for (Theia::UInt32 vertex = 0; vertex < 3; ++vertex) {
+				p[vertex] = Theia::Point3f(block.m_positions[vertex][0][lane], block.m_positions[vertex][1][lane], block.m_positions[vertex][2][lane]);
+			}
+			return Theia::IntersectTriangle(ray, t_max, p[0], p[1], p[2]);
+		}
+	}
+
+	std::optional<Theia::TriangleIntersection> IntersectTriangle(const Theia::Ray& ray, Theia::Float t_max, const Theia::Point3f& p0, const Theia::Point3f& p1, const Theia::Point3f& p2) {
+		if (Theia::LengthSquared(Theia::Cross(p2 - p0, p1 - p0)) == 0.0f) {
+			return {};
+		}
+
+		Theia::Point3f origin = ray.GetOrigin();
+		Theia::Vector3f p0t = p0 - origin;
+		Theia::Vector3f p1t = p1 - origin;
+		Theia::Vector3f p2t = p2 - origin;
+
+		Theia::Int32 kz = Theia::MaxComponentIndex(Theia::Abs(ray.GetDirection()));
+		Theia::Int32 kx = (kz + 1 == 3) ? 0 : kz + 1;
+		Theia::Int32 ky = (kx + 1 == 3) ? 0 : kx + 1;
+		Theia::Vector3f direction = Theia::Permute(ray.GetDirection(), { kx, ky, kz });
+		p0t = Theia::Permute(p0t, { kx, ky, kz });
+		p1t = Theia::Permute(p1t, { kx, ky, kz });
+		p2t = Theia::Permute(p2t, { kx, ky, kz });
+
+		Theia::Float shear_x = -direction.m_x / direction.m_z;
+		Theia::Float shear_y = -direction.m_y / direction.m_z;
+		Theia::Float shear_z = 1.0f / direction.m_z;
+		p0t.m_x += shear_x * p0t.m_z;
+		p0t.m_y += shear_y * p0t.m_z;
+		p1t.m_x += shear_x * p1t.m_z;
+		p1t.m_y += shear_y * p1t.m_z;
+		p2t.m_x += shear_x * p2t.m_z;
+		p2t.m_y += shear_y * p2t.m_z;
+
+		Theia::Float e0 = Theia::DifferenceOfProducts(p1t.m_x, p2t.m_y, p1t.m_y, p2t.m_x);
+		Theia::Float e1 = Theia::DifferenceOfProducts(p2t.m_x, p0t.m_y, p2t.m_y, p0t.m_x);
+		Theia::Float e2 = Theia::DifferenceOfProducts(p0t.m_x, p1t.m_y, p0t.m_y, p1t.m_x);
+
+		if (e0 == 0.0f || e1 == 0.0f || e2 == 0.0f) {
+			e0 = Theia::Float(Theia::Float64(p1t.m_x) * Theia::Float64(p2t.m_y) - Theia::Float64(p1t.m_y) * Theia::Float64(p2t.m_x));
+			e1 = Theia::Float(Theia::Float64(p2t.m_x) * Theia::Float64(p0t.m_y) - Theia::Float64(p2t.m_y) * Theia::Float64(p0t.m_x));
+			e2 = Theia::Float(Theia::Float64(p0t.m_x) * Theia::Float64(p1t.m_y) - Theia::Float64(p0t.m_y) * Theia::Float64(p1t.m_x));
+		}
+
+		if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0)) {
+			return {};
+		}
+
+		Theia::Float determinant = e0 + e1 + e2;
+		if (determinant == 0.0f) {
+			return {};
+		}
+
+		p0t.m_z *= shear_z;
+		p1t.m_z *= shear_z;
+		p2t.m_z *= shear_z;
+		Theia::Float t_scaled = e0 * p0t.m_z + e1 * p1t.m_z + e2 * p2t.m_z;
+		if (determinant < 0 && (t_scaled >= 0 || t_scaled < t_max * determinant)) {
+			return {};
+		}
+		else if (determinant > 0 && (t_scaled <= 0 || t_scaled > t_max * determinant)) {
+			return {};
+		}
+
+		Theia::Float inverse_determinant = 1.0f / determinant;
+		Theia::Float b0 = e0 * inverse_determinant;
+		Theia::Float b1 = e1 * inverse_determinant;
+		Theia::Float b2 = e2 * inverse_determinant;
+		Theia::Float t = t_scaled * inverse_determinant;
+
+		Theia::Float max_z = Theia::MaxComponentValue(Theia::Abs(Theia::Vector3f(p0t.m_z, p1t.m_z, p2t.m_z)));
+		Theia::Float max_x = Theia::MaxComponentValue(Theia::Abs(Theia::Vector3f(p0t.m_x, p1t.m_x, p2t.m_x)));
+		Theia::Float max_y = Theia::MaxComponentValue(Theia::Abs(Theia::Vector3f(p0t.m_y, p1t.m_y, p2t.m_y)));
+		Theia::Float delta_z = Theia::Gamma(3) * max_z;
+		Theia::Float delta_x = Theia::Gamma(5) * (max_x + max_z);
+		Theia::Float delta_y = Theia::Gamma(5) * (max_y + max_z);
+		Theia::Float delta_e = 2 * (Theia::Gamma(2) * max_x * max_y + delta_y * max_x + delta_x * max_y);
+		Theia::Float max_e = Theia::MaxComponentValue(Theia::Abs(Theia::Vector3f(e0, e1, e2)));
+		Theia::Float delta_t = 3 * (Theia::Gamma(3) * max_e * max_z + delta_e * max_z + delta_z * max_e) * std::abs(inverse_determinant);
+		if (t <= delta_t) {
+			return {};
+		}
+
+		return Theia::TriangleIntersection{ b0, b1, b2, t };
+	}
+
+	template <Theia::UInt32 Width> std::optional<Theia::TriangleBlockIntersection> IntersectTriangleBlock(const Theia::Ray& ray, Theia::Float t_max, const Theia::TriangleBlock<Width>& block) {
+		Theia::UInt32 valid_mask = 0;
+		for (Theia::UInt32 lane = 0; lane < Width; ++lane) {
+			valid_mask |= (block.m_triangles[lane] != nullptr) << lane;
+		}
+		std::optional<Theia::TriangleBlockIntersection> closest_intersection = {};
+
+#if defined(__AVX2__)
+		typedef Lanes<Width> L;
+		typedef typename L::Type Type;
+
+		// The steps of IntersectTriangle, for all lanes at once.
+		Theia::Point3f origin = ray.GetOrigin();
+		Theia::Int32 kz = Theia::MaxComponentIndex(Theia::Abs(ray.GetDirection()));
+		Theia::Int32 kx = (kz + 1 == 3) ? 0 : kz + 1;
+		Theia::Int32 ky = (kx + 1 == 3) ? 0 : kx + 1;
+		Theia::Vector3f direction = Theia::Permute(ray.GetDirection(), { kx, ky, kz });
+		Type shear_x = L::Set(-direction.m_x / direction.m_z);
+		Type shear_y = L::Set(-direction.m_y / direction.m_z);
+		Type shear_z = L::Set(1.0f / direction.m_z);
+
+		Type p_x[3], p_y[3], p_z[3];
+		for (Theia::UInt32 vertex = 0; vertex < 3; ++vertex) {
+			p_x[vertex] = L::Subtract(L::Load(block.m_positions[vertex][kx]), L::Set(origin[kx]));
+			p_y[vertex] = L::Subtract(L::Load(block.m_positions[vertex][ky]), L::Set(origin[ky]));
+			p_z[vertex] = L::Subtract(L::Load(block.m_positions[vertex][kz]), L::Set(origin[kz]));
+			p_x[vertex] = L::Add(p_x[vertex], L::Multiply(shear_x, p_z[vertex]));
+			p_y[vertex] = L::Add(p_y[vertex], L::Multiply(shear_y, p_z[vertex]));
+		}
+
+		Type e0 = DifferenceOfProducts<Width>(p_x[1], p_y[2], p_y[1], p_x[2]);
+		Type e1 = DifferenceOfProducts<Width>(p_x[2], p_y[0], p_y[2], p_x[0]);
+		Type e2 = DifferenceOfProducts<Width>(p_x[0], p_y[1], p_y[0], p_x[1]);
+
+		// Lanes with an edge function of exactly zero are redone by the scalar test, which falls back to double precision.
+		Type zero = L::Set(0.0f);
+		Theia::UInt32 fallback_mask = L::Mask(L::Or(L::Or(L::Equal(e0, zero), L::Equal(e1, zero)), L::Equal(e2, zero))) & valid_mask;
+
+		Type rejected = L::And(L::Or(L::Or(L::Less(e0, zero), L::Less(e1, zero)), L::Less(e2, zero)), L::Or(L::Or(L::Greater(e0, zero), L::Greater(e1, zero)), L::Greater(e2, zero)));
+		Type determinant = L::Add(L::Add(e0, e1), e2);
+		rejected = L::Or(rejected, L::Equal(determinant, zero));
+
+		for (Theia::UInt32 vertex = 0; vertex < 3; ++vertex) {
+			p_z[vertex] = L::Multiply(p_z[vertex], shear_z);
+		}
+		Type t_scaled = L::Add(L::Add(L::Multiply(e0, p_z[0]), L::Multiply(e1, p_z[1])), L::Multiply(e2, p_z[2]));
+		Type t_max_scaled = L::Multiply(L::Set(t_max), determinant);
+		rejected = L::Or(rejected, L::And(L::Less(determinant, zero), L::Or(L::GreaterEqual(t_scaled, zero), L::Less(t_scaled, t_max_scaled))));
+		rejected = L::Or(rejected, L::And(L::Greater(determinant, zero), L::Or(L::LessEqual(t_scaled, zero), L::Greater(t_scaled, t_max_scaled))));
+
+		Type inverse_determinant = L::Divide(L::Set(1.0f), determinant);
+		Type t = L::Multiply(t_scaled, inverse_determinant);
+
+		Type max_z = L::Max(L::Max(L::Abs(p_z[0]), L::Abs(p_z[1])), L::Abs(p_z[2]));
+		Type max_x = L::Max(L::Max(L::Abs(p_x[0]), L::Abs(p_x[1])), L::Abs(p_x[2]));
+		Type max_y = L::Max(L::Max(L::Abs(p_y[0]), L::Abs(p_y[1])), L::Abs(p_y[2]));
+		Type delta_z = L::Multiply(L::Set(Theia::Gamma(3)), max_z);
+		Type delta_x = L::Multiply(L::Set(Theia::Gamma(5)), L::Add(max_x, max_z));
+		Type delta_y = L::Multiply(L::Set(Theia::Gamma(5)), L::Add(max_y, max_z));
+		Type delta_e = L::Multiply(L::Set(2.0f), L::Add(L::Add(L::Multiply(L::Multiply(L::Set(Theia::Gamma(2)), max_x), max_y), L::Multiply(delta_y, max_x)), L::Multiply(delta_x, max_y)));
+		Type max_e = L::Max(L::Max(L::Abs(e0), L::Abs(e1)), L::Abs(e2));
+		Type delta_t = L::Multiply(L::Multiply(L::Set(3.0f), L::Add(L::Add(L::Multiply(L::Multiply(L::Set(Theia::Gamma(3)), max_e), max_z), L::Multiply(delta_e, max_z)), L::Multiply(delta_z, max_e))), L::Abs(inverse_determinant));
+		rejected = L::Or(rejected, L::LessEqual(t, delta_t));
+
+		alignas(32) Theia::Float ts[Width], e0s[Width], e1s[Width], e2s[Width], inverse_determinants[Width];
+		L::Store(ts, t);
+		L::Store(e0s, e0);
+		L::Store(e1s, e1);
+		L::Store(e2s, e2);
+		L::Store(inverse_determinants, inverse_determinant);
+
+		for (Theia::UInt32 hit_mask = ~L::Mask(rejected) & valid_mask & ~fallback_mask; hit_mask != 0; hit_mask &= hit_mask - 1) {
+			Theia::UInt32 lane = Theia::UInt32(std::countr_zero(hit_mask));
+			if (!closest_intersection || ts[lane] <= closest_intersection->m_triangle_intersection.m_t) {
+				closest_intersection = Theia::TriangleBlockIntersection{ { e0s[lane] * inverse_determinants[lane], e1s[lane] * inverse_determinants[lane], e2s[lane] * inverse_determinants[lane], ts[lane] }, block.m_triangles[lane] };
+			}
+		}
+		if (closest_intersection) {
+			t_max = closest_intersection->m_triangle_intersection.m_t;
+		}
+#else
+		Theia::UInt32 fallback_mask = valid_mask;
+#endif
+
+		for (; fallback_mask != 0; fallback_mask &= fallback_mask - 1) {
+			Theia::UInt32 lane = Theia::UInt32(std::countr_zero(fallback_mask));
+			std::optional<Theia::TriangleIntersection> triangle_intersection = IntersectTriangleLane(ray, t_max, block, lane);
+			if (triangle_intersection) {
+				t_max = triangle_intersection->m_t;
+				closest_intersection = Theia::TriangleBlockIntersection{ *triangle_intersection, block.m_triangles[lane] };
+			}
+		}
+
+		return closest_intersection;
+	}
+
+	template std::optional<Theia::TriangleBlockIntersection> IntersectTriangleBlock<4>(const Theia::Ray& ray, Theia::Float t_max, const Theia::TriangleBlock<4>& block);
+	template std::optional<Theia::TriangleBlockIntersection> IntersectTriangleBlock<8>(const Theia::Ray& ray, Theia::Float t_max, const Theia::TriangleBlock<8>& block);
+
+	Triangle::Triangle(const Theia::TriangleMesh* mesh, Theia::UInt32 triangle_index) :
+		m_mesh(mesh),
+		m_triangle_index(triangle_index),
+		m_vertex_offset(0)
+	{
+		const Theia::Meshlet* meshlet = mesh->FindMeshlet(triangle_index);
+		if (meshlet) {
+			m_vertex_offset = meshlet->m_vertex_offset;
+		}
+	}
+
+	const Theia::TriangleMesh* Triangle::GetMesh() const {
+		return m_mesh;
+	}
+
+	Theia::UInt32 Triangle::GetTriangleIndex() const {
+		return m_triangle_index;
+	}
+
+	const Theia::Meshlet* Triangle::GetMeshlet() const {
+		return m_mesh->FindMeshlet(m_triangle_index);
+	}
+
+	Theia::AABB3f Triangle::Bounds() const {
+		std::array<Theia::UInt32, 3> vertices = m_mesh->TriangleVertices(m_triangle_index, m_vertex_offset);
+		Theia::AABB3f aabb = Theia::AABB3f(m_mesh->Position(vertices[0]), m_mesh->Position(vertices[1]));
+		return Theia::Union(aabb, m_mesh->Position(vertices[2]));
+	}
+
+	Theia::AABB3f Triangle::ClippedBounds(const Theia::AABB3f& clip_aabb) const {
+		std::array<Theia::UInt32, 3> vertices = m_mesh->TriangleVertices(m_triangle_index, m_vertex_offset);
+
+		// Sutherland-Hodgman clipping of the triangle against each slab of clip_aabb; a triangle clipped by six planes has at most nine vertices.
+		std::array<Theia::Point3f, 9> polygon = { m_mesh->Position(vertices[0]), m_mesh->Position(vertices[1]), m_mesh->Position(vertices[2]) };
+		std::array<Theia::Point3f, 9> clipped_polygon;
+		Theia::UInt32 vertex_count = 3;
+
+		for (Theia::UInt32 plane = 0; plane < 6 && vertex_count > 0; ++plane) {
+			Theia::UInt32 axis = plane % 3;
+			Theia::Float sign = (plane < 3) ? 1.0f : -1.0f;
+			Theia::Float position = (plane < 3) ? clip_aabb.m_min[axis] : clip_aabb.m_max[axis];
+			Theia::UInt32 clipped_count = 0;
+
+			for (Theia::UInt32 i = 0; i < vertex_count; ++i) {
+				const Theia::Point3f& current = polygon[i];
+				const Theia::Point3f& next = polygon[(i + 1) % vertex_count];
+				Theia::Float current_distance = sign * (current[axis] - position);
+				Theia::Float next_distance = sign * (next[axis] - position);
+
+				if (current_distance >= 0) {
+					clipped_polygon[clipped_count++] = current;
+				}
+
+				if ((current_distance < 0 && next_distance > 0) || (current_distance > 0 && next_distance < 0)) {
+					Theia::Float t = current_distance / (current_distance - next_distance);
+					Theia::Point3f intersection = current + (next - current) * t;
+					intersection[axis] = position;
+					clipped_polygon[clipped_count++] = intersection;
+				}
+			}
+
+			polygon = clipped_polygon;
+			vertex_count = clipped_count;
+		}
+
+		Theia::AABB3f aabb;
+		for (Theia::UInt32 i = 0; i < vertex_count; ++i) {
+			aabb = Theia::Union(aabb, polygon[i]);
+		}
+
+		return Theia::Intersection(aabb, clip_aabb);
+	}
+
+	std::optional<Theia::ShapeIntersection> Triangle::Intersect(const Theia::Ray& ray, Theia::Float t_max) const {
+		std::array<Theia::UInt32, 3> vertices = m_mesh->TriangleVertices(m_triangle_index, m_vertex_offset);
+		std::optional<Theia::TriangleIntersection> triangle_intersection = Theia::IntersectTriangle(ray, t_max, m_mesh->Position(vertices[0]), m_mesh->Position(vertices[1]), m_mesh->Position(vertices[2]));
+
+		if (!triangle_intersection) {
+			return {};
+		}
+
+		return InteractionFromIntersection(*triangle_intersection, ray);
+	}
+
+	bool Triangle::Occluded(const Theia::Ray& ray, Theia::Float t_max) const {
+		std::array<Theia::UInt32, 3> vertices = m_mesh->TriangleVertices(m_triangle_index, m_vertex_offset);
+		return Theia::IntersectTriangle(ray, t_max, m_mesh->Position(vertices[0]), m_mesh->Position(vertices[1]), m_mesh->Position(vertices[2])).has_value();
+	}
+
+	Theia::Float Triangle::Area() const {
+		std::array<Theia::UInt32, 3> vertices = m_mesh->TriangleVertices(m_triangle_index, m_vertex_offset);
+		Theia::Point3f p0 = m_mesh->Position(vertices[0]);
+		Theia::Point3f p1 = m_mesh->Position(vertices[1]);
+		Theia::Point3f p2 = m_mesh->Position(vertices[2]);
+		return 0.5f * Theia::Length(Theia::Cross(p1 - p0, p2 - p0));
+	}
+
+	std::vector<Theia::Triangle> Triangle::CreateTriangles(const Theia::TriangleMesh* mesh) {
+		std::vector<Theia::Triangle> triangles;
+		triangles.reserve(mesh->TriangleCount());
+
+		for (Theia::UInt32 i = 0; i < mesh->TriangleCount(); ++i) {
+			triangles.push_back(Theia::Triangle(mesh, i));
+		}
+
+		return triangles;
+	}
+
+	template <Theia::UInt32 Width> Theia::TriangleBlock<Width> Triangle::CreateTriangleBlock(std::span<const Theia::Triangle* const> triangles) {
+		assert(triangles.size() <= Width, "Triangle::CreateTriangleBlock too many triangles for one block.");
+		Theia::TriangleBlock<Width> block = {};
+		for (Theia::UInt32 lane = 0; lane < triangles.size(); ++lane) {
+			const Theia::TriangleMesh* mesh = triangles[lane]->m_mesh;
+			std::array<Theia::UInt32, 3> vertices = mesh->TriangleVertices(triangles[lane]->m_triangle_index, triangles[lane]->m_vertex_offset);
+			// Compressed meshes are decoded here once, so packed leaves trace at full speed but hold uncompressed copies.
+			Theia::Point3f p[3] = { mesh->Position(vertices[0]), mesh->Position(vertices[1]), mesh->Position(vertices[2]) };
+			for (Theia::UInt32 vertex = 0; vertex < 3; ++vertex) {
+				for (Theia::UInt32 axis = 0; axis < 3; ++axis) {
+					block.m_positions[vertex][axis][lane] = p[vertex][axis];
+				}
+			}
+
+			// Degenerate triangles never report a hit, so their lanes are left empty.
+			if (Theia::LengthSquared(Theia::Cross(p[2] - p[0], p[1] - p[0])) != 0.0f) {
+				block.m_triangles[lane] = triangles[lane];
+			}
+		}
+		return block;
+	}
+
+	template Theia::TriangleBlock<4> Triangle::CreateTriangleBlock<4>(std::span<const Theia::Triangle* const> triangles);
+	template Theia::TriangleBlock<8> Triangle::CreateTriangleBlock<8>(std::span<const Theia::Triangle* const> triangles);
+
+	Theia::ShapeIntersection Triangle::InteractionFromIntersection(const Theia::TriangleIntersection& triangle_intersection, const Theia::Ray& ray) const {
+		std::array<Theia::UInt32, 3> vertices = m_mesh->TriangleVertices(m_triangle_index, m_vertex_offset);
+		Theia::Point3f p0 = m_mesh->Position(vertices[0]);
+		Theia::Point3f p1 = m_mesh->Position(vertices[1]);
+		Theia::Point3f p2 = m_mesh->Position(vertices[2]);
+		Theia::Float b0 = triangle_intersection.m_b0;
+		Theia::Float b1 = triangle_intersection.m_b1;
+		Theia::Float b2 = triangle_intersection.m_b2;
+
+		Theia::Vector3f hit = b0 * (p0 - Theia::Point3f()) + b1 * (p1 - Theia::Point3f()) + b2 * (p2 - Theia::Point3f());
+		Theia::Vector3f error = Theia::Gamma(7) * (Theia::Abs(b0 * (p0 - Theia::Point3f())) + Theia::Abs(b1 * (p1 - Theia::Point3f())) + Theia::Abs(b2 * (p2 - Theia::Point3f())));
+		Theia::Point3Interval point_interval = Theia::Point3Interval(
+			Theia::Interval::FromValueAndError(hit.m_x, error.m_x),
+			Theia::Interval::FromValueAndError(hit.m_y, error.m_y),
+			Theia::Interval::FromValueAndError(hit.m_z, error.m_z)
+		);
+
+		Theia::Vector3f geometric_normal = Theia::Normalize(Theia::Cross(p0 - p2, p1 - p2));
+		if (m_mesh->HasNormals()) {
+			Theia::Normal3f n0 = m_mesh->Normal(vertices[0]);
+			Theia::Normal3f n1 = m_mesh->Normal(vertices[1]);
+			Theia::Normal3f n2 = m_mesh->Normal(vertices[2]);
+			Theia::Vector3f shading_normal = Theia::Vector3f(
+				b0 * n0.m_x + b1 * n1.m_x + b2 * n2.m_x,
+				b0 * n0.m_y + b1 * n1.m_y + b2 * n2.m_y,
+				b0 * n0.m_z + b1 * n1.m_z + b2 * n2.m_z
+			);
+			if (Theia::Dot(geometric_normal, shading_normal) < 0.0f) {
+				geometric_normal = -geometric_normal;
+			}
+		}
+
+		Theia::Point2f uv = Theia::Point2f(b1 + b2, b2);
+		if (m_mesh->HasUVs()) {
+			Theia::Point2f uv0 = m_mesh->UV(vertices[0]);
+			Theia::Point2f uv1 = m_mesh->UV(vertices[1]);
+			Theia::Point2f uv2 = m_mesh->UV(vertices[2]);
+			uv = Theia::Point2f(b0 * uv0.m_x + b1 * uv1.m_x + b2 * uv2.m_x, b0 * uv0.m_y + b1 * uv1.m_y + b2 * uv2.m_y);
+		}
+
+		Theia::IInteraction interaction = Theia::IInteraction(point_interval, ray.GetTime(), -ray.GetDirection(), Theia::Normal3f(geometric_normal.m_x, geometric_normal.m_y, geometric_normal.m_z), uv, ray.GetMedium());
+		return Theia::ShapeIntersection{ interaction, triangle_intersection.m_t };
+	}
+}
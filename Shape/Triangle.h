@@ -0,0 +1,59 @@
+#ifndef _THEIA_SHAPE_TRIANGLE_H_
+#define _THEIA_SHAPE_TRIANGLE_H_
+#include "IShape.h"
+#include "TriangleMesh.h"
+#include <span>
+#include <vector>
+
+namespace Theia {
+	typedef struct TriangleIntersection {
+		Theia::Float m_b0, m_b1, m_b2;
+		Theia::Float m_t;
+	} TriangleIntersection;
+
+	std::optional<Theia::TriangleIntersection> IntersectTriangle(const Theia::Ray& ray, Theia::Float t_max, const Theia::Point3f& p0, const Theia::Point3f& p1, const Theia::Point3f& p2);
+
+	class Triangle;
+
+	// Up to Width triangles with their vertices copied out of the mesh in SoA form, so that all of them can be tested against a ray at once. Lanes without a triangle, or with a degenerate one, have a null m_triangles entry.
+	template <Theia::UInt32 Width> struct alignas(32) TriangleBlock {
+		Theia::Float m_positions[3][3][Width];
+		const Theia::Triangle* m_triangles[Width];
+	};
+
+	typedef struct TriangleBlockIntersection {
+		Theia::TriangleIntersection m_triangle_intersection;
+		const Theia::Triangle* m_triangle;
+	} TriangleBlockIntersection;
+
+	// Closest hit among the triangles of block, with the same watertight test as IntersectTriangle. Uses AVX2 when the build enables it.
+	template <Theia::UInt32 Width> std::optional<Theia::TriangleBlockIntersection> IntersectTriangleBlock(const Theia::Ray& ray, Theia::Float t_max, const Theia::TriangleBlock<Width>& block);
+
+	class Triangle : public IShape {
+	public:
+		Triangle(const Theia::TriangleMesh* mesh, Theia::UInt32 triangle_index);
+
+		Theia::AABB3f Bounds() const override;
+		Theia::AABB3f ClippedBounds(const Theia::AABB3f& clip_aabb) const override;
+		std::optional<Theia::ShapeIntersection> Intersect(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		bool Occluded(const Theia::Ray& ray, Theia::Float t_max = Theia::Infinity) const override;
+		Theia::Float Area() const override;
+
+		Theia::ShapeIntersection InteractionFromIntersection(const Theia::TriangleIntersection& triangle_intersection, const Theia::Ray& ray) const;
+		const Theia::TriangleMesh* GetMesh() const;
+		Theia::UInt32 GetTriangleIndex() const;
+		// Null when the mesh has no meshlets.
+		const Theia::Meshlet* GetMeshlet() const;
+
+		static std::vector<Theia::Triangle> CreateTriangles(const Theia::TriangleMesh* mesh);
+		template <Theia::UInt32 Width> static Theia::TriangleBlock<Width> CreateTriangleBlock(std::span<const Theia::Triangle* const> triangles);
+	protected:
+	private:
+
+		const Theia::TriangleMesh* m_mesh;
+		Theia::UInt32 m_triangle_index;
+		// Start of the vertex table of the meshlet of the triangle, kept in what would otherwise be padding.
+		Theia::UInt32 m_vertex_offset;
+	};
+}
+#endif
@@ -0,0 +1,213 @@
+#include "TriangleMesh.h"
+#include <algorithm>
+#include <numeric>
+
+namespace Theia {
+	void TriangleMesh::Compress(const Theia::MeshCompression& compression) {
+		assert(m_position_quantization == Theia::PositionQuantization::None && m_octahedral_normals.empty() && m_half_uvs.empty(), "TriangleMesh::Compress mesh is already compressed.");
+		assert(!m_is_view, "TriangleMesh::Compress cannot compress a view.");
+
+		if (compression.m_position_quantization != Theia::PositionQuantization::None && !m_positions.empty()) {
+			Theia::AABB3f bounds;
+			for (const Theia::Point3f& position : m_positions) {
+				bounds = Theia::Union(bounds, position);
+			}
+
+			Theia::UInt32 bits = compression.m_position_quantization == Theia::PositionQuantization::Bits16 ? 16 : 21;
+			Theia::Float max_quantized = Theia::Float((Theia::UInt32(1) << bits) - 1);
+			Theia::Vector3f extent = bounds.Diagonal();
+			m_quantization_origin = bounds.m_min;
+			m_quantization_scale = extent / max_quantized;
+
+			auto quantize = [&](Theia::Float value, Theia::Float origin, Theia::Float range) {
+				if (range <= 0.0f) {
+					return Theia::UInt32(0);
+				}
+				return Theia::UInt32(std::clamp(std::round((value - origin) / range * max_quantized), 0.0f, max_quantized));
+			};
+
+			for (const Theia::Point3f& position : m_positions) {
+				Theia::UInt32 x = quantize(position.m_x, bounds.m_min.m_x, extent.m_x);
+				Theia::UInt32 y = quantize(position.m_y, bounds.m_min.m_y, extent.m_y);
+				Theia::UInt32 z = quantize(position.m_z, bounds.m_min.m_z, extent.m_z);
+				if (compression.m_position_quantization == Theia::PositionQuantization::Bits16) {
+					m_quantized_positions_16.insert(m_quantized_positions_16.end(), { Theia::UInt16(x), Theia::UInt16(y), Theia::UInt16(z) });
+				}
+				else {
+					m_quantized_positions_21.push_back(Theia::UInt64(x) | (Theia::UInt64(y) << 21) | (Theia::UInt64(z) << 42));
+				}
+			}
+
+			m_position_quantization = compression.m_position_quantization;
+			m_positions = std::vector<Theia::Point3f>();
+		}
+
+		if (compression.m_octahedral_normals && !m_normals.empty()) {
+			m_octahedral_normals.reserve(m_normals.size());
+			for (const Theia::Normal3f& normal : m_normals) {
+				m_octahedral_normals.push_back(Theia::OctahedralVector(Theia::Vector3f(normal.m_x, normal.m_y, normal.m_z)));
+			}
+			m_normals = std::vector<Theia::Normal3f>();
+		}
+
+		if (compression.m_half_uvs && !m_uvs.empty()) {
+			m_half_uvs.reserve(2 * m_uvs.size());
+			for (const Theia::Point2f& uv : m_uvs) {
+				m_half_uvs.push_back(Theia::Half(uv.m_x));
+				m_half_uvs.push_back(Theia::Half(uv.m_y));
+			}
+			m_uvs = std::vector<Theia::Point2f>();
+		}
+	}
+
+	void TriangleMesh::BuildMeshlets(Theia::UInt32 max_vertices, Theia::UInt32 max_triangles) {
+		assert(m_position_quantization == Theia::PositionQuantization::None && m_octahedral_normals.empty() && m_half_uvs.empty(), "TriangleMesh::BuildMeshlets must be called before Compress.");
+		assert(m_meshlets.empty(), "TriangleMesh::BuildMeshlets mesh already has meshlets.");
+		assert(!m_is_view, "TriangleMesh::BuildMeshlets cannot cluster a view.");
+		assert(max_vertices >= 3 && max_vertices <= Max_Meshlet_Vertices && max_triangles >= 1 && max_triangles <= 0xFFFF, "TriangleMesh::BuildMeshlets meshlet limits out of range.");
+
+		Theia::UInt32 triangle_count = TriangleCount();
+		if (triangle_count == 0) {
+			return;
+		}
+
+		std::vector<Theia::Point3f> centroids(triangle_count);
+		for (Theia::UInt32 i = 0; i < triangle_count; i++) {
+			const Theia::UInt32* vertices = &m_indices[3 * i];
+			centroids[i] = Theia::Union(Theia::AABB3f(m_positions[vertices[0]], m_positions[vertices[1]]), m_positions[vertices[2]]).Centroid();
+		}
+
+		// Ranges of triangles are split at the median centroid along their longest axis until they fit in a meshlet, which keeps meshlets about square and evenly filled. Ranges are visited depth first, so every meshlet is a contiguous run of the final triangle order.
+		std::vector<Theia::UInt32> order(triangle_count);
+		std::iota(order.begin(), order.end(), 0);
+		std::vector<Theia::UInt32> stamp(m_positions.size(), 0);
+		Theia::UInt32 current_stamp = 0;
+		std::vector<std::pair<Theia::UInt32, Theia::UInt32>> ranges = { { 0, triangle_count } };
+		std::vector<Theia::Int32> local_index(m_positions.size(), -1);
+		m_local_indices.reserve(3 * size_t(triangle_count));
+
+		while (!ranges.empty()) {
+			auto [begin, end] = ranges.back();
+			ranges.pop_back();
+
+			current_stamp++;
+			Theia::UInt32 vertex_count = 0;
+			for (Theia::UInt32 i = begin; i < end; i++) {
+				for (Theia::UInt32 j = 0; j < 3; j++) {
+					Theia::UInt32 vertex = m_indices[3 * order[i] + j];
+					if (stamp[vertex] != current_stamp) {
+						stamp[vertex] = current_stamp;
+						vertex_count++;
+					}
+				}
+			}
+
+			if (end - begin > max_triangles || vertex_count > max_vertices) {
+				Theia::AABB3f range_bounds;
+				for (Theia::UInt32 i = begin; i < end; i++) {
+					range_bounds = Theia::Union(range_bounds, centroids[order[i]]);
+				}
+				Theia::UInt32 axis = Theia::MaxComponentIndex(range_bounds.Diagonal());
+				Theia::UInt32 middle = begin + (end - begin) / 2;
+				std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](Theia::UInt32 a, Theia::UInt32 b) {
+					return centroids[a][axis] < centroids[b][axis];
+				});
+				ranges.push_back({ middle, end });
+				ranges.push_back({ begin, middle });
+				continue;
+			}
+
+			Theia::Meshlet meshlet = { Theia::AABB3f(), Theia::UInt32(m_meshlet_vertices.size()), begin, Theia::UInt16(vertex_count), Theia::UInt16(end - begin) };
+			for (Theia::UInt32 i = begin; i < end; i++) {
+				for (Theia::UInt32 j = 0; j < 3; j++) {
+					Theia::UInt32 vertex = m_indices[3 * order[i] + j];
+					if (local_index[vertex] < 0) {
+						local_index[vertex] = Theia::Int32(m_meshlet_vertices.size() - meshlet.m_vertex_offset);
+						m_meshlet_vertices.push_back(vertex);
+						meshlet.m_bounds = Theia::Union(meshlet.m_bounds, m_positions[vertex]);
+					}
+					m_local_indices.push_back(Theia::UInt8(local_index[vertex]));
+				}
+			}
+			for (Theia::UInt32 i = meshlet.m_vertex_offset; i < m_meshlet_vertices.size(); i++) {
+				local_index[m_meshlet_vertices[i]] = -1;
+			}
+			m_meshlets.push_back(meshlet);
+		}
+
+		// Vertices are renumbered in the order the meshlets first use them, so the vertex tables mostly read forward through memory. Unused vertices go last.
+		std::vector<Theia::UInt32> new_index(m_positions.size(), ~Theia::UInt32(0));
+		std::vector<Theia::UInt32> old_index;
+		old_index.reserve(m_positions.size());
+		for (Theia::UInt32& vertex : m_meshlet_vertices) {
+			if (new_index[vertex] == ~Theia::UInt32(0)) {
+				new_index[vertex] = Theia::UInt32(old_index.size());
+				old_index.push_back(vertex);
+			}
+			vertex = new_index[vertex];
+		}
+		for (Theia::UInt32 vertex = 0; vertex < m_positions.size(); vertex++) {
+			if (new_index[vertex] == ~Theia::UInt32(0)) {
+				old_index.push_back(vertex);
+			}
+		}
+
+		auto permute = [&](auto& attributes) {
+			if (attributes.empty()) {
+				return;
+			}
+			std::remove_reference_t<decltype(attributes)> permuted;
+			permuted.reserve(attributes.size());
+			for (Theia::UInt32 vertex : old_index) {
+				permuted.push_back(attributes[vertex]);
+			}
+			attributes = std::move(permuted);
+		};
+		permute(m_positions);
+		permute(m_normals);
+		permute(m_uvs);
+
+		m_indices = std::vector<Theia::UInt32>();
+		m_meshlets.shrink_to_fit();
+		m_meshlet_vertices.shrink_to_fit();
+	}
+
+	const Theia::Meshlet* TriangleMesh::FindMeshlet(Theia::UInt32 triangle_index) const {
+		if (m_meshlets.empty()) {
+			return nullptr;
+		}
+
+		auto meshlet = std::upper_bound(m_meshlets.begin(), m_meshlets.end(), triangle_index, [](Theia::UInt32 index, const Theia::Meshlet& meshlet) {
+			return index < meshlet.m_triangle_offset;
+		});
+		return &*(meshlet - 1);
+	}
+
+	Theia::UInt32 TriangleMesh::VertexCount() const {
+		if (m_is_view) {
+			return Theia::UInt32(m_view_positions.size());
+		}
+		else if (m_position_quantization == Theia::PositionQuantization::Bits16) {
+			return Theia::UInt32(m_quantized_positions_16.size() / 3);
+		}
+		else if (m_position_quantization == Theia::PositionQuantization::Bits21) {
+			return Theia::UInt32(m_quantized_positions_21.size());
+		}
+		return Theia::UInt32(m_positions.size());
+	}
+
+	Theia::UInt64 TriangleMesh::MemoryBytes() const {
+		return sizeof(TriangleMesh) +
+			m_positions.capacity() * sizeof(Theia::Point3f) +
+			m_indices.capacity() * sizeof(Theia::UInt32) +
+			m_normals.capacity() * sizeof(Theia::Normal3f) +
+			m_uvs.capacity() * sizeof(Theia::Point2f) +
+			m_quantized_positions_16.capacity() * sizeof(Theia::UInt16) +
+			m_quantized_positions_21.capacity() * sizeof(Theia::UInt64) +
+			m_octahedral_normals.capacity() * sizeof(Theia::OctahedralVector) +
+			m_half_uvs.capacity() * sizeof(Theia::Half) +
+			m_meshlets.capacity() * sizeof(Theia::Meshlet) +
+			m_meshlet_vertices.capacity() * sizeof(Theia::UInt32) +
+			m_local_indices.capacity() * sizeof(Theia::UInt8);
+	}
+}
\ No newline at end of file
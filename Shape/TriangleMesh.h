@@ -0,0 +1,163 @@
+#ifndef _THEIA_SHAPE_TRIANGLE_MESH_H_
+#define _THEIA_SHAPE_TRIANGLE_MESH_H_
+#include "../Math/Math.h"
+#include "../Math/Half.h"
+#include "../Math/OctahedralVector.h"
+#include <array>
+#include <span>
+#include <vector>
+
+namespace Theia {
+	// Positions are quantized relative to the mesh bounds, so the largest error along an axis is half the extent of the mesh along that axis divided by 2^bits - 1.
+	enum class PositionQuantization {
+		None,
+		Bits16,
+		Bits21
+	};
+
+	typedef struct MeshCompression {
+		Theia::PositionQuantization m_position_quantization = Theia::PositionQuantization::Bits16;
+		bool m_octahedral_normals = true;
+		bool m_half_uvs = true;
+	} MeshCompression;
+
+	// A spatially compact run of triangles that uses at most 256 vertices. Its triangles index into its own table of vertices, which starts at m_vertex_offset in TriangleMesh::m_meshlet_vertices, with 8-bit indices.
+	typedef struct Meshlet {
+		Theia::AABB3f m_bounds;
+		Theia::UInt32 m_vertex_offset;
+		Theia::UInt32 m_triangle_offset;
+		Theia::UInt16 m_vertex_count;
+		Theia::UInt16 m_triangle_count;
+	} Meshlet;
+
+	class TriangleMesh {
+	public:
+		TriangleMesh(const Theia::Transform& render_from_object, std::vector<Theia::Point3f> positions, std::vector<Theia::UInt32> indices, std::vector<Theia::Normal3f> normals = {}, std::vector<Theia::Point2f> uvs = {}) :
+			m_positions(std::move(positions)),
+			m_indices(std::move(indices)),
+			m_normals(std::move(normals)),
+			m_uvs(std::move(uvs))
+		{
+			for (Theia::Point3f& position : m_positions) {
+				position = render_from_object(position);
+			}
+
+			for (Theia::Normal3f& normal : m_normals) {
+				normal = render_from_object(normal);
+			}
+		}
+
+		// Views vertex and index buffers owned by someone else, such as a mapped SceneCache, instead of copying them. The buffers must already be in render space and must outlive the mesh, which cannot be compressed or clustered.
+		TriangleMesh(std::span<const Theia::Point3f> positions, std::span<const Theia::UInt32> indices, std::span<const Theia::Normal3f> normals, std::span<const Theia::Point2f> uvs) :
+			m_view_positions(positions),
+			m_view_indices(indices),
+			m_view_normals(normals),
+			m_view_uvs(uvs),
+			m_is_view(true)
+		{
+
+		}
+
+		Theia::UInt32 TriangleCount() const {
+			if (m_is_view) {
+				return Theia::UInt32(m_view_indices.size() / 3);
+			}
+			return Theia::UInt32((m_local_indices.empty() ? m_indices.size() : m_local_indices.size()) / 3);
+		}
+
+		// Splits the triangles into spatially compact meshlets, reorders them meshlet by meshlet and renumbers the vertices in the order the meshlets use them. Replaces the 12 bytes of m_indices per triangle by 3 bytes of m_local_indices plus about 3 bytes of vertex tables. Must be called before Compress() and before triangles are created.
+		void BuildMeshlets(Theia::UInt32 max_vertices = Max_Meshlet_Vertices, Theia::UInt32 max_triangles = Max_Meshlet_Triangles);
+		// Null when the mesh has no meshlets.
+		const Theia::Meshlet* FindMeshlet(Theia::UInt32 triangle_index) const;
+
+		// Vertex indices of a triangle, given the m_vertex_offset of its meshlet (0 without meshlets).
+		std::array<Theia::UInt32, 3> TriangleVertices(Theia::UInt32 triangle_index, Theia::UInt32 vertex_offset) const {
+			if (m_local_indices.empty()) {
+				const Theia::UInt32* vertices = m_is_view ? &m_view_indices[3 * triangle_index] : &m_indices[3 * triangle_index];
+				return { vertices[0], vertices[1], vertices[2] };
+			}
+			const Theia::UInt8* local_indices = &m_local_indices[3 * triangle_index];
+			const Theia::UInt32* meshlet_vertices = &m_meshlet_vertices[vertex_offset];
+			return { meshlet_vertices[local_indices[0]], meshlet_vertices[local_indices[1]], meshlet_vertices[local_indices[2]] };
+		}
+
+		// Replaces the vertex attributes by their compressed form, which the accessors below decode on every access. Must be called before triangles or BVHs are built over the mesh, and the vertex vectors must not be edited afterwards.
+		void Compress(const Theia::MeshCompression& compression = Theia::MeshCompression());
+
+		Theia::Point3f Position(Theia::UInt32 vertex) const {
+			if (m_position_quantization == Theia::PositionQuantization::None) {
+				return m_is_view ? m_view_positions[vertex] : m_positions[vertex];
+			}
+			else if (m_position_quantization == Theia::PositionQuantization::Bits16) {
+				const Theia::UInt16* quantized = &m_quantized_positions_16[3 * vertex];
+				return Theia::Point3f(
+					m_quantization_origin.m_x + Theia::Float(quantized[0]) * m_quantization_scale.m_x,
+					m_quantization_origin.m_y + Theia::Float(quantized[1]) * m_quantization_scale.m_y,
+					m_quantization_origin.m_z + Theia::Float(quantized[2]) * m_quantization_scale.m_z
+				);
+			}
+			else {
+				Theia::UInt64 packed = m_quantized_positions_21[vertex];
+				return Theia::Point3f(
+					m_quantization_origin.m_x + Theia::Float(packed & Bits_21_Mask) * m_quantization_scale.m_x,
+					m_quantization_origin.m_y + Theia::Float((packed >> 21) & Bits_21_Mask) * m_quantization_scale.m_y,
+					m_quantization_origin.m_z + Theia::Float((packed >> 42) & Bits_21_Mask) * m_quantization_scale.m_z
+				);
+			}
+		}
+
+		bool HasNormals() const {
+			return !m_normals.empty() || !m_octahedral_normals.empty() || !m_view_normals.empty();
+		}
+
+		Theia::Normal3f Normal(Theia::UInt32 vertex) const {
+			if (!m_octahedral_normals.empty()) {
+				Theia::Vector3f normal = Theia::Vector3f(m_octahedral_normals[vertex]);
+				return Theia::Normal3f(normal.m_x, normal.m_y, normal.m_z);
+			}
+			return m_is_view ? m_view_normals[vertex] : m_normals[vertex];
+		}
+
+		bool HasUVs() const {
+			return !m_uvs.empty() || !m_half_uvs.empty() || !m_view_uvs.empty();
+		}
+
+		Theia::Point2f UV(Theia::UInt32 vertex) const {
+			if (!m_half_uvs.empty()) {
+				return Theia::Point2f(Theia::Float(m_half_uvs[2 * vertex]), Theia::Float(m_half_uvs[2 * vertex + 1]));
+			}
+			return m_is_view ? m_view_uvs[vertex] : m_uvs[vertex];
+		}
+
+		Theia::UInt32 VertexCount() const;
+		// Memory owned by the mesh, which excludes the buffers of a view.
+		Theia::UInt64 MemoryBytes() const;
+
+		std::vector<Theia::Point3f> m_positions;
+		std::vector<Theia::UInt32> m_indices;
+		std::vector<Theia::Normal3f> m_normals;
+		std::vector<Theia::Point2f> m_uvs;
+		std::vector<Theia::Meshlet> m_meshlets;
+		std::vector<Theia::UInt32> m_meshlet_vertices;
+		std::vector<Theia::UInt8> m_local_indices;
+
+		static constexpr Theia::UInt32 Max_Meshlet_Vertices = 256;
+		static constexpr Theia::UInt32 Max_Meshlet_Triangles = 256;
+	private:
+		static constexpr Theia::UInt64 Bits_21_Mask = (Theia::UInt64(1) << 21) - 1;
+
+		Theia::PositionQuantization m_position_quantization = Theia::PositionQuantization::None;
+		Theia::Point3f m_quantization_origin;
+		Theia::Vector3f m_quantization_scale;
+		std::vector<Theia::UInt16> m_quantized_positions_16;
+		std::vector<Theia::UInt64> m_quantized_positions_21;
+		std::vector<Theia::OctahedralVector> m_octahedral_normals;
+		std::vector<Theia::Half> m_half_uvs;
+		std::span<const Theia::Point3f> m_view_positions;
+		std::span<const Theia::UInt32> m_view_indices;
+		std::span<const Theia::Normal3f> m_view_normals;
+		std::span<const Theia::Point2f> m_view_uvs;
+		bool m_is_view = false;
+	};
+}
+#endif
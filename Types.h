@@ -3,14 +3,19 @@
 #include <stdint.h>
 #include <bit>
 #include <cmath>
+#include <limits>
 
 namespace Theia {
 	using Float32 = float;
 	using Float64 = double;
 	using FloatBits32 = uint32_t;
 	using FloatBits64 = uint64_t;
+	using UInt8 = uint8_t;
+	using UInt16 = uint16_t;
 	using UInt32 = uint32_t;
 	using UInt64 = uint64_t;
+	using Int8 = int8_t;
+	using Int16 = int16_t;
 	using Int32 = int32_t;
 	using Int64 = int64_t;
 
@@ -74,5 +79,12 @@ namespace Theia {
 	}
 
 	constexpr Theia::Float Infinity = std::numeric_limits<Theia::Float>::infinity();
+	constexpr Theia::Float Pi = 3.14159265358979323846f;
+	constexpr Theia::Float MachineEpsilon = std::numeric_limits<Theia::Float>::epsilon() * 0.5f;
+	constexpr Theia::Float OneMinusEpsilon = 0x1.fffffep-1f;
+
+	inline constexpr Theia::Float Gamma(Theia::Int32 n) {
+		return (n * MachineEpsilon) / (1 - n * MachineEpsilon);
+	}
 }
 #endif
\ No newline at end of file
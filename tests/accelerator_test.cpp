@@ -0,0 +1,1291 @@
+#include "../ext/gtest/gtest.h"
+
+#include "../Math/Math.h"
+#include "../Shape/Triangle.h"
+#include "../Accelerator/BVHAggregate.h"
+#include "../Accelerator/Instance.h"
+#include "../Accelerator/RaySorter.h"
+#include "../Accelerator/GeometryCache.h"
+#include "../Shape/BSplinePatch.h"
+#include "test_helpers.h"
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+using namespace Theia;
+
+// Long, thin triangles running diagonally through the scene, the worst case
+// for object-partition BVHs.
+static std::unique_ptr<TriangleMesh> SliverMesh(RNG& rng, int n, Float length = 1) {
+    std::vector<Point3f> positions;
+    std::vector<UInt32> indices;
+    for (int i = 0; i < n; ++i) {
+        Point3f p = RandomPoint(rng, 1);
+        Vector3f d = length * RandomDirection(rng);
+        Vector3f w = 0.01f * RandomDirection(rng);
+        UInt32 base = UInt32(positions.size());
+        positions.push_back(p - d);
+        positions.push_back(p + d);
+        positions.push_back(p + d + w);
+        indices.push_back(base);
+        indices.push_back(base + 1);
+        indices.push_back(base + 2);
+    }
+    return std::make_unique<TriangleMesh>(Transform(), positions, indices);
+}
+
+// Diagonal walls tessellated into long, thin strips: the triangles barely
+// overlap but their bounding boxes overlap badly.
+static std::unique_ptr<TriangleMesh> WallMesh(RNG& rng, int nWalls, int nStrips) {
+    std::vector<Point3f> positions;
+    std::vector<UInt32> indices;
+    for (int i = 0; i < nWalls; ++i) {
+        Point3f center = RandomPoint(rng, 1);
+        Vector3f u = RandomDirection(rng);
+        Vector3f v = Normalize(Cross(u, RandomDirection(rng)));
+        UInt32 base = UInt32(positions.size());
+        for (int j = 0; j <= nStrips; ++j) {
+            Point3f a = center + (2 * Float(j) / nStrips - 1) * u;
+            positions.push_back(a - v);
+            positions.push_back(a + v);
+        }
+        for (int j = 0; j < nStrips; ++j) {
+            UInt32 k = base + 2 * j;
+            for (UInt32 index : { k, k + 1, k + 3, k, k + 3, k + 2 })
+                indices.push_back(index);
+        }
+    }
+    return std::make_unique<TriangleMesh>(Transform(), positions, indices);
+}
+
+static std::unique_ptr<TriangleMesh> RandomMesh(RNG& rng, int n) {
+    std::vector<Point3f> positions;
+    std::vector<UInt32> indices;
+    for (int i = 0; i < n; ++i) {
+        Point3f p = RandomPoint(rng, 1);
+        UInt32 base = UInt32(positions.size());
+        for (int j = 0; j < 3; ++j) {
+            positions.push_back(p + 0.2f * (RandomPoint(rng, 1) - Point3f()));
+            indices.push_back(base + j);
+        }
+    }
+    return std::make_unique<TriangleMesh>(Transform(), positions, indices);
+}
+
+static void Wave(TriangleMesh& mesh, Float time) {
+    for (Point3f& p : mesh.m_positions)
+        p.m_y = 0.2f * std::sin(4 * p.m_x + time) * std::cos(3 * p.m_z + time);
+}
+
+static void CheckAgainstBruteForce(const BVHAggregate& bvh, const std::vector<Triangle>& triangles, RNG& rng, int nRays) {
+    for (int i = 0; i < nRays; ++i) {
+        Ray ray(RandomPoint(rng, 2), RandomDirection(rng));
+
+        std::optional<ShapeIntersection> expected;
+        Float tMax = Infinity;
+        for (const Triangle& triangle : triangles) {
+            std::optional<ShapeIntersection> si = triangle.Intersect(ray, tMax);
+            if (si) {
+                expected = si;
+                tMax = si->m_t_hit;
+            }
+        }
+
+        std::optional<ShapeIntersection> si = bvh.Intersect(ray);
+        ASSERT_EQ(expected.has_value(), si.has_value());
+        if (si) {
+            EXPECT_EQ(expected->m_t_hit, si->m_t_hit);
+        }
+    }
+}
+
+TEST(Triangle, ClippedBounds) {
+    TriangleMesh mesh(Transform(), { Point3f(0, 0, 0), Point3f(4, 0, 0), Point3f(0, 4, 0) }, { 0, 1, 2 });
+    Triangle triangle(&mesh, 0);
+
+    AABB3f clip(Point3f(2, 2, -1), Point3f(5, 5, 1));
+    AABB3f bounds = triangle.ClippedBounds(clip);
+    EXPECT_EQ(Point3f(2, 2, 0), bounds.m_min);
+    EXPECT_EQ(Point3f(2, 2, 0), bounds.m_max);
+
+    clip = AABB3f(Point3f(-1, -1, -1), Point3f(1, 5, 1));
+    bounds = triangle.ClippedBounds(clip);
+    EXPECT_EQ(Point3f(0, 0, 0), bounds.m_min);
+    EXPECT_EQ(Point3f(1, 4, 0), bounds.m_max);
+
+    clip = AABB3f(Point3f(3, 3, -1), Point3f(5, 5, 1));
+    EXPECT_TRUE(triangle.ClippedBounds(clip).IsEmpty());
+}
+
+TEST(BVHAggregate, MatchesBruteForce) {
+    RNG rng(17);
+    std::unique_ptr<TriangleMesh> mesh = RandomMesh(rng, 500);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(mesh.get());
+
+    BVHAggregate bvh(Primitives(triangles));
+    CheckAgainstBruteForce(bvh, triangles, rng, 1000);
+}
+
+TEST(BVHAggregate, SpatialSplitsMatchBruteForce) {
+    RNG rng(23);
+    std::unique_ptr<TriangleMesh> mesh = SliverMesh(rng, 500);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(mesh.get());
+
+    BVHBuildOptions options;
+    options.m_split_method = BVHSplitMethod::SpatialSAH;
+    BVHAggregate bvh(Primitives(triangles), options);
+    EXPECT_GT(bvh.GetStatistics().m_spatial_split_count, 0u);
+    CheckAgainstBruteForce(bvh, triangles, rng, 1000);
+}
+
+TEST(BVHAggregate, SpatialSplitBudget) {
+    RNG rng(5);
+    std::unique_ptr<TriangleMesh> mesh = SliverMesh(rng, 2000);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(mesh.get());
+
+    BVHAggregate sah(Primitives(triangles));
+    EXPECT_EQ(sah.GetStatistics().m_reference_count, triangles.size());
+
+    for (Float budget : { 0.f, 0.1f, 0.5f }) {
+        BVHBuildOptions options;
+        options.m_split_method = BVHSplitMethod::SpatialSAH;
+        options.m_spatial_split_budget = budget;
+        BVHAggregate sbvh(Primitives(triangles), options);
+
+        const BVHStatistics& stats = sbvh.GetStatistics();
+        EXPECT_LE(stats.m_reference_count, triangles.size() * (1 + budget));
+        if (budget > 0)
+            EXPECT_LT(stats.m_sah_cost, sah.GetStatistics().m_sah_cost);
+        else
+            EXPECT_EQ(stats.m_reference_count, triangles.size());
+    }
+}
+
+// No split separates coincident triangles, yet every leaf must still hold
+// few enough for BVHNode::m_primitive_count to count.
+TEST(BVHAggregate, CoincidentTrianglesFitInLeaves) {
+    const UInt32 n = 70000;
+    std::vector<Point3f> positions = { Point3f(-1, 0, -1), Point3f(1, 0, -1), Point3f(0, 0, 1) };
+    std::vector<UInt32> indices;
+    for (UInt32 i = 0; i < n; ++i)
+        for (UInt32 index : { 0u, 1u, 2u })
+            indices.push_back(index);
+    TriangleMesh mesh(Transform(), positions, indices);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(&mesh);
+
+    for (BVHSplitMethod method : { BVHSplitMethod::SAH, BVHSplitMethod::SpatialSAH }) {
+        BVHBuildOptions options;
+        options.m_split_method = method;
+        BVHAggregate bvh(Primitives(triangles), options);
+
+        UInt64 leafReferences = 0;
+        for (const BVHNode& node : bvh.GetNodes())
+            leafReferences += node.m_primitive_count;
+        EXPECT_EQ(bvh.GetOrderedPrimitives().size(), leafReferences);
+        EXPECT_GE(leafReferences, n);
+
+        std::optional<ShapeIntersection> si = bvh.Intersect(Ray(Point3f(0, 1, 0), Vector3f(0, -1, 0)));
+        ASSERT_TRUE(si.has_value());
+        EXPECT_EQ(1, si->m_t_hit);
+    }
+}
+
+TEST(BVHAggregate, RefitDeformingMesh) {
+    RNG rng(11);
+    std::unique_ptr<TriangleMesh> mesh = GridMesh(30);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(mesh.get());
+    BVHAggregate bvh(Primitives(triangles));
+
+    for (int frame = 1; frame <= 5; ++frame) {
+        Wave(*mesh, 0.3f * frame);
+        BVHUpdateStatistics update = bvh.Update();
+        EXPECT_EQ(0u, update.m_rebuilt_subtree_count);
+        EXPECT_EQ(update.m_sah_cost, bvh.GetStatistics().m_sah_cost);
+        CheckAgainstBruteForce(bvh, triangles, rng, 200);
+    }
+}
+
+TEST(BVHAggregate, RebuildDegradedSubtrees) {
+    RNG rng(13);
+    std::unique_ptr<TriangleMesh> mesh = RandomMesh(rng, 4000);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(mesh.get());
+
+    BVHBuildOptions options;
+    options.m_split_method = BVHSplitMethod::SpatialSAH;
+    BVHAggregate bvh(Primitives(triangles), options);
+
+    // Scramble the vertices: the topology is unchanged but the old tree is
+    // now a poor fit for almost every subtree.
+    for (int i = 0; i < 10 * int(mesh->m_positions.size()); ++i)
+        std::swap(mesh->m_positions[rng.Uniform<UInt32>(mesh->m_positions.size())],
+                  mesh->m_positions[rng.Uniform<UInt32>(mesh->m_positions.size())]);
+
+    BVHUpdateStatistics update = bvh.Update();
+    EXPECT_GT(update.m_rebuilt_subtree_count, 0u);
+    EXPECT_GT(update.m_rebuilt_primitive_count, 0u);
+    EXPECT_EQ(bvh.GetStatistics().m_node_count, bvh.GetStatistics().m_leaf_count * 2 - 1);
+    CheckAgainstBruteForce(bvh, triangles, rng, 500);
+
+    // A second update without motion keeps the tree as it is.
+    update = bvh.Update();
+    EXPECT_EQ(0u, update.m_rebuilt_subtree_count);
+    CheckAgainstBruteForce(bvh, triangles, rng, 500);
+}
+
+// Run with --gtest_also_run_disabled_tests to compare per-frame update time
+// with rebuilding from scratch.
+TEST(BVHAggregate, DISABLED_UpdateBenchmark) {
+    std::unique_ptr<TriangleMesh> mesh = GridMesh(500);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(mesh.get());
+    BVHAggregate bvh(Primitives(triangles));
+
+    for (int frame = 1; frame <= 10; ++frame) {
+        Wave(*mesh, 0.5f * frame);
+        BVHUpdateStatistics update = bvh.Update();
+
+        auto start = std::chrono::steady_clock::now();
+        BVHAggregate rebuilt(Primitives(triangles));
+        double rebuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "frame " << frame << ": update " << update.m_total_milliseconds << " ms (refit "
+                  << update.m_refit_milliseconds << " ms, " << update.m_rebuilt_subtree_count << " subtrees rebuilt in "
+                  << update.m_rebuild_milliseconds << " ms), SAH cost " << update.m_sah_cost << "; full rebuild "
+                  << rebuildMilliseconds << " ms, SAH cost " << rebuilt.GetStatistics().m_sah_cost << std::endl;
+    }
+}
+
+static Transform RandomTransform(RNG& rng) {
+    return Translate(RandomPoint(rng, 4) - Point3f()) * RotateYAxis(6.28f * rng.Uniform<Float>()) *
+           RotateXAxis(6.28f * rng.Uniform<Float>()) * Scale(Vector3f(0.5f + rng.Uniform<Float>()));
+}
+
+TEST(Instance, MatchesFlattened) {
+    RNG rng(3);
+    std::unique_ptr<TriangleMesh> objectMesh = RandomMesh(rng, 200);
+    std::vector<Triangle> objectTriangles = Triangle::CreateTriangles(objectMesh.get());
+    BVHAggregate blas(Primitives(objectTriangles));
+
+    std::vector<std::unique_ptr<TriangleMesh>> flattenedMeshes;
+    std::vector<Triangle> flattenedTriangles;
+    std::vector<Instance> instances;
+    for (int i = 0; i < 20; ++i) {
+        Transform renderFromObject = RandomTransform(rng);
+        instances.push_back(Instance(&blas, renderFromObject));
+        flattenedMeshes.push_back(std::make_unique<TriangleMesh>(renderFromObject, objectMesh->m_positions, objectMesh->m_indices));
+        for (Triangle& triangle : Triangle::CreateTriangles(flattenedMeshes.back().get()))
+            flattenedTriangles.push_back(triangle);
+    }
+
+    std::vector<Primitive> instancePrimitives;
+    for (Instance& instance : instances)
+        instancePrimitives.push_back(&instance);
+    BVHAggregate tlas(instancePrimitives);
+    BVHAggregate flattened(Primitives(flattenedTriangles));
+
+    int mismatches = 0, hits = 0;
+    for (int i = 0; i < 10000; ++i) {
+        Ray ray(RandomPoint(rng, 6), RandomDirection(rng));
+        std::optional<ShapeIntersection> expected = flattened.Intersect(ray);
+        std::optional<ShapeIntersection> si = tlas.Intersect(ray);
+        if (expected.has_value() != si.has_value()) {
+            ++mismatches;
+            continue;
+        }
+        if (!si)
+            continue;
+
+        ++hits;
+        EXPECT_NEAR(expected->m_t_hit, si->m_t_hit, 1e-3f * expected->m_t_hit);
+        Point3f p = ray(si->m_t_hit);
+        const Point3Interval& pi = si->m_interaction.m_point_interval;
+        for (int c = 0; c < 3; ++c)
+            EXPECT_NEAR(p[c], Float(pi[c]), 1e-3f);
+    }
+    EXPECT_GT(hits, 100);
+    // Only rays grazing triangle edges may disagree.
+    EXPECT_LT(mismatches, 10);
+}
+
+TEST(Instance, SharesGeometry) {
+    RNG rng(9);
+    std::unique_ptr<TriangleMesh> objectMesh = RandomMesh(rng, 5000);
+    std::vector<Triangle> objectTriangles = Triangle::CreateTriangles(objectMesh.get());
+    BVHAggregate blas(Primitives(objectTriangles));
+
+    std::vector<Instance> instances;
+    for (int i = 0; i < 10000; ++i)
+        instances.push_back(Instance(&blas, RandomTransform(rng)));
+    std::vector<Primitive> instancePrimitives;
+    for (Instance& instance : instances)
+        instancePrimitives.push_back(&instance);
+    BVHAggregate tlas(instancePrimitives);
+
+    // Per-instance cost is a few BVH nodes plus the Instance itself,
+    // independent of the size of the instanced geometry.
+    double bytesPerInstance = double(tlas.GetStatistics().m_memory_bytes + instances.size() * sizeof(Instance)) / instances.size();
+    EXPECT_LT(bytesPerInstance, 300);
+    EXPECT_LT(bytesPerInstance * 10, blas.GetStatistics().m_memory_bytes);
+}
+
+// Run with --gtest_also_run_disabled_tests to compare traversal speed and
+// memory of the two build modes.
+TEST(BVHAggregate, DISABLED_SpatialSplitBenchmark) {
+    RNG rng(1);
+    std::unique_ptr<TriangleMesh> mesh = WallMesh(rng, 32, 500);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(mesh.get());
+
+    std::vector<Ray> rays;
+    for (int i = 0; i < 100000; ++i)
+        rays.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+
+    for (Float budget : { 0.f, 0.3f, 1.f, 4.f }) {
+        BVHBuildOptions options;
+        options.m_split_method = budget > 0 ? BVHSplitMethod::SpatialSAH : BVHSplitMethod::SAH;
+        options.m_spatial_split_budget = budget;
+
+        auto start = std::chrono::steady_clock::now();
+        BVHAggregate bvh(Primitives(triangles), options);
+        auto built = std::chrono::steady_clock::now();
+
+        int hits = 0;
+        for (const Ray& ray : rays)
+            hits += bvh.Intersect(ray).has_value();
+        auto traced = std::chrono::steady_clock::now();
+
+        const BVHStatistics& stats = bvh.GetStatistics();
+        double buildSeconds = std::chrono::duration<double>(built - start).count();
+        double traceSeconds = std::chrono::duration<double>(traced - built).count();
+        std::cout << (budget > 0 ? "SpatialSAH" : "SAH") << " (budget " << budget << ")"
+                  << ": build " << buildSeconds << " s, "
+                  << rays.size() / traceSeconds / 1e6 << " Mrays/s, "
+                  << "SAH cost " << stats.m_sah_cost << ", "
+                  << stats.m_reference_count << " references, "
+                  << stats.m_node_count << " nodes, "
+                  << stats.m_memory_bytes / (1024.0 * 1024.0) << " MiB, "
+                  << hits << " hits" << std::endl;
+    }
+}
+
+// Pinhole camera rays, ordered by 8x8 screen tiles as a tile renderer would
+// generate them.
+static std::vector<Ray> PrimaryRays(int width, int height) {
+    Point3f eye(0, 0.6f, -1.2f);
+    Vector3f forward = Normalize(Point3f(0, 0, 0) - eye);
+    Vector3f right = Normalize(Cross(Vector3f(0, 1, 0), forward));
+    Vector3f up = Cross(forward, right);
+    Float aspect = Float(width) / height;
+
+    std::vector<Ray> rays;
+    for (int y0 = 0; y0 < height; y0 += 8)
+        for (int x0 = 0; x0 < width; x0 += 8)
+            for (int y = y0; y < std::min(y0 + 8, height); ++y)
+                for (int x = x0; x < std::min(x0 + 8, width); ++x) {
+                    Float u = (2 * (x + 0.5f) / width - 1) * aspect;
+                    Float v = 1 - 2 * (y + 0.5f) / height;
+                    rays.push_back(Ray(eye, Normalize(forward + u * right + v * up)));
+                }
+    return rays;
+}
+
+static void CheckBatchTraversals(const BVHAggregate& bvh, const std::vector<Ray>& rays) {
+    std::vector<std::optional<ShapeIntersection>> expected(rays.size());
+    for (size_t i = 0; i < rays.size(); ++i)
+        expected[i] = bvh.Intersect(rays[i]);
+
+    for (BVHTraversal traversal : { BVHTraversal::Automatic, BVHTraversal::Single, BVHTraversal::Packet, BVHTraversal::Stream }) {
+        std::vector<std::optional<ShapeIntersection>> results(rays.size());
+        bvh.Intersect(rays, results, traversal);
+        for (size_t i = 0; i < rays.size(); ++i) {
+            ASSERT_EQ(expected[i].has_value(), results[i].has_value()) << "traversal " << int(traversal) << ", ray " << i;
+            if (results[i]) {
+                EXPECT_EQ(expected[i]->m_t_hit, results[i]->m_t_hit);
+            }
+        }
+    }
+}
+
+TEST(BVHAggregate, BatchTraversalsMatchSingle) {
+    RNG rng(10);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(100);
+    Wave(*grid, 0);
+    std::unique_ptr<TriangleMesh> clutter = RandomMesh(rng, 2000);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    std::vector<Triangle> clutterTriangles = Triangle::CreateTriangles(clutter.get());
+    triangles.insert(triangles.end(), clutterTriangles.begin(), clutterTriangles.end());
+    BVHAggregate bvh(Primitives(triangles));
+
+    CheckBatchTraversals(bvh, PrimaryRays(100, 75));
+
+    std::vector<Ray> incoherent;
+    for (int i = 0; i < 5000; ++i)
+        incoherent.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+    CheckBatchTraversals(bvh, incoherent);
+}
+
+TEST(BVHAggregate, ChooseTraversal) {
+    std::vector<Ray> primary = PrimaryRays(64, 64);
+    EXPECT_EQ(BVHTraversal::Packet, BVHAggregate::ChooseTraversal(std::span<const Ray>(primary).subspan(0, 64)));
+
+    RNG rng(11);
+    std::vector<Ray> incoherent;
+    for (int i = 0; i < 64; ++i)
+        incoherent.push_back(Ray(RandomPoint(rng, 1), RandomDirection(rng)));
+    EXPECT_EQ(BVHTraversal::Single, BVHAggregate::ChooseTraversal(incoherent));
+    EXPECT_EQ(BVHTraversal::Single, BVHAggregate::ChooseTraversal(std::span<const Ray>(incoherent).subspan(0, 1)));
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the traversal engines
+// on 4K primary visibility and on incoherent rays.
+TEST(BVHAggregate, DISABLED_TraversalBenchmark) {
+    RNG rng(12);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(400);
+    Wave(*grid, 0);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    BVHAggregate bvh(Primitives(triangles));
+
+    std::vector<Ray> primary = PrimaryRays(3840, 2160);
+    std::vector<Ray> incoherent;
+    for (int i = 0; i < 1000000; ++i)
+        incoherent.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+
+    for (const auto& [name, rays] : { std::pair<const char*, const std::vector<Ray>&>("primary 3840x2160", primary),
+                                      std::pair<const char*, const std::vector<Ray>&>("incoherent", incoherent) }) {
+        std::vector<std::optional<ShapeIntersection>> results(rays.size());
+        for (BVHTraversal traversal : { BVHTraversal::Single, BVHTraversal::Packet, BVHTraversal::Stream, BVHTraversal::Automatic }) {
+            const char* traversalNames[] = { "Automatic", "Single", "Packet", "Stream" };
+            auto start = std::chrono::steady_clock::now();
+            bvh.Intersect(rays, results, traversal);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            size_t hits = std::count_if(results.begin(), results.end(), [](const std::optional<ShapeIntersection>& si) { return si.has_value(); });
+            std::cout << name << ", " << traversalNames[int(traversal)] << ": " << rays.size() / seconds / 1e6 << " Mrays/s, " << hits << " hits" << std::endl;
+        }
+    }
+}
+
+// Shadow rays from the visible points of the primary rays towards a point
+// light, in the same tile order.
+static void ShadowRays(const BVHAggregate& bvh, const std::vector<Ray>& primary, Point3f light, std::vector<Ray>& rays, std::vector<Float>& tMax) {
+    std::vector<std::optional<ShapeIntersection>> hits(primary.size());
+    bvh.Intersect(primary, hits);
+    for (size_t i = 0; i < primary.size(); ++i) {
+        if (!hits[i])
+            continue;
+        Point3f p = primary[i](hits[i]->m_t_hit);
+        Vector3f n(hits[i]->m_interaction.m_normal.m_x, hits[i]->m_interaction.m_normal.m_y, hits[i]->m_interaction.m_normal.m_z);
+        if (Dot(n, light - p) < 0)
+            n = -n;
+        rays.push_back(Ray(p + 1e-3f * n, light - p));
+        tMax.push_back(0.9999f);
+    }
+}
+
+TEST(BVHAggregate, OccludedMatchesIntersect) {
+    RNG rng(13);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(100);
+    Wave(*grid, 0);
+    std::unique_ptr<TriangleMesh> clutter = RandomMesh(rng, 2000);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    std::vector<Triangle> clutterTriangles = Triangle::CreateTriangles(clutter.get());
+    triangles.insert(triangles.end(), clutterTriangles.begin(), clutterTriangles.end());
+    BVHAggregate bvh(Primitives(triangles));
+
+    std::vector<Ray> rays;
+    std::vector<Float> tMax;
+    ShadowRays(bvh, PrimaryRays(100, 75), Point3f(0.5f, 2, 0.3f), rays, tMax);
+    for (int i = 0; i < 5000; ++i) {
+        rays.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+        tMax.push_back(rng.Uniform<Float>() * 3);
+    }
+
+    std::unique_ptr<bool[]> occluded(new bool[rays.size()]);
+    bvh.Occluded(rays, tMax, std::span<bool>(occluded.get(), rays.size()));
+    int occludedCount = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        bool expected = bvh.Intersect(rays[i], tMax[i]).has_value();
+        EXPECT_EQ(expected, bvh.Occluded(rays[i], tMax[i])) << "ray " << i;
+        EXPECT_EQ(expected, occluded[i]) << "ray " << i;
+        occludedCount += expected;
+    }
+    EXPECT_GT(occludedCount, 0);
+    EXPECT_LT(occludedCount, int(rays.size()));
+}
+
+TEST(Instance, OccludedMatchesIntersect) {
+    RNG rng(14);
+    std::unique_ptr<TriangleMesh> objectMesh = RandomMesh(rng, 200);
+    std::vector<Triangle> objectTriangles = Triangle::CreateTriangles(objectMesh.get());
+    BVHAggregate blas(Primitives(objectTriangles));
+
+    std::vector<Instance> instances;
+    for (int i = 0; i < 20; ++i)
+        instances.push_back(Instance(&blas, RandomTransform(rng)));
+    std::vector<Primitive> instancePrimitives;
+    for (Instance& instance : instances)
+        instancePrimitives.push_back(&instance);
+    BVHAggregate tlas(instancePrimitives);
+
+    for (int i = 0; i < 5000; ++i) {
+        Ray ray(RandomPoint(rng, 3), RandomDirection(rng));
+        Float tMax = rng.Uniform<Float>() * 6;
+        EXPECT_EQ(tlas.Intersect(ray, tMax).has_value(), tlas.Occluded(ray, tMax));
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare closest-hit and
+// any-hit queries on the shadow rays of a 1920x1080 frame.
+TEST(BVHAggregate, DISABLED_OcclusionBenchmark) {
+    RNG rng(15);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(400);
+    Wave(*grid, 0);
+    std::unique_ptr<TriangleMesh> clutter = RandomMesh(rng, 20000);
+    for (Point3f& p : clutter->m_positions)
+        p = Point3f(p.m_x, 0.3f + 0.1f * p.m_y, p.m_z);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    std::vector<Triangle> clutterTriangles = Triangle::CreateTriangles(clutter.get());
+    triangles.insert(triangles.end(), clutterTriangles.begin(), clutterTriangles.end());
+    BVHAggregate bvh(Primitives(triangles));
+
+    std::vector<Ray> rays;
+    std::vector<Float> tMax;
+    ShadowRays(bvh, PrimaryRays(1920, 1080), Point3f(0.5f, 2, 0.3f), rays, tMax);
+    std::unique_ptr<bool[]> occluded(new bool[rays.size()]);
+
+    auto report = [&](const char* name, auto trace) {
+        auto start = std::chrono::steady_clock::now();
+        trace();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << rays.size() / seconds / 1e6 << " Mrays/s, "
+                  << std::count(occluded.get(), occluded.get() + rays.size(), true) << " occluded" << std::endl;
+    };
+    report("Intersect", [&]() {
+        for (size_t i = 0; i < rays.size(); ++i)
+            occluded[i] = bvh.Intersect(rays[i], tMax[i]).has_value();
+    });
+    report("Occluded", [&]() {
+        for (size_t i = 0; i < rays.size(); ++i)
+            occluded[i] = bvh.Occluded(rays[i], tMax[i]);
+    });
+    report("Occluded (batch)", [&]() { bvh.Occluded(rays, tMax, std::span<bool>(occluded.get(), rays.size())); });
+}
+
+// Diffuse bounce rays leaving the visible points of the primary rays in
+// random directions above the surface, in the same tile order.
+static std::vector<Ray> BounceRays(const BVHAggregate& bvh, const std::vector<Ray>& primary, RNG& rng) {
+    std::vector<std::optional<ShapeIntersection>> hits(primary.size());
+    bvh.Intersect(primary, hits);
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < primary.size(); ++i) {
+        if (!hits[i])
+            continue;
+        Vector3f n(hits[i]->m_interaction.m_normal.m_x, hits[i]->m_interaction.m_normal.m_y, hits[i]->m_interaction.m_normal.m_z);
+        Vector3f w = RandomDirection(rng);
+        if (Dot(n, w) < 0)
+            w = -w;
+        rays.push_back(hits[i]->m_interaction.SpawnRay(w));
+    }
+    return rays;
+}
+
+TEST(RaySorter, OrderIsAStablePermutationGroupedByOctantAndOrigin) {
+    RNG rng(16);
+    std::vector<Ray> rays;
+    for (int i = 0; i < 40000; ++i)
+        rays.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+    // Duplicates keep their relative order.
+    for (int i = 0; i < 100; ++i)
+        rays.push_back(rays[i]);
+
+    for (UInt32 threads : { 1u, 4u }) {
+        ThreadPool pool({ threads });
+        RaySorter sorter(pool);
+        sorter.Sort(rays);
+        std::span<const UInt32> order = sorter.GetOrder();
+        ASSERT_EQ(rays.size(), order.size());
+        std::vector<UInt32> sortedIndices(order.begin(), order.end());
+        std::sort(sortedIndices.begin(), sortedIndices.end());
+        for (UInt32 i = 0; i < sortedIndices.size(); ++i)
+            ASSERT_EQ(i, sortedIndices[i]);
+
+        std::vector<size_t> position(rays.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            position[order[i]] = i;
+        for (int i = 0; i < 100; ++i)
+            EXPECT_EQ(position[i] + 1, position[40000 + i]);
+
+        auto octant = [](const Ray& ray) {
+            Vector3f d = ray.GetDirection();
+            return (d.m_x < 0 ? 1 : 0) | (d.m_y < 0 ? 2 : 0) | (d.m_z < 0 ? 4 : 0);
+        };
+        std::vector<Ray> sorted;
+        for (UInt32 index : order)
+            sorted.push_back(rays[index]);
+        for (size_t i = 1; i < sorted.size(); ++i)
+            ASSERT_LE(octant(sorted[i - 1]), octant(sorted[i]));
+        EXPECT_EQ(rays.size(), sorter.GetStatistics().m_ray_count);
+        RayCoherence before = RaySorter::MeasureCoherence(rays);
+        RayCoherence after = RaySorter::MeasureCoherence(sorted);
+        EXPECT_LT(after.m_mean_origin_distance, before.m_mean_origin_distance / 4);
+        EXPECT_GT(after.m_mean_direction_cosine, before.m_mean_direction_cosine + 0.3f);
+    }
+}
+
+TEST(BVHAggregate, SortedBatchesMatchSingleRays) {
+    RNG rng(17);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(100);
+    Wave(*grid, 0);
+    std::unique_ptr<TriangleMesh> clutter = RandomMesh(rng, 2000);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    std::vector<Triangle> clutterTriangles = Triangle::CreateTriangles(clutter.get());
+    triangles.insert(triangles.end(), clutterTriangles.begin(), clutterTriangles.end());
+    BVHAggregate bvh(Primitives(triangles));
+
+    std::vector<Ray> rays = BounceRays(bvh, PrimaryRays(100, 75), rng);
+    std::vector<Float> tMax;
+    for (size_t i = 0; i < rays.size(); ++i)
+        tMax.push_back(rng.Uniform<Float>() * 3);
+    RaySorter sorter;
+    std::vector<std::optional<ShapeIntersection>> hits(rays.size());
+    bvh.Intersect(rays, hits, sorter);
+    std::unique_ptr<bool[]> occluded(new bool[rays.size()]);
+    bvh.Occluded(rays, tMax, std::span<bool>(occluded.get(), rays.size()), sorter);
+    int hitCount = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        std::optional<ShapeIntersection> expected = bvh.Intersect(rays[i]);
+        ASSERT_EQ(expected.has_value(), hits[i].has_value()) << "ray " << i;
+        if (expected) {
+            EXPECT_EQ(expected->m_t_hit, hits[i]->m_t_hit) << "ray " << i;
+            EXPECT_EQ(expected->m_primitive, hits[i]->m_primitive) << "ray " << i;
+            ++hitCount;
+        }
+        EXPECT_EQ(bvh.Occluded(rays[i], tMax[i]), occluded[i]) << "ray " << i;
+    }
+    EXPECT_GT(hitCount, 0);
+}
+
+// Run with --gtest_also_run_disabled_tests to measure how much sorting the
+// diffuse bounce rays of a 1920x1080 frame raises packet coherence, and the
+// rays per second of batched traversal with and without the sort.
+TEST(BVHAggregate, DISABLED_RaySortBenchmark) {
+    RNG rng(18);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(400);
+    Wave(*grid, 0);
+    std::unique_ptr<TriangleMesh> clutter = RandomMesh(rng, 2000);
+    for (Point3f& p : clutter->m_positions)
+        p = Point3f(p.m_x, 0.3f + 0.1f * p.m_y, p.m_z);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    std::vector<Triangle> clutterTriangles = Triangle::CreateTriangles(clutter.get());
+    triangles.insert(triangles.end(), clutterTriangles.begin(), clutterTriangles.end());
+    BVHAggregate bvh(Primitives(triangles));
+
+    std::vector<Ray> rays = BounceRays(bvh, PrimaryRays(1920, 1080), rng);
+    std::vector<std::optional<ShapeIntersection>> hits(rays.size());
+    RaySorter sorter;
+    sorter.Sort(rays);
+    std::vector<Ray> sorted;
+    for (UInt32 index : sorter.GetOrder())
+        sorted.push_back(rays[index]);
+    std::cout << rays.size() << " bounce rays, sorted in " << sorter.GetStatistics().m_sort_milliseconds << " ms with "
+              << sorter.GetStatistics().m_pass_count << " radix passes" << std::endl;
+    for (const auto& [name, batch] : { std::pair<const char*, const std::vector<Ray>&>("unsorted", rays), std::pair<const char*, const std::vector<Ray>&>("sorted", sorted) }) {
+        RayCoherence coherence = RaySorter::MeasureCoherence(batch);
+        std::cout << name << ": mean origin distance " << coherence.m_mean_origin_distance << ", mean direction cosine "
+                  << coherence.m_mean_direction_cosine << ", packet fraction " << coherence.m_packet_fraction << std::endl;
+    }
+
+    auto report = [&](const char* name, auto trace) {
+        double seconds = std::numeric_limits<double>::infinity();
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            auto start = std::chrono::steady_clock::now();
+            trace();
+            seconds = std::min(seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cout << name << ": " << rays.size() / seconds / 1e6 << " Mrays/s" << std::endl;
+    };
+    report("Intersect (batch)", [&]() { bvh.Intersect(rays, hits); });
+    report("Intersect (sorted batch, with sort)", [&]() { bvh.Intersect(rays, hits, sorter); });
+    report("Intersect (presorted batch)", [&]() { bvh.Intersect(sorted, hits); });
+    report("Intersect (single rays)", [&]() { bvh.Intersect(rays, hits, BVHTraversal::Single); });
+    report("Intersect (presorted single rays)", [&]() { bvh.Intersect(sorted, hits, BVHTraversal::Single); });
+}
+
+TEST(BVHAggregate, PackedLeavesMatchIndexed) {
+    RNG rng(16);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(60);
+    Wave(*grid, 0);
+    std::unique_ptr<TriangleMesh> clutter = RandomMesh(rng, 2000);
+    // A few degenerate triangles, which must never be hit.
+    for (int i = 0; i < 50; ++i)
+        clutter->m_positions[3 * i + 2] = clutter->m_positions[3 * i];
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    std::vector<Triangle> clutterTriangles = Triangle::CreateTriangles(clutter.get());
+    triangles.insert(triangles.end(), clutterTriangles.begin(), clutterTriangles.end());
+    BVHAggregate indexed(Primitives(triangles));
+
+    for (BVHLeafFormat format : { BVHLeafFormat::Packed4, BVHLeafFormat::Packed8 }) {
+        BVHBuildOptions options;
+        options.m_leaf_format = format;
+        options.m_max_primitives_in_node = format == BVHLeafFormat::Packed4 ? 4 : 8;
+        BVHAggregate packed(Primitives(triangles), options);
+        EXPECT_GT(packed.GetStatistics().m_memory_bytes, indexed.GetStatistics().m_memory_bytes);
+
+        for (int i = 0; i < 20000; ++i) {
+            Ray ray(RandomPoint(rng, 2), RandomDirection(rng));
+            Float tMax = rng.Uniform<Float>() * 4;
+            std::optional<ShapeIntersection> expected = indexed.Intersect(ray, tMax);
+            std::optional<ShapeIntersection> si = packed.Intersect(ray, tMax);
+            ASSERT_EQ(expected.has_value(), si.has_value());
+            // The kernels round like the scalar test up to FMA contraction,
+            // which compilers may apply to the scalar code only.
+            if (si) {
+                EXPECT_NEAR(expected->m_t_hit, si->m_t_hit, 1e-6f * std::max<Float>(1, expected->m_t_hit));
+                EXPECT_NEAR(expected->m_interaction.m_uv.m_x, si->m_interaction.m_uv.m_x, 1e-4f);
+                EXPECT_NEAR(expected->m_interaction.m_uv.m_y, si->m_interaction.m_uv.m_y, 1e-4f);
+            }
+            EXPECT_EQ(expected.has_value(), packed.Occluded(ray, tMax));
+        }
+    }
+}
+
+// Rays aimed exactly at the vertices and edge midpoints of a flat grid, where
+// six or two triangles meet, must never slip through the cracks.
+TEST(BVHAggregate, PackedLeavesAreWatertight) {
+    RNG rng(17);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(32);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    for (BVHLeafFormat format : { BVHLeafFormat::Packed4, BVHLeafFormat::Packed8 }) {
+        BVHBuildOptions options;
+        options.m_leaf_format = format;
+        BVHAggregate bvh(Primitives(triangles), options);
+
+        for (int i = 0; i < 20000; ++i) {
+            Point3f target = grid->m_positions[rng.Uniform<UInt32>() % grid->m_positions.size()];
+            if (i % 2)
+                target = Point3f(target.m_x + 1.f / 32, 0, target.m_z);
+            if (std::abs(target.m_x) >= 1 || std::abs(target.m_z) >= 1)
+                continue;
+            Point3f origin(RandomPoint(rng, 2).m_x, 0.1f + 2 * rng.Uniform<Float>(), RandomPoint(rng, 2).m_z);
+            Ray ray(origin, target - origin);
+            EXPECT_TRUE(bvh.Intersect(ray).has_value());
+            EXPECT_TRUE(bvh.Occluded(ray));
+        }
+    }
+}
+
+// GridMesh displaced by Wave, with its analytic normals and uvs.
+static std::unique_ptr<TriangleMesh> ShadedWaveMesh(int n) {
+    std::unique_ptr<TriangleMesh> grid = GridMesh(n);
+    Wave(*grid, 0);
+    for (const Point3f& p : grid->m_positions) {
+        Float dydx = 0.8f * std::cos(4 * p.m_x) * std::cos(3 * p.m_z);
+        Float dydz = -0.6f * std::sin(4 * p.m_x) * std::sin(3 * p.m_z);
+        Vector3f n = Normalize(Vector3f(-dydx, 1, -dydz));
+        grid->m_normals.push_back(Normal3f(n.m_x, n.m_y, n.m_z));
+        grid->m_uvs.push_back(Point2f((p.m_x + 1) / 2, (p.m_z + 1) / 2));
+    }
+    return grid;
+}
+
+TEST(TriangleMesh, CompressionErrorIsBounded) {
+    for (PositionQuantization quantization : { PositionQuantization::Bits16, PositionQuantization::Bits21 }) {
+        std::unique_ptr<TriangleMesh> original = ShadedWaveMesh(40), compressed = ShadedWaveMesh(40);
+        MeshCompression compression;
+        compression.m_position_quantization = quantization;
+        compressed->Compress(compression);
+        EXPECT_TRUE(compressed->m_positions.empty());
+        EXPECT_TRUE(compressed->HasNormals() && compressed->HasUVs());
+        ASSERT_EQ(original->VertexCount(), compressed->VertexCount());
+        // 12 + 12 + 8 bytes of attributes per vertex become 6 or 8 + 4 + 4.
+        EXPECT_LT(compressed->MemoryBytes(), original->MemoryBytes() * 3 / 4);
+
+        AABB3f bounds;
+        for (const Point3f& p : original->m_positions)
+            bounds = Union(bounds, p);
+        Float steps = quantization == PositionQuantization::Bits16 ? 65535.f : 2097151.f;
+        Vector3f maxError = bounds.Diagonal() / (2 * steps);
+        for (UInt32 i = 0; i < original->VertexCount(); ++i) {
+            Point3f p = original->Position(i), q = compressed->Position(i);
+            for (int c = 0; c < 3; ++c)
+                EXPECT_LE(std::abs(p[c] - q[c]), 1.01f * maxError[c] + 1e-7f);
+            Normal3f n = original->Normal(i), m = compressed->Normal(i);
+            EXPECT_GT(n.m_x * m.m_x + n.m_y * m.m_y + n.m_z * m.m_z, 0.9999f);
+            EXPECT_NEAR(original->UV(i).m_x, compressed->UV(i).m_x, 0x1p-12f);
+            EXPECT_NEAR(original->UV(i).m_y, compressed->UV(i).m_y, 0x1p-12f);
+        }
+    }
+}
+
+TEST(TriangleMesh, CompressedMeshTracesLikeOriginal) {
+    RNG rng(36);
+    std::unique_ptr<TriangleMesh> original = ShadedWaveMesh(60), compressed = ShadedWaveMesh(60);
+    compressed->Compress();
+    std::vector<Triangle> originalTriangles = Triangle::CreateTriangles(original.get());
+    std::vector<Triangle> compressedTriangles = Triangle::CreateTriangles(compressed.get());
+    BVHAggregate originalBvh(Primitives(originalTriangles)), compressedBvh(Primitives(compressedTriangles));
+
+    // Rays that graze the moved edges may change between hit and miss, but only rarely.
+    int mismatches = 0;
+    for (int i = 0; i < 20000; ++i) {
+        Ray ray(RandomPoint(rng, 2), RandomDirection(rng));
+        std::optional<ShapeIntersection> expected = originalBvh.Intersect(ray), si = compressedBvh.Intersect(ray);
+        EXPECT_EQ(si.has_value(), compressedBvh.Occluded(ray));
+        if (expected.has_value() != si.has_value()) {
+            ++mismatches;
+            continue;
+        }
+        if (si && std::abs(Dot(ray.GetDirection(), Vector3f(0, 1, 0))) > 0.1f) {
+            EXPECT_NEAR(expected->m_t_hit, si->m_t_hit, 1e-3f);
+            EXPECT_NEAR(expected->m_interaction.m_uv.m_x, si->m_interaction.m_uv.m_x, 1e-3f);
+            EXPECT_NEAR(expected->m_interaction.m_uv.m_y, si->m_interaction.m_uv.m_y, 1e-3f);
+        }
+    }
+    EXPECT_LT(mismatches, 20);
+
+    // Shared vertices decode to the same position in every triangle, so the
+    // mesh stays watertight.
+    std::unique_ptr<TriangleMesh> grid = GridMesh(32);
+    grid->Compress();
+    std::vector<Triangle> gridTriangles = Triangle::CreateTriangles(grid.get());
+    BVHAggregate gridBvh(Primitives(gridTriangles));
+    for (int i = 0; i < 20000; ++i) {
+        UInt32 vertex = rng.Uniform<UInt32>() % grid->VertexCount();
+        Point3f target = grid->Position(vertex);
+        if (i % 2 && vertex % 33 != 32)
+            target = target + (grid->Position(vertex + 1) - target) / 2;
+        if (std::abs(target.m_x) >= 1 || std::abs(target.m_z) >= 1)
+            continue;
+        Point3f origin(RandomPoint(rng, 2).m_x, 0.1f + 2 * rng.Uniform<Float>(), RandomPoint(rng, 2).m_z);
+        Ray ray(origin, target - origin);
+        EXPECT_TRUE(gridBvh.Intersect(ray).has_value());
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the memory and
+// traversal cost of compressed meshes.
+TEST(TriangleMesh, DISABLED_CompressionBenchmark) {
+    RNG rng(36);
+    std::vector<Ray> primary = PrimaryRays(1920, 1080);
+    std::vector<Ray> incoherent;
+    for (int i = 0; i < 500000; ++i)
+        incoherent.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+
+    const char* names[] = { "uncompressed", "16-bit", "21-bit" };
+    for (PositionQuantization quantization : { PositionQuantization::None, PositionQuantization::Bits16, PositionQuantization::Bits21 }) {
+        std::unique_ptr<TriangleMesh> grid = ShadedWaveMesh(700);
+        if (quantization != PositionQuantization::None) {
+            MeshCompression compression;
+            compression.m_position_quantization = quantization;
+            grid->Compress(compression);
+        }
+        std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+        BVHAggregate bvh(Primitives(triangles));
+
+        std::cout << names[int(quantization)] << ": mesh " << grid->MemoryBytes() / (1024.0 * 1024.0) << " MiB, BVH "
+                  << bvh.GetStatistics().m_memory_bytes / (1024.0 * 1024.0) << " MiB";
+        for (const std::vector<Ray>* rays : { &primary, &incoherent }) {
+            auto start = std::chrono::steady_clock::now();
+            int hits = 0;
+            for (const Ray& ray : *rays) {
+                std::optional<ShapeIntersection> si = bvh.Intersect(ray);
+                hits += si.has_value();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << ", " << (rays == &primary ? "primary " : "incoherent ") << rays->size() / seconds / 1e6 << " Mrays/s";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Shuffles the triangle order, as in meshes whose triangles come out of a
+// file in no particular order.
+static void ShuffleTriangles(TriangleMesh& mesh, RNG& rng) {
+    for (UInt32 i = mesh.TriangleCount() - 1; i > 0; --i) {
+        UInt32 j = rng.Uniform<UInt32>() % (i + 1);
+        for (int k = 0; k < 3; ++k)
+            std::swap(mesh.m_indices[3 * i + k], mesh.m_indices[3 * j + k]);
+    }
+}
+
+static std::array<Float, 9> TriangleKey(const Triangle& triangle) {
+    AABB3f b = triangle.Bounds();
+    Point3f c = b.Centroid();
+    return { b.m_min.m_x, b.m_min.m_y, b.m_min.m_z, b.m_max.m_x, b.m_max.m_y, b.m_max.m_z, c.m_x, c.m_y, c.m_z };
+}
+
+TEST(TriangleMesh, MeshletsPreserveTriangles) {
+    RNG rng(37);
+    std::unique_ptr<TriangleMesh> original = ShadedWaveMesh(60), clustered = ShadedWaveMesh(60);
+    ShuffleTriangles(*original, rng);
+    clustered->m_indices = original->m_indices;
+    clustered->BuildMeshlets();
+    EXPECT_TRUE(clustered->m_indices.empty());
+    ASSERT_EQ(original->TriangleCount(), clustered->TriangleCount());
+    EXPECT_LT(clustered->MemoryBytes(), original->MemoryBytes());
+
+    UInt32 triangleCount = 0;
+    Float meanDiagonal = 0;
+    for (const Meshlet& meshlet : clustered->m_meshlets) {
+        EXPECT_EQ(triangleCount, meshlet.m_triangle_offset);
+        EXPECT_LE(meshlet.m_vertex_count, TriangleMesh::Max_Meshlet_Vertices);
+        EXPECT_LE(meshlet.m_triangle_count, TriangleMesh::Max_Meshlet_Triangles);
+        for (UInt32 i = 0; i < 3 * UInt32(meshlet.m_triangle_count); ++i)
+            EXPECT_LT(clustered->m_local_indices[3 * meshlet.m_triangle_offset + i], meshlet.m_vertex_count);
+        for (UInt32 i = meshlet.m_triangle_offset; i < meshlet.m_triangle_offset + meshlet.m_triangle_count; ++i)
+            EXPECT_EQ(&meshlet, clustered->FindMeshlet(i));
+        triangleCount += meshlet.m_triangle_count;
+        meanDiagonal += Length(meshlet.m_bounds.Diagonal()) / clustered->m_meshlets.size();
+    }
+    EXPECT_EQ(original->TriangleCount(), triangleCount);
+    // 7200 triangles of a 2 x 2 grid in 32 meshlets of 225 triangles: each
+    // covers about a 0.35 x 0.35 square, plus the height of the wave, and
+    // not a strip across the mesh, whose diagonal is about 2.9.
+    EXPECT_LE(clustered->m_meshlets.size(), 32u);
+    EXPECT_LT(meanDiagonal, 0.75f);
+
+    // The same triangles with the same vertex values, in Morton order.
+    std::vector<Triangle> originalTriangles = Triangle::CreateTriangles(original.get());
+    std::vector<Triangle> clusteredTriangles = Triangle::CreateTriangles(clustered.get());
+    std::vector<std::array<Float, 9>> originalKeys, clusteredKeys;
+    for (const Triangle& triangle : originalTriangles)
+        originalKeys.push_back(TriangleKey(triangle));
+    for (const Triangle& triangle : clusteredTriangles)
+        clusteredKeys.push_back(TriangleKey(triangle));
+    std::sort(originalKeys.begin(), originalKeys.end());
+    std::sort(clusteredKeys.begin(), clusteredKeys.end());
+    EXPECT_TRUE(originalKeys == clusteredKeys);
+
+    // Limits of 3 vertices leave one triangle per meshlet.
+    std::unique_ptr<TriangleMesh> single = GridMesh(4);
+    single->BuildMeshlets(3, 256);
+    EXPECT_EQ(32u, single->m_meshlets.size());
+    EXPECT_EQ(96u, single->m_meshlet_vertices.size());
+    EXPECT_EQ(25u, single->VertexCount());
+}
+
+TEST(BVHAggregate, MeshletsMatchIndexed) {
+    RNG rng(37);
+    std::unique_ptr<TriangleMesh> original = ShadedWaveMesh(60), clustered = ShadedWaveMesh(60), compressed = ShadedWaveMesh(60);
+    ShuffleTriangles(*original, rng);
+    clustered->m_indices = original->m_indices;
+    clustered->BuildMeshlets();
+    compressed->m_indices = original->m_indices;
+    compressed->BuildMeshlets();
+    compressed->Compress();
+
+    std::vector<Triangle> originalTriangles = Triangle::CreateTriangles(original.get());
+    std::vector<Triangle> clusteredTriangles = Triangle::CreateTriangles(clustered.get());
+    std::vector<Triangle> compressedTriangles = Triangle::CreateTriangles(compressed.get());
+    BVHAggregate originalBvh(Primitives(originalTriangles)), clusteredBvh(Primitives(clusteredTriangles));
+    BVHAggregate compressedBvh(Primitives(compressedTriangles));
+    BVHBuildOptions options;
+    options.m_group_meshlets = false;
+    BVHAggregate ungroupedBvh(Primitives(clusteredTriangles), options);
+
+    for (int i = 0; i < 20000; ++i) {
+        Ray ray(RandomPoint(rng, 2), RandomDirection(rng));
+        std::optional<ShapeIntersection> expected = originalBvh.Intersect(ray);
+        for (const BVHAggregate* bvh : { &clusteredBvh, &ungroupedBvh }) {
+            std::optional<ShapeIntersection> si = bvh->Intersect(ray);
+            ASSERT_EQ(expected.has_value(), si.has_value());
+            EXPECT_EQ(expected.has_value(), bvh->Occluded(ray));
+            if (si) {
+                EXPECT_EQ(expected->m_t_hit, si->m_t_hit);
+                EXPECT_EQ(expected->m_interaction.m_uv, si->m_interaction.m_uv);
+            }
+        }
+        std::optional<ShapeIntersection> si = compressedBvh.Intersect(ray);
+        if (si && expected) {
+            EXPECT_NEAR(expected->m_t_hit, si->m_t_hit, 0.01f);
+        }
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare index storage on a
+// mesh whose triangles come in random order.
+TEST(TriangleMesh, DISABLED_MeshletBenchmark) {
+    RNG rng(37);
+    std::vector<Ray> primary = PrimaryRays(1920, 1080);
+    std::vector<Ray> incoherent;
+    for (int i = 0; i < 500000; ++i)
+        incoherent.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+
+    const char* names[] = { "32-bit indices", "meshlets", "meshlets + 16-bit" };
+    for (int variant = 0; variant < 3; ++variant) {
+        std::unique_ptr<TriangleMesh> grid = ShadedWaveMesh(700);
+        RNG shuffleRng(38);
+        ShuffleTriangles(*grid, shuffleRng);
+        if (variant > 0)
+            grid->BuildMeshlets();
+        if (variant > 1)
+            grid->Compress();
+        std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+        BVHAggregate bvh(Primitives(triangles));
+
+        std::cout << names[variant] << ": mesh " << grid->MemoryBytes() / (1024.0 * 1024.0) << " MiB";
+        for (const std::vector<Ray>* rays : { &primary, &incoherent }) {
+            auto start = std::chrono::steady_clock::now();
+            int hits = 0;
+            for (const Ray& ray : *rays)
+                hits += bvh.Intersect(ray).has_value();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << ", " << (rays == &primary ? "primary " : "incoherent ") << rays->size() / seconds / 1e6 << " Mrays/s";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the leaf formats.
+TEST(BVHAggregate, DISABLED_LeafFormatBenchmark) {
+    RNG rng(18);
+    std::unique_ptr<TriangleMesh> grid = GridMesh(400);
+    Wave(*grid, 0);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(grid.get());
+    std::vector<Ray> primary = PrimaryRays(1920, 1080);
+    std::vector<Ray> incoherent;
+    for (int i = 0; i < 500000; ++i)
+        incoherent.push_back(Ray(RandomPoint(rng, 2), RandomDirection(rng)));
+
+    const char* formatNames[] = { "Indexed", "Packed4", "Packed8" };
+    for (BVHLeafFormat format : { BVHLeafFormat::Indexed, BVHLeafFormat::Packed4, BVHLeafFormat::Packed8 }) {
+        BVHBuildOptions options;
+        options.m_leaf_format = format;
+        BVHAggregate bvh(Primitives(triangles), options);
+
+        std::cout << formatNames[int(format)] << ": " << bvh.GetStatistics().m_memory_bytes / (1024.0 * 1024.0) << " MiB";
+        for (const std::vector<Ray>* rays : { &primary, &incoherent }) {
+            auto start = std::chrono::steady_clock::now();
+            int hits = 0;
+            for (const Ray& ray : *rays)
+                hits += bvh.Intersect(ray).has_value();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << ", " << (rays == &primary ? "primary " : "incoherent ") << rays->size() / seconds / 1e6 << " Mrays/s";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Control mesh of a rolling terrain over [-1, 1]^2 with n x n patches.
+static std::vector<BSplinePatch> TerrainPatches(int n, Float amplitude = 0.2f) {
+    std::vector<Point3f> controlPoints;
+    for (int z = -1; z <= n + 1; ++z)
+        for (int x = -1; x <= n + 1; ++x) {
+            Float px = 2 * Float(x) / n - 1, pz = 2 * Float(z) / n - 1;
+            controlPoints.push_back(Point3f(px, amplitude * std::sin(4 * px) * std::cos(3 * pz), pz));
+        }
+    return BSplinePatch::CreatePatches(Transform(), controlPoints, n + 3, n + 3);
+}
+
+static Float Bumps(const Point3f& p, const Point2f&) {
+    return 0.02f * std::sin(40 * p.m_x) * std::sin(40 * p.m_z);
+}
+
+// Center ray of the PrimaryRays camera with its pixel differentials.
+static RayDifferential DicingRay(int width, int height) {
+    Point3f eye(0, 0.6f, -1.2f);
+    Vector3f forward = Normalize(Point3f(0, 0, 0) - eye);
+    Vector3f right = Normalize(Cross(Vector3f(0, 1, 0), forward));
+    Vector3f up = Cross(forward, right);
+    Float aspect = Float(width) / height;
+    return RayDifferential(Ray(eye, forward), eye, Normalize(forward + (2 * aspect / width) * right), eye, Normalize(forward - (2.0f / height) * up));
+}
+
+static std::vector<TessellatedPatch> LazyPatches(const std::vector<BSplinePatch>& patches, GeometryCache* cache, DisplacementFunction displacement = {}, Float maxDisplacement = 0) {
+    std::vector<TessellatedPatch> lazyPatches;
+    for (const BSplinePatch& patch : patches)
+        lazyPatches.emplace_back(&patch, cache, displacement, maxDisplacement);
+    return lazyPatches;
+}
+
+TEST(BSplinePatch, ReproducesPlanes) {
+    std::vector<Point3f> controlPoints;
+    for (int z = 0; z < 5; ++z)
+        for (int x = 0; x < 6; ++x)
+            controlPoints.push_back(Point3f(Float(x), 0.5f * x + 0.25f * z, Float(z)));
+    std::vector<BSplinePatch> patches = BSplinePatch::CreatePatches(Transform(), controlPoints, 6, 5);
+    ASSERT_EQ(6u, patches.size());
+
+    RNG rng(35);
+    for (size_t i = 0; i < patches.size(); ++i)
+        for (int j = 0; j < 20; ++j) {
+            Point2f uv(rng.Uniform<Float>(), rng.Uniform<Float>());
+            PatchPoint patchPoint = patches[i].Evaluate(uv);
+            EXPECT_NEAR(1 + (i % 3) + uv.m_x, patchPoint.m_position.m_x, 1e-5f);
+            EXPECT_NEAR(1 + (i / 3) + uv.m_y, patchPoint.m_position.m_z, 1e-5f);
+            EXPECT_NEAR(0.5f * patchPoint.m_position.m_x + 0.25f * patchPoint.m_position.m_z, patchPoint.m_position.m_y, 1e-5f);
+            EXPECT_NEAR(0, Dot(patchPoint.m_normal, Vector3f(1, 0.5f, 0)), 1e-5f);
+            EXPECT_NEAR(0, Dot(patchPoint.m_normal, Vector3f(0, 0.25f, 1)), 1e-5f);
+            AABB3f bounds = patches[i].Bounds();
+            EXPECT_EQ(bounds.m_min, Min(bounds.m_min, patchPoint.m_position));
+            EXPECT_EQ(bounds.m_max, Max(bounds.m_max, patchPoint.m_position));
+        }
+}
+
+TEST(TessellatedPatch, MatchesEagerTessellation) {
+    std::vector<BSplinePatch> patches = TerrainPatches(8);
+    GeometryCache cache(DicingRay(160, 120));
+    std::vector<TessellatedPatch> lazyPatches = LazyPatches(patches, &cache, Bumps, 0.02f);
+    BVHAggregate bvh(Primitives(lazyPatches));
+
+    std::vector<std::shared_ptr<const TessellatedGrid>> grids;
+    for (const TessellatedPatch& patch : lazyPatches)
+        grids.push_back(patch.Tessellate(patch.TessellationRate()));
+
+    RNG rng(35);
+    std::vector<Ray> rays = PrimaryRays(80, 60);
+    for (int i = 0; i < 2000; ++i)
+        rays.push_back(Ray(RandomPoint(rng, 1.5f), RandomDirection(rng)));
+
+    int hits = 0;
+    for (const Ray& ray : rays) {
+        std::optional<ShapeIntersection> expected;
+        Float tMax = Infinity;
+        for (const std::shared_ptr<const TessellatedGrid>& grid : grids) {
+            std::optional<ShapeIntersection> si = grid->Intersect(ray, tMax);
+            if (si) {
+                expected = si;
+                tMax = si->m_t_hit;
+            }
+        }
+
+        std::optional<ShapeIntersection> si = bvh.Intersect(ray);
+        ASSERT_EQ(expected.has_value(), si.has_value());
+        EXPECT_EQ(si.has_value(), bvh.Occluded(ray));
+        if (si) {
+            EXPECT_EQ(expected->m_t_hit, si->m_t_hit);
+            EXPECT_TRUE(si->m_interaction.m_uv.m_x >= 0 && si->m_interaction.m_uv.m_x <= 1);
+            EXPECT_TRUE(si->m_interaction.m_uv.m_y >= 0 && si->m_interaction.m_uv.m_y <= 1);
+            ++hits;
+        }
+    }
+    EXPECT_GT(hits, 1000);
+}
+
+TEST(GeometryCache, TessellatesOnlyReachedPatches) {
+    std::vector<BSplinePatch> patches = TerrainPatches(16);
+    GeometryCache cache(DicingRay(320, 240));
+    std::vector<TessellatedPatch> lazyPatches = LazyPatches(patches, &cache);
+    BVHAggregate bvh(Primitives(lazyPatches));
+    EXPECT_EQ(0u, cache.GetStatistics().m_tessellation_count);
+
+    // Straight down onto a 0.25 x 0.25 corner of the terrain, which spans 3 x 3 patches at most.
+    RNG rng(35);
+    for (int i = 0; i < 1000; ++i) {
+        Ray ray(Point3f(-1 + 0.25f * rng.Uniform<Float>(), 1, -1 + 0.25f * rng.Uniform<Float>()), Vector3f(0, -1, 0));
+        EXPECT_TRUE(bvh.Intersect(ray).has_value());
+    }
+
+    GeometryCacheStatistics statistics = cache.GetStatistics();
+    EXPECT_GT(statistics.m_tessellation_count, 0u);
+    EXPECT_LE(statistics.m_tessellation_count, 9u);
+    EXPECT_EQ(statistics.m_tessellation_count, statistics.m_resident_count);
+    EXPECT_GT(statistics.m_hit_count, 900u);
+}
+
+TEST(GeometryCache, EvictsLeastRecentlyUsed) {
+    // Without differentials every patch is tessellated at the maximum rate, and the flat patches all make grids of the same size.
+    std::vector<BSplinePatch> patches = TerrainPatches(4, 0);
+    GeometryCacheOptions options;
+    options.m_max_rate = 8;
+    options.m_budget_bytes = 0;
+    GeometryCache cache(RayDifferential(Ray(Point3f(0, 1, -2), Vector3f(0, 0, 1))), options);
+    std::vector<TessellatedPatch> lazyPatches = LazyPatches(patches, &cache);
+    UInt64 gridBytes = lazyPatches[0].Tessellate(8)->GetMemoryBytes();
+
+    options.m_budget_bytes = 3 * gridBytes + gridBytes / 2;
+    GeometryCache budgetCache(RayDifferential(Ray(Point3f(0, 1, -2), Vector3f(0, 0, 1))), options);
+    lazyPatches = LazyPatches(patches, &budgetCache);
+
+    for (int i : { 0, 1, 2, 0 })
+        budgetCache.Acquire(&lazyPatches[i]);
+    GeometryCacheStatistics statistics = budgetCache.GetStatistics();
+    EXPECT_EQ(3u, statistics.m_tessellation_count);
+    EXPECT_EQ(1u, statistics.m_hit_count);
+    EXPECT_EQ(0u, statistics.m_eviction_count);
+
+    // Patch 1 is now the least recently used, so patch 3 pushes it out and patch 0 stays.
+    std::shared_ptr<const TessellatedGrid> grid = budgetCache.Acquire(&lazyPatches[3]);
+    EXPECT_EQ(8u, grid->GetRate());
+    budgetCache.Acquire(&lazyPatches[0]);
+    statistics = budgetCache.GetStatistics();
+    EXPECT_EQ(1u, statistics.m_eviction_count);
+    EXPECT_EQ(2u, statistics.m_hit_count);
+    budgetCache.Acquire(&lazyPatches[1]);
+    statistics = budgetCache.GetStatistics();
+    EXPECT_EQ(5u, statistics.m_tessellation_count);
+    EXPECT_EQ(3u, statistics.m_resident_count);
+    EXPECT_LE(statistics.m_resident_bytes, options.m_budget_bytes);
+    EXPECT_LE(statistics.m_peak_resident_bytes, options.m_budget_bytes);
+
+    // A zero budget keeps only the newest grid, and tracing through it still gives the same hits.
+    std::vector<TessellatedPatch> zeroBudgetPatches = LazyPatches(patches, &cache);
+    BVHAggregate bvh(Primitives(lazyPatches)), zeroBudgetBvh(Primitives(zeroBudgetPatches));
+    RNG rng(35);
+    for (int i = 0; i < 1000; ++i) {
+        Ray ray(RandomPoint(rng, 1.5f), RandomDirection(rng));
+        std::optional<ShapeIntersection> expected = bvh.Intersect(ray), si = zeroBudgetBvh.Intersect(ray);
+        ASSERT_EQ(expected.has_value(), si.has_value());
+        if (si) {
+            EXPECT_EQ(expected->m_t_hit, si->m_t_hit);
+        }
+    }
+    EXPECT_EQ(1u, cache.GetStatistics().m_resident_count);
+    EXPECT_LE(budgetCache.GetStatistics().m_resident_bytes, options.m_budget_bytes);
+}
+
+TEST(GeometryCache, RateFollowsFootprint) {
+    RayDifferential dicingRay = DicingRay(640, 480);
+    Point3f eye = dicingRay.GetRay().GetOrigin();
+    Vector3f forward = dicingRay.GetRay().GetDirection();
+    // A patch 48 pixels across at distance 1.
+    Float size = 48 * dicingRay.FootprintWidth(1);
+
+    GeometryCacheOptions options;
+    GeometryCache cache(dicingRay, options);
+    auto rateAt = [&](const GeometryCache& cache, Float distance) {
+        return cache.TessellationRate(AABB3f(eye + distance * forward), size);
+    };
+    EXPECT_EQ(64u, rateAt(cache, 1));
+    EXPECT_EQ(32u, rateAt(cache, 2));
+    EXPECT_EQ(16u, rateAt(cache, 4));
+    EXPECT_EQ(2u, rateAt(cache, 32));
+    EXPECT_EQ(1u, rateAt(cache, 1000));
+    EXPECT_EQ(64u, rateAt(cache, 0.1f));
+
+    options.m_shading_rate = 2;
+    GeometryCache coarseCache(dicingRay, options);
+    EXPECT_EQ(32u, rateAt(coarseCache, 1));
+    EXPECT_EQ(16u, rateAt(coarseCache, 2));
+
+    GeometryCache noDifferentialsCache(RayDifferential(dicingRay.GetRay()), options);
+    EXPECT_EQ(64u, rateAt(noDifferentialsCache, 1000));
+}
+
+TEST(GeometryCache, DISABLED_DisplacedTerrainBenchmark) {
+    int width = 1280, height = 720;
+    std::vector<BSplinePatch> patches = TerrainPatches(32);
+    std::vector<Ray> rays = PrimaryRays(width, height);
+
+    UInt64 fullBytes = 0;
+    for (UInt64 budget : { std::numeric_limits<UInt64>::max(), UInt64(128) << 20, UInt64(64) << 20 }) {
+        GeometryCacheOptions options;
+        options.m_budget_bytes = budget;
+        GeometryCache cache(DicingRay(width, height), options);
+        std::vector<TessellatedPatch> lazyPatches = LazyPatches(patches, &cache, Bumps, 0.02f);
+        BVHAggregate bvh(Primitives(lazyPatches));
+
+        auto start = std::chrono::steady_clock::now();
+        int hits = 0;
+        for (const Ray& ray : rays)
+            hits += bvh.Intersect(ray).has_value();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        GeometryCacheStatistics statistics = cache.GetStatistics();
+        if (fullBytes == 0)
+            fullBytes = statistics.m_peak_resident_bytes;
+        std::cout << "budget " << (budget == std::numeric_limits<UInt64>::max() ? "unbounded" : std::to_string(budget >> 20) + " MiB") << ": " << rays.size() / seconds / 1e6 << " Mrays/s, "
+                  << statistics.m_tessellation_count << " tessellations of " << patches.size() << " patches, "
+                  << statistics.m_eviction_count << " evictions, peak " << statistics.m_peak_resident_bytes / (1024.0 * 1024.0)
+                  << " of " << fullBytes / (1024.0 * 1024.0) << " MiB, " << hits << " hits" << std::endl;
+    }
+}
\ No newline at end of file
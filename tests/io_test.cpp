@@ -0,0 +1,399 @@
+#include "../ext/gtest/gtest.h"
+
+#include "../Math/Math.h"
+#include "../IO/MeshReader.h"
+#include "../IO/Parsing.h"
+#include "../IO/Socket.h"
+#include "test_helpers.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+using namespace Theia;
+
+static void WriteOBJ(const TriangleMesh& mesh, const std::string& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    char line[128];
+    for (UInt32 v = 0; v < mesh.VertexCount(); ++v) {
+        Point3f p = mesh.Position(v);
+        Normal3f n = mesh.Normal(v);
+        Point2f uv = mesh.UV(v);
+        file.write(line, std::snprintf(line, sizeof(line), "v %.9g %.9g %.9g\nvn %.9g %.9g %.9g\nvt %.9g %.9g\n", p.m_x, p.m_y, p.m_z, n.m_x, n.m_y, n.m_z, uv.m_x, uv.m_y));
+    }
+    for (UInt32 t = 0; t < mesh.TriangleCount(); ++t) {
+        std::array<UInt32, 3> v = mesh.TriangleVertices(t, 0);
+        file.write(line, std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", v[0] + 1, v[0] + 1, v[0] + 1, v[1] + 1, v[1] + 1, v[1] + 1, v[2] + 1, v[2] + 1, v[2] + 1));
+    }
+}
+
+static void WritePLY(const TriangleMesh& mesh, const std::string& path, const std::string& format) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "ply\nformat " << format << " 1.0\ncomment written by io_test\n"
+         << "element vertex " << mesh.VertexCount() << "\n"
+         << "property float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\nproperty float u\nproperty float v\n"
+         << "element face " << mesh.TriangleCount() << "\nproperty list uchar int vertex_indices\nend_header\n";
+    bool swap = format == "binary_big_endian";
+    auto writeBinary = [&](const void* data, size_t size) {
+        char bytes[8];
+        std::memcpy(bytes, data, size);
+        if (swap)
+            std::reverse(bytes, bytes + size);
+        file.write(bytes, size);
+    };
+    char line[128];
+    for (UInt32 v = 0; v < mesh.VertexCount(); ++v) {
+        Point3f p = mesh.Position(v);
+        Normal3f n = mesh.Normal(v);
+        Point2f uv = mesh.UV(v);
+        Float values[8] = { p.m_x, p.m_y, p.m_z, n.m_x, n.m_y, n.m_z, uv.m_x, uv.m_y };
+        if (format == "ascii")
+            file.write(line, std::snprintf(line, sizeof(line), "%.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]));
+        else
+            for (Float value : values)
+                writeBinary(&value, sizeof(Float));
+    }
+    for (UInt32 t = 0; t < mesh.TriangleCount(); ++t) {
+        std::array<UInt32, 3> v = mesh.TriangleVertices(t, 0);
+        if (format == "ascii")
+            file.write(line, std::snprintf(line, sizeof(line), "3 %u %u %u\n", v[0], v[1], v[2]));
+        else {
+            UInt8 count = 3;
+            file.write(reinterpret_cast<const char*>(&count), 1);
+            for (UInt32 index : v)
+                writeBinary(&index, sizeof(UInt32));
+        }
+    }
+}
+
+static void ExpectSameMesh(const TriangleMesh& expected, const TriangleMesh& actual) {
+    ASSERT_EQ(expected.VertexCount(), actual.VertexCount());
+    ASSERT_EQ(expected.TriangleCount(), actual.TriangleCount());
+    ASSERT_EQ(expected.HasNormals(), actual.HasNormals());
+    ASSERT_EQ(expected.HasUVs(), actual.HasUVs());
+    for (UInt32 v = 0; v < expected.VertexCount(); ++v) {
+        EXPECT_EQ(expected.Position(v), actual.Position(v));
+        if (expected.HasNormals()) {
+            EXPECT_EQ(expected.Normal(v), actual.Normal(v));
+        }
+        if (expected.HasUVs()) {
+            EXPECT_EQ(expected.UV(v), actual.UV(v));
+        }
+    }
+    for (UInt32 t = 0; t < expected.TriangleCount(); ++t)
+        EXPECT_EQ(expected.TriangleVertices(t, 0), actual.TriangleVertices(t, 0));
+}
+
+TEST(Parsing, ParseFloatMatchesFromChars) {
+    RNG rng(39);
+    const char* formats[] = { "%.9g", "%.3f", "%.12e", "%.1f", "%g", "%.17g" };
+    for (int i = 0; i < 20000; ++i) {
+        Float64 magnitude = std::pow(10.0, 12 * rng.Uniform<Float>() - 6);
+        Float64 value = (rng.Uniform<Float>() < 0.5f ? -1 : 1) * magnitude * rng.Uniform<Float>();
+        char text[64];
+        int length = std::snprintf(text, sizeof(text), formats[i % 6], value);
+        Float expected = 0, parsed = 0;
+        std::from_chars(text, text + length, expected);
+        const char* cursor = text;
+        ASSERT_TRUE(ParseFloat(cursor, text + length, parsed)) << text;
+        EXPECT_EQ(text + length, cursor) << text;
+        // Exact apart from double rounding through Float64.
+        EXPECT_LE(std::abs(FloatToFloatBits(expected) - Int64(FloatToFloatBits(parsed))), 1) << text;
+    }
+
+    for (const char* text : { "0", "-0.0", "+12", "1e3", "2.5E-3", ".5", "5.", "000012345678901234.5", "1e-50", "-3e45", "inf", "12345678901234567890123" }) {
+        const char* end = text + std::strlen(text);
+        Float expected = 0, parsed = 0;
+        std::from_chars(text + (text[0] == '+'), end, expected);
+        if (std::string(text) == "1e-50")
+            expected = 0;
+        else if (std::string(text) == "-3e45")
+            expected = -Infinity;
+        const char* cursor = text;
+        ASSERT_TRUE(ParseFloat(cursor, end, parsed)) << text;
+        EXPECT_EQ(end, cursor) << text;
+        EXPECT_EQ(expected, parsed) << text;
+    }
+
+    const char* cursor = "x1";
+    Float unused;
+    EXPECT_FALSE(ParseFloat(cursor, cursor + 2, unused));
+    EXPECT_TRUE(IsEightDigits("12345678"));
+    EXPECT_FALSE(IsEightDigits("1234a678"));
+    EXPECT_EQ(12345678u, ParseEightDigits("12345678"));
+    EXPECT_EQ(90000001u, ParseEightDigits("90000001"));
+}
+
+TEST(Parsing, SkipLinesAndSplitLines) {
+    std::string text;
+    for (int i = 0; i < 1000; ++i)
+        text += std::string(i % 7, 'a') + "\n";
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    const char* expected = begin;
+    for (int i = 0; i <= 1000; ++i) {
+        EXPECT_EQ(expected, SkipLines(begin, end, i));
+        expected = NextLine(expected, end);
+    }
+    EXPECT_EQ(1000u, CountByte(begin, end, '\n'));
+
+    std::vector<const char*> boundaries = SplitLines(begin, end, 7);
+    ASSERT_EQ(8u, boundaries.size());
+    for (size_t i = 1; i + 1 < boundaries.size(); ++i)
+        EXPECT_EQ('\n', boundaries[i][-1]);
+}
+
+TEST(OBJReader, ReadsPolygonsSeamsAndNegativeIndices) {
+    std::string path = TemporaryPath("theia_io_test.obj");
+    WriteFile(path,
+        "# two quads sharing an edge, with a uv seam along it\n"
+        "mtllib scene.mtl\n"
+        "o quads\n"
+        "v 0 0 0\nv 1 0 0\nv 1 0 1\nv 0 0 1\r\n"
+        "v 2 0 0\nv 2 0 1\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "vt 0.5\n"
+        "vn 0 1 0\n"
+        "usemtl red\n"
+        "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+        "g right\n"
+        "f -5/5/-1 -2/2/-1 -1/3/-1 -4/4/-1\n");
+    MeshReadResult result = ReadMesh(path);
+    ASSERT_TRUE(result.m_mesh != nullptr) << result.m_error;
+    const TriangleMesh& mesh = *result.m_mesh;
+    ASSERT_EQ(4u, mesh.TriangleCount());
+    ASSERT_TRUE(mesh.HasUVs() && mesh.HasNormals());
+    // Positions 2 and 3 have other uvs in the second quad, so they are split.
+    EXPECT_EQ(8u, mesh.VertexCount());
+
+    Point3f expectedPositions[4][3] = { { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 } }, { { 0, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 } },
+                                        { { 1, 0, 0 }, { 2, 0, 0 }, { 2, 0, 1 } }, { { 1, 0, 0 }, { 2, 0, 1 }, { 1, 0, 1 } } };
+    Point2f expectedUVs[4][3] = { { { 0, 0 }, { 1, 0 }, { 1, 1 } }, { { 0, 0 }, { 1, 1 }, { 0, 1 } },
+                                  { { 0.5f, 0 }, { 1, 0 }, { 1, 1 } }, { { 0.5f, 0 }, { 1, 1 }, { 0, 1 } } };
+    for (UInt32 t = 0; t < 4; ++t) {
+        std::array<UInt32, 3> v = mesh.TriangleVertices(t, 0);
+        for (int k = 0; k < 3; ++k) {
+            EXPECT_EQ(expectedPositions[t][k], mesh.Position(v[k])) << t << " " << k;
+            EXPECT_EQ(expectedUVs[t][k], mesh.UV(v[k])) << t << " " << k;
+            EXPECT_EQ(Normal3f(0, 1, 0), mesh.Normal(v[k]));
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(OBJReader, ChunksMatchSingleThread) {
+    std::string path = TemporaryPath("theia_io_test_chunks.obj");
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(200);
+    WriteOBJ(*wave, path);
+    ASSERT_GT(std::filesystem::file_size(path), 4u << 20);
+
+    MeshReadOptions serial, parallel;
+    serial.m_thread_count = 1;
+    parallel.m_thread_count = 4;
+    MeshReadResult expected = ReadOBJ(path, Transform(), serial), actual = ReadOBJ(path, Transform(), parallel);
+    ASSERT_TRUE(expected.m_mesh && actual.m_mesh) << expected.m_error << actual.m_error;
+    ExpectSameMesh(*wave, *expected.m_mesh);
+    ExpectSameMesh(*expected.m_mesh, *actual.m_mesh);
+    std::filesystem::remove(path);
+}
+
+TEST(PLYReader, FormatsAgree) {
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(200);
+    MeshReadOptions parallel;
+    parallel.m_thread_count = 4;
+    for (const char* format : { "ascii", "binary_little_endian", "binary_big_endian" }) {
+        std::string path = TemporaryPath("theia_io_test.ply");
+        WritePLY(*wave, path, format);
+        MeshReadResult result = ReadMesh(path, Transform(), parallel);
+        ASSERT_TRUE(result.m_mesh != nullptr) << format << ": " << result.m_error;
+        ExpectSameMesh(*wave, *result.m_mesh);
+        std::filesystem::remove(path);
+    }
+}
+
+TEST(PLYReader, ReadsPolygonsAndSkipsOtherData) {
+    // The same two quads in all formats, with an extra vertex property, an
+    // extra face property and an element the reader does not use.
+    std::string header =
+        "element vertex 6\nproperty float x\nproperty float y\nproperty float z\nproperty uchar red\n"
+        "element material 2\nproperty list uchar float values\n"
+        "element face 2\nproperty uchar flags\nproperty list uchar uint vertex_indices\nproperty short group\nend_header\n";
+    Float positions[6][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 }, { 2, 0, 0 }, { 2, 0, 1 } };
+    UInt32 quads[2][4] = { { 0, 1, 2, 3 }, { 1, 4, 5, 2 } };
+
+    std::string ascii = "ply\nformat ascii 1.0\n" + header;
+    for (auto& p : positions)
+        ascii += std::to_string(p[0]) + " " + std::to_string(p[1]) + " " + std::to_string(p[2]) + " 255\n";
+    ascii += "3 0.1 0.2 0.3\n0\n";
+    for (auto& q : quads)
+        ascii += "7 4 " + std::to_string(q[0]) + " " + std::to_string(q[1]) + " " + std::to_string(q[2]) + " " + std::to_string(q[3]) + " -1\n";
+
+    std::vector<std::string> files = { ascii };
+    for (bool bigEndian : { false, true }) {
+        std::string binary = std::string("ply\nformat ") + (bigEndian ? "binary_big_endian" : "binary_little_endian") + " 1.0\n" + header;
+        auto append = [&](const void* data, size_t size) {
+            std::string bytes(static_cast<const char*>(data), size);
+            if (bigEndian)
+                std::reverse(bytes.begin(), bytes.end());
+            binary += bytes;
+        };
+        for (auto& p : positions) {
+            for (Float value : p)
+                append(&value, 4);
+            binary += char(255);
+        }
+        Float values[3] = { 0.1f, 0.2f, 0.3f };
+        binary += char(3);
+        for (Float value : values)
+            append(&value, 4);
+        binary += char(0);
+        for (auto& q : quads) {
+            binary += char(7);
+            binary += char(4);
+            for (UInt32 index : q)
+                append(&index, 4);
+            Int16 group = -1;
+            append(&group, 2);
+        }
+        files.push_back(binary);
+    }
+
+    std::string path = TemporaryPath("theia_io_test_quads.ply");
+    for (const std::string& contents : files) {
+        WriteFile(path, contents);
+        MeshReadResult result = ReadPLY(path);
+        ASSERT_TRUE(result.m_mesh != nullptr) << result.m_error;
+        const TriangleMesh& mesh = *result.m_mesh;
+        EXPECT_FALSE(mesh.HasNormals() || mesh.HasUVs());
+        ASSERT_EQ(6u, mesh.VertexCount());
+        ASSERT_EQ(4u, mesh.TriangleCount());
+        for (UInt32 v = 0; v < 6; ++v)
+            EXPECT_EQ(Point3f(positions[v][0], positions[v][1], positions[v][2]), mesh.Position(v));
+        EXPECT_EQ((std::array<UInt32, 3>{ 0, 1, 2 }), mesh.TriangleVertices(0, 0));
+        EXPECT_EQ((std::array<UInt32, 3>{ 0, 2, 3 }), mesh.TriangleVertices(1, 0));
+        EXPECT_EQ((std::array<UInt32, 3>{ 1, 4, 5 }), mesh.TriangleVertices(2, 0));
+        EXPECT_EQ((std::array<UInt32, 3>{ 1, 5, 2 }), mesh.TriangleVertices(3, 0));
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(PLYReader, SkipsFaceValuesBeforeTheIndexList) {
+    // A float in front of the list must be skipped whole when counting the
+    // triangles, or the fan of each quad lands past the end of the indices.
+    std::string header =
+        "ply\nformat ascii 1.0\nelement vertex 6\nproperty float x\nproperty float y\nproperty float z\n"
+        "element face 2\nproperty float quality\nproperty list uchar int vertex_indices\nend_header\n"
+        "0 0 0\n1 0 0\n1 0 1\n0 0 1\n2 0 0\n2 0 1\n";
+    std::string path = TemporaryPath("theia_io_test_quality.ply");
+    WriteFile(path, header + "0.5 4 0 1 2 3\n0.25 4 1 4 5 2\n");
+    MeshReadResult result = ReadPLY(path);
+    ASSERT_TRUE(result.m_mesh != nullptr) << result.m_error;
+    ASSERT_EQ(4u, result.m_mesh->TriangleCount());
+    EXPECT_EQ((std::array<UInt32, 3>{ 0, 1, 2 }), result.m_mesh->TriangleVertices(0, 0));
+    EXPECT_EQ((std::array<UInt32, 3>{ 0, 2, 3 }), result.m_mesh->TriangleVertices(1, 0));
+    EXPECT_EQ((std::array<UInt32, 3>{ 1, 4, 5 }), result.m_mesh->TriangleVertices(2, 0));
+    EXPECT_EQ((std::array<UInt32, 3>{ 1, 5, 2 }), result.m_mesh->TriangleVertices(3, 0));
+
+    WriteFile(path, header + "0.5 four 0 1 2 3\n0.25 4 1 4 5 2\n");
+    MeshReadResult malformed = ReadPLY(path);
+    EXPECT_TRUE(malformed.m_mesh == nullptr);
+    EXPECT_NE(std::string::npos, malformed.m_error.find("malformed"));
+    std::filesystem::remove(path);
+}
+
+TEST(MeshReader, ReportsErrors) {
+    EXPECT_FALSE(ReadMesh(TemporaryPath("theia_io_test_missing.obj")).m_error.empty());
+    EXPECT_FALSE(ReadMesh(TemporaryPath("theia_io_test.stl")).m_error.empty());
+
+    std::string objPath = TemporaryPath("theia_io_test_bad.obj");
+    WriteFile(objPath, "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n");
+    MeshReadResult obj = ReadOBJ(objPath);
+    EXPECT_TRUE(obj.m_mesh == nullptr);
+    EXPECT_NE(std::string::npos, obj.m_error.find("out of range"));
+    WriteFile(objPath, "v 0 0 zero\n");
+    EXPECT_TRUE(ReadOBJ(objPath).m_mesh == nullptr);
+    std::filesystem::remove(objPath);
+
+    std::string plyPath = TemporaryPath("theia_io_test_bad.ply");
+    WriteFile(plyPath, "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\nelement face 1\nproperty list uchar int vertex_indices\nend_header\n0 0 0\n1 0 0\n1 1 0\n3 0 1 3\n");
+    EXPECT_TRUE(ReadPLY(plyPath).m_mesh == nullptr);
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(20);
+    WritePLY(*wave, plyPath, "binary_little_endian");
+    std::filesystem::resize_file(plyPath, std::filesystem::file_size(plyPath) - 5);
+    MeshReadResult truncated = ReadPLY(plyPath);
+    EXPECT_TRUE(truncated.m_mesh == nullptr);
+    EXPECT_NE(std::string::npos, truncated.m_error.find("ends before"));
+    std::filesystem::remove(plyPath);
+}
+
+TEST(Socket, MovesWholeBuffersBothWays) {
+    SocketListener listener;
+    ASSERT_TRUE(listener.IsOpen());
+    UInt16 port = listener.GetPort();
+    ASSERT_NE(0, port);
+    EXPECT_FALSE(listener.Accept(10).IsOpen());
+
+    // Larger than the socket buffers, so it crosses in many pieces.
+    std::vector<UInt32> sent(1 << 20);
+    std::iota(sent.begin(), sent.end(), 0u);
+    UInt64 echoed = 0;
+    std::thread client([&] {
+        Socket socket = Socket::Connect("127.0.0.1", port);
+        EXPECT_TRUE(socket.Send(sent.data(), sent.size() * sizeof(UInt32)));
+        EXPECT_TRUE(socket.Receive(&echoed, sizeof(echoed)));
+    });
+    Socket server = listener.Accept(5000);
+    ASSERT_TRUE(server.IsOpen());
+    std::vector<UInt32> received(sent.size());
+    ASSERT_TRUE(server.Receive(received.data(), received.size() * sizeof(UInt32)));
+    EXPECT_EQ(sent, received);
+    UInt64 sum = std::accumulate(received.begin(), received.end(), UInt64(0));
+    EXPECT_TRUE(server.Send(&sum, sizeof(sum)));
+    client.join();
+    EXPECT_EQ(sum, echoed);
+
+    // Once the peer is gone Receive fails rather than waiting.
+    UInt32 value = 0;
+    EXPECT_FALSE(server.Receive(&value, sizeof(value)));
+    EXPECT_FALSE(Socket::Connect("not an address", port).IsOpen());
+}
+
+// Run with --gtest_also_run_disabled_tests to measure load throughput. The
+// grid resolution can be raised with THEIA_LOAD_BENCHMARK_GRID; 10000 gives
+// files of 2 to 8 GB.
+TEST(MeshReader, DISABLED_LoadBenchmark) {
+    int n = std::getenv("THEIA_LOAD_BENCHMARK_GRID") ? std::atoi(std::getenv("THEIA_LOAD_BENCHMARK_GRID")) : 3000;
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(n);
+    std::vector<std::pair<std::string, std::string>> files = {
+        { "obj", TemporaryPath("theia_load_benchmark.obj") },
+        { "ply ascii", TemporaryPath("theia_load_benchmark_ascii.ply") },
+        { "ply binary", TemporaryPath("theia_load_benchmark_binary.ply") } };
+    WriteOBJ(*wave, files[0].second);
+    WritePLY(*wave, files[1].second, "ascii");
+    WritePLY(*wave, files[2].second, "binary_little_endian");
+
+    UInt32 hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << wave->TriangleCount() << " triangles, " << hardwareThreads << " hardware threads" << std::endl;
+    for (const auto& [name, path] : files) {
+        for (UInt32 threads : { 1u, hardwareThreads }) {
+            MeshReadOptions options;
+            options.m_thread_count = threads;
+            auto start = std::chrono::steady_clock::now();
+            MeshReadResult result = ReadMesh(path, Transform(), options);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ASSERT_TRUE(result.m_mesh != nullptr) << result.m_error;
+            std::cout << name << ", " << threads << " threads: " << result.m_file_bytes / (1024.0 * 1024.0) << " MiB in " << seconds << " s, "
+                      << result.m_file_bytes / (1024.0 * 1024.0) / seconds << " MiB/s, " << result.m_mesh->TriangleCount() / seconds / 1e6 << " Mtriangles/s" << std::endl;
+            if (hardwareThreads == 1)
+                break;
+        }
+        std::filesystem::remove(path);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "../ext/gtest/gtest.h"
+
+#include "../Parallel/Algorithms.h"
+#include "../Parallel/TaskGraph.h"
+#include "../Parallel/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace Theia;
+
+TEST(TaskGraph, RunsTasksAfterTheirDependencies) {
+    for (UInt32 threads : { 1u, 4u }) {
+        TaskGraph graph(threads);
+        std::mutex mutex;
+        std::vector<int> order;
+        auto record = [&](int id) {
+            return [&, id]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(id);
+            };
+        };
+
+        // A diamond per layer: each layer waits for both tasks of the previous one.
+        std::vector<TaskHandle> previous;
+        for (int layer = 0; layer < 50; ++layer) {
+            TaskHandle left = graph.Add(record(2 * layer), previous);
+            TaskHandle right = graph.Add(record(2 * layer + 1), previous);
+            previous = { left, right };
+        }
+        graph.Wait(previous[0]);
+        graph.Wait();
+
+        ASSERT_EQ(100u, order.size());
+        for (int i = 0; i < 100; i += 2) {
+            EXPECT_EQ(i / 2, std::min(order[i], order[i + 1]) / 2);
+            EXPECT_EQ(i / 2, std::max(order[i], order[i + 1]) / 2);
+        }
+    }
+}
+
+TEST(TaskGraph, WaitsForTasksAddedByTasks) {
+    for (UInt32 threads : { 1u, 3u, 8u }) {
+        TaskGraph graph(threads);
+        EXPECT_EQ(threads, graph.GetThreadCount());
+        std::atomic<int> count = 0;
+        // Every task below depth 10 adds two more, 2047 tasks in all.
+        std::function<void(int)> spawn = [&](int depth) {
+            count++;
+            if (depth < 10) {
+                graph.Add([&, depth]() { spawn(depth + 1); });
+                graph.Add([&, depth]() { spawn(depth + 1); });
+            }
+        };
+        graph.Add([&]() { spawn(0); });
+        graph.Wait();
+        EXPECT_EQ(2047, count.load());
+
+        // Dependencies that already finished do not hold a task back.
+        TaskHandle done = graph.Add([&]() { count++; });
+        graph.Wait();
+        TaskHandle after = graph.Add([&]() { count++; }, std::span<const TaskHandle>(&done, 1));
+        graph.Wait(after);
+        EXPECT_EQ(2049, count.load());
+    }
+}
+
+TEST(ThreadPool, ParallelForRunsEveryIndexOnce) {
+    for (UInt32 threads : { 1u, 2u, 7u }) {
+        ThreadPool pool({ threads });
+        EXPECT_EQ(threads, pool.GetThreadCount());
+        for (Int64 count : { 0, 1, 5, 1000, 100003 }) {
+            for (Int64 grain : { 0, 1, 64 }) {
+                std::vector<std::atomic<int>> visits(count + 10);
+                ParallelFor(10, 10 + count, [&](Int64 i) {
+                    visits[i]++;
+                    EXPECT_LT(pool.GetThreadIndex(), threads);
+                }, grain, pool);
+                for (Int64 i = 0; i < count + 10; ++i)
+                    EXPECT_EQ(i < 10 ? 0 : 1, visits[i].load()) << i;
+            }
+        }
+    }
+}
+
+TEST(ThreadPool, ParallelFor2DCoversBoundsWithClippedTiles) {
+    ThreadPool pool({ 4 });
+    AABB2i bounds(Point2i(-3, 5), Point2i(50, 42));
+    std::vector<std::atomic<int>> visits(53 * 37);
+    std::mutex mutex;
+    std::set<std::pair<Int32, Int32>> corners;
+    ParallelFor2D(bounds, [&](AABB2i tile) {
+        EXPECT_FALSE(tile.IsEmpty());
+        EXPECT_LE(tile.Diagonal().m_x, 16);
+        EXPECT_LE(tile.Diagonal().m_y, 16);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            corners.insert({ tile.m_min.m_x, tile.m_min.m_y });
+        }
+        for (Int32 y = tile.m_min.m_y; y < tile.m_max.m_y; ++y)
+            for (Int32 x = tile.m_min.m_x; x < tile.m_max.m_x; ++x)
+                visits[(y - 5) * 53 + (x + 3)]++;
+    }, 16, pool);
+
+    // 4 x 3 tiles, the last column 5 pixels and the last row 5 pixels wide.
+    EXPECT_EQ(12u, corners.size());
+    for (const std::atomic<int>& visit : visits)
+        EXPECT_EQ(1, visit.load());
+    ParallelFor2D(AABB2i(Point2i(0, 0), Point2i(0, 10)), [&](AABB2i) { ADD_FAILURE(); }, 16, pool);
+}
+
+TEST(ThreadPool, TaskGroupsNestAndHelpWhileWaiting) {
+    // Every level waits on its children from inside a task, which only finishes because waiting threads run tasks.
+    for (UInt32 threads : { 1u, 2u, 6u }) {
+        ThreadPool pool({ threads, true });
+        std::function<Int64(int)> fibonacci = [&](int n) -> Int64 {
+            if (n < 2)
+                return n;
+            Int64 a = 0, b = 0;
+            TaskGroup group(pool);
+            group.Run([&]() { a = fibonacci(n - 1); });
+            group.Run([&]() { b = fibonacci(n - 2); });
+            group.Wait();
+            return a + b;
+        };
+        EXPECT_EQ(6765, fibonacci(20));
+
+        // Tasks from several outside threads share the pool.
+        std::atomic<Int64> sum = 0;
+        std::vector<std::thread> callers;
+        for (int t = 0; t < 3; ++t)
+            callers.emplace_back([&]() {
+                ParallelFor(0, 10000, [&](Int64 i) { sum += i; }, 16, pool);
+            });
+        for (std::thread& caller : callers)
+            caller.join();
+        EXPECT_EQ(3 * 49995000, sum.load());
+    }
+}
+
+TEST(ThreadPool, TaskGraphRunsOnASharedPool) {
+    ThreadPool pool({ 3 });
+    TaskGraph graph(pool);
+    EXPECT_EQ(3u, graph.GetThreadCount());
+    std::atomic<int> count = 0;
+    TaskHandle first = graph.Add([&]() {
+        // Loops inside graph tasks use the same workers.
+        ParallelFor(0, 100, [&](Int64) { count++; }, 1, pool);
+    });
+    TaskHandle second = graph.Add([&]() { EXPECT_EQ(100, count.load()); count++; }, std::span<const TaskHandle>(&first, 1));
+    graph.Wait(second);
+    EXPECT_EQ(101, count.load());
+}
+
+// Run with --gtest_also_run_disabled_tests to measure how ParallelFor2D scales with the thread count on a compute-bound per-pixel loop, the shape of a tile renderer.
+TEST(ThreadPool, DISABLED_ScalingBenchmark) {
+    AABB2i bounds(Point2i(0, 0), Point2i(1024, 1024));
+    auto shade = [](Int32 x, Int32 y) {
+        Float value = Float(x * 31 + y);
+        for (int i = 0; i < 200; ++i)
+            value = std::sin(value) * 1.0001f + 0.5f;
+        return value;
+    };
+    std::vector<Float> image(1024 * 1024);
+
+    UInt32 hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    double serialSeconds = 0;
+    for (UInt32 threads = 1; threads <= hardwareThreads; threads = threads < hardwareThreads && 2 * threads > hardwareThreads ? hardwareThreads : 2 * threads) {
+        ThreadPool pool({ threads, true });
+        auto start = std::chrono::steady_clock::now();
+        ParallelFor2D(bounds, [&](AABB2i tile) {
+            for (Int32 y = tile.m_min.m_y; y < tile.m_max.m_y; ++y)
+                for (Int32 x = tile.m_min.m_x; x < tile.m_max.m_x; ++x)
+                    image[y * 1024 + x] = shade(x, y);
+        }, 16, pool);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1)
+            serialSeconds = seconds;
+        std::cout << threads << " threads: " << seconds * 1000 << " ms, speedup " << serialSeconds / seconds << ", efficiency "
+                  << serialSeconds / seconds / threads << std::endl;
+    }
+}
+TEST(ParallelAlgorithms, ExclusiveScanMatchesSerialScan) {
+    std::mt19937 rng(7);
+    for (UInt32 threads : { 1u, 4u }) {
+        ThreadPool pool({ threads });
+        for (size_t size : { size_t(0), size_t(1), size_t(7), size_t(4097), size_t(100003) }) {
+            std::vector<UInt32> values(size);
+            for (UInt32& value : values)
+                value = rng() % 1000;
+            std::vector<UInt32> expected(size);
+            std::exclusive_scan(values.begin(), values.end(), expected.begin(), 0u);
+            std::vector<UInt32> scanned(size);
+            UInt32 total = ExclusiveScan<UInt32>(values, scanned, pool);
+            EXPECT_EQ(expected, scanned) << size << " values on " << threads << " threads";
+            EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0u), total);
+
+            std::vector<UInt64> wide(values.begin(), values.end());
+            EXPECT_EQ(UInt64(total), ExclusiveScan<UInt64>(wide, wide, pool));
+            EXPECT_TRUE(std::equal(wide.begin(), wide.end(), expected.begin()));
+        }
+    }
+}
+
+TEST(ParallelAlgorithms, CompactionKeepsOrder) {
+    std::mt19937 rng(8);
+    for (UInt32 threads : { 1u, 4u }) {
+        ThreadPool pool({ threads });
+        for (size_t size : { size_t(0), size_t(1), size_t(33), size_t(100003) }) {
+            std::vector<UInt8> tags(size);
+            for (UInt8& tag : tags)
+                tag = UInt8(rng() % 3);
+            std::vector<UInt32> expected;
+            for (UInt32 i = 0; i < size; ++i)
+                if (tags[i] == 2)
+                    expected.push_back(i);
+
+            std::vector<UInt32> indices(size);
+            UInt32 count = CompactMatches<UInt32>(tags, 2, indices, pool);
+            EXPECT_EQ(expected, std::vector<UInt32>(indices.begin(), indices.begin() + count));
+            count = CompactIndices<UInt32>(UInt32(size), [&](UInt32 i) { return tags[i] == 2; }, indices, pool);
+            EXPECT_EQ(expected, std::vector<UInt32>(indices.begin(), indices.begin() + count));
+
+            std::vector<UInt32> kept(size);
+            size_t keptCount = Compact<UInt32>(expected, kept, [](UInt32 i) { return i % 2 == 0; }, pool);
+            std::vector<UInt32> even;
+            std::copy_if(expected.begin(), expected.end(), std::back_inserter(even), [](UInt32 i) { return i % 2 == 0; });
+            EXPECT_EQ(even, std::vector<UInt32>(kept.begin(), kept.begin() + keptCount));
+        }
+    }
+}
+
+template <typename Key> void ExpectRadixSortIsStable(std::mt19937_64& rng, ThreadPool& pool, size_t size, UInt32 keyBits) {
+    std::vector<Key> keys(size);
+    for (Key& key : keys)
+        key = Key(rng()) & (keyBits == sizeof(Key) * 8 ? ~Key(0) : (Key(1) << keyBits) - 1) & ~Key(0xF0);
+    std::vector<UInt32> values(size);
+    std::iota(values.begin(), values.end(), 0u);
+    std::vector<std::pair<Key, UInt32>> expected(size);
+    for (size_t i = 0; i < size; ++i)
+        expected[i] = { keys[i], values[i] };
+    std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<Key> keyScratch;
+    std::vector<UInt32> valueScratch;
+    std::vector<Key> keysOnly = keys;
+    RadixSort(keys, values, keyScratch, valueScratch, keyBits, pool);
+    for (size_t i = 0; i < size; ++i) {
+        ASSERT_EQ(expected[i].first, keys[i]) << i << " of " << size;
+        ASSERT_EQ(expected[i].second, values[i]) << i << " of " << size;
+    }
+    RadixSort(keysOnly, keyScratch, keyBits, pool);
+    EXPECT_EQ(keys, keysOnly);
+}
+
+TEST(ParallelAlgorithms, RadixSortIsStableWithPayloads) {
+    std::mt19937_64 rng(9);
+    for (UInt32 threads : { 1u, 4u }) {
+        ThreadPool pool({ threads });
+        for (size_t size : { size_t(0), size_t(1), size_t(1000), size_t(100003) }) {
+            ExpectRadixSortIsStable<UInt32>(rng, pool, size, 32);
+            ExpectRadixSortIsStable<UInt32>(rng, pool, size, 12);
+            ExpectRadixSortIsStable<UInt64>(rng, pool, size, 64);
+            ExpectRadixSortIsStable<UInt64>(rng, pool, size, 39);
+        }
+    }
+
+    // Keys that share every byte but the lowest sort in one pass.
+    ThreadPool pool({ 4 });
+    std::vector<UInt64> keys = { 0x1234567800000003ull, 0x1234567800000001ull, 0x1234567800000002ull };
+    std::vector<UInt64> scratch;
+    EXPECT_EQ(1u, RadixSort(keys, scratch, 64, pool));
+    EXPECT_EQ((std::vector<UInt64>{ 0x1234567800000001ull, 0x1234567800000002ull, 0x1234567800000003ull }), keys);
+}
+
+// Run with --gtest_also_run_disabled_tests to time the parallel primitives against their standard library counterparts from 10^6 elements up to THEIA_PRIMITIVES_BENCHMARK_MAX_ELEMENTS, 10^8 by default; 10^9 needs about 16 GB for the 64-bit sort.
+TEST(ParallelAlgorithms, DISABLED_PrimitivesBenchmark) {
+    double maxElements = std::getenv("THEIA_PRIMITIVES_BENCHMARK_MAX_ELEMENTS") ? std::atof(std::getenv("THEIA_PRIMITIVES_BENCHMARK_MAX_ELEMENTS")) : 1e8;
+    auto report = [](const char* name, size_t size, auto run) {
+        double seconds = std::numeric_limits<double>::infinity();
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            seconds = std::min(seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cout << "  " << name << ": " << seconds * 1000 << " ms, " << size / seconds / 1e6 << " M elements/s" << std::endl;
+    };
+
+    std::mt19937_64 rng(10);
+    ThreadPool& pool = ThreadPool::Default();
+    std::cout << pool.GetThreadCount() << " threads" << std::endl;
+    for (size_t size = 1000000; size <= size_t(maxElements); size *= 10) {
+        std::cout << size << " elements" << std::endl;
+        {
+            std::vector<UInt32> values(size);
+            for (UInt32& value : values)
+                value = UInt32(rng() & 0xFF);
+            std::vector<UInt32> scanned(size);
+            report("ExclusiveScan (32-bit)", size, [&]() { ExclusiveScan<UInt32>(values, scanned, pool); });
+            report("std::exclusive_scan (32-bit)", size, [&]() { std::exclusive_scan(values.begin(), values.end(), scanned.begin(), 0u); });
+        }
+        {
+            std::vector<UInt8> flags(size);
+            for (UInt8& flag : flags)
+                flag = UInt8(rng() % 2);
+            std::vector<UInt32> indices(size);
+            report("CompactMatches", size, [&]() { CompactMatches<UInt32>(flags, 1, indices, pool); });
+            report("CompactIndices", size, [&]() { CompactIndices<UInt32>(UInt32(size), [&](UInt32 i) { return flags[i] == 1; }, indices, pool); });
+            report("serial compaction", size, [&]() {
+                UInt32 count = 0;
+                for (UInt32 i = 0; i < size; ++i)
+                    if (flags[i] == 1)
+                        indices[count++] = i;
+            });
+        }
+        for (UInt32 keyBytes : { 4u, 8u }) {
+            std::vector<UInt64> source(size);
+            for (UInt64& key : source)
+                key = keyBytes == 4 ? rng() & 0xFFFFFFFFull : rng();
+            std::vector<UInt32> values(size), valueScratch;
+            auto time = [&](const char* name, auto sort) {
+                double seconds = std::numeric_limits<double>::infinity();
+                for (int repeat = 0; repeat < 3; ++repeat) {
+                    std::iota(values.begin(), values.end(), 0u);
+                    seconds = std::min(seconds, sort());
+                }
+                std::cout << "  " << name << " (" << 8 * keyBytes << "-bit keys with payloads): " << seconds * 1000 << " ms, " << size / seconds / 1e6 << " M elements/s" << std::endl;
+            };
+            if (keyBytes == 4) {
+                std::vector<UInt32> keys(size), keyScratch;
+                time("RadixSort", [&]() {
+                    std::copy(source.begin(), source.end(), keys.begin());
+                    auto start = std::chrono::steady_clock::now();
+                    RadixSort(keys, values, keyScratch, valueScratch, 32, pool);
+                    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                });
+            } else {
+                std::vector<UInt64> keys(size), keyScratch;
+                time("RadixSort", [&]() {
+                    std::copy(source.begin(), source.end(), keys.begin());
+                    auto start = std::chrono::steady_clock::now();
+                    RadixSort(keys, values, keyScratch, valueScratch, 64, pool);
+                    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                });
+            }
+            std::vector<std::pair<UInt64, UInt32>> pairs(size);
+            time("std::sort", [&]() {
+                for (size_t i = 0; i < size; ++i)
+                    pairs[i] = { source[i], values[i] };
+                auto start = std::chrono::steady_clock::now();
+                std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            });
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,961 @@
+#include "../ext/gtest/gtest.h"
+
+#include "../Math/Math.h"
+#include "../Accelerator/GeometryCache.h"
+#include "../Render/DistributedRender.h"
+#include "../Render/ImageTileIntegrator.h"
+#include "../Render/PathIntegrator.h"
+#include "../Render/RenderCheckpoint.h"
+#include "../Render/WavefrontPathIntegrator.h"
+#include "../Shape/BSplinePatch.h"
+#include "../Shape/Sphere.h"
+#include "../Shape/Triangle.h"
+#include "test_helpers.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <thread>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace Theia;
+
+// Pinhole at the origin looking down +z with a 90 degree vertical field of view. Pixels left of column 1 produce no ray.
+class PinholeCamera : public ICamera {
+public:
+    explicit PinholeCamera(Point2i resolution) : m_resolution(resolution) {}
+
+    void GenerateRay() const override {}
+
+    std::optional<CameraRayDifferential> GenerateRayDifferentials(const CameraSample& sample) const override {
+        if (sample.Film_Point.m_x < 1)
+            return {};
+        Ray ray(Point3f(0, 0, 0), Direction(sample.Film_Point.m_x, sample.Film_Point.m_y), sample.Time);
+        Vector3f rx = Direction(sample.Film_Point.m_x + 1, sample.Film_Point.m_y);
+        Vector3f ry = Direction(sample.Film_Point.m_x, sample.Film_Point.m_y + 1);
+        return CameraRayDifferential{ RayDifferential(ray, Point3f(0, 0, 0), rx, Point3f(0, 0, 0), ry) };
+    }
+
+private:
+    Vector3f Direction(Float x, Float y) const {
+        Float aspect = Float(m_resolution.m_x) / m_resolution.m_y;
+        return Normalize(Vector3f((2 * x / m_resolution.m_x - 1) * aspect, 1 - 2 * y / m_resolution.m_y, 1));
+    }
+
+    Point2i m_resolution;
+};
+
+// Shades a sphere of radius 1 at z = 4 by distance, plus a random term, so every sample of a pixel differs.
+class SphereIntegrator : public ImageTileIntegrator {
+public:
+    SphereIntegrator(const ICamera& camera, Film& film, const ImageTileIntegratorOptions& options, ThreadPool& pool)
+        : ImageTileIntegrator(camera, film, options, pool), m_sphere(&m_renderFromObject, 1) {}
+
+protected:
+    Vector3f Li(const RayDifferential& ray, RandomNumberGenerator& rng) const override {
+        Float noise = 0.01f * rng.Uniform<Float>();
+        std::optional<ShapeIntersection> hit = m_sphere.Intersect(ray.GetRay());
+        if (!hit)
+            return Vector3f(0, 0, noise);
+        return Vector3f(1 / hit->m_t_hit, ray.HasDifferentials() ? 1.0f : 0.0f, noise);
+    }
+
+private:
+    Transform m_renderFromObject = Translate(Vector3f(0, 0, 4));
+    Sphere m_sphere;
+};
+
+// Cancels its own render after a number of samples, as a preempted job would be.
+class CancellingIntegrator : public SphereIntegrator {
+public:
+    CancellingIntegrator(const ICamera& camera, Film& film, const ImageTileIntegratorOptions& options, ThreadPool& pool, UInt64 cancelAfter)
+        : SphereIntegrator(camera, film, options, pool), m_cancelAfter(cancelAfter) {}
+
+protected:
+    Vector3f Li(const RayDifferential& ray, RandomNumberGenerator& rng) const override {
+        if (++m_sampleCount == m_cancelAfter)
+            const_cast<CancellingIntegrator*>(this)->Cancel();
+        return SphereIntegrator::Li(ray, rng);
+    }
+
+private:
+    UInt64 m_cancelAfter;
+    mutable std::atomic<UInt64> m_sampleCount = 0;
+};
+
+static Film Render(Point2i resolution, ImageTileIntegratorOptions options, UInt32 threads, ImageTileStatistics* statistics = nullptr) {
+    ThreadPool pool({ threads });
+    PinholeCamera camera(resolution);
+    Film film(resolution);
+    SphereIntegrator integrator(camera, film, options, pool);
+    integrator.Integrate();
+    if (statistics)
+        *statistics = integrator.GetStatistics();
+    return film;
+}
+
+TEST(ImageTileIntegrator, RendersEveryPixelWithEverySample) {
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 4;
+    options.m_tile_size = 16;
+    ImageTileStatistics statistics;
+    Film film = Render(Point2i(100, 70), options, 3, &statistics);
+
+    // 7 x 5 tiles, the last band 6 pixels high.
+    EXPECT_EQ(35u, statistics.m_tile_count);
+    EXPECT_EQ(6, statistics.m_min_tile_size);
+    EXPECT_EQ(16, statistics.m_max_tile_size);
+    EXPECT_EQ(100u * 70u * 4u, statistics.m_sample_count);
+    EXPECT_EQ(3u, statistics.m_thread_count);
+
+    for (Int32 y = 0; y < 70; ++y)
+        for (Int32 x = 0; x < 100; ++x)
+            EXPECT_EQ(4.0, film.GetPixel(Point2i(x, y)).m_weight_sum);
+    // Column 0 has no camera rays, the centre sees the sphere 3 units away, the corners miss it.
+    EXPECT_EQ(0.0f, film.GetPixelRGB(Point2i(0, 35)).m_z);
+    EXPECT_NEAR(1.0f / 3, film.GetPixelRGB(Point2i(50, 35)).m_x, 2e-3f);
+    EXPECT_EQ(1.0f, film.GetPixelRGB(Point2i(50, 35)).m_y);
+    EXPECT_EQ(0.0f, film.GetPixelRGB(Point2i(99, 0)).m_x);
+    EXPECT_GT(film.GetPixelRGB(Point2i(99, 0)).m_z, 0.0f);
+}
+
+TEST(ImageTileIntegrator, ImageDoesNotDependOnTilesOrThreads) {
+    Point2i resolution(83, 61);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 3;
+    options.m_tile_size = 83;
+    Film expected = Render(resolution, options, 1);
+
+    for (Int32 tileSize : { 0, 1, 7, 32 })
+        for (UInt32 threads : { 1u, 4u }) {
+            options.m_tile_size = tileSize;
+            options.m_target_tile_milliseconds = 0.01;
+            ImageTileStatistics statistics;
+            Film film = Render(resolution, options, threads, &statistics);
+            if (tileSize == 0) {
+                EXPECT_GE(statistics.m_min_tile_size, 1);
+                EXPECT_LE(statistics.m_max_tile_size, 128);
+            }
+            for (Int32 y = 0; y < resolution.m_y; ++y)
+                for (Int32 x = 0; x < resolution.m_x; ++x) {
+                    const FilmPixel& a = expected.GetPixel(Point2i(x, y));
+                    const FilmPixel& b = film.GetPixel(Point2i(x, y));
+                    ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum) << x << " " << y << " tile " << tileSize << " threads " << threads;
+                    ASSERT_EQ(a.m_weight_sum, b.m_weight_sum);
+                }
+        }
+
+    // A different seed gives different noise.
+    options.m_seed = 1;
+    Film reseeded = Render(resolution, options, 2);
+    EXPECT_NE(expected.GetPixel(Point2i(40, 30)).m_rgb_sum[2], reseeded.GetPixel(Point2i(40, 30)).m_rgb_sum[2]);
+}
+
+TEST(ImageTileIntegrator, AdaptiveTilesShrinkTowardsTheEnd) {
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 2;
+    options.m_tile_size = 0;
+    // A large target grows tiles from the first band of 16 to the limit while much of the image is left; the last bands are split finer so every thread gets several tiles.
+    options.m_target_tile_milliseconds = 1000;
+    ImageTileStatistics statistics;
+    Render(Point2i(512, 512), options, 2, &statistics);
+    EXPECT_EQ(128, statistics.m_max_tile_size);
+    EXPECT_LE(statistics.m_min_tile_size, 16);
+    EXPECT_GT(statistics.m_tile_count, 32u + 8u);
+}
+
+TEST(Film, TracksLuminanceVarianceAcrossTiles) {
+    RandomNumberGenerator rng;
+    Film direct(Point2i(2, 1));
+    Film merged(Point2i(2, 1));
+    Film stored(Point2i(2, 1));
+    std::vector<double> luminances;
+    for (int tile = 0; tile < 3; ++tile) {
+        FilmTile filmTile(AABB2i(Point2i(0, 0), Point2i(2, 1)));
+        FilmTile storedTile;
+        storedTile.Reset(AABB2i(Point2i(0, 0), Point2i(2, 1)), stored);
+        for (int i = 0; i < 5 + 4 * tile; ++i) {
+            Vector3f rgb(rng.Uniform<Float>(), 2 * rng.Uniform<Float>(), tile + rng.Uniform<Float>());
+            direct.AddSample(Point2i(1, 0), rgb, 1);
+            filmTile.AddSample(Point2i(1, 0), rgb, 1);
+            storedTile.AddSample(Point2i(1, 0), rgb, 1);
+            luminances.push_back(0.2126 * rgb.m_x + 0.7152 * rgb.m_y + 0.0722 * rgb.m_z);
+        }
+        merged.MergeTile(filmTile);
+        stored.StoreTile(storedTile);
+    }
+
+    // Stored tiles continue the sums of the film, so they come out as if every sample went to the film directly.
+    const FilmPixel& directPixel = direct.GetPixel(Point2i(1, 0));
+    const FilmPixel& storedPixel = stored.GetPixel(Point2i(1, 0));
+    EXPECT_EQ(directPixel.m_rgb_sum, storedPixel.m_rgb_sum);
+    EXPECT_EQ(directPixel.m_luminance_mean, storedPixel.m_luminance_mean);
+    EXPECT_EQ(directPixel.m_luminance_m2, storedPixel.m_luminance_m2);
+
+    double mean = std::accumulate(luminances.begin(), luminances.end(), 0.0) / luminances.size();
+    double m2 = 0;
+    for (double luminance : luminances)
+        m2 += (luminance - mean) * (luminance - mean);
+    for (const Film* film : { &direct, &merged }) {
+        const FilmPixel& pixel = film->GetPixel(Point2i(1, 0));
+        EXPECT_EQ(luminances.size(), pixel.m_sample_count);
+        EXPECT_NEAR(mean, pixel.m_luminance_mean, 1e-12);
+        EXPECT_NEAR(m2, pixel.m_luminance_m2, 1e-10);
+        EXPECT_NEAR(std::sqrt(m2 / (luminances.size() - 1) / luminances.size()) / mean, film->GetRelativeStandardError(Point2i(1, 0), 0.01), 1e-10);
+    }
+    // The untouched pixel has no estimate, and dark pixels are measured against the minimum luminance.
+    EXPECT_EQ(std::numeric_limits<Float64>::infinity(), merged.GetRelativeStandardError(Point2i(0, 0), 0.01));
+    EXPECT_LT(merged.GetRelativeStandardError(Point2i(1, 0), 100), merged.GetRelativeStandardError(Point2i(1, 0), 0.01));
+}
+
+TEST(ImageTileIntegrator, AdaptiveSamplingStopsWherePixelsConverge) {
+    Point2i resolution(100, 70);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 4;
+    options.m_error_threshold = 0.005;
+    options.m_max_samples_per_pixel = 64;
+    ImageTileStatistics statistics;
+    Film film = Render(resolution, options, 3, &statistics);
+
+    UInt64 samples = 0, unconverged = 0;
+    bool reachedLimit = false;
+    for (Int32 y = 0; y < resolution.m_y; ++y)
+        for (Int32 x = 0; x < resolution.m_x; ++x) {
+            const FilmPixel& pixel = film.GetPixel(Point2i(x, y));
+            Float64 error = film.GetRelativeStandardError(Point2i(x, y), options.m_error_min_luminance);
+            EXPECT_TRUE(error <= options.m_error_threshold || pixel.m_sample_count == 64) << x << " " << y;
+            EXPECT_EQ(pixel.m_weight_sum, Float64(pixel.m_sample_count));
+            EXPECT_EQ(0u, pixel.m_sample_count % 4);
+            samples += pixel.m_sample_count;
+            unconverged += error > options.m_error_threshold ? 1 : 0;
+            reachedLimit |= pixel.m_sample_count == 64;
+        }
+    EXPECT_EQ(samples, statistics.m_sample_count);
+    EXPECT_EQ(unconverged, statistics.m_unconverged_pixel_count);
+    EXPECT_EQ(16u - 1u, statistics.m_pass_count);
+    // Column 0 is black and the inside of the sphere nearly flat, so both converge in the first pass; the faint noise of the background takes a few passes, and the silhouette of the sphere reaches the limit.
+    EXPECT_TRUE(reachedLimit);
+    EXPECT_EQ(4u, film.GetPixel(Point2i(0, 35)).m_sample_count);
+    EXPECT_EQ(4u, film.GetPixel(Point2i(50, 35)).m_sample_count);
+    EXPECT_GT(film.GetPixel(Point2i(99, 0)).m_sample_count, 4u);
+    EXPECT_LT(film.GetPixel(Point2i(99, 0)).m_sample_count, 64u);
+    // Under a third of the samples of sampling every pixel to the limit.
+    EXPECT_LT(samples, UInt64(resolution.m_x * resolution.m_y) * 64 / 3);
+}
+
+TEST(ImageTileIntegrator, AdaptiveSamplingDoesNotDependOnTilesOrThreads) {
+    Point2i resolution(61, 43);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 2;
+    options.m_error_threshold = 0.01;
+    options.m_max_samples_per_pixel = 32;
+    options.m_tile_size = 61;
+    Film expected = Render(resolution, options, 1);
+
+    for (Int32 tileSize : { 0, 5 })
+        for (UInt32 threads : { 2u, 4u }) {
+            options.m_tile_size = tileSize;
+            Film film = Render(resolution, options, threads);
+            for (Int32 y = 0; y < resolution.m_y; ++y)
+                for (Int32 x = 0; x < resolution.m_x; ++x) {
+                    const FilmPixel& a = expected.GetPixel(Point2i(x, y));
+                    const FilmPixel& b = film.GetPixel(Point2i(x, y));
+                    ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum) << x << " " << y << " tile " << tileSize << " threads " << threads;
+                    ASSERT_EQ(a.m_sample_count, b.m_sample_count);
+                }
+        }
+}
+
+TEST(ImageTileIntegrator, ProgressiveRenderingStopsWithinTheBudget) {
+    Point2i resolution(64, 48);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 4;
+    options.m_time_budget_milliseconds = 200;
+    options.m_max_samples_per_pixel = 1u << 20;
+    ImageTileStatistics statistics;
+    Film film = Render(resolution, options, 2, &statistics);
+
+    // Generous, as the test machine may be busy; the passes are sized to end well before the deadline.
+    EXPECT_LT(statistics.m_render_milliseconds, 1.5 * options.m_time_budget_milliseconds);
+    EXPECT_GT(statistics.m_pass_count, 2u);
+    UInt64 samples = 0;
+    UInt64 firstCount = film.GetPixel(Point2i(0, 0)).m_sample_count;
+    EXPECT_GT(firstCount, 1u);
+    for (Int32 y = 0; y < resolution.m_y; ++y)
+        for (Int32 x = 0; x < resolution.m_x; ++x) {
+            const FilmPixel& pixel = film.GetPixel(Point2i(x, y));
+            EXPECT_EQ(pixel.m_weight_sum, Float64(pixel.m_sample_count));
+            // Unless the last pass hit the deadline every pixel has as many samples as every other.
+            if (!statistics.m_is_cut_short) {
+                ASSERT_EQ(firstCount, pixel.m_sample_count) << x << " " << y;
+            }
+            samples += pixel.m_sample_count;
+        }
+    EXPECT_EQ(samples, statistics.m_sample_count);
+}
+
+TEST(ImageTileIntegrator, ProgressiveRenderingMatchesUniformSampling) {
+    Point2i resolution(83, 61);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 9;
+    Film expected = Render(resolution, options, 1);
+
+    // A pass of 1 sample per pixel, then passes of 4 up to the limit of 9.
+    options.m_samples_per_pixel = 4;
+    options.m_time_budget_milliseconds = 1e6;
+    options.m_max_samples_per_pixel = 9;
+    ImageTileStatistics statistics;
+    Film film = Render(resolution, options, 3, &statistics);
+    EXPECT_EQ(3u, statistics.m_pass_count);
+    EXPECT_FALSE(statistics.m_is_cut_short);
+    EXPECT_EQ(UInt64(83 * 61 * 9), statistics.m_sample_count);
+    for (Int32 y = 0; y < resolution.m_y; ++y)
+        for (Int32 x = 0; x < resolution.m_x; ++x) {
+            const FilmPixel& a = expected.GetPixel(Point2i(x, y));
+            const FilmPixel& b = film.GetPixel(Point2i(x, y));
+            ASSERT_EQ(9u, b.m_sample_count);
+            // Passes of 1, 4 and 4 samples sum to the bit what one pass of 9 does.
+            ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum) << x << " " << y;
+            ASSERT_EQ(a.m_luminance_m2, b.m_luminance_m2) << x << " " << y;
+        }
+}
+
+TEST(RenderCheckpoint, RestoresOnlyTheRenderItWasTakenFrom) {
+    Point2i resolution(7, 5);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 3;
+    Film film = Render(resolution, options, 2);
+    std::string path = (std::filesystem::temp_directory_path() / "theia_render_checkpoint_test.bin").string();
+    ASSERT_TRUE(RenderCheckpoint::Write(path, 42, resolution, film.GetPixels()));
+
+    Film restored(resolution);
+    EXPECT_FALSE(RenderCheckpoint::Read(path, 43, restored));
+    Film transposed(Point2i(5, 7));
+    EXPECT_FALSE(RenderCheckpoint::Read(path, 42, transposed));
+    EXPECT_EQ(0u, restored.GetPixel(Point2i(3, 2)).m_sample_count);
+    ASSERT_TRUE(RenderCheckpoint::Read(path, 42, restored));
+    for (Int32 y = 0; y < resolution.m_y; ++y)
+        for (Int32 x = 0; x < resolution.m_x; ++x) {
+            const FilmPixel& a = film.GetPixel(Point2i(x, y));
+            const FilmPixel& b = restored.GetPixel(Point2i(x, y));
+            ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum);
+            ASSERT_EQ(a.m_sample_count, b.m_sample_count);
+            ASSERT_EQ(a.m_luminance_m2, b.m_luminance_m2);
+        }
+
+    // A flipped bit in the pixels is caught by the payload hash.
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(100);
+        char byte = char(file.get());
+        file.seekp(100);
+        file.put(char(byte ^ 1));
+    }
+    EXPECT_FALSE(RenderCheckpoint::Read(path, 42, restored));
+    std::filesystem::remove(path);
+}
+
+TEST(ImageTileIntegrator, ResumedRenderMatchesUninterruptedRender) {
+    Point2i resolution(53, 37);
+    std::string path = (std::filesystem::temp_directory_path() / "theia_resume_test.bin").string();
+    // Uniform sampling cancelled in its only pass, adaptive sampling cancelled in its first pass and in a later one.
+    struct Case { Float64 errorThreshold; UInt64 cancelAfter; };
+    for (Case c : { Case{ 0.0, 3000 }, Case{ 0.01, 3000 }, Case{ 0.01, 9000 } }) {
+        ImageTileIntegratorOptions options;
+        options.m_samples_per_pixel = 4;
+        options.m_error_threshold = c.errorThreshold;
+        options.m_max_samples_per_pixel = 32;
+        options.m_tile_size = 8;
+        Film expected = Render(resolution, options, 1);
+
+        options.m_checkpoint_path = path;
+        options.m_checkpoint_interval_milliseconds = 0;
+        options.m_scene_hash = 7;
+        {
+            ThreadPool pool({ 3 });
+            PinholeCamera camera(resolution);
+            Film film(resolution);
+            CancellingIntegrator integrator(camera, film, options, pool, c.cancelAfter);
+            integrator.Integrate();
+            EXPECT_TRUE(integrator.GetStatistics().m_is_cancelled);
+            EXPECT_GE(integrator.GetStatistics().m_checkpoint_count, 1u);
+        }
+
+        // Another scene does not pick up the checkpoint; the same one does, with other threads and tiles.
+        ThreadPool pool({ 2 });
+        PinholeCamera camera(resolution);
+        Film film(resolution);
+        options.m_scene_hash = 8;
+        EXPECT_FALSE(SphereIntegrator(camera, film, options, pool).Resume());
+        options.m_scene_hash = 7;
+        options.m_tile_size = 0;
+        SphereIntegrator integrator(camera, film, options, pool);
+        ASSERT_TRUE(integrator.Resume());
+        EXPECT_FALSE(integrator.GetStatistics().m_is_cancelled);
+        for (Int32 y = 0; y < resolution.m_y; ++y)
+            for (Int32 x = 0; x < resolution.m_x; ++x) {
+                const FilmPixel& a = expected.GetPixel(Point2i(x, y));
+                const FilmPixel& b = film.GetPixel(Point2i(x, y));
+                ASSERT_EQ(a.m_sample_count, b.m_sample_count) << x << " " << y << " cancelled after " << c.cancelAfter;
+                ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum) << x << " " << y;
+                ASSERT_EQ(a.m_luminance_m2, b.m_luminance_m2) << x << " " << y;
+            }
+    }
+    std::filesystem::remove(path);
+}
+
+// Workers of distributed render tests: processes forked from the test where fork exists, so every worker has an address space of its own as on separate machines, and threads elsewhere.
+class WorkerGroup {
+public:
+    // run(i) returns whether worker i succeeded.
+    WorkerGroup(UInt32 count, const std::function<bool(UInt32)>& run) {
+        for (UInt32 i = 0; i < count; ++i) {
+#ifdef _WIN32
+            m_threads.emplace_back([this, run, i] { m_succeeded += run(i) ? 1 : 0; });
+#else
+            pid_t pid = fork();
+            if (pid == 0)
+                _exit(run(i) ? 0 : 1);
+            m_pids.push_back(pid);
+#endif
+        }
+    }
+
+    ~WorkerGroup() { Join(); }
+
+    // Waits for the workers, and returns how many succeeded.
+    UInt32 Join() {
+#ifdef _WIN32
+        for (std::thread& thread : m_threads)
+            if (thread.joinable())
+                thread.join();
+#else
+        for (pid_t pid : m_pids) {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            m_succeeded += WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 1 : 0;
+        }
+        m_pids.clear();
+#endif
+        return m_succeeded;
+    }
+
+private:
+#ifdef _WIN32
+    std::vector<std::thread> m_threads;
+#else
+    std::vector<pid_t> m_pids;
+#endif
+    std::atomic<UInt32> m_succeeded = 0;
+};
+
+// Every field of every pixel, so merged pixels must match exactly rather than just their sums.
+static void ExpectSamePixels(const Film& expected, const Film& film, Point2i resolution) {
+    for (Int32 y = 0; y < resolution.m_y; ++y)
+        for (Int32 x = 0; x < resolution.m_x; ++x) {
+            const FilmPixel& a = expected.GetPixel(Point2i(x, y));
+            const FilmPixel& b = film.GetPixel(Point2i(x, y));
+            ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum) << x << " " << y;
+            ASSERT_EQ(a.m_weight_sum, b.m_weight_sum) << x << " " << y;
+            ASSERT_EQ(a.m_sample_count, b.m_sample_count) << x << " " << y;
+            ASSERT_EQ(a.m_luminance_mean, b.m_luminance_mean) << x << " " << y;
+            ASSERT_EQ(a.m_luminance_m2, b.m_luminance_m2) << x << " " << y;
+        }
+}
+
+TEST(TileCoordinator, WorkerProcessesRenderTheImageOfOneProcess) {
+    Point2i resolution(67, 45);
+    ImageTileIntegratorOptions options;
+    // An odd count, whose mean does not survive being scaled by n / n.
+    options.m_samples_per_pixel = 3;
+    options.m_scene_hash = 3;
+    Film expected = Render(resolution, options, 1);
+
+    ThreadPool pool({ 1 });
+    PinholeCamera camera(resolution);
+    Film film(resolution);
+    SphereIntegrator integrator(camera, film, options, pool);
+    TileCoordinatorOptions coordinatorOptions;
+    coordinatorOptions.m_tile_size = 8;
+    auto coordinator = std::make_unique<TileCoordinator>(film, integrator.GetRenderHash(), coordinatorOptions);
+    UInt16 port = coordinator->GetPort();
+    ASSERT_NE(0, port);
+
+    // Workers with 1, 2 and 3 threads, and one rendering another scene, which is turned away.
+    WorkerGroup workers(4, [&](UInt32 i) {
+        ThreadPool workerPool({ i % 3 + 1 });
+        Film workerFilm(resolution);
+        ImageTileIntegratorOptions workerOptions = options;
+        workerOptions.m_scene_hash = i == 3 ? 4 : 3;
+        SphereIntegrator workerIntegrator(camera, workerFilm, workerOptions, workerPool);
+        return TileWorker(workerIntegrator, workerPool).Run("127.0.0.1", port);
+    });
+    ASSERT_TRUE(coordinator->Render(4));
+    DistributedRenderStatistics statistics = coordinator->GetStatistics();
+    // Workers still connecting are turned away once the coordinator is gone.
+    coordinator.reset();
+    EXPECT_EQ(3u, workers.Join());
+
+    EXPECT_EQ(3u, statistics.m_worker_count);
+    EXPECT_EQ(6u, statistics.m_thread_count);
+    EXPECT_EQ(9u * 6u, statistics.m_tile_count);
+    EXPECT_EQ(0u, statistics.m_reissued_tile_count);
+    EXPECT_EQ(UInt64(67 * 45 * 3), statistics.m_sample_count);
+    EXPECT_GT(statistics.m_efficiency, 0.0);
+    EXPECT_LE(statistics.m_efficiency, 1.01);
+    ExpectSamePixels(expected, film, resolution);
+}
+
+// Stops sending results partway through its tiles for hangMilliseconds, as a hung or stalled machine would.
+class HangingIntegrator : public SphereIntegrator {
+public:
+    HangingIntegrator(const ICamera& camera, Film& film, const ImageTileIntegratorOptions& options, ThreadPool& pool, UInt64 hangAfter, int hangMilliseconds)
+        : SphereIntegrator(camera, film, options, pool), m_hangAfter(hangAfter), m_hangMilliseconds(hangMilliseconds) {}
+
+protected:
+    Vector3f Li(const RayDifferential& ray, RandomNumberGenerator& rng) const override {
+        if (++m_sampleCount == m_hangAfter)
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_hangMilliseconds));
+        return SphereIntegrator::Li(ray, rng);
+    }
+
+private:
+    UInt64 m_hangAfter;
+    int m_hangMilliseconds;
+    mutable std::atomic<UInt64> m_sampleCount = 0;
+};
+
+TEST(TileCoordinator, SilentWorkersTimeOut) {
+    Point2i resolution(67, 45);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 3;
+    Film expected = Render(resolution, options, 1);
+
+    ThreadPool pool({ 1 });
+    PinholeCamera camera(resolution);
+    Film film(resolution);
+    SphereIntegrator integrator(camera, film, options, pool);
+    TileCoordinatorOptions coordinatorOptions;
+    coordinatorOptions.m_tile_size = 8;
+    coordinatorOptions.m_receive_timeout_milliseconds = 500.0;
+    auto coordinator = std::make_unique<TileCoordinator>(film, integrator.GetRenderHash(), coordinatorOptions);
+    UInt16 port = coordinator->GetPort();
+    // The first worker stops within its second tile for far longer than the timeout, while holding 4 tiles.
+    WorkerGroup workers(2, [&](UInt32 i) {
+        ThreadPool workerPool({ 2 });
+        Film workerFilm(resolution);
+        if (i == 0) {
+            HangingIntegrator workerIntegrator(camera, workerFilm, options, workerPool, 250, 3000);
+            return TileWorker(workerIntegrator, workerPool).Run("127.0.0.1", port);
+        }
+        SphereIntegrator workerIntegrator(camera, workerFilm, options, workerPool);
+        return TileWorker(workerIntegrator, workerPool).Run("127.0.0.1", port);
+    });
+    // A peer that connects and never says hello.
+    Socket silent = Socket::Connect("127.0.0.1", port);
+    ASSERT_TRUE(silent.IsOpen());
+    ASSERT_TRUE(coordinator->Render(3));
+    DistributedRenderStatistics statistics = coordinator->GetStatistics();
+    coordinator.reset();
+    EXPECT_EQ(1u, workers.Join());
+
+    EXPECT_EQ(2u, statistics.m_worker_count);
+    EXPECT_GT(statistics.m_reissued_tile_count, 0u);
+    EXPECT_EQ(9u * 6u, statistics.m_tile_count);
+    ExpectSamePixels(expected, film, resolution);
+}
+
+#ifndef _WIN32
+// Ends its worker process partway through its tiles, as a crashed or preempted machine would.
+class ExitingIntegrator : public SphereIntegrator {
+public:
+    ExitingIntegrator(const ICamera& camera, Film& film, const ImageTileIntegratorOptions& options, ThreadPool& pool, UInt64 exitAfter)
+        : SphereIntegrator(camera, film, options, pool), m_exitAfter(exitAfter) {}
+
+protected:
+    Vector3f Li(const RayDifferential& ray, RandomNumberGenerator& rng) const override {
+        if (++m_sampleCount == m_exitAfter)
+            _exit(2);
+        return SphereIntegrator::Li(ray, rng);
+    }
+
+private:
+    UInt64 m_exitAfter;
+    mutable std::atomic<UInt64> m_sampleCount = 0;
+};
+
+TEST(TileCoordinator, TilesOfALostWorkerAreRenderedByTheOthers) {
+    Point2i resolution(67, 45);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 4;
+    Film expected = Render(resolution, options, 1);
+
+    ThreadPool pool({ 1 });
+    PinholeCamera camera(resolution);
+    Film film(resolution);
+    SphereIntegrator integrator(camera, film, options, pool);
+    TileCoordinatorOptions coordinatorOptions;
+    coordinatorOptions.m_tile_size = 8;
+    auto coordinator = std::make_unique<TileCoordinator>(film, integrator.GetRenderHash(), coordinatorOptions);
+    UInt16 port = coordinator->GetPort();
+    // The first worker holds 4 tiles of 256 samples when it exits within its second.
+    WorkerGroup workers(2, [&](UInt32 i) {
+        ThreadPool workerPool({ 2 });
+        Film workerFilm(resolution);
+        if (i == 0) {
+            ExitingIntegrator workerIntegrator(camera, workerFilm, options, workerPool, 300);
+            return TileWorker(workerIntegrator, workerPool).Run("127.0.0.1", port);
+        }
+        SphereIntegrator workerIntegrator(camera, workerFilm, options, workerPool);
+        return TileWorker(workerIntegrator, workerPool).Run("127.0.0.1", port);
+    });
+    ASSERT_TRUE(coordinator->Render(2));
+    DistributedRenderStatistics statistics = coordinator->GetStatistics();
+    coordinator.reset();
+    EXPECT_EQ(1u, workers.Join());
+
+    EXPECT_GT(statistics.m_reissued_tile_count, 0u);
+    EXPECT_EQ(9u * 6u, statistics.m_tile_count);
+    ExpectSamePixels(expected, film, resolution);
+}
+#endif
+
+// Run with --gtest_also_run_disabled_tests to time the tile loop with fixed and adaptive tile sizes on 1 thread and on every hardware thread.
+TEST(ImageTileIntegrator, DISABLED_TileBenchmark) {
+    UInt32 hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (Int32 tileSize : { 8, 16, 64, 0 })
+        for (UInt32 threads : { 1u, hardwareThreads }) {
+            ImageTileIntegratorOptions options;
+            options.m_samples_per_pixel = 16;
+            options.m_tile_size = tileSize;
+            ImageTileStatistics statistics;
+            Render(Point2i(1024, 768), options, threads, &statistics);
+            std::cout << "tile " << tileSize << ", " << threads << " threads: " << statistics.m_render_milliseconds << " ms, "
+                      << statistics.m_sample_count / (statistics.m_render_milliseconds * 1000) << " Msamples/s, " << statistics.m_tile_count
+                      << " tiles of " << statistics.m_min_tile_size << " to " << statistics.m_max_tile_size << std::endl;
+            if (hardwareThreads == 1)
+                break;
+        }
+}
+
+// Grey floor, red back wall and a wavy mirror on the right, lit by two point lights, in front of the pinhole camera.
+struct RoomScene {
+    explicit RoomScene(int gridSize) {
+        meshes.push_back(GridMesh(gridSize, Translate(Vector3f(0, -1, 4)) * Scale(Vector3f(3, 1, 3)), 0));
+        meshes.push_back(GridMesh(gridSize, Translate(Vector3f(0, 0, 6)) * RotateXAxis(-Pi / 2) * Scale(Vector3f(3, 1, 3)), 0));
+        meshes.push_back(GridMesh(gridSize, Translate(Vector3f(2, 0, 4)) * RotateZAxis(Pi / 2) * Scale(Vector3f(1, 1, 1.5f)), 0.2f));
+        std::vector<size_t> firstTriangle;
+        for (const std::unique_ptr<TriangleMesh>& mesh : meshes) {
+            firstTriangle.push_back(triangles.size());
+            std::vector<Triangle> meshTriangles = Triangle::CreateTriangles(mesh.get());
+            triangles.insert(triangles.end(), meshTriangles.begin(), meshTriangles.end());
+        }
+        firstTriangle.push_back(triangles.size());
+
+        scene.m_materials = { SurfaceMaterial{ MaterialType::Diffuse, Vector3f(0.7f, 0.7f, 0.7f) }, SurfaceMaterial{ MaterialType::Diffuse, Vector3f(0.7f, 0.2f, 0.2f) },
+                              SurfaceMaterial{ MaterialType::Mirror, Vector3f(0.9f, 0.9f, 0.9f) } };
+        std::vector<Primitive> primitives;
+        for (UInt32 material = 0; material < meshes.size(); ++material)
+            for (size_t i = firstTriangle[material]; i < firstTriangle[material + 1]; ++i) {
+                primitives.push_back(&triangles[i]);
+                scene.m_primitive_materials[&triangles[i]] = material;
+            }
+        bvh = std::make_unique<BVHAggregate>(primitives);
+        scene.m_aggregate = bvh.get();
+        scene.m_lights = { PointLight{ Point3f(0, 2.5f, 3), Vector3f(8, 8, 8) }, PointLight{ Point3f(-2, 0, 2), Vector3f(3, 4, 6) } };
+        scene.m_environment = Vector3f(0.1f, 0.1f, 0.2f);
+    }
+
+    std::vector<std::unique_ptr<TriangleMesh>> meshes;
+    std::vector<Triangle> triangles;
+    std::unique_ptr<BVHAggregate> bvh;
+    PathTracingScene scene;
+};
+
+static Film RenderDepthFirst(const PathTracingScene& scene, Point2i resolution, UInt32 samplesPerPixel, UInt32 maxDepth, UInt32 threads, ImageTileStatistics* statistics = nullptr) {
+    ThreadPool pool({ threads });
+    PinholeCamera camera(resolution);
+    Film film(resolution);
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = samplesPerPixel;
+    PathIntegrator integrator(camera, film, scene, maxDepth, options, pool);
+    integrator.Integrate();
+    if (statistics)
+        *statistics = integrator.GetStatistics();
+    return film;
+}
+
+static Film RenderWavefront(const PathTracingScene& scene, Point2i resolution, const WavefrontPathIntegratorOptions& options, UInt32 threads, WavefrontStatistics* statistics = nullptr) {
+    ThreadPool pool({ threads });
+    PinholeCamera camera(resolution);
+    Film film(resolution);
+    WavefrontPathIntegrator integrator(camera, film, scene, options, pool);
+    integrator.Integrate();
+    if (statistics)
+        *statistics = integrator.GetStatistics();
+    return film;
+}
+
+TEST(PathIntegrator, HitsReportTheirPrimitive) {
+    RoomScene room(4);
+    // Straight down onto the floor at (0.1, -1, 4.1).
+    Ray ray(Point3f(0.1f, 1, 4.1f), Vector3f(0, -1, 0));
+    std::optional<ShapeIntersection> hit = room.bvh->Intersect(ray);
+    ASSERT_TRUE(hit.has_value());
+    ASSERT_NE(nullptr, hit->m_primitive);
+    EXPECT_TRUE(hit->m_primitive->Intersect(ray).has_value());
+    EXPECT_EQ(0u, room.scene.GetMaterialIndex(*hit));
+
+    std::vector<Ray> rays(64, Ray(Point3f(0, 0, 0), Vector3f(0.02f, 0, 1)));
+    std::vector<std::optional<ShapeIntersection>> hits(rays.size());
+    room.bvh->Intersect(rays, hits, BVHTraversal::Packet);
+    ASSERT_TRUE(hits[0].has_value());
+    EXPECT_EQ(1u, room.scene.GetMaterialIndex(*hits[0]));
+}
+
+TEST(PathIntegrator, TessellatedPatchesKeepTheirMaterial) {
+    // A bumpy red floor of 6 x 6 B-spline patches below the camera.
+    std::vector<Point3f> controlPoints;
+    for (int z = -1; z <= 7; ++z)
+        for (int x = -1; x <= 7; ++x)
+            controlPoints.push_back(Point3f(x - 3.0f, -1 + 0.1f * std::sin(Float(x + z)), Float(z)));
+    std::vector<BSplinePatch> patches = BSplinePatch::CreatePatches(Transform(), controlPoints, 9, 9);
+    // A zero budget keeps only the newest grid, so grids are evicted while other threads still trace them. Coarse grids keep retessellating cheap.
+    GeometryCacheOptions cacheOptions;
+    cacheOptions.m_budget_bytes = 0;
+    cacheOptions.m_max_rate = 4;
+    Point2i resolution(48, 36);
+    Vector3f dx(2 * Float(resolution.m_x) / resolution.m_y / resolution.m_x, 0, 1), dy(0, -2.0f / resolution.m_y, 1);
+    GeometryCache cache(RayDifferential(Ray(Point3f(0, 0, 0), Vector3f(0, 0, 1)), Point3f(0, 0, 0), Normalize(dx), Point3f(0, 0, 0), Normalize(dy)), cacheOptions);
+    std::vector<TessellatedPatch> lazyPatches;
+    for (const BSplinePatch& patch : patches)
+        lazyPatches.emplace_back(&patch, &cache, [](const Point3f& p, const Point2f&) { return 0.02f * std::sin(20 * p.m_x); }, 0.02f);
+    BVHAggregate bvh(Primitives(lazyPatches));
+
+    PathTracingScene scene;
+    scene.m_aggregate = &bvh;
+    scene.m_materials.push_back(SurfaceMaterial{ MaterialType::Diffuse, Vector3f(0.8f, 0.1f, 0.1f) });
+    for (const TessellatedPatch& patch : lazyPatches)
+        scene.m_primitive_materials[&patch] = 1;
+    scene.m_lights = { PointLight{ Point3f(0, 2, 3), Vector3f(8, 8, 8) } };
+
+    Film film = RenderDepthFirst(scene, resolution, 1, 2, 4);
+    EXPECT_GT(cache.GetStatistics().m_eviction_count, 0u);
+    int floorPixels = 0;
+    for (Int32 y = resolution.m_y / 2; y < resolution.m_y; ++y)
+        for (Int32 x = 1; x < resolution.m_x; ++x) {
+            Vector3f rgb = film.GetPixelRGB(Point2i(x, y));
+            if (rgb.m_x > 0) {
+                EXPECT_GT(rgb.m_x, 4 * rgb.m_y) << x << " " << y;
+                ++floorPixels;
+            }
+        }
+    EXPECT_GT(floorPixels, resolution.m_x * resolution.m_y / 4);
+}
+
+TEST(WavefrontPathIntegrator, MatchesDepthFirstPathTracing) {
+    RoomScene room(6);
+    Point2i resolution(48, 36);
+    Film expected = RenderDepthFirst(room.scene, resolution, 4, 5, 1);
+    // The red wall is lit, and the mirror on the right reflects it.
+    Vector3f wall = expected.GetPixelRGB(Point2i(24, 17));
+    EXPECT_GT(wall.m_x, 2 * wall.m_y);
+    EXPECT_GT(expected.GetPixelRGB(Point2i(40, 18)).m_x, 0.0f);
+
+    struct { UInt32 waveSize, batchSize, threads; bool sortRays; } configurations[] = { { 1u << 18, 4096, 1, false }, { 1000, 64, 3, false }, { 333, 17, 4, false }, { 1u << 18, 4096, 1, true }, { 1000, 64, 3, true } };
+    for (const auto& configuration : configurations) {
+        WavefrontPathIntegratorOptions options;
+        options.m_samples_per_pixel = 4;
+        options.m_max_depth = 5;
+        options.m_wave_size = configuration.waveSize;
+        options.m_batch_size = configuration.batchSize;
+        options.m_sort_rays = configuration.sortRays;
+        WavefrontStatistics statistics;
+        Film film = RenderWavefront(room.scene, resolution, options, configuration.threads, &statistics);
+
+        UInt64 samples = 48 * 36 * 4;
+        EXPECT_EQ(samples, statistics.m_sample_count);
+        UInt64 waveSize = std::min<UInt64>(options.m_wave_size, samples);
+        EXPECT_EQ((samples + waveSize - 1) / waveSize, statistics.m_wave_count);
+        EXPECT_GT(statistics.m_ray_count, samples);
+        EXPECT_GT(statistics.m_shadow_ray_count, 0u);
+        for (Int32 y = 0; y < resolution.m_y; ++y)
+            for (Int32 x = 0; x < resolution.m_x; ++x) {
+                const FilmPixel& a = expected.GetPixel(Point2i(x, y));
+                const FilmPixel& b = film.GetPixel(Point2i(x, y));
+                ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum) << x << " " << y << " wave " << configuration.waveSize;
+                ASSERT_EQ(a.m_weight_sum, b.m_weight_sum);
+            }
+    }
+}
+
+TEST(PathIntegrator, ImageIsBitIdenticalOnAnyThreadCount) {
+    RoomScene room(6);
+    Point2i resolution(40, 30);
+    PinholeCamera camera(resolution);
+    auto render = [&](const ImageTileIntegratorOptions& options, UInt32 threads) {
+        ThreadPool pool({ threads });
+        Film film(resolution);
+        PathIntegrator integrator(camera, film, room.scene, 5, options, pool);
+        integrator.Integrate();
+        return film;
+    };
+    auto expectIdentical = [&](const Film& expected, const Film& film, const char* name, UInt32 threads) {
+        for (Int32 y = 0; y < resolution.m_y; ++y)
+            for (Int32 x = 0; x < resolution.m_x; ++x) {
+                const FilmPixel& a = expected.GetPixel(Point2i(x, y));
+                const FilmPixel& b = film.GetPixel(Point2i(x, y));
+                ASSERT_EQ(a.m_sample_count, b.m_sample_count) << name << " " << threads << " threads " << x << " " << y;
+                ASSERT_EQ(a.m_rgb_sum, b.m_rgb_sum) << name << " " << threads << " threads " << x << " " << y;
+                ASSERT_EQ(a.m_weight_sum, b.m_weight_sum);
+                ASSERT_EQ(a.m_luminance_m2, b.m_luminance_m2);
+            }
+    };
+
+    ImageTileIntegratorOptions uniform;
+    uniform.m_samples_per_pixel = 4;
+    uniform.m_tile_size = 7;
+    ImageTileIntegratorOptions adaptive = uniform;
+    adaptive.m_error_threshold = 0.05;
+    adaptive.m_max_samples_per_pixel = 16;
+    for (ImageTileIntegratorOptions options : { uniform, adaptive }) {
+        const char* name = options.m_error_threshold > 0 ? "adaptive" : "uniform";
+        Film expected = render(options, 1);
+        options.m_tile_size = 0;
+        for (UInt32 threads : { 2u, 7u, 128u })
+            expectIdentical(expected, render(options, threads), name, threads);
+    }
+
+    Film expected = render(uniform, 1);
+    WavefrontPathIntegratorOptions wavefront;
+    wavefront.m_samples_per_pixel = 4;
+    wavefront.m_max_depth = 5;
+    wavefront.m_wave_size = 1000;
+    wavefront.m_batch_size = 64;
+    wavefront.m_sort_rays = true;
+    expectIdentical(expected, RenderWavefront(room.scene, resolution, wavefront, 128), "wavefront", 128);
+}
+
+// Run with --gtest_also_run_disabled_tests to compare samples per second of the depth-first and the wavefront path tracer on a scene of 180,000 triangles, and to print the time of every wavefront stage.
+TEST(WavefrontPathIntegrator, DISABLED_WavefrontBenchmark) {
+    RoomScene room(173);
+    Point2i resolution(640, 480);
+    UInt32 threads = std::max(1u, std::thread::hardware_concurrency());
+    ImageTileStatistics tileStatistics;
+    RenderDepthFirst(room.scene, resolution, 8, 5, threads, &tileStatistics);
+    std::cout << "depth first, " << threads << " threads: " << tileStatistics.m_render_milliseconds << " ms, "
+              << tileStatistics.m_sample_count / (tileStatistics.m_render_milliseconds * 1000) << " Msamples/s" << std::endl;
+
+    for (UInt32 waveSize : { 1u << 16, 1u << 18, 1u << 20 })
+        for (bool sortRays : { false, true }) {
+            WavefrontPathIntegratorOptions options;
+            options.m_samples_per_pixel = 8;
+            options.m_wave_size = waveSize;
+            options.m_sort_rays = sortRays;
+            WavefrontStatistics statistics;
+            RenderWavefront(room.scene, resolution, options, threads, &statistics);
+            std::cout << "wavefront, waves of " << waveSize << (sortRays ? ", sorted" : "") << ": " << statistics.m_render_milliseconds << " ms, "
+                      << statistics.m_sample_count / (statistics.m_render_milliseconds * 1000) << " Msamples/s; camera " << statistics.m_camera_milliseconds << ", sort " << statistics.m_sort_milliseconds
+                      << ", intersect " << statistics.m_intersect_milliseconds << ", queues " << statistics.m_queue_milliseconds << ", shade "
+                      << statistics.m_shade_milliseconds << ", shadow " << statistics.m_shadow_milliseconds << ", film " << statistics.m_film_milliseconds
+                      << " ms; " << statistics.m_ray_count << " rays, " << statistics.m_shadow_ray_count << " shadow rays" << std::endl;
+        }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare adaptive sampling with uniform sampling at the same average samples per pixel: the time taken and the pixels left above the error threshold.
+TEST(ImageTileIntegrator, DISABLED_AdaptiveSamplingBenchmark) {
+    RoomScene room(40);
+    Point2i resolution(320, 240);
+    UInt32 threads = std::max(1u, std::thread::hardware_concurrency());
+    ThreadPool pool({ threads });
+    PinholeCamera camera(resolution);
+    auto render = [&](const ImageTileIntegratorOptions& options, const char* name) {
+        Film film(resolution);
+        PathIntegrator integrator(camera, film, room.scene, 5, options, pool);
+        integrator.Integrate();
+        const ImageTileStatistics& statistics = integrator.GetStatistics();
+        UInt64 above = 0;
+        for (Int32 y = 0; y < resolution.m_y; ++y)
+            for (Int32 x = 0; x < resolution.m_x; ++x)
+                above += film.GetRelativeStandardError(Point2i(x, y), 0.01) > 0.02 ? 1 : 0;
+        std::cout << name << ": " << statistics.m_render_milliseconds << " ms, " << Float64(statistics.m_sample_count) / resolution.m_x / resolution.m_y
+                  << " samples per pixel, " << statistics.m_pass_count << " adaptive passes, " << above << " pixels above the threshold" << std::endl;
+        return statistics.m_sample_count;
+    };
+
+    ImageTileIntegratorOptions adaptive;
+    adaptive.m_samples_per_pixel = 16;
+    adaptive.m_error_threshold = 0.02;
+    adaptive.m_max_samples_per_pixel = 1024;
+    UInt64 samples = render(adaptive, "adaptive");
+    ImageTileIntegratorOptions uniform;
+    uniform.m_samples_per_pixel = UInt32(std::ceil(Float64(samples) / resolution.m_x / resolution.m_y));
+    render(uniform, "uniform");
+}
+
+// Run with --gtest_also_run_disabled_tests to see how close progressive rendering of the room scene comes to time budgets from a quarter of a second to several seconds.
+TEST(ImageTileIntegrator, DISABLED_ProgressiveBudgetBenchmark) {
+    RoomScene room(40);
+    Point2i resolution(320, 240);
+    ThreadPool pool({ std::max(1u, std::thread::hardware_concurrency()) });
+    PinholeCamera camera(resolution);
+    for (Float64 budget : { 250.0, 1000.0, 4000.0 }) {
+        Film film(resolution);
+        ImageTileIntegratorOptions options;
+        options.m_samples_per_pixel = 8;
+        options.m_time_budget_milliseconds = budget;
+        PathIntegrator integrator(camera, film, room.scene, 5, options, pool);
+        integrator.Integrate();
+        const ImageTileStatistics& statistics = integrator.GetStatistics();
+        std::cout << "budget " << budget << " ms: rendered in " << statistics.m_render_milliseconds << " ms, "
+                  << Float64(statistics.m_sample_count) / resolution.m_x / resolution.m_y << " samples per pixel in " << statistics.m_pass_count << " passes"
+                  << (statistics.m_is_cut_short ? ", last pass cut short" : "") << std::endl;
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to render the room scene with 1 to THEIA_DISTRIBUTED_BENCHMARK_MAX_WORKERS worker processes of one thread each (default: every hardware thread), and report the speedup and scaling efficiency over one worker.
+TEST(TileCoordinator, DISABLED_DistributedScalingBenchmark) {
+    RoomScene room(40);
+    Point2i resolution(320, 240);
+    UInt32 maxWorkers = std::getenv("THEIA_DISTRIBUTED_BENCHMARK_MAX_WORKERS") ? UInt32(std::atoi(std::getenv("THEIA_DISTRIBUTED_BENCHMARK_MAX_WORKERS"))) : std::max(1u, std::thread::hardware_concurrency());
+    ImageTileIntegratorOptions options;
+    options.m_samples_per_pixel = 16;
+    PinholeCamera camera(resolution);
+    Float64 singleMilliseconds = 0;
+    for (UInt32 workerCount = 1; workerCount <= maxWorkers; workerCount *= 2) {
+        ThreadPool pool({ 1 });
+        Film film(resolution);
+        PathIntegrator integrator(camera, film, room.scene, 5, options, pool);
+        auto coordinator = std::make_unique<TileCoordinator>(film, integrator.GetRenderHash());
+        UInt16 port = coordinator->GetPort();
+        // Workers share the scene of the test, copied on write.
+        WorkerGroup workers(workerCount, [&](UInt32) {
+            ThreadPool workerPool({ 1 });
+            Film workerFilm(resolution);
+            PathIntegrator workerIntegrator(camera, workerFilm, room.scene, 5, options, workerPool);
+            return TileWorker(workerIntegrator, workerPool).Run("127.0.0.1", port);
+        });
+        bool isRendered = coordinator->Render(workerCount);
+        DistributedRenderStatistics statistics = coordinator->GetStatistics();
+        coordinator.reset();
+        workers.Join();
+        ASSERT_TRUE(isRendered);
+
+        if (workerCount == 1)
+            singleMilliseconds = statistics.m_render_milliseconds;
+        Float64 speedup = singleMilliseconds / statistics.m_render_milliseconds;
+        std::cout << workerCount << " workers: " << statistics.m_render_milliseconds << " ms, speedup " << speedup << ", scaling efficiency " << speedup / workerCount
+                  << ", busy threads " << statistics.m_efficiency << ", " << statistics.m_tile_count << " tiles, " << Float64(statistics.m_received_bytes) / (1 << 20) << " MB received" << std::endl;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,445 @@
+#include "../ext/gtest/gtest.h"
+
+#include "../Math/Math.h"
+#include "../Shape/Triangle.h"
+#include "../Accelerator/BVHAggregate.h"
+#include "../Scene/PBRTParser.h"
+#include "../Scene/SceneCache.h"
+#include "test_helpers.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+using namespace Theia;
+
+static void ExpectSameIntersections(const BVHAggregate& expected, const BVHAggregate& actual, int rayCount) {
+    RNG rng(38);
+    for (int i = 0; i < rayCount; ++i) {
+        Point3f origin(2 * rng.Uniform<Float>() - 1, 1, 2 * rng.Uniform<Float>() - 1);
+        Ray ray(origin, RandomDirection(rng) - Vector3f(0, 1.5f, 0));
+        std::optional<ShapeIntersection> a = expected.Intersect(ray), b = actual.Intersect(ray);
+        ASSERT_EQ(a.has_value(), b.has_value());
+        if (a) {
+            EXPECT_EQ(a->m_t_hit, b->m_t_hit);
+        }
+    }
+}
+
+TEST(SceneCache, RoundTripsMeshesBVHsAndInstances) {
+    std::string path = TemporaryPath("theia_scene_cache_round_trip.bin");
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(40);
+    std::vector<Triangle> waveTriangles = Triangle::CreateTriangles(wave.get());
+    BVHBuildOptions options;
+    options.m_split_method = BVHSplitMethod::SpatialSAH;
+    options.m_leaf_format = BVHLeafFormat::Packed4;
+    BVHAggregate waveBvh(Primitives(waveTriangles), options);
+
+    // Clustered and compressed meshes are saved decoded.
+    std::unique_ptr<TriangleMesh> compressed = WaveMesh(20, Translate(Vector3f(3, 0, 0)));
+    compressed->BuildMeshlets();
+    compressed->Compress();
+
+    std::vector<SceneCacheMesh> meshes = { { wave.get(), &waveBvh }, { compressed.get() } };
+    std::vector<SceneCacheInstance> instances = { { 0, Transform() }, { 1, Translate(Vector3f(0, 2, 0)) }, { 0, RotateYAxis(30) } };
+    ASSERT_TRUE(SceneCache::Write(path, 42, meshes, instances));
+
+    std::unique_ptr<SceneCache> cache = SceneCache::Open(path, 42, true);
+    ASSERT_TRUE(cache != nullptr);
+    ASSERT_EQ(2u, cache->GetMeshCount());
+    for (UInt32 m = 0; m < 2; ++m) {
+        const TriangleMesh* original = meshes[m].m_mesh;
+        const TriangleMesh* cached = cache->GetMesh(m);
+        ASSERT_EQ(original->VertexCount(), cached->VertexCount());
+        ASSERT_EQ(original->TriangleCount(), cached->TriangleCount());
+        ASSERT_TRUE(cached->HasNormals() && cached->HasUVs());
+        // The mesh views the mapped file instead of owning a copy.
+        EXPECT_EQ(sizeof(TriangleMesh), cached->MemoryBytes());
+        for (UInt32 v = 0; v < original->VertexCount(); ++v) {
+            EXPECT_EQ(original->Position(v), cached->Position(v));
+            EXPECT_EQ(original->Normal(v), cached->Normal(v));
+            EXPECT_EQ(original->UV(v), cached->UV(v));
+        }
+        for (UInt32 t = 0; t < original->TriangleCount(); ++t) {
+            const Meshlet* meshlet = original->FindMeshlet(t);
+            EXPECT_EQ(original->TriangleVertices(t, meshlet ? meshlet->m_vertex_offset : 0), cached->TriangleVertices(t, 0));
+        }
+        EXPECT_EQ(original->TriangleCount(), cache->GetTriangles(m).size());
+    }
+    EXPECT_TRUE(cache->GetBVH(1) == nullptr);
+
+    const BVHAggregate* cachedBvh = cache->GetBVH(0);
+    ASSERT_TRUE(cachedBvh != nullptr);
+    EXPECT_EQ(waveBvh.GetStatistics().m_node_count, cachedBvh->GetStatistics().m_node_count);
+    EXPECT_EQ(waveBvh.GetStatistics().m_reference_count, cachedBvh->GetStatistics().m_reference_count);
+    EXPECT_EQ(waveBvh.GetStatistics().m_spatial_split_count, cachedBvh->GetStatistics().m_spatial_split_count);
+    EXPECT_EQ(waveBvh.GetStatistics().m_memory_bytes, cachedBvh->GetStatistics().m_memory_bytes);
+    EXPECT_FLOAT_EQ(waveBvh.GetStatistics().m_sah_cost, cachedBvh->GetStatistics().m_sah_cost);
+    ExpectSameIntersections(waveBvh, *cachedBvh, 2000);
+
+    ASSERT_EQ(instances.size(), cache->GetInstances().size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        EXPECT_EQ(instances[i].m_mesh_index, cache->GetInstances()[i].m_mesh_index);
+        EXPECT_TRUE(instances[i].m_render_from_object.GetMatrix() == cache->GetInstances()[i].m_render_from_object.GetMatrix());
+        EXPECT_TRUE(instances[i].m_render_from_object.GetInverseMatrix() == cache->GetInstances()[i].m_render_from_object.GetInverseMatrix());
+    }
+
+    cache.reset();
+    std::filesystem::remove(path);
+}
+
+TEST(SceneCache, RejectsStaleAndDamagedFiles) {
+    std::string path = TemporaryPath("theia_scene_cache_damaged.bin");
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(8);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(wave.get());
+    BVHAggregate bvh(Primitives(triangles));
+    std::vector<SceneCacheMesh> meshes = { { wave.get(), &bvh } };
+    ASSERT_TRUE(SceneCache::Write(path, 7, meshes));
+    EXPECT_TRUE(SceneCache::Open(path, 7, true) != nullptr);
+
+    // Other sources, or no file at all.
+    EXPECT_TRUE(SceneCache::Open(path, 8) == nullptr);
+    EXPECT_TRUE(SceneCache::Open(TemporaryPath("theia_scene_cache_missing.bin"), 7) == nullptr);
+
+    std::vector<char> bytes(std::filesystem::file_size(path));
+    std::ifstream(path, std::ios::binary).read(bytes.data(), bytes.size());
+    auto writeBytes = [&](const std::vector<char>& contents) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(contents.data(), contents.size());
+    };
+
+    // Another version of the format.
+    std::vector<char> otherVersion = bytes;
+    otherVersion[8] ^= 0x7F;
+    writeBytes(otherVersion);
+    EXPECT_TRUE(SceneCache::Open(path, 7) == nullptr);
+
+    // Truncated, e.g. by a full disk.
+    writeBytes(std::vector<char>(bytes.begin(), bytes.end() - 64));
+    EXPECT_TRUE(SceneCache::Open(path, 7) == nullptr);
+
+    // A flipped bit in the vertex data is only caught by verifying the payload.
+    std::vector<char> corrupted = bytes;
+    corrupted[bytes.size() / 2] ^= 0x10;
+    writeBytes(corrupted);
+    EXPECT_TRUE(SceneCache::Open(path, 7) != nullptr);
+    EXPECT_TRUE(SceneCache::Open(path, 7, true) == nullptr);
+
+    std::filesystem::remove(path);
+}
+
+TEST(SceneCache, HashFilesFollowsContents) {
+    std::string path = TemporaryPath("theia_scene_cache_source.txt");
+    std::ofstream(path) << "Shape \"trianglemesh\"";
+    std::optional<UInt64> hash = SceneCache::HashFiles(std::vector<std::string>{ path });
+    ASSERT_TRUE(hash.has_value());
+    EXPECT_EQ(hash, SceneCache::HashFiles(std::vector<std::string>{ path }));
+
+    std::ofstream(path) << "Shape \"trianglemesh\" ";
+    EXPECT_NE(hash, SceneCache::HashFiles(std::vector<std::string>{ path }));
+    EXPECT_FALSE(SceneCache::HashFiles(std::vector<std::string>{ path, TemporaryPath("theia_scene_cache_missing.txt") }).has_value());
+    std::filesystem::remove(path);
+}
+
+// Run with --gtest_also_run_disabled_tests to compare building a scene with
+// opening its cache.
+TEST(SceneCache, DISABLED_StartupBenchmark) {
+    std::string path = TemporaryPath("theia_scene_cache_benchmark.bin");
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(1500);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(wave.get());
+    BVHBuildOptions options;
+    options.m_split_method = BVHSplitMethod::SpatialSAH;
+    BVHAggregate bvh(Primitives(triangles), options);
+    double buildSeconds = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<SceneCacheMesh> meshes = { { wave.get(), &bvh } };
+    ASSERT_TRUE(SceneCache::Write(path, 1, meshes));
+    double writeSeconds = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    std::unique_ptr<SceneCache> cache = SceneCache::Open(path, 1);
+    ASSERT_TRUE(cache != nullptr);
+    double openSeconds = seconds(start);
+    start = std::chrono::steady_clock::now();
+    ExpectSameIntersections(bvh, *cache->GetBVH(0), 100000);
+    double traceSeconds = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(SceneCache::Open(path, 1, true) != nullptr);
+    double verifiedOpenSeconds = seconds(start);
+
+    std::cout << wave->TriangleCount() << " triangles, cache " << std::filesystem::file_size(path) / (1024.0 * 1024.0) << " MiB" << std::endl;
+    std::cout << "build " << buildSeconds << " s, write " << writeSeconds << " s, open " << openSeconds << " s, open with verification " << verifiedOpenSeconds
+              << " s, first 100k rays on both " << traceSeconds << " s" << std::endl;
+    cache.reset();
+    std::filesystem::remove(path);
+}
+
+static void WriteFile(const std::filesystem::path& path, const std::string& contents) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
+
+// Writes the test scene into directory. With useImport the nested files are
+// imported, otherwise they are included in attribute blocks, which isolates
+// their graphics state the same way.
+static std::string WriteTestScene(const std::filesystem::path& directory, bool useImport) {
+    std::filesystem::create_directories(directory);
+    auto nested = [&](const char* name) {
+        return useImport ? std::string("Import \"") + name + "\"\n"
+                         : std::string("AttributeBegin\nInclude \"") + name + "\"\nAttributeEnd\n";
+    };
+    WriteFile(directory / "main.pbrt",
+        "# Test scene\n"
+        "LookAt 0 0 -5  0 0 0  0 1 0\n"
+        "Camera \"perspective\" \"float fov\" [ 45 ]\n"
+        "Film \"rgb\" \"integer xresolution\" [ 64 ] \"integer yresolution\" 48 \"string filename\" \"out.exr\"\n"
+        "Sampler \"halton\" \"integer pixelsamples\" 16\n"
+        "WorldBegin\n"
+        "LightSource \"infinite\" \"rgb L\" [ 0.5 0.5 0.5 ]\n"
+        "Attribute \"shape\" \"float alpha\" 0.5\n"
+        "Material \"diffuse\" \"rgb reflectance\" [ 0.8 0.2 0.2 ]\n"
+        "AttributeBegin\n"
+        "  Translate 0 0 3\n"
+        "  Rotate 90 0 1 0\n"
+        "  Shape \"sphere\" \"float radius\" 0.5 \"float alpha\" 1\n"
+        "AttributeEnd\n" +
+        nested("a.pbrt") + nested("b.pbrt"));
+    WriteFile(directory / "a.pbrt",
+        "MakeNamedMaterial \"metal\" \"string type\" \"conductor\"\n"
+        "Material \"dielectric\"\n"
+        "Texture \"checks\" \"spectrum\" \"checkerboard\" \"float uscale\" 4\n"
+        "AttributeBegin\n"
+        "  AreaLightSource \"diffuse\" \"blackbody L\" 6500\n"
+        "  ConcatTransform [ 1 0 0 0  0 1 0 0  0 0 1 0  2 0 0 1 ]\n"
+        "  Shape \"trianglemesh\" \"point3 P\" [ -0.5 -0.5 0  0.5 -0.5 0  0.5 0.5 0  -0.5 0.5 0 ]\n"
+        "    \"integer indices\" [ 0 1 2 0 2 3 ] \"point2 uv\" [ 0 0 1 0 1 1 0 1 ]\n"
+        "AttributeEnd\n" +
+        nested("c.pbrt"));
+    WriteFile(directory / "c.pbrt",
+        "NamedMaterial \"metal\"\n"
+        "Shape \"plymesh\" \"string filename\" \"quad.ply\"\n");
+    WriteFile(directory / "quad.ply",
+        "ply\nformat ascii 1.0\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\n"
+        "element face 1\nproperty list uchar int vertex_indices\nend_header\n"
+        "3.5 -0.5 1\n4.5 -0.5 1\n4.5 0.5 1\n3.5 0.5 1\n4 0 1 2 3\n");
+    WriteFile(directory / "b.pbrt",
+        "ObjectBegin \"tree\"\n"
+        "  Shape \"disk\" \"float radius\" 0.25\n"
+        "  Shape \"curve\" \"point3 P\" [ 0 0 0  0 0.1 0  0 0.2 0  0 0.3 0 ] \"float width\" 0.01\n"
+        "ObjectEnd\n"
+        "AttributeBegin\n  Translate -2 0 0\n  ObjectInstance \"tree\"\nAttributeEnd\n"
+        "AttributeBegin\n  Translate -3 0 0\n  ObjectInstance \"tree\"\nAttributeEnd\n"
+        "Shape \"loopsubdiv\" \"point3 P\" [ 0 0 0 1 0 0 0 1 0 ] \"integer indices\" [ 0 1 2 ]\n");
+    return (directory / "main.pbrt").string();
+}
+
+TEST(PBRTParser, ParsesDirectivesTransformsAndShapes) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "theia_pbrt_test";
+    PBRTParseOptions options;
+    options.m_thread_count = 4;
+    PBRTParseResult result = ParsePBRT(WriteTestScene(directory, true), options);
+    ASSERT_TRUE(result.m_scene != nullptr) << result.m_error;
+    const PBRTScene& scene = *result.m_scene;
+
+    EXPECT_EQ("perspective", scene.m_camera.m_type);
+    EXPECT_EQ(45, scene.m_camera.m_parameters.GetFloat("fov", 90));
+    Point3f eye = scene.m_camera.m_render_from_object(Point3f(0, 0, 0));
+    Vector3f forward = scene.m_camera.m_render_from_object(Vector3f(0, 0, 1));
+    EXPECT_NEAR(-5, eye.m_z, 1e-5f);
+    EXPECT_NEAR(1, forward.m_z, 1e-5f);
+    EXPECT_EQ(64, scene.m_film.m_parameters.GetInteger("xresolution", 0));
+    EXPECT_EQ(48, scene.m_film.m_parameters.GetInteger("yresolution", 0));
+    EXPECT_EQ("out.exr", scene.m_film.m_parameters.GetString("filename", ""));
+    EXPECT_EQ("halton", scene.m_sampler.m_type);
+    EXPECT_EQ("volpath", scene.m_integrator.m_type);
+
+    ASSERT_EQ(1u, scene.m_lights.size());
+    EXPECT_EQ(3u, scene.m_lights[0].m_parameters.Find("L")->m_floats.size());
+    ASSERT_EQ(3u, scene.m_materials.size());
+    EXPECT_EQ("diffuse", scene.m_materials[1].m_type);
+    EXPECT_EQ("dielectric", scene.m_materials[2].m_type);
+    ASSERT_EQ(1u, scene.m_named_materials.size());
+    EXPECT_EQ("conductor", scene.m_named_materials[0].m_type);
+    ASSERT_EQ(1u, scene.m_spectrum_textures.size());
+    EXPECT_EQ("checks", scene.m_spectrum_textures[0].m_name);
+    ASSERT_EQ(1u, scene.m_area_lights.size());
+    EXPECT_EQ(6500, scene.m_area_lights[0].m_parameters.GetFloat("L", 0));
+
+    // Shapes of each file come before those of the files it imports.
+    ASSERT_EQ(4u, scene.m_shapes.size());
+    const char* types[] = { "sphere", "trianglemesh", "plymesh", "loopsubdiv" };
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(types[i], scene.m_shapes[i].m_entity.m_type);
+    EXPECT_EQ(1, scene.m_shapes[0].m_material_index);
+    EXPECT_EQ(1, scene.m_shapes[0].m_entity.m_parameters.GetFloat("alpha", 0));
+    EXPECT_EQ(0.5f, scene.m_shapes[1].m_entity.m_parameters.GetFloat("alpha", 0));
+    EXPECT_EQ(2, scene.m_shapes[1].m_material_index);
+    EXPECT_EQ(0, scene.m_shapes[1].m_area_light_index);
+    EXPECT_EQ(-1, scene.m_shapes[2].m_material_index);
+    EXPECT_EQ("metal", scene.m_shapes[2].m_material_name);
+    EXPECT_EQ(-1, scene.m_shapes[2].m_area_light_index);
+    EXPECT_EQ(1, scene.m_shapes[3].m_material_index);
+    EXPECT_TRUE(scene.m_shapes[3].m_geometry == nullptr);
+    EXPECT_EQ(2u, scene.m_shapes[1].m_geometry->m_triangles.size());
+    EXPECT_TRUE(scene.m_shapes[1].m_geometry->m_triangle_mesh->HasUVs());
+    ASSERT_EQ(1u, scene.m_warnings.size());
+    EXPECT_NE(std::string::npos, scene.m_warnings[0].find("b.pbrt:13: Shape \"loopsubdiv\" is not supported"));
+
+    ASSERT_EQ(1u, scene.m_objects.size());
+    EXPECT_EQ(2u, scene.m_objects[0].m_shapes.size());
+    ASSERT_EQ(2u, scene.m_instances.size());
+    EXPECT_TRUE(scene.m_instances[0].m_instance && scene.m_instances[1].m_instance);
+    EXPECT_EQ(4u, scene.m_statistics.m_file_count);
+    EXPECT_EQ(6u, scene.m_statistics.m_shape_count);
+    // Sphere, 2 triangles, 2 triangles, disk and 8 curve pieces in the object.
+    EXPECT_EQ(14u, scene.m_statistics.m_primitive_count);
+
+    // The sphere, the translated quad, the PLY quad and the two instanced disks.
+    ASSERT_TRUE(scene.m_bvh != nullptr);
+    std::pair<Float, Float> hits[] = { { 0, 7.5f }, { 2, 5 }, { 4, 6 }, { -2, 5 }, { -3, 5 } };
+    for (auto [x, t] : hits) {
+        std::optional<ShapeIntersection> hit = scene.m_bvh->Intersect(Ray(Point3f(x, 0.05f, -5), Vector3f(0, 0, 1)));
+        ASSERT_TRUE(hit.has_value()) << x;
+        EXPECT_NEAR(t, hit->m_t_hit, 1e-2f) << x;
+    }
+    EXPECT_FALSE(scene.m_bvh->Intersect(Ray(Point3f(-1, 0, -5), Vector3f(0, 0, 1))).has_value());
+    std::filesystem::remove_all(directory);
+}
+
+TEST(PBRTParser, ImportsMatchIncludesForAnyThreadCount) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "theia_pbrt_import_test";
+    PBRTParseOptions serial;
+    serial.m_thread_count = 1;
+    PBRTParseResult expected = ParsePBRT(WriteTestScene(directory, false), serial);
+    ASSERT_TRUE(expected.m_scene != nullptr) << expected.m_error;
+
+    for (UInt32 threads : { 1u, 2u, 8u }) {
+        PBRTParseOptions options;
+        options.m_thread_count = threads;
+        PBRTParseResult actual = ParsePBRT(WriteTestScene(directory, true), options);
+        ASSERT_TRUE(actual.m_scene != nullptr) << actual.m_error;
+        const PBRTScene& a = *expected.m_scene;
+        const PBRTScene& b = *actual.m_scene;
+        ASSERT_EQ(a.m_shapes.size(), b.m_shapes.size());
+        for (size_t i = 0; i < a.m_shapes.size(); ++i) {
+            EXPECT_EQ(a.m_shapes[i].m_entity.m_type, b.m_shapes[i].m_entity.m_type);
+            EXPECT_EQ(a.m_shapes[i].m_material_index, b.m_shapes[i].m_material_index);
+            EXPECT_EQ(a.m_shapes[i].m_material_name, b.m_shapes[i].m_material_name);
+            EXPECT_EQ(a.m_shapes[i].m_area_light_index, b.m_shapes[i].m_area_light_index);
+            EXPECT_EQ(a.m_shapes[i].m_entity.m_render_from_object.GetMatrix(), b.m_shapes[i].m_entity.m_render_from_object.GetMatrix());
+        }
+        ASSERT_EQ(a.m_materials.size(), b.m_materials.size());
+        for (size_t i = 0; i < a.m_materials.size(); ++i)
+            EXPECT_EQ(a.m_materials[i].m_type, b.m_materials[i].m_type);
+        EXPECT_EQ(a.m_instances.size(), b.m_instances.size());
+        EXPECT_EQ(a.m_statistics.m_primitive_count, b.m_statistics.m_primitive_count);
+        EXPECT_EQ(b.m_statistics.m_thread_count, threads);
+
+        RNG rng(40);
+        for (int i = 0; i < 2000; ++i) {
+            Ray ray(Point3f(10 * rng.Uniform<Float>() - 5, rng.Uniform<Float>() - 0.5f, -5), Vector3f(0, 0, 1) + 0.05f * RandomDirection(rng));
+            std::optional<ShapeIntersection> hitA = a.m_bvh->Intersect(ray), hitB = b.m_bvh->Intersect(ray);
+            ASSERT_EQ(hitA.has_value(), hitB.has_value());
+            if (hitA) {
+                EXPECT_EQ(hitA->m_t_hit, hitB->m_t_hit);
+            }
+        }
+    }
+    std::filesystem::remove_all(directory);
+}
+
+TEST(PBRTParser, ReportsErrorsWithLocations) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "theia_pbrt_error_test";
+    std::filesystem::create_directories(directory);
+    std::string path = (directory / "main.pbrt").string();
+    auto parse = [&](const std::string& contents) {
+        WriteFile(path, contents);
+        PBRTParseResult result = ParsePBRT(path);
+        EXPECT_TRUE(result.m_scene == nullptr);
+        return result.m_error;
+    };
+
+    EXPECT_NE(std::string::npos, parse("WorldBegin\n\nFrobnicate 1 2\n").find("main.pbrt:3: has an unknown directive Frobnicate."));
+    EXPECT_NE(std::string::npos, parse("Translate 1 2\nWorldBegin\n").find("Translate expects 3 numbers"));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\nShape \"sphere\" \"float radius\" [ 1\n").find("no closing bracket"));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\nShape \"trianglemesh\" \"point3 P\" [ 0 0 0 1 0 0 ]\n").find("multiple of 3"));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\n# comment\nShape \"trianglemesh\" \"point3 P\" [ 0 0 0 1 0 0 0 1 0 ] \"integer indices\" [ 0 1 5 ]\n")
+                                     .find("main.pbrt:3: Shape \"trianglemesh\" has an index out of range."));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\nShape \"plymesh\" \"string filename\" \"missing.ply\"\n").find("main.pbrt:2: Shape \"plymesh\" ReadPLY"));
+    EXPECT_NE(std::string::npos, parse("Import \"a.pbrt\"\n").find("Import must be in the world block"));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\nImport \"missing.pbrt\"\n").find("cannot open"));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\nAttributeEnd\n").find("AttributeEnd has no AttributeBegin"));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\nObjectBegin \"a\"\n").find("has no ObjectEnd"));
+    EXPECT_NE(std::string::npos, parse("WorldBegin\nShape \"sphere\" \"bool flag\" \"maybe\"\n").find("has a string value"));
+    std::filesystem::remove_all(directory);
+}
+
+// Run with --gtest_also_run_disabled_tests to time the parser stages on a
+// scene of many imported files of text meshes and PLY meshes. The scene size
+// can be raised with THEIA_PBRT_BENCHMARK_FILES.
+TEST(PBRTParser, DISABLED_ParseBenchmark) {
+    int fileCount = std::getenv("THEIA_PBRT_BENCHMARK_FILES") ? std::atoi(std::getenv("THEIA_PBRT_BENCHMARK_FILES")) : 64;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "theia_pbrt_benchmark";
+    std::filesystem::create_directories(directory);
+
+    std::unique_ptr<TriangleMesh> wave = WaveMesh(150);
+    std::string ply = "ply\nformat binary_little_endian 1.0\nelement vertex " + std::to_string(wave->VertexCount()) +
+                      "\nproperty float x\nproperty float y\nproperty float z\nelement face " + std::to_string(wave->TriangleCount()) +
+                      "\nproperty list uchar int vertex_indices\nend_header\n";
+    for (UInt32 v = 0; v < wave->VertexCount(); ++v) {
+        Point3f p = wave->Position(v);
+        ply.append(reinterpret_cast<const char*>(&p), sizeof(Point3f));
+    }
+    for (UInt32 t = 0; t < wave->TriangleCount(); ++t) {
+        std::array<UInt32, 3> vertices = wave->TriangleVertices(t, 0);
+        ply += char(3);
+        ply.append(reinterpret_cast<const char*>(vertices.data()), sizeof(vertices));
+    }
+    WriteFile(directory / "wave.ply", ply);
+
+    std::ostringstream text;
+    text << "Shape \"trianglemesh\" \"point3 P\" [";
+    for (UInt32 v = 0; v < wave->VertexCount(); ++v)
+        text << " " << wave->Position(v).m_x << " " << wave->Position(v).m_y << " " << wave->Position(v).m_z;
+    text << " ] \"integer indices\" [";
+    for (UInt32 t = 0; t < wave->TriangleCount(); ++t)
+        for (UInt32 index : wave->TriangleVertices(t, 0))
+            text << " " << index;
+    text << " ]\n";
+
+    std::string main = "LookAt 0 5 -5 0 0 0 0 1 0\nCamera \"perspective\"\nWorldBegin\n";
+    for (int i = 0; i < fileCount; ++i) {
+        std::string name = "part" + std::to_string(i) + ".pbrt";
+        std::string offset = "Translate " + std::to_string(3 * (i % 8)) + " 0 " + std::to_string(3 * (i / 8)) + "\n";
+        WriteFile(directory / name, offset + text.str() + "Translate 0 1 0\nShape \"plymesh\" \"string filename\" \"wave.ply\"\n");
+        main += "Import \"" + name + "\"\n";
+    }
+    WriteFile(directory / "main.pbrt", main);
+
+    UInt32 hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (UInt32 threads : { 1u, hardwareThreads }) {
+        PBRTParseOptions options;
+        options.m_thread_count = threads;
+        PBRTParseResult result = ParsePBRT((directory / "main.pbrt").string(), options);
+        ASSERT_TRUE(result.m_scene != nullptr) << result.m_error;
+        const PBRTParseStatistics& statistics = result.m_scene->m_statistics;
+        std::cout << threads << " threads: " << statistics.m_file_count << " files, " << (statistics.m_scene_bytes + statistics.m_mesh_bytes) / (1024.0 * 1024.0)
+                  << " MiB, " << statistics.m_primitive_count << " primitives" << std::endl;
+        std::cout << "  parse " << statistics.m_parse_milliseconds << " ms, imports " << statistics.m_import_milliseconds << " ms, shapes " << statistics.m_shape_milliseconds
+                  << " ms, BVHs " << statistics.m_bvh_milliseconds << " ms, total " << statistics.m_total_milliseconds << " ms" << std::endl;
+        std::cout << "  task time: imports " << statistics.m_import_task_milliseconds << " ms, shapes " << statistics.m_shape_task_milliseconds << " ms, BVHs "
+                  << statistics.m_bvh_task_milliseconds << " ms" << std::endl;
+        if (hardwareThreads == 1)
+            break;
+    }
+    std::filesystem::remove_all(directory);
+}
\ No newline at end of file
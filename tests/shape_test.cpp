@@ -0,0 +1,727 @@
+#include "../ext/gtest/gtest.h"
+
+#include "../Math/Math.h"
+#include "../Shape/Sphere.h"
+#include "../Shape/Disk.h"
+#include "../Shape/Cylinder.h"
+#include "../Shape/Curve.h"
+#include "../Shape/BilinearPatch.h"
+#include "../Shape/Triangle.h"
+#include "../Accelerator/BVHAggregate.h"
+#include "../Accelerator/Instance.h"
+#include "test_helpers.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+using namespace Theia;
+
+static Vector3f Normal(const ShapeIntersection& si) {
+    return Vector3f(si.m_interaction.m_normal.m_x, si.m_interaction.m_normal.m_y, si.m_interaction.m_normal.m_z);
+}
+
+// Far from the origin and non-uniformly scaled, so that the interval bounds
+// have real rounding error to cover.
+static Transform OffCenter() {
+    return Translate(Vector3f(1000, -700, 350)) * RotateYAxis(0.7f) * Scale(Vector3f(2, 3, 2));
+}
+
+// Rays from a shell around the object-space origin, aimed near it.
+static Ray RayTowards(RNG& rng, const Transform& renderFromObject, Float extent) {
+    Point3f origin = renderFromObject(RandomPoint(rng, 4 * extent));
+    Point3f target = renderFromObject(RandomPoint(rng, extent));
+    return Ray(origin, Normalize(target - origin));
+}
+
+// True if the surface with the implicit function f can pass through the box:
+// f is evaluated in double precision at the corners of the object-space box
+// that contains the render-space point interval.
+template <typename F>
+static bool SurfaceCrossesBox(const Transform& renderFromObject, const Point3Interval& p, F f) {
+    Point3Interval objectP = renderFromObject.ApplyInverse(p);
+    bool negative = false, positive = false;
+    for (int i = 0; i < 8; ++i) {
+        double x = (i & 1) ? objectP.m_x.GetHigh() : objectP.m_x.GetLow();
+        double y = (i & 2) ? objectP.m_y.GetHigh() : objectP.m_y.GetLow();
+        double z = (i & 4) ? objectP.m_z.GetHigh() : objectP.m_z.GetLow();
+        double value = f(x, y, z);
+        negative |= value <= 0;
+        positive |= value >= 0;
+    }
+    return negative && positive;
+}
+
+TEST(Sphere, MatchesAnalytic) {
+    RNG rng(1);
+    Transform renderFromObject = Translate(Vector3f(0.5f, -1, 2));
+    Sphere sphere(&renderFromObject, 1.5f);
+    int hits = 0;
+    for (int i = 0; i < 10000; ++i) {
+        Ray ray = RayTowards(rng, renderFromObject, 1.5f);
+
+        Vector3f o = ray.GetOrigin() - Point3f(0.5f, -1, 2);
+        Vector3f d = ray.GetDirection();
+        double b = Dot(o, d), c = double(LengthSquared(o)) - 1.5 * 1.5;
+        double discriminant = b * b - c;
+        // Origins inside the sphere hit the far side.
+        double t = -b - std::sqrt(discriminant) > 0 ? -b - std::sqrt(discriminant) : -b + std::sqrt(discriminant);
+
+        std::optional<ShapeIntersection> si = sphere.Intersect(ray);
+        EXPECT_EQ(si.has_value(), sphere.Occluded(ray));
+        if (std::abs(discriminant) < 1e-3)
+            continue;
+        ASSERT_EQ(discriminant > 0 && t > 0, si.has_value()) << i;
+        if (si) {
+            ++hits;
+            EXPECT_NEAR(t, si->m_t_hit, 1e-4 * t);
+            EXPECT_NEAR(1, Length(Normal(*si)), 1e-5);
+            EXPECT_GT(Dot(Normal(*si), Vector3f(Point3f(si->m_interaction.m_point_interval) - Point3f(0.5f, -1, 2))), 0);
+        }
+    }
+    EXPECT_GT(hits, 1000);
+}
+
+TEST(Sphere, Clipped) {
+    Transform identity;
+    Sphere hemisphere(&identity, 1, 0, 1);
+    EXPECT_TRUE(hemisphere.Intersect(Ray(Point3f(0, 0, 5), Vector3f(0, 0, -1))).has_value());
+    // Enters through the open bottom and hits the inside of the cap.
+    std::optional<ShapeIntersection> si = hemisphere.Intersect(Ray(Point3f(0, 0, -5), Vector3f(0, 0, 1)));
+    ASSERT_TRUE(si.has_value());
+    EXPECT_NEAR(6, si->m_t_hit, 1e-4);
+
+    Sphere wedge(&identity, 1, -1, 1, Pi / 2);
+    EXPECT_TRUE(wedge.Intersect(Ray(Point3f(0.5f, 0.5f, 5), Vector3f(0, 0, -1))).has_value());
+    EXPECT_FALSE(wedge.Intersect(Ray(Point3f(-0.5f, 0.5f, 5), Vector3f(0, 0, -1))).has_value());
+    EXPECT_NEAR(Pi, wedge.Area(), 1e-5);
+    EXPECT_NEAR(4 * Pi, Sphere(&identity, 1).Area(), 1e-5);
+}
+
+TEST(Disk, MatchesAnalytic) {
+    Transform identity;
+    Disk annulus(&identity, 2, 1, 0.5f);
+    std::optional<ShapeIntersection> si = annulus.Intersect(Ray(Point3f(1.5f, 0, 3), Vector3f(0, 0, -1)));
+    ASSERT_TRUE(si.has_value());
+    EXPECT_FLOAT_EQ(2.5f, si->m_t_hit);
+    EXPECT_FLOAT_EQ(0.5f, Float(si->m_interaction.m_point_interval.m_z));
+    EXPECT_EQ(Vector3f(0, 0, 1), Normal(*si));
+    EXPECT_FALSE(annulus.Intersect(Ray(Point3f(0.5f, 0, 3), Vector3f(0, 0, -1))).has_value());
+    EXPECT_FALSE(annulus.Intersect(Ray(Point3f(2.5f, 0, 3), Vector3f(0, 0, -1))).has_value());
+    EXPECT_FALSE(annulus.Intersect(Ray(Point3f(1.5f, 0, 3), Vector3f(0, 0, -1)), 2).has_value());
+    EXPECT_NEAR(3 * Pi, annulus.Area(), 1e-5);
+}
+
+TEST(Cylinder, MatchesAnalytic) {
+    Transform identity;
+    Cylinder cylinder(&identity, 1, -1, 1);
+    std::optional<ShapeIntersection> si = cylinder.Intersect(Ray(Point3f(-5, 0, 0.5f), Vector3f(1, 0, 0)));
+    ASSERT_TRUE(si.has_value());
+    EXPECT_FLOAT_EQ(4, si->m_t_hit);
+    EXPECT_NEAR(-1, Normal(*si).m_x, 1e-6);
+    // Open ends: a ray along the axis passes through.
+    EXPECT_FALSE(cylinder.Intersect(Ray(Point3f(0, 0, -5), Vector3f(0, 0, 1))).has_value());
+    // Starting inside, the first hit is the far wall.
+    si = cylinder.Intersect(Ray(Point3f(0, 0, 0), Vector3f(0, 1, 0)));
+    ASSERT_TRUE(si.has_value());
+    EXPECT_FLOAT_EQ(1, si->m_t_hit);
+    EXPECT_FALSE(cylinder.Intersect(Ray(Point3f(-5, 0, 1.5f), Vector3f(1, 0, 0))).has_value());
+    EXPECT_NEAR(4 * Pi, cylinder.Area(), 1e-5);
+}
+
+// The surface must pass through every reported point interval, and rays
+// spawned from it away from the surface must not hit it again.
+template <typename S, typename F>
+static void CheckErrorBounds(const S& shape, const Transform& renderFromObject, Float extent, F implicit, bool convex) {
+    RNG rng(2);
+    int hits = 0;
+    for (int i = 0; i < 20000; ++i) {
+        Ray ray = RayTowards(rng, renderFromObject, extent);
+        std::optional<ShapeIntersection> si = shape.Intersect(ray);
+        if (!si)
+            continue;
+        ++hits;
+        const IInteraction& interaction = si->m_interaction;
+        ASSERT_TRUE(SurfaceCrossesBox(renderFromObject, interaction.m_point_interval, implicit)) << i;
+
+        for (int j = 0; j < 8; ++j) {
+            Vector3f w = RandomDirection(rng);
+            std::optional<ShapeIntersection> again = shape.Intersect(interaction.SpawnRay(w));
+            // Rays leaving a convex surface on the outside, or either side of a plane, never come back.
+            if (!convex || Dot(w, Normal(*si)) > 0) {
+                EXPECT_FALSE(again.has_value()) << i << ", t " << again->m_t_hit;
+            } else if (again) {
+                EXPECT_GT(again->m_t_hit, 1e-4f * extent);
+            }
+        }
+    }
+    EXPECT_GT(hits, 1000);
+}
+
+TEST(Sphere, ErrorBoundsAndSpawnedRays) {
+    Transform renderFromObject = OffCenter();
+    Sphere sphere(&renderFromObject, 0.01f);
+    CheckErrorBounds(sphere, renderFromObject, 0.01f, [](double x, double y, double z) { return x * x + y * y + z * z - 0.01 * 0.01; }, true);
+}
+
+TEST(Disk, ErrorBoundsAndSpawnedRays) {
+    Transform renderFromObject = OffCenter();
+    Disk disk(&renderFromObject, 0.01f, 0, 0.002f);
+    CheckErrorBounds(disk, renderFromObject, 0.01f, [](double, double, double z) { return z - 0.002; }, false);
+}
+
+TEST(Cylinder, ErrorBoundsAndSpawnedRays) {
+    Transform renderFromObject = OffCenter();
+    Cylinder cylinder(&renderFromObject, 0.01f, -0.01f, 0.01f);
+    CheckErrorBounds(cylinder, renderFromObject, 0.01f, [](double x, double y, double) { return x * x + y * y - 0.01 * 0.01; }, true);
+}
+
+// A gently bent curve, narrowing from 0.1 to 0.05, placed far from the
+// origin so that rays from around it see it at many angles.
+static std::array<Point3f, 4> BentCurve() {
+    return { Point3f(-1, 0, 0), Point3f(-0.3f, 0.5f, 0.2f), Point3f(0.3f, -0.4f, 0.1f), Point3f(1, 0.2f, -0.3f) };
+}
+
+static Point3f BezierPoint(const std::array<Point3f, 4>& cp, Float u) {
+    Float s = 1 - u;
+    return Point3f() + s * s * s * (cp[0] - Point3f()) + 3 * s * s * u * (cp[1] - Point3f()) + 3 * s * u * u * (cp[2] - Point3f()) + u * u * u * (cp[3] - Point3f());
+}
+
+TEST(Curve, MatchesReference) {
+    RNG rng(4);
+    Transform renderFromObject = Translate(Vector3f(3, -2, 5));
+    std::array<Point3f, 4> cp = BentCurve();
+    CurveCommon common(renderFromObject, cp, 0.1f, 0.05f, CurveType::Flat);
+    std::vector<Curve> curves = Curve::CreateCurves(&common);
+    const Curve& curve = curves[0];
+
+    int hits = 0, checked = 0;
+    for (int i = 0; i < 5000; ++i) {
+        Float uTarget = rng.Uniform<Float>();
+        Point3f target = renderFromObject(BezierPoint(cp, uTarget)) + 0.1f * RandomDirection(rng);
+        Point3f origin = target + 5 * RandomDirection(rng);
+        Ray ray(origin, Normalize(target - origin));
+
+        // The flat curve faces the ray, so it is hit where the ray passes
+        // closest to the center line: at local minima of the distance over a
+        // dense sampling, scaled by the half width. The curve bends, so a ray
+        // can pass it more than once; minima near the flat end caps are
+        // skipped.
+        std::vector<double> distances(4097), ts(4097);
+        for (int j = 0; j <= 4096; ++j) {
+            Float u = j / 4096.f;
+            Vector3f v = renderFromObject(BezierPoint(cp, u)) - ray.GetOrigin();
+            ts[j] = Dot(v, ray.GetDirection());
+            distances[j] = Length(Cross(v, ray.GetDirection())) / (0.5 * Lerp(u, 0.1f, 0.05f));
+        }
+        double nearT = 1e30, nearU = 0;
+        std::vector<double> looseTs;
+        bool nearEnd = false;
+        for (int j = 0; j <= 4096; ++j) {
+            if ((j > 0 && distances[j - 1] < distances[j]) || (j < 4096 && distances[j + 1] < distances[j]) || distances[j] >= 1.1)
+                continue;
+            looseTs.push_back(ts[j]);
+            nearEnd |= j < 80 || j > 4016;
+            if (distances[j] < 0.9 && ts[j] < nearT) {
+                nearT = ts[j];
+                nearU = j / 4096.;
+            }
+        }
+        std::optional<ShapeIntersection> si = curve.Intersect(ray);
+        EXPECT_EQ(si.has_value(), curve.Occluded(ray)) << i;
+        if (nearEnd)
+            continue;
+        if (nearT < 1e30) {
+            ++checked;
+            ASSERT_TRUE(si.has_value()) << i;
+            // Pieces are tested as straight lines, which puts the depth of rays
+            // that graze the curve off by up to about the width.
+            Float u = si->m_interaction.m_uv.m_x;
+            Vector3f tangent = Normalize(BezierPoint(cp, std::min(u + 1e-3f, 1.0f)) - BezierPoint(cp, std::max(u - 1e-3f, 0.0f)));
+            double tolerance = 0.01 / Length(Cross(tangent, ray.GetDirection()));
+            EXPECT_LE(si->m_t_hit, nearT + tolerance) << i;
+            double gap = 1e30;
+            for (double t : looseTs)
+                gap = std::min(gap, std::abs(t - si->m_t_hit));
+            EXPECT_LT(gap, tolerance) << i;
+            if (std::abs(si->m_t_hit - nearT) < 0.01) {
+                EXPECT_NEAR(nearU, u, 0.01) << i;
+            }
+            EXPECT_LE(Dot(Normal(*si), ray.GetDirection()), 0) << i;
+        }
+        else if (looseTs.empty()) {
+            EXPECT_FALSE(si.has_value()) << i;
+        }
+        hits += si.has_value();
+    }
+    EXPECT_GT(checked, 1000);
+    EXPECT_GT(hits, checked);
+}
+
+TEST(Curve, Strands) {
+    std::vector<Point3f> points = { Point3f(0, 0, 0), Point3f(1, 0, 0), Point3f(1, 1, 0), Point3f(0, 1, 1), Point3f(0, 0, 2), Point3f(1, 0, 3) };
+    std::vector<CurveCommon> bspline = CurveCommon::CreateStrand(Transform(), points, CurveBasis::BSpline, 0.2f, 0.1f, CurveType::Cylinder);
+    ASSERT_EQ(3u, bspline.size());
+    for (size_t i = 0; i + 1 < bspline.size(); ++i) {
+        // B-spline segments join with matching position and tangent.
+        EXPECT_LT(Length(bspline[i].m_control_points[3] - bspline[i + 1].m_control_points[0]), 1e-6f);
+        EXPECT_LT(Length((bspline[i].m_control_points[3] - bspline[i].m_control_points[2]) - (bspline[i + 1].m_control_points[1] - bspline[i + 1].m_control_points[0])), 1e-6f);
+        EXPECT_FLOAT_EQ(bspline[i].m_width[1], bspline[i + 1].m_width[0]);
+    }
+    EXPECT_FLOAT_EQ(0.2f, bspline.front().m_width[0]);
+    EXPECT_FLOAT_EQ(0.1f, bspline.back().m_width[1]);
+
+    std::vector<Point3f> bezierPoints(points.begin(), points.begin() + 4);
+    bezierPoints.insert(bezierPoints.end(), { Point3f(0, 0, 3), Point3f(1, 0, 3), Point3f(2, 0, 3) });
+    std::vector<CurveCommon> bezier = CurveCommon::CreateStrand(Translate(Vector3f(0, 0, 1)), bezierPoints, CurveBasis::Bezier, 0.2f, 0.1f, CurveType::Flat);
+    ASSERT_EQ(2u, bezier.size());
+    EXPECT_EQ(Point3f(0, 1, 2), bezier[0].m_control_points[3]);
+    EXPECT_EQ(Point3f(0, 1, 2), bezier[1].m_control_points[0]);
+}
+
+TEST(Curve, TightBounds) {
+    // A long diagonal hair, where the box of the whole segment is mostly empty.
+    std::array<Point3f, 4> cp = { Point3f(0, 0, 0), Point3f(4, 3, 2), Point3f(6, 7, 8), Point3f(10, 10, 10) };
+    CurveCommon common(Transform(), cp, 0.02f, 0.01f, CurveType::Flat);
+    std::vector<Curve> whole = Curve::CreateCurves(&common);
+    std::vector<Curve> split = Curve::CreateCurves(&common, 8);
+
+    AABB3f bounds = whole[0].Bounds();
+    for (int j = 0; j <= 1000; ++j) {
+        Point3f p = BezierPoint(cp, j / 1000.f);
+        for (int axis = 0; axis < 3; ++axis) {
+            EXPECT_LE(bounds.m_min[axis], p[axis] - 0.005f);
+            EXPECT_GE(bounds.m_max[axis], p[axis] + 0.005f);
+        }
+    }
+    // The curve never leaves [0, 10]^3, although its control points alone would allow it.
+    EXPECT_NEAR(0, bounds.m_min.m_x, 0.011f);
+    EXPECT_NEAR(10, bounds.m_max.m_z, 0.011f);
+
+    Float splitVolume = 0;
+    for (const Curve& curve : split) {
+        EXPECT_TRUE(Overlaps(curve.Bounds(), bounds));
+        splitVolume += curve.Bounds().Volume();
+    }
+    EXPECT_LT(splitVolume, 0.05f * bounds.Volume());
+
+    // The part of the hair inside a slab is found by subdividing, not by
+    // clipping the whole box.
+    AABB3f slab(Point3f(-100, -100, 4), Point3f(100, 100, 5));
+    AABB3f clipped = whole[0].ClippedBounds(slab);
+    AABB3f naive = Intersection(bounds, slab);
+    EXPECT_LT(clipped.Volume(), 0.1f * naive.Volume());
+    for (int j = 0; j <= 1000; ++j) {
+        Point3f p = BezierPoint(cp, j / 1000.f);
+        if (p.m_z >= 4 && p.m_z <= 5) {
+            EXPECT_LE(clipped.m_min.m_x, p.m_x);
+            EXPECT_GE(clipped.m_max.m_x, p.m_x);
+            EXPECT_LE(clipped.m_min.m_y, p.m_y);
+            EXPECT_GE(clipped.m_max.m_y, p.m_y);
+        }
+    }
+}
+
+TEST(Curve, TypesAndSpawnedRays) {
+    std::array<Point3f, 4> cp = BentCurve();
+    Transform identity;
+    std::array<Normal3f, 2> up = { Normal3f(0, 0, 1), Normal3f(0, 0, 1) };
+    for (CurveType type : { CurveType::Flat, CurveType::Cylinder, CurveType::Ribbon }) {
+        CurveCommon common(identity, cp, 0.1f, 0.1f, type, up);
+        std::vector<Curve> curves = Curve::CreateCurves(&common, 2);
+        RNG rng(5);
+        int hits = 0;
+        for (int i = 0; i < 5000; ++i) {
+            Point3f target = BezierPoint(cp, rng.Uniform<Float>()) + 0.05f * RandomDirection(rng);
+            Point3f origin = target + 3 * RandomDirection(rng);
+            Ray ray(origin, Normalize(target - origin));
+            for (const Curve& curve : curves) {
+                std::optional<ShapeIntersection> si = curve.Intersect(ray);
+                ASSERT_EQ(si.has_value(), curve.Occluded(ray)) << i;
+                if (!si)
+                    continue;
+                ++hits;
+                EXPECT_LE(Dot(Normal(*si), ray.GetDirection()), 0) << i;
+                // Rays that graze the curve may find it again within a width,
+                // but ones that pass through it do not; the curve bends, so they
+                // can still meet it further on.
+                std::optional<ShapeIntersection> again = curve.Intersect(si->m_interaction.SpawnRay(ray.GetDirection()));
+                if (again && Dot(Normal(*si), ray.GetDirection()) < -0.5f) {
+                    EXPECT_GT(again->m_t_hit, 0.1f) << i;
+                }
+                EXPECT_FALSE(curve.Intersect(ray, 0.99f * si->m_t_hit).has_value()) << i;
+            }
+        }
+        EXPECT_GT(hits, 500);
+    }
+
+    // A ribbon seen edge on has no width.
+    CurveCommon ribbon(identity, cp, 0.1f, 0.1f, CurveType::Ribbon, up);
+    Curve curve(&ribbon, 0, 1);
+    EXPECT_FALSE(curve.Intersect(Ray(Point3f(0, -5, 0.1f), Vector3f(0, 1, 0))).has_value());
+    EXPECT_TRUE(curve.Intersect(Ray(BezierPoint(cp, 0.5f) + Vector3f(0, 0, 5), Vector3f(0, 0, -1))).has_value());
+}
+
+static Point3f BilinearPoint(const std::array<Point3f, 4>& p, Float u, Float v) {
+    return Lerp(v, Lerp(u, p[0], p[1]), Lerp(u, p[2], p[3]));
+}
+
+// The patch p00, p10, p01, p11 as an n x n grid of quads.
+static void AppendGrid(const std::array<Point3f, 4>& p, int n, bool triangles, std::vector<Point3f>& positions, std::vector<UInt32>& indices) {
+    UInt32 first = UInt32(positions.size());
+    for (int j = 0; j <= n; ++j)
+        for (int i = 0; i <= n; ++i)
+            positions.push_back(BilinearPoint(p, Float(i) / n, Float(j) / n));
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < n; ++i) {
+            UInt32 v00 = first + j * (n + 1) + i, v10 = v00 + 1, v01 = v00 + n + 1, v11 = v01 + 1;
+            if (triangles)
+                indices.insert(indices.end(), { v00, v10, v11, v00, v11, v01 });
+            else
+                indices.insert(indices.end(), { v00, v10, v01, v11 });
+        }
+}
+
+static const std::array<Point3f, 4> Twisted = { Point3f(0, 0, 0), Point3f(1, 0, 0.3f), Point3f(0, 1, -0.2f), Point3f(1.2f, 1.1f, 0.8f) };
+
+TEST(BilinearPatch, MatchesTessellation) {
+    BilinearPatchMesh mesh(Transform(), { Twisted.begin(), Twisted.end() }, { 0, 1, 2, 3 });
+    BilinearPatch patch(&mesh, 0);
+
+    std::vector<Point3f> positions;
+    std::vector<UInt32> indices;
+    AppendGrid(Twisted, 128, true, positions, indices);
+    TriangleMesh triangleMesh(Transform(), positions, indices);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(&triangleMesh);
+    std::vector<Primitive> primitives;
+    for (Triangle& triangle : triangles)
+        primitives.push_back(&triangle);
+    BVHAggregate tessellation(primitives);
+
+    RNG rng(7);
+    int hits = 0, mismatches = 0;
+    for (int i = 0; i < 10000; ++i) {
+        Point3f target = BilinearPoint(Twisted, 1.2f * rng.Uniform<Float>() - 0.1f, 1.2f * rng.Uniform<Float>() - 0.1f);
+        Point3f origin = target + 3 * RandomDirection(rng);
+        Ray ray(origin, Normalize(target - origin));
+        std::optional<ShapeIntersection> si = patch.Intersect(ray);
+        std::optional<ShapeIntersection> reference = tessellation.Intersect(ray);
+        EXPECT_EQ(si.has_value(), patch.Occluded(ray)) << i;
+        if (si && reference) {
+            ++hits;
+            EXPECT_NEAR(reference->m_t_hit, si->m_t_hit, 1e-2f) << i;
+            Point2f uv = si->m_interaction.m_uv;
+            EXPECT_LT(Length(BilinearPoint(Twisted, uv.m_x, uv.m_y) - ray(si->m_t_hit)), 1e-4f) << i;
+            Point3f p = BilinearPoint(Twisted, uv.m_x, uv.m_y);
+            Vector3f n = Normalize(Cross(BilinearPoint(Twisted, uv.m_x + 1e-3f, uv.m_y) - p, BilinearPoint(Twisted, uv.m_x, uv.m_y + 1e-3f) - p));
+            EXPECT_GT(std::abs(Dot(Normal(*si), n)), 0.99f) << i;
+        }
+        else if (si.has_value() != reference.has_value()) {
+            // Only rays that pass within a sliver of the boundary may differ.
+            ++mismatches;
+        }
+    }
+    EXPECT_GT(hits, 3000);
+    EXPECT_LT(mismatches, 50);
+}
+
+TEST(BilinearPatch, PlanarAndArea) {
+    // A rectangle and a trapezoid, where the area is exact.
+    BilinearPatchMesh mesh(Transform(), { Point3f(0, 0, 0), Point3f(2, 0, 0), Point3f(0, 1, 0), Point3f(2, 1, 0), Point3f(0.5f, 2, 0), Point3f(1.5f, 2, 0) }, { 0, 1, 2, 3, 2, 3, 4, 5 });
+    std::vector<BilinearPatch> patches = BilinearPatch::CreatePatches(&mesh);
+    ASSERT_EQ(2u, patches.size());
+    EXPECT_FLOAT_EQ(2, patches[0].Area());
+    EXPECT_FLOAT_EQ(1.5f, patches[1].Area());
+
+    std::optional<ShapeIntersection> si = patches[0].Intersect(Ray(Point3f(0.5f, 0.25f, 3), Vector3f(0, 0, -1)));
+    ASSERT_TRUE(si.has_value());
+    EXPECT_FLOAT_EQ(3, si->m_t_hit);
+    EXPECT_FLOAT_EQ(0.25f, si->m_interaction.m_uv.m_x);
+    EXPECT_FLOAT_EQ(0.25f, si->m_interaction.m_uv.m_y);
+    EXPECT_EQ(Vector3f(0, 0, 1), Normal(*si));
+    EXPECT_FALSE(patches[0].Intersect(Ray(Point3f(0.5f, 0.25f, 3), Vector3f(0, 0, -1)), 2).has_value());
+    EXPECT_FALSE(patches[1].Intersect(Ray(Point3f(0.2f, 1.9f, 3), Vector3f(0, 0, -1))).has_value());
+    EXPECT_TRUE(patches[1].Intersect(Ray(Point3f(0.6f, 1.9f, 3), Vector3f(0, 0, -1))).has_value());
+
+    // The area of curved patches is approximated to within half a percent.
+    std::vector<Point3f> positions;
+    std::vector<UInt32> indices;
+    AppendGrid(Twisted, 256, true, positions, indices);
+    double area = 0;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        area += 0.5 * Length(Cross(positions[indices[i + 1]] - positions[indices[i]], positions[indices[i + 2]] - positions[indices[i]]));
+    BilinearPatchMesh twisted(Transform(), { Twisted.begin(), Twisted.end() }, { 0, 1, 2, 3 });
+    EXPECT_NEAR(area, BilinearPatch(&twisted, 0).Area(), 5e-3 * area);
+}
+
+TEST(BilinearPatch, Sampling) {
+    BilinearPatchMesh rectangle(Transform(), { Point3f(0, 0, 0), Point3f(2, 0, 0), Point3f(0, 1, 0), Point3f(2, 1, 0) }, { 0, 1, 2, 3 });
+    BilinearPatchMesh twisted(Transform(), { Twisted.begin(), Twisted.end() }, { 0, 1, 2, 3 });
+    RNG rng(8);
+    for (const BilinearPatchMesh* mesh : { &rectangle, &twisted }) {
+        BilinearPatch patch(mesh, 0);
+        double inversePdfSum = 0;
+        int quadrants[2][2] = {};
+        const int n = 100000;
+        for (int i = 0; i < n; ++i) {
+            std::optional<ShapeSample> ss = patch.Sample(Point2f(rng.Uniform<Float>(), rng.Uniform<Float>()));
+            ASSERT_TRUE(ss.has_value());
+            Point2f uv = ss->m_interaction.m_uv;
+            EXPECT_LT(Length(BilinearPoint({ mesh->m_positions[0], mesh->m_positions[1], mesh->m_positions[2], mesh->m_positions[3] }, uv.m_x, uv.m_y) - Point3f(ss->m_interaction.m_point_interval)), 1e-5f);
+            inversePdfSum += 1 / ss->m_pdf;
+            ++quadrants[uv.m_x > 0.5f][uv.m_y > 0.5f];
+        }
+        // E[1 / pdf] is the area.
+        EXPECT_NEAR(patch.Area(), inversePdfSum / n, 0.01 * patch.Area());
+        if (mesh == &rectangle) {
+            for (int i = 0; i < 4; ++i)
+                EXPECT_NEAR(0.25, quadrants[i / 2][i % 2] / double(n), 0.01);
+        }
+    }
+}
+
+TEST(BilinearPatch, ErrorBoundsAndSpawnedRays) {
+    Transform renderFromObject = OffCenter();
+    BilinearPatchMesh mesh(renderFromObject, { Point3f(-0.01f, -0.01f, 0.002f), Point3f(0.01f, -0.01f, 0.002f), Point3f(-0.005f, 0.01f, 0.002f), Point3f(0.006f, 0.01f, 0.002f) }, { 0, 1, 2, 3 });
+    BilinearPatch patch(&mesh, 0);
+    CheckErrorBounds(patch, renderFromObject, 0.01f, [](double, double, double z) { return z - 0.002; }, false);
+
+    // A saddle, z = x y / 0.01, where the hits must still lie on the surface.
+    BilinearPatchMesh saddle(renderFromObject, { Point3f(-0.01f, -0.01f, 0.01f), Point3f(0.01f, -0.01f, -0.01f), Point3f(-0.01f, 0.01f, -0.01f), Point3f(0.01f, 0.01f, 0.01f) }, { 0, 1, 2, 3 });
+    BilinearPatch saddlePatch(&saddle, 0);
+    RNG rng(9);
+    int hits = 0;
+    for (int i = 0; i < 20000; ++i) {
+        Ray ray = RayTowards(rng, renderFromObject, 0.01f);
+        std::optional<ShapeIntersection> si = saddlePatch.Intersect(ray);
+        if (!si)
+            continue;
+        ++hits;
+        ASSERT_TRUE(SurfaceCrossesBox(renderFromObject, si->m_interaction.m_point_interval, [](double x, double y, double z) { return z - x * y / 0.01; })) << i;
+    }
+    EXPECT_GT(hits, 1000);
+}
+
+// Latitude-longitude triangulation of a sphere, the usual stand-in for
+// particles in triangle-only renderers.
+static void AppendSphereMesh(Point3f center, Float radius, int nTheta, int nPhi, std::vector<Point3f>& positions, std::vector<UInt32>& indices) {
+    UInt32 top = UInt32(positions.size());
+    positions.push_back(center + Vector3f(0, 0, radius));
+    for (int i = 1; i < nTheta; ++i) {
+        Float theta = Pi * i / nTheta;
+        for (int j = 0; j < nPhi; ++j) {
+            Float phi = 2 * Pi * j / nPhi;
+            positions.push_back(center + radius * Vector3f(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)));
+        }
+    }
+    UInt32 bottom = UInt32(positions.size());
+    positions.push_back(center - Vector3f(0, 0, radius));
+
+    auto ring = [&](int i, int j) { return top + 1 + UInt32((i - 1) * nPhi + (j % nPhi)); };
+    for (int j = 0; j < nPhi; ++j) {
+        for (UInt32 index : { top, ring(1, j), ring(1, j + 1), bottom, ring(nTheta - 1, j + 1), ring(nTheta - 1, j) })
+            indices.push_back(index);
+        for (int i = 1; i < nTheta - 1; ++i)
+            for (UInt32 index : { ring(i, j), ring(i + 1, j), ring(i + 1, j + 1), ring(i, j), ring(i + 1, j + 1), ring(i, j + 1) })
+                indices.push_back(index);
+    }
+}
+
+static void Trace(const char* name, const BVHAggregate& bvh, const std::vector<Ray>& rays) {
+    std::vector<std::optional<ShapeIntersection>> results(rays.size());
+    auto start = std::chrono::steady_clock::now();
+    bvh.Intersect(rays, results);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t hits = std::count_if(results.begin(), results.end(), [](const std::optional<ShapeIntersection>& si) { return si.has_value(); });
+    std::cout << name << ": " << rays.size() / seconds / 1e6 << " Mrays/s, "
+              << bvh.GetStatistics().m_memory_bytes / (1024.0 * 1024.0) << " MiB BVH, "
+              << hits << " hits" << std::endl;
+}
+
+// Run with --gtest_also_run_disabled_tests to compare a particle cloud of
+// analytic spheres against the same cloud tessellated into triangles, both
+// as individual shapes and as instances of one shared sphere.
+TEST(Sphere, DISABLED_ParticleBenchmark) {
+    const int nParticles = 20000, nTheta = 8, nPhi = 16;
+    RNG rng(3);
+    std::vector<Point3f> centers;
+    std::vector<Float> radii;
+    for (int i = 0; i < nParticles; ++i) {
+        centers.push_back(RandomPoint(rng, 1));
+        radii.push_back(0.01f + 0.02f * rng.Uniform<Float>());
+    }
+
+    std::vector<Ray> rays;
+    for (int y = 0; y < 1024; ++y)
+        for (int x = 0; x < 1024; ++x) {
+            Vector3f d(2 * (x + 0.5f) / 1024 - 1, 2 * (y + 0.5f) / 1024 - 1, 2.5f);
+            rays.push_back(Ray(Point3f(0, 0, -3), Normalize(d)));
+        }
+
+    std::vector<Transform> particleTransforms;
+    std::vector<Sphere> spheres;
+    particleTransforms.reserve(nParticles);
+    spheres.reserve(nParticles);
+    for (int i = 0; i < nParticles; ++i) {
+        particleTransforms.push_back(Translate(centers[i] - Point3f()));
+        spheres.push_back(Sphere(&particleTransforms.back(), radii[i]));
+    }
+    std::vector<Primitive> spherePrimitives;
+    for (Sphere& sphere : spheres)
+        spherePrimitives.push_back(&sphere);
+    Trace("spheres", BVHAggregate(spherePrimitives), rays);
+
+    std::vector<Point3f> positions;
+    std::vector<UInt32> indices;
+    for (int i = 0; i < nParticles; ++i)
+        AppendSphereMesh(centers[i], radii[i], nTheta, nPhi, positions, indices);
+    TriangleMesh mesh(Transform(), positions, indices);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(&mesh);
+    std::vector<Primitive> trianglePrimitives;
+    for (Triangle& triangle : triangles)
+        trianglePrimitives.push_back(&triangle);
+    Trace("triangle mesh", BVHAggregate(trianglePrimitives), rays);
+
+    // One unit sphere, and one tessellated unit sphere, instanced per particle.
+    Transform identity;
+    Sphere unitSphere(&identity, 1);
+    positions.clear();
+    indices.clear();
+    AppendSphereMesh(Point3f(), 1, nTheta, nPhi, positions, indices);
+    TriangleMesh unitMesh(Transform(), positions, indices);
+    std::vector<Triangle> unitTriangles = Triangle::CreateTriangles(&unitMesh);
+    std::vector<Primitive> unitPrimitives;
+    for (Triangle& triangle : unitTriangles)
+        unitPrimitives.push_back(&triangle);
+    BVHAggregate unitBVH(unitPrimitives);
+
+    for (const auto& [name, primitive] : { std::pair<const char*, const IPrimitive*>("instanced spheres", &unitSphere),
+                                           std::pair<const char*, const IPrimitive*>("instanced triangle mesh", &unitBVH) }) {
+        std::vector<Instance> instances;
+        instances.reserve(nParticles);
+        for (int i = 0; i < nParticles; ++i)
+            instances.push_back(Instance(primitive, Translate(centers[i] - Point3f()) * Scale(Vector3f(radii[i], radii[i], radii[i]))));
+        std::vector<Primitive> instancePrimitives;
+        for (Instance& instance : instances)
+            instancePrimitives.push_back(&instance);
+        Trace(name, BVHAggregate(instancePrimitives), rays);
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare a head of hair made of
+// curves against the same strands tessellated into camera-facing triangle
+// ribbons, and to see how splitting long diagonal segments changes the BVH.
+TEST(Curve, DISABLED_HairBenchmark) {
+    const int nStrands = 20000, nSegments = 3, nPieces = 8;
+    RNG rng(6);
+    std::vector<std::vector<Point3f>> strands;
+    for (int i = 0; i < nStrands; ++i) {
+        Vector3f root = RandomDirection(rng);
+        Vector3f comb = Normalize(Cross(root, Vector3f(0, 0, 1)) + 0.5f * RandomDirection(rng));
+        std::vector<Point3f> points = { Point3f() + root };
+        for (int j = 1; j <= 3 * nSegments; ++j)
+            points.push_back(points.back() + 0.08f * Normalize(root + 1.5f * comb) + 0.02f * RandomDirection(rng));
+        strands.push_back(points);
+    }
+
+    std::vector<Ray> rays;
+    for (int y = 0; y < 512; ++y)
+        for (int x = 0; x < 512; ++x) {
+            Vector3f d(2 * (x + 0.5f) / 512 - 1, 2 * (y + 0.5f) / 512 - 1, 1.5f);
+            rays.push_back(Ray(Point3f(0, 0, -3), Normalize(d)));
+        }
+
+    std::vector<CurveCommon> commons;
+    for (const std::vector<Point3f>& points : strands) {
+        std::vector<CurveCommon> segments = CurveCommon::CreateStrand(Transform(), points, CurveBasis::Bezier, 0.004f, 0.001f, CurveType::Cylinder);
+        commons.insert(commons.end(), segments.begin(), segments.end());
+    }
+    for (UInt32 split : { 1u, 4u }) {
+        std::vector<Curve> curves;
+        for (const CurveCommon& common : commons) {
+            std::vector<Curve> pieces = Curve::CreateCurves(&common, split);
+            curves.insert(curves.end(), pieces.begin(), pieces.end());
+        }
+        std::vector<Primitive> primitives;
+        for (Curve& curve : curves)
+            primitives.push_back(&curve);
+        std::cout << "curves, split " << split << ": " << (commons.size() * sizeof(CurveCommon) + curves.size() * sizeof(Curve)) / (1024.0 * 1024.0) << " MiB geometry" << std::endl;
+        Trace("  SAH", BVHAggregate(primitives), rays);
+        BVHBuildOptions options;
+        options.m_split_method = BVHSplitMethod::SpatialSAH;
+        Trace("  spatial SAH", BVHAggregate(primitives, options), rays);
+    }
+
+    // Each segment as nPieces quads facing the camera, with the width of the
+    // curve at their ends.
+    std::vector<Point3f> positions;
+    std::vector<UInt32> indices;
+    for (const CurveCommon& common : commons) {
+        UInt32 first = UInt32(positions.size());
+        const std::array<Point3f, 4>& cp = common.m_control_points;
+        for (int j = 0; j <= nPieces; ++j) {
+            Float u = Float(j) / nPieces;
+            Point3f p = BezierPoint(cp, u);
+            Vector3f tangent = BezierPoint(cp, std::min(u + 1e-3f, 1.0f)) - BezierPoint(cp, std::max(u - 1e-3f, 0.0f));
+            Vector3f across = 0.5f * Lerp(u, common.m_width[0], common.m_width[1]) * Normalize(Cross(tangent, p - Point3f(0, 0, -3)));
+            positions.push_back(p - across);
+            positions.push_back(p + across);
+        }
+        for (UInt32 j = 0; j < nPieces; ++j)
+            for (UInt32 index : { 0u, 1u, 3u, 0u, 3u, 2u })
+                indices.push_back(first + 2 * j + index);
+    }
+    TriangleMesh mesh(Transform(), positions, indices);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(&mesh);
+    std::vector<Primitive> trianglePrimitives;
+    for (Triangle& triangle : triangles)
+        trianglePrimitives.push_back(&triangle);
+    std::cout << "triangle ribbons: " << (positions.size() * sizeof(Point3f) + indices.size() * sizeof(UInt32) + triangles.size() * sizeof(Triangle)) / (1024.0 * 1024.0) << " MiB geometry" << std::endl;
+    Trace("  SAH", BVHAggregate(trianglePrimitives), rays);
+}
+
+// Run with --gtest_also_run_disabled_tests to compare a displaced quad grid
+// as bilinear patches against the same grid split into two triangles per
+// quad.
+TEST(BilinearPatch, DISABLED_QuadMeshBenchmark) {
+    const int n = 512;
+    std::vector<Point3f> positions;
+    for (int j = 0; j <= n; ++j)
+        for (int i = 0; i <= n; ++i) {
+            Float x = 2.0f * i / n - 1, y = 2.0f * j / n - 1;
+            positions.push_back(Point3f(x, y, 0.05f * std::sin(20 * x) * std::cos(17 * y)));
+        }
+    std::vector<UInt32> quadIndices, triangleIndices;
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < n; ++i) {
+            UInt32 v00 = j * (n + 1) + i, v10 = v00 + 1, v01 = v00 + n + 1, v11 = v01 + 1;
+            quadIndices.insert(quadIndices.end(), { v00, v10, v01, v11 });
+            triangleIndices.insert(triangleIndices.end(), { v00, v10, v11, v00, v11, v01 });
+        }
+
+    std::vector<Ray> rays;
+    for (int y = 0; y < 1024; ++y)
+        for (int x = 0; x < 1024; ++x) {
+            Vector3f d(2 * (x + 0.5f) / 1024 - 1, 2 * (y + 0.5f) / 1024 - 1, -2.0f);
+            rays.push_back(Ray(Point3f(0.3f, -0.2f, 2), Normalize(d)));
+        }
+
+    BilinearPatchMesh patchMesh(Transform(), positions, quadIndices);
+    std::vector<BilinearPatch> patches = BilinearPatch::CreatePatches(&patchMesh);
+    std::vector<Primitive> patchPrimitives;
+    for (BilinearPatch& patch : patches)
+        patchPrimitives.push_back(&patch);
+    std::cout << "bilinear patches: " << (positions.size() * sizeof(Point3f) + quadIndices.size() * sizeof(UInt32) + patches.size() * sizeof(BilinearPatch)) / (1024.0 * 1024.0) << " MiB geometry" << std::endl;
+    Trace("  SAH", BVHAggregate(patchPrimitives), rays);
+
+    TriangleMesh triangleMesh(Transform(), positions, triangleIndices);
+    std::vector<Triangle> triangles = Triangle::CreateTriangles(&triangleMesh);
+    std::vector<Primitive> trianglePrimitives;
+    for (Triangle& triangle : triangles)
+        trianglePrimitives.push_back(&triangle);
+    std::cout << "triangles: " << (positions.size() * sizeof(Point3f) + triangleIndices.size() * sizeof(UInt32) + triangles.size() * sizeof(Triangle)) / (1024.0 * 1024.0) << " MiB geometry" << std::endl;
+    Trace("  SAH", BVHAggregate(trianglePrimitives), rays);
+    BVHBuildOptions options;
+    options.m_leaf_format = BVHLeafFormat::Packed8;
+    Trace("  SAH, packed 8", BVHAggregate(trianglePrimitives, options), rays);
+}
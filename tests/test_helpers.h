@@ -0,0 +1,84 @@
+#ifndef _THEIA_TESTS_TEST_HELPERS_H_
+#define _THEIA_TESTS_TEST_HELPERS_H_
+#include "../Math/Math.h"
+#include "../Shape/Triangle.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Fixtures shared by the test files.
+
+using RNG = Theia::RandomNumberGenerator;
+
+inline Theia::Point3f RandomPoint(RNG& rng, Theia::Float extent) {
+    return Theia::Point3f(extent * (2 * rng.Uniform<Theia::Float>() - 1), extent * (2 * rng.Uniform<Theia::Float>() - 1), extent * (2 * rng.Uniform<Theia::Float>() - 1));
+}
+
+inline Theia::Vector3f RandomDirection(RNG& rng) {
+    while (true) {
+        Theia::Vector3f v(2 * rng.Uniform<Theia::Float>() - 1, 2 * rng.Uniform<Theia::Float>() - 1, 2 * rng.Uniform<Theia::Float>() - 1);
+        if (Theia::LengthSquared(v) > 1e-4f && Theia::LengthSquared(v) <= 1)
+            return Theia::Normalize(v);
+    }
+}
+
+// Pointers to the shapes, which must outlive them.
+template <typename S> std::vector<Theia::Primitive> Primitives(std::vector<S>& shapes) {
+    std::vector<Theia::Primitive> primitives;
+    for (S& shape : shapes)
+        primitives.push_back(&shape);
+    return primitives;
+}
+
+inline std::string TemporaryPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+inline void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(contents.data(), contents.size());
+}
+
+// n x n grid of quads over [-1, 1] in the xz plane, displaced in y by waves of the given height.
+inline std::unique_ptr<Theia::TriangleMesh> GridMesh(int n, const Theia::Transform& renderFromObject = Theia::Transform(), Theia::Float waveHeight = 0) {
+    std::vector<Theia::Point3f> positions;
+    std::vector<Theia::UInt32> indices;
+    for (int z = 0; z <= n; ++z)
+        for (int x = 0; x <= n; ++x) {
+            Theia::Float px = 2 * Theia::Float(x) / n - 1, pz = 2 * Theia::Float(z) / n - 1;
+            positions.push_back(Theia::Point3f(px, waveHeight == 0 ? 0 : waveHeight * std::sin(4 * px) * std::cos(3 * pz), pz));
+        }
+    for (int z = 0; z < n; ++z)
+        for (int x = 0; x < n; ++x) {
+            Theia::UInt32 k = z * (n + 1) + x;
+            for (Theia::UInt32 index : { k, k + 1, k + n + 2, k, k + n + 2, k + n + 1 })
+                indices.push_back(index);
+        }
+    return std::make_unique<Theia::TriangleMesh>(renderFromObject, positions, indices);
+}
+
+// GridMesh with waves of height 0.2, with their analytic normals and uvs, indexed the same way for every attribute.
+inline std::unique_ptr<Theia::TriangleMesh> WaveMesh(int n, const Theia::Transform& renderFromObject = Theia::Transform()) {
+    std::vector<Theia::Point3f> positions;
+    std::vector<Theia::Normal3f> normals;
+    std::vector<Theia::Point2f> uvs;
+    std::vector<Theia::UInt32> indices;
+    for (int z = 0; z <= n; ++z)
+        for (int x = 0; x <= n; ++x) {
+            Theia::Float px = 2 * Theia::Float(x) / n - 1, pz = 2 * Theia::Float(z) / n - 1;
+            positions.push_back(Theia::Point3f(px, 0.2f * std::sin(4 * px) * std::cos(3 * pz), pz));
+            Theia::Vector3f normal = Theia::Normalize(Theia::Vector3f(-0.8f * std::cos(4 * px) * std::cos(3 * pz), 1, 0.6f * std::sin(4 * px) * std::sin(3 * pz)));
+            normals.push_back(Theia::Normal3f(normal.m_x, normal.m_y, normal.m_z));
+            uvs.push_back(Theia::Point2f(Theia::Float(x) / n, Theia::Float(z) / n));
+        }
+    for (int z = 0; z < n; ++z)
+        for (int x = 0; x < n; ++x) {
+            Theia::UInt32 k = z * (n + 1) + x;
+            for (Theia::UInt32 index : { k, k + 1, k + n + 2, k, k + n + 2, k + n + 1 })
+                indices.push_back(index);
+        }
+    return std::make_unique<Theia::TriangleMesh>(renderFromObject, positions, indices, normals, uvs);
+}
+#endif
\ No newline at end of file